@@ -88,6 +88,17 @@ void addSecondsDurationOption(CLI::App &App, const std::string &Name,
   App.add_option(Name, Fun, Description, Defaulted);
 }
 
+void addMillisecondsDurationOption(CLI::App &App, const std::string &Name,
+                                   std::chrono::system_clock::duration &MSArg,
+                                   const std::string &Description = "",
+                                   bool Defaulted = false) {
+  CLI::callback_t Fun = [&MSArg](CLI::results_t Results) {
+    MSArg = std::chrono::milliseconds(std::stoi(Results[0]));
+    return true;
+  };
+  App.add_option(Name, Fun, Description, Defaulted);
+}
+
 CLI::Option *SetKeyValueOptions(CLI::App &App, const std::string &Name,
                                 const std::string &Description, bool Defaulted,
                                 const CLI::callback_t &Fun) {
@@ -173,6 +184,9 @@ void setCLIOptions(CLI::App &App, MainOpt &MainOptions) {
                  "<absolute/or/relative/directory> Directory which gets "
                  "prepended to the HDF output filenames in the file write "
                  "commands");
+  App.add_option("--source-profile-file", MainOptions.SourceProfileFile,
+                 "File in which per-source message statistics are stored "
+                 "at the end of a job and used to size chunks in later jobs");
   App.add_option("--log-file", MainOptions.LogFilename,
                  "Specify file to log to");
   App.add_option(
@@ -194,6 +208,48 @@ void setCLIOptions(CLI::App &App, MainOpt &MainOptions) {
   addMillisecondOption(App, "--streamer-ms-after-stop",
                        MainOptions.StreamerConfiguration.AfterStopTime,
                        "Streamer option - milliseconds after stop time", true);
+  App.add_option("--decode-threads",
+                 MainOptions.StreamerConfiguration.DecodeThreads,
+                 "Number of helper threads used for verifying large "
+                 "flatbuffers, 0 to verify all on the partition threads",
+                 true);
+  App.add_option("--decode-min-message-size",
+                 MainOptions.StreamerConfiguration.DecodeMinMessageSize,
+                 "Flatbuffers of at least this many bytes are verified by the "
+                 "decode helper threads",
+                 true);
+  addMillisecondOption(App, "--write-stall-timeout",
+                       MainOptions.StreamerConfiguration.WriteStallTimeout,
+                       "A write to file taking longer than this many "
+                       "milliseconds is reported as a stall",
+                       true);
+  addMillisecondOption(App, "--max-message-age",
+                       MainOptions.StreamerConfiguration.MaxMessageAge,
+                       "A message waiting longer than this many milliseconds "
+                       "to be written is reported as a stall",
+                       true);
+  App.add_option("--stall-dump-directory",
+                 MainOptions.StreamerConfiguration.StallDumpDirectory,
+                 "Directory to which the recent history of the writer is "
+                 "dumped when writing stalls, by default that of the file "
+                 "being written");
+  App.add_option("--consumer-memory-budget",
+                 MainOptions.StreamerConfiguration.ConsumerMemoryBudget,
+                 "Bytes of fetched messages that all Kafka consumers may hold, "
+                 "used to derive their fetch settings from the profiled "
+                 "rates of the topics, 0 to use the configured settings",
+                 true);
+  App.add_option("--preallocation-increment",
+                 MainOptions.StreamerConfiguration.PreallocationIncrement,
+                 "Bytes of disk space reserved at a time for the file being "
+                 "written, the expected size of the file up front, 0 to not "
+                 "reserve disk space",
+                 true);
+  App.add_option("--expected-byte-rate",
+                 MainOptions.StreamerConfiguration.ExpectedByteRate,
+                 "Bytes per second assumed when estimating the size of a file "
+                 "of which not all streams have been profiled",
+                 true);
   addSecondsDurationOption(
       App, "--kafka-metadata-max-timeout-seconds",
       MainOptions.StreamerConfiguration.BrokerSettings.MaxMetadataTimeout,
@@ -206,6 +262,13 @@ void setCLIOptions(CLI::App &App, MainOpt &MainOptions) {
       "Number of seconds to wait for recovery from kafka error before "
       "abandoning stream.",
       true);
+  addMillisecondsDurationOption(
+      App, "--end-of-partition-grace-ms",
+      MainOptions.StreamerConfiguration.BrokerSettings.EndOfPartitionGrace,
+      "Milliseconds to wait at the end of a partition after the stop time "
+      "for messages still on their way to the broker before checking if "
+      "the partition has been consumed; capped by the stop leeway.",
+      true);
   addKafkaOption(
       App, "-X,--kafka-config",
       MainOptions.StreamerConfiguration.BrokerSettings.KafkaConfiguration,
@@ -218,5 +281,14 @@ void setCLIOptions(CLI::App &App, MainOpt &MainOptions) {
                  "Writer aborts the whole job if one or more streams are "
                  "misconfigured and fail to start",
                  true);
+  App.add_option("--optimise-finished-files",
+                 MainOptions.OptimiseFinishedFiles,
+                 "Rewrite finished files in the background, while idle, into "
+                 "a layout that is faster to read",
+                 true);
+  App.add_option("--max-open-datasets", MainOptions.MaxOpenDatasets,
+                 "Maximum number of datasets kept open by writer modules that "
+                 "support buffering (f142), 0 for no limit",
+                 true);
   App.set_config("-c,--config-file", "", "Read configuration from an ini file");
 }
@@ -0,0 +1,643 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "FileOptimiser.h"
+#include "Filesystem.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <hdf5.h>
+#include <map>
+#include <optional>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace FileWriter {
+
+namespace {
+
+/// Datasets up to this size get compact layout, see also HDFFile.cpp.
+size_t const MaxCompactSize{8 * 1024};
+
+/// Datasets without filters up to this size get contiguous layout.
+size_t const MaxContiguousSize{16 * 1024 * 1024};
+
+/// Data is copied in blocks of about this size.
+size_t const CopyBlockSize{16 * 1024 * 1024};
+
+/// Metadata (and small raw data) is allocated in blocks of this size.
+hsize_t const MetaDataBlockSize{1024 * 1024};
+
+/// \brief Closes an HDF5 identifier when it goes out of scope.
+class Id {
+public:
+  Id(hid_t Identifier, herr_t (*CloseFunction)(hid_t), char const *What)
+      : Value(Identifier), Close(CloseFunction) {
+    if (Value < 0) {
+      throw std::runtime_error(fmt::format("Unable to {}.", What));
+    }
+  }
+  ~Id() { Close(Value); }
+  Id(Id const &) = delete;
+  Id &operator=(Id const &) = delete;
+  operator hid_t() const { return Value; }
+
+private:
+  hid_t Value;
+  herr_t (*Close)(hid_t);
+};
+
+/// \brief Closes a file descriptor when it goes out of scope.
+class Descriptor {
+public:
+  explicit Descriptor(int FileDescriptor) : Value(FileDescriptor) {}
+  ~Descriptor() {
+    if (Value >= 0) {
+      ::close(Value);
+    }
+  }
+  Descriptor(Descriptor const &) = delete;
+  Descriptor &operator=(Descriptor const &) = delete;
+  operator int() const { return Value; }
+
+  /// \brief Close the descriptor, returning the result of close().
+  int close() {
+    auto Result = ::close(Value);
+    Value = -1;
+    return Result;
+  }
+
+private:
+  int Value;
+};
+
+void check(herr_t Result, char const *What) {
+  if (Result < 0) {
+    throw std::runtime_error(fmt::format("Unable to {}.", What));
+  }
+}
+
+/// \brief Buffer for data read with the datatype of the file, which frees
+/// the variable length data allocated by HDF5.
+class ReadBuffer {
+public:
+  ReadBuffer(hid_t DataType, hid_t MemorySpace, size_t NrOfElements)
+      : Type(DataType), Space(MemorySpace),
+        Data(H5Tget_size(DataType) * NrOfElements),
+        VariableLength(H5Tdetect_class(DataType, H5T_VLEN) > 0 or
+                       H5Tis_variable_str(DataType) > 0) {}
+  ~ReadBuffer() {
+    if (VariableLength) {
+      H5Dvlen_reclaim(Type, Space, H5P_DEFAULT, Data.data());
+    }
+  }
+  ReadBuffer(ReadBuffer const &) = delete;
+  ReadBuffer &operator=(ReadBuffer const &) = delete;
+  void *data() { return Data.data(); }
+  bool empty() const { return Data.empty(); }
+
+private:
+  hid_t Type;
+  hid_t Space;
+  std::vector<char> Data;
+  bool VariableLength;
+};
+
+/// \brief Type of an object and a key that identifies it in its file.
+struct ObjectInfo {
+  std::string Key;
+  H5O_type_t Type;
+};
+
+/// \brief Get the type and identity of an object.
+///
+/// HDF5 versions after 1.10, which identify objects by a token instead of
+/// by their address, are not supported (see HDFFile.cpp).
+///
+/// \return The object info or an empty optional if it could not be read.
+std::optional<ObjectInfo> objectInfo(hid_t Location, char const *Name) {
+  H5O_info_t Info;
+#if H5_VERSION_GE(1, 10, 3)
+  auto Result =
+      H5Oget_info_by_name2(Location, Name, &Info, H5O_INFO_BASIC, H5P_DEFAULT);
+#else
+  auto Result = H5Oget_info_by_name(Location, Name, &Info, H5P_DEFAULT);
+#endif
+  if (Result < 0) {
+    return {};
+  }
+  return ObjectInfo{std::string(reinterpret_cast<char const *>(&Info.addr),
+                                sizeof(Info.addr)),
+                    Info.type};
+}
+
+struct CopyState {
+  hid_t TargetFile;
+  std::function<bool()> const &Stop;
+  /// Descriptor of the target file, used to start writing the copied data
+  /// to disk while copying, -1 if not available.
+  int TargetDescriptor{-1};
+  /// Path in the target file of the objects copied so far, by their key
+  /// (see objectInfo()) in the source file.
+  std::map<std::string, std::string> CopiedObjects;
+  OptimiseStatistics Statistics;
+};
+
+void checkIfStopped(CopyState const &State) {
+  if (State.Stop()) {
+    throw std::runtime_error("Optimisation stopped.");
+  }
+}
+
+herr_t copyAttribute(hid_t Source, char const *Name, H5A_info_t const *,
+                     void *TargetPtr) {
+  try {
+    auto Target = *static_cast<hid_t *>(TargetPtr);
+    Id Attribute(H5Aopen(Source, Name, H5P_DEFAULT), H5Aclose,
+                 "open attribute");
+    Id Type(H5Aget_type(Attribute), H5Tclose, "get attribute type");
+    Id Space(H5Aget_space(Attribute), H5Sclose, "get attribute dataspace");
+    Id Copy(H5Acreate2(Target, Name, Type, Space, H5P_DEFAULT, H5P_DEFAULT),
+            H5Aclose, "create attribute");
+    ReadBuffer Buffer(Type, Space,
+                      static_cast<size_t>(H5Sget_simple_extent_npoints(Space)));
+    if (not Buffer.empty()) {
+      check(H5Aread(Attribute, Type, Buffer.data()), "read attribute");
+      check(H5Awrite(Copy, Type, Buffer.data()), "write attribute");
+    }
+  } catch (std::exception const &) {
+    return -1;
+  }
+  return 0;
+}
+
+void copyAttributes(hid_t Source, hid_t Target) {
+  hsize_t Index{0};
+  check(H5Aiterate2(Source, H5_INDEX_NAME, H5_ITER_NATIVE, &Index,
+                    copyAttribute, &Target),
+        "copy attributes");
+}
+
+/// \brief Start writing the data copied so far to disk, without waiting for
+/// it, so that the final fsync() of the file, which can not be interrupted,
+/// does not take long.
+void startWriteBack(CopyState const &State) {
+#if defined(__linux__)
+  if (State.TargetDescriptor >= 0) {
+    sync_file_range(State.TargetDescriptor, 0, 0, SYNC_FILE_RANGE_WRITE);
+  }
+#else
+  static_cast<void>(State);
+#endif
+}
+
+/// \brief Copy the data of a dataset in blocks of rows.
+void copyData(hid_t Source, hid_t Target, hid_t Type,
+              std::vector<hsize_t> const &Dims, hsize_t RowsPerBlock,
+              CopyState const &State) {
+  if (Dims.empty() or
+      std::find(Dims.begin(), Dims.end(), 0) != Dims.end()) {
+    return;
+  }
+  size_t ElementsPerRow{1};
+  for (size_t i = 1; i < Dims.size(); ++i) {
+    ElementsPerRow *= Dims[i];
+  }
+  auto Rank = static_cast<int>(Dims.size());
+  for (hsize_t Row = 0; Row < Dims[0]; Row += RowsPerBlock) {
+    checkIfStopped(State);
+    std::vector<hsize_t> Offset(Dims.size(), 0);
+    Offset[0] = Row;
+    auto Count = Dims;
+    Count[0] = std::min(RowsPerBlock, Dims[0] - Row);
+    Id MemorySpace(H5Screate_simple(Rank, Count.data(), nullptr), H5Sclose,
+                   "create dataspace");
+    Id SourceSpace(H5Dget_space(Source), H5Sclose, "get dataspace");
+    check(H5Sselect_hyperslab(SourceSpace, H5S_SELECT_SET, Offset.data(),
+                              nullptr, Count.data(), nullptr),
+          "select rows");
+    Id TargetSpace(H5Dget_space(Target), H5Sclose, "get dataspace");
+    check(H5Sselect_hyperslab(TargetSpace, H5S_SELECT_SET, Offset.data(),
+                              nullptr, Count.data(), nullptr),
+          "select rows");
+    ReadBuffer Buffer(Type, MemorySpace, Count[0] * ElementsPerRow);
+    check(H5Dread(Source, Type, MemorySpace, SourceSpace, H5P_DEFAULT,
+                  Buffer.data()),
+          "read data");
+    check(H5Dwrite(Target, Type, MemorySpace, TargetSpace, H5P_DEFAULT,
+                   Buffer.data()),
+          "write data");
+    startWriteBack(State);
+  }
+}
+
+/// \brief Copy a dataset, changing its layout if it is chunked.
+void copyDataset(hid_t SourceGroup, char const *Name, hid_t TargetGroup,
+                 CopyState &State) {
+  Id Dataset(H5Dopen2(SourceGroup, Name, H5P_DEFAULT), H5Dclose,
+             "open dataset");
+  Id CreationList(H5Dget_create_plist(Dataset), H5Pclose,
+                  "get dataset creation properties");
+  Id Space(H5Dget_space(Dataset), H5Sclose, "get dataspace");
+  Id Type(H5Dget_type(Dataset), H5Tclose, "get datatype");
+  auto const IsSimple = H5Sget_simple_extent_type(Space) == H5S_SIMPLE;
+  auto Rank = IsSimple ? H5Sget_simple_extent_ndims(Space) : 0;
+  std::vector<hsize_t> Dims(static_cast<size_t>(std::max(Rank, 0)));
+  H5Sget_simple_extent_dims(Space, Dims.data(), nullptr);
+  auto NrOfElements = static_cast<size_t>(H5Sget_simple_extent_npoints(Space));
+  auto DataSize = H5Tget_size(Type) * NrOfElements;
+  if (H5Pget_layout(CreationList) != H5D_CHUNKED or Rank <= 0) {
+    if (not IsSimple or Rank <= 0 or DataSize <= CopyBlockSize) {
+      check(H5Ocopy(SourceGroup, Name, TargetGroup, Name, H5P_DEFAULT,
+                    H5P_DEFAULT),
+            "copy dataset");
+      return;
+    }
+    // Large datasets are copied in blocks rather than by H5Ocopy(), so that
+    // the copy can be stopped.
+    Id Copy(H5Dcreate2(TargetGroup, Name, Type, Space, H5P_DEFAULT,
+                       CreationList, H5P_DEFAULT),
+            H5Dclose, "create dataset");
+    auto RowSize =
+        std::max<size_t>(1, DataSize / std::max<hsize_t>(1, Dims[0]));
+    copyData(Dataset, Copy, Type, Dims,
+             std::max<hsize_t>(1, CopyBlockSize / RowSize), State);
+    copyAttributes(Dataset, Copy);
+    return;
+  }
+  std::vector<hsize_t> ChunkDims(Dims.size());
+  H5Pget_chunk(CreationList, Rank, ChunkDims.data());
+
+  Id NewCreationList(H5Pcopy(CreationList), H5Pclose,
+                     "copy dataset creation properties");
+  auto HasFilters = H5Pget_nfilters(CreationList) > 0;
+  if (DataSize <= MaxContiguousSize and (not HasFilters or DataSize == 0)) {
+    if (HasFilters) {
+      check(H5Premove_filter(NewCreationList, H5Z_FILTER_ALL),
+            "remove filters");
+    }
+    auto Layout = (DataSize > 0 and DataSize <= MaxCompactSize)
+                      ? H5D_COMPACT
+                      : H5D_CONTIGUOUS;
+    check(H5Pset_layout(NewCreationList, Layout), "set layout");
+    ++State.Statistics.ConsolidatedDatasets;
+  } else {
+    // The extent is fixed, so chunks larger than the dataset only waste
+    // space.
+    auto NewChunkDims = ChunkDims;
+    for (size_t i = 0; i < Dims.size(); ++i) {
+      NewChunkDims[i] = std::max<hsize_t>(1, std::min(ChunkDims[i], Dims[i]));
+    }
+    check(H5Pset_chunk(NewCreationList, Rank, NewChunkDims.data()),
+          "set chunk size");
+    ++State.Statistics.TrimmedDatasets;
+  }
+  Id NewSpace(H5Screate_simple(Rank, Dims.data(), nullptr), H5Sclose,
+              "create dataspace");
+  Id Copy(H5Dcreate2(TargetGroup, Name, Type, NewSpace, H5P_DEFAULT,
+                     NewCreationList, H5P_DEFAULT),
+          H5Dclose, "create dataset");
+
+  // Copy whole chunks at a time.
+  auto RowSize = std::max<size_t>(1, DataSize / std::max<hsize_t>(1, Dims[0]));
+  auto ChunkRows = std::max<hsize_t>(1, ChunkDims[0]);
+  auto RowsPerBlock =
+      std::max<hsize_t>(1, CopyBlockSize / RowSize / ChunkRows) * ChunkRows;
+  copyData(Dataset, Copy, Type, Dims, RowsPerBlock, State);
+  copyAttributes(Dataset, Copy);
+}
+
+size_t nrOfElements(hid_t Group, char const *Name) {
+  Id Dataset(H5Dopen2(Group, Name, H5P_DEFAULT), H5Dclose, "open dataset");
+  Id Space(H5Dget_space(Dataset), H5Sclose, "get dataspace");
+  return static_cast<size_t>(H5Sget_simple_extent_npoints(Space));
+}
+
+bool isDataset(hid_t Group, char const *Name) {
+  if (H5Lexists(Group, Name, H5P_DEFAULT) <= 0) {
+    return false;
+  }
+  auto Info = objectInfo(Group, Name);
+  return Info and Info->Type == H5O_TYPE_DATASET;
+}
+
+/// \brief Check if a group has a chunked time dataset next to empty cue
+/// datasets, as written by e.g. the f142 writer module.
+bool hasEmptyCues(hid_t Group) {
+  if (not(isDataset(Group, "time") and isDataset(Group, "cue_index") and
+          isDataset(Group, "cue_timestamp_zero"))) {
+    return false;
+  }
+  if (nrOfElements(Group, "cue_index") != 0 or
+      nrOfElements(Group, "cue_timestamp_zero") != 0 or
+      nrOfElements(Group, "time") == 0) {
+    return false;
+  }
+  Id Time(H5Dopen2(Group, "time", H5P_DEFAULT), H5Dclose, "open dataset");
+  Id Space(H5Dget_space(Time), H5Sclose, "get dataspace");
+  Id CreationList(H5Dget_create_plist(Time), H5Pclose,
+                  "get dataset creation properties");
+  return H5Sget_simple_extent_ndims(Space) == 1 and
+         H5Pget_layout(CreationList) == H5D_CHUNKED;
+}
+
+/// \brief Replace an (empty) cue dataset in the target file by one holding
+/// the given values, keeping the datatype and attributes of the original.
+void writeCueDataset(hid_t SourceGroup, hid_t TargetGroup, char const *Name,
+                     std::vector<std::uint64_t> const &Values) {
+  Id Source(H5Dopen2(SourceGroup, Name, H5P_DEFAULT), H5Dclose,
+            "open dataset");
+  Id Type(H5Dget_type(Source), H5Tclose, "get datatype");
+  check(H5Ldelete(TargetGroup, Name, H5P_DEFAULT), "delete dataset");
+  hsize_t Size{Values.size()};
+  Id Space(H5Screate_simple(1, &Size, nullptr), H5Sclose,
+           "create dataspace");
+  Id CreationList(H5Pcreate(H5P_DATASET_CREATE), H5Pclose,
+                  "create dataset creation properties");
+  check(H5Pset_layout(CreationList, H5Tget_size(Type) * Values.size() <=
+                                            MaxCompactSize
+                                        ? H5D_COMPACT
+                                        : H5D_CONTIGUOUS),
+        "set layout");
+  Id Target(H5Dcreate2(TargetGroup, Name, Type, Space, H5P_DEFAULT,
+                       CreationList, H5P_DEFAULT),
+            H5Dclose, "create dataset");
+  check(H5Dwrite(Target, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                 Values.data()),
+        "write dataset");
+  copyAttributes(Source, Target);
+}
+
+/// \brief Write a cue entry for the first element of every chunk of the
+/// time dataset.
+void writeCues(hid_t SourceGroup, hid_t TargetGroup) {
+  Id Time(H5Dopen2(SourceGroup, "time", H5P_DEFAULT), H5Dclose,
+          "open dataset");
+  Id CreationList(H5Dget_create_plist(Time), H5Pclose,
+                  "get dataset creation properties");
+  hsize_t Interval{1};
+  H5Pget_chunk(CreationList, 1, &Interval);
+  Interval = std::max<hsize_t>(1, Interval);
+
+  std::vector<std::uint64_t> Index;
+  std::vector<hsize_t> Positions;
+  auto NrOfTimes = nrOfElements(SourceGroup, "time");
+  for (hsize_t Position = 0; Position < NrOfTimes; Position += Interval) {
+    Index.push_back(Position);
+    Positions.push_back(Position);
+  }
+  std::vector<std::uint64_t> TimestampZero(Positions.size());
+  Id FileSpace(H5Dget_space(Time), H5Sclose, "get dataspace");
+  check(H5Sselect_elements(FileSpace, H5S_SELECT_SET, Positions.size(),
+                           Positions.data()),
+        "select elements");
+  hsize_t NrOfCues{Positions.size()};
+  Id MemorySpace(H5Screate_simple(1, &NrOfCues, nullptr), H5Sclose,
+                 "create dataspace");
+  check(H5Dread(Time, H5T_NATIVE_UINT64, MemorySpace, FileSpace, H5P_DEFAULT,
+                TimestampZero.data()),
+        "read time");
+  writeCueDataset(SourceGroup, TargetGroup, "cue_index", Index);
+  writeCueDataset(SourceGroup, TargetGroup, "cue_timestamp_zero",
+                  TimestampZero);
+}
+
+herr_t appendLinkName(hid_t, char const *Name, H5L_info_t const *,
+                      void *NamesPtr) {
+  // Exceptions must not pass through the HDF5 library.
+  try {
+    static_cast<std::vector<std::string> *>(NamesPtr)->emplace_back(Name);
+  } catch (std::exception const &) {
+    return -1;
+  }
+  return 0;
+}
+
+void copyGroup(hid_t Source, hid_t Target, std::string const &Path,
+               CopyState &State);
+
+void copyLink(hid_t SourceGroup, char const *Name, hid_t TargetGroup,
+              std::string const &Path, CopyState &State) {
+  H5L_info_t LinkInfo;
+  check(H5Lget_info(SourceGroup, Name, &LinkInfo, H5P_DEFAULT),
+        "get link info");
+  if (LinkInfo.type == H5L_TYPE_SOFT or LinkInfo.type == H5L_TYPE_EXTERNAL) {
+    std::vector<char> Value(LinkInfo.u.val_size);
+    check(H5Lget_val(SourceGroup, Name, Value.data(), Value.size(),
+                     H5P_DEFAULT),
+          "get link value");
+    if (LinkInfo.type == H5L_TYPE_SOFT) {
+      check(H5Lcreate_soft(Value.data(), TargetGroup, Name, H5P_DEFAULT,
+                           H5P_DEFAULT),
+            "create soft link");
+    } else {
+      char const *File{nullptr};
+      char const *Object{nullptr};
+      unsigned Flags{0};
+      check(H5Lunpack_elink_val(Value.data(), Value.size(), &Flags, &File,
+                                &Object),
+            "unpack external link");
+      check(H5Lcreate_external(File, Object, TargetGroup, Name, H5P_DEFAULT,
+                               H5P_DEFAULT),
+            "create external link");
+    }
+    return;
+  }
+  if (LinkInfo.type != H5L_TYPE_HARD) {
+    check(H5Lcopy(SourceGroup, Name, TargetGroup, Name, H5P_DEFAULT,
+                  H5P_DEFAULT),
+          "copy link");
+    return;
+  }
+
+  auto Info = objectInfo(SourceGroup, Name);
+  if (not Info) {
+    throw std::runtime_error("Unable to get object info.");
+  }
+  auto Copied = State.CopiedObjects.find(Info->Key);
+  if (Copied != State.CopiedObjects.end()) {
+    // A second hard link to an object, e.g. created from a "link" in the
+    // nexus structure.
+    check(H5Lcreate_hard(State.TargetFile, Copied->second.c_str(),
+                         TargetGroup, Name, H5P_DEFAULT, H5P_DEFAULT),
+          "create hard link");
+    return;
+  }
+  auto ObjectPath = Path + "/" + Name;
+  State.CopiedObjects[Info->Key] = ObjectPath;
+  if (Info->Type == H5O_TYPE_GROUP) {
+    Id Group(H5Gopen2(SourceGroup, Name, H5P_DEFAULT), H5Gclose,
+             "open group");
+    Id CreationList(H5Gget_create_plist(Group), H5Pclose,
+                    "get group creation properties");
+    Id NewGroup(H5Gcreate2(TargetGroup, Name, H5P_DEFAULT, CreationList,
+                           H5P_DEFAULT),
+                H5Gclose, "create group");
+    copyGroup(Group, NewGroup, ObjectPath, State);
+  } else if (Info->Type == H5O_TYPE_DATASET) {
+    copyDataset(SourceGroup, Name, TargetGroup, State);
+  } else {
+    check(H5Ocopy(SourceGroup, Name, TargetGroup, Name, H5P_DEFAULT,
+                  H5P_DEFAULT),
+          "copy object");
+  }
+}
+
+void copyGroup(hid_t Source, hid_t Target, std::string const &Path,
+               CopyState &State) {
+  checkIfStopped(State);
+  copyAttributes(Source, Target);
+  std::vector<std::string> Names;
+  hsize_t Index{0};
+  check(H5Literate(Source, H5_INDEX_NAME, H5_ITER_INC, &Index, appendLinkName,
+                   &Names),
+        "iterate over links");
+  for (auto const &Name : Names) {
+    copyLink(Source, Name.c_str(), Target, Path, State);
+  }
+  if (hasEmptyCues(Source)) {
+    writeCues(Source, Target);
+    ++State.Statistics.CueIndicesWritten;
+  }
+}
+
+/// \brief Give the optimised file the permissions and ownership of the
+/// original and make sure that it is on disk before it replaces the original.
+void finishFile(std::string const &Filename, std::string const &Original) {
+  struct stat OriginalStatus {};
+  if (::stat(Original.c_str(), &OriginalStatus) != 0) {
+    throw std::runtime_error(fmt::format("Unable to get the status of {}: {}",
+                                         Original, std::strerror(errno)));
+  }
+  Descriptor FileDescriptor(::open(Filename.c_str(), O_RDONLY));
+  if (FileDescriptor < 0) {
+    throw std::runtime_error(
+        fmt::format("Unable to open {} for syncing.", Filename));
+  }
+  auto Result = fchmod(FileDescriptor, OriginalStatus.st_mode & 07777);
+  if (Result == 0 and
+      fchown(FileDescriptor, OriginalStatus.st_uid, OriginalStatus.st_gid) !=
+          0) {
+    // Only privileged processes can give files away to other users.
+    Result = fchown(FileDescriptor, static_cast<uid_t>(-1),
+                    OriginalStatus.st_gid);
+  }
+  if (Result != 0) {
+    throw std::runtime_error(fmt::format(
+        "Unable to give {} the permissions of {}: {}", Filename, Original,
+        std::strerror(errno)));
+  }
+  Result = fsync(FileDescriptor);
+  if (FileDescriptor.close() != 0 or Result != 0) {
+    throw std::runtime_error(fmt::format("Unable to sync {}.", Filename));
+  }
+}
+
+void lowerThreadPriority() {
+#if defined(__linux__)
+  // The nice value is a property of the thread on Linux.
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+}
+
+} // namespace
+
+OptimiseStatistics optimiseFile(std::string const &Filename,
+                                std::function<bool()> const &Stop) {
+  auto TemporaryFilename = Filename + ".optimising";
+  CopyState State{-1, Stop, -1, {}, {}};
+  State.Statistics.SizeBefore = fs::file_size(Filename);
+  try {
+    {
+      // All handles are closed by their guards at the end of this block,
+      // also if the copy fails.
+      Id Source(H5Fopen(Filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT),
+                H5Fclose, "open file");
+      Id AccessList(H5Pcreate(H5P_FILE_ACCESS), H5Pclose,
+                    "create file access properties");
+      check(H5Pset_meta_block_size(AccessList, MetaDataBlockSize),
+            "set metadata block size");
+      check(H5Pset_small_data_block_size(AccessList, MetaDataBlockSize),
+            "set small data block size");
+      Id Target(H5Fcreate(TemporaryFilename.c_str(), H5F_ACC_TRUNC,
+                          H5P_DEFAULT, AccessList),
+                H5Fclose, "create file");
+      State.TargetFile = Target;
+      Descriptor TargetDescriptor(::open(TemporaryFilename.c_str(), O_RDONLY));
+      State.TargetDescriptor = TargetDescriptor;
+      Id SourceRoot(H5Gopen2(Source, "/", H5P_DEFAULT), H5Gclose,
+                    "open root group");
+      Id TargetRoot(H5Gopen2(Target, "/", H5P_DEFAULT), H5Gclose,
+                    "open root group");
+      auto RootInfo = objectInfo(SourceRoot, ".");
+      if (not RootInfo) {
+        throw std::runtime_error("Unable to get object info.");
+      }
+      State.CopiedObjects[RootInfo->Key] = "/";
+      copyGroup(SourceRoot, TargetRoot, "", State);
+    }
+    checkIfStopped(State);
+    finishFile(TemporaryFilename, Filename);
+    fs::rename(TemporaryFilename, Filename);
+  } catch (...) {
+    std::error_code Ignored;
+    fs::remove(TemporaryFilename, Ignored);
+    throw;
+  }
+  State.Statistics.SizeAfter = fs::file_size(Filename);
+  return State.Statistics;
+}
+
+void FileOptimiser::optimise(std::string const &Filename) {
+  auto JobGeneration = Generation.load();
+  Executor.sendLowPriorityWork([this, Filename, JobGeneration]() {
+    lowerThreadPriority();
+    std::lock_guard<std::mutex> Lock(WorkMutex);
+    auto Stop = [this, JobGeneration]() {
+      return Generation.load() != JobGeneration;
+    };
+    if (Stop()) {
+      Logger->info("Not optimising file {} as a new file is being written.",
+                   Filename);
+      return;
+    }
+    auto StartTime = std::chrono::steady_clock::now();
+    try {
+      auto Statistics = optimiseFile(Filename, Stop);
+      Logger->info(
+          "Optimised file {} in {} ms: {} datasets consolidated, {} trimmed, "
+          "{} cue indices written, size {} -> {} bytes.",
+          Filename,
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - StartTime)
+              .count(),
+          Statistics.ConsolidatedDatasets, Statistics.TrimmedDatasets,
+          Statistics.CueIndicesWritten, Statistics.SizeBefore,
+          Statistics.SizeAfter);
+    } catch (std::exception const &E) {
+      Logger->warn("File {} was not optimised: {}", Filename, E.what());
+    }
+  });
+}
+
+void FileOptimiser::cancel() {
+  ++Generation;
+  // Wait for the file being optimised to be abandoned.
+  std::lock_guard<std::mutex> Lock(WorkMutex);
+}
+
+} // namespace FileWriter
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+/// \file Rewriting of finished files into a layout that is faster to read.
+
+#pragma once
+
+#include "ThreadedExecutor.h"
+#include "logger.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace FileWriter {
+
+/// \brief What was done by optimiseFile().
+struct OptimiseStatistics {
+  /// Small datasets rewritten with compact or contiguous layout.
+  size_t ConsolidatedDatasets{0};
+  /// Chunked datasets rewritten with their extent fixed to their size.
+  size_t TrimmedDatasets{0};
+  /// Groups of which the empty cue datasets were filled in.
+  size_t CueIndicesWritten{0};
+  std::uintmax_t SizeBefore{0};
+  std::uintmax_t SizeAfter{0};
+};
+
+/// \brief Rewrite a closed file into a layout that is faster to read.
+///
+/// Files written while streaming have many partially filled chunks, datasets
+/// that can be extended indefinitely and metadata spread out over the file.
+/// The file is copied to a temporary file next to it in which:
+/// - small datasets have compact or contiguous layout,
+/// - the extent of chunked datasets is fixed to their size,
+/// - empty `cue_index`/`cue_timestamp_zero` datasets next to a `time` dataset
+///   are filled in, with one entry per chunk of `time`,
+/// - metadata is allocated in large contiguous blocks.
+///
+/// The temporary file gets the permissions and ownership of the original and
+/// then replaces it by an (atomic) rename. If anything fails, the original
+/// file is left as it is.
+///
+/// \param Filename The file, which must not be open.
+/// \param Stop Called between the steps of the optimisation, e.g. between
+/// the blocks of a large dataset, which is abandoned if it returns true.
+/// \return Statistics of the optimisation.
+/// \throw std::runtime_error If the file could not be optimised or if the
+/// optimisation was stopped.
+OptimiseStatistics optimiseFile(std::string const &Filename,
+                                std::function<bool()> const &Stop = [] {
+                                  return false;
+                                });
+
+/// \brief Optimises finished files in a background thread.
+///
+/// The HDF5 library is not used from more than one thread at a time, so the
+/// optimisation has to be cancelled before a new file is written.
+class FileOptimiser {
+public:
+  FileOptimiser() = default;
+
+  /// \brief Abandons the file being optimised, see cancel().
+  ~FileOptimiser() { ++Generation; }
+
+  /// \brief Queue a closed file for optimisation.
+  void optimise(std::string const &Filename);
+
+  /// \brief Abandon the file being optimised and the queued files.
+  ///
+  /// Returns when the optimiser no longer uses the HDF5 library, which is
+  /// after at most the copy of one block of data. The files that were not
+  /// optimised are left as they are.
+  void cancel();
+
+private:
+  SharedLogger Logger = getLogger();
+  std::atomic<uint64_t> Generation{0};
+  std::mutex WorkMutex;
+  ThreadedExecutor Executor; // Must be last
+};
+
+} // namespace FileWriter
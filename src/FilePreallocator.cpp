@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "FilePreallocator.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+namespace FileWriter {
+
+FilePreallocator::FilePreallocator(std::string const &Path,
+                                   std::uint64_t Increment,
+                                   Metrics::Registrar const &MetricReg,
+                                   double MinFreeFraction)
+    : Path(Path), Increment(std::max(Increment, std::uint64_t(1))),
+      MinFreeFraction(std::clamp(MinFreeFraction, 0.0, 1.0)),
+      Registrar(MetricReg.getNewRegistrar("preallocation")) {
+  FileDescriptor = open(Path.c_str(), O_WRONLY);
+  if (FileDescriptor < 0) {
+    throw std::runtime_error(
+        fmt::format("Unable to open \"{}\" to reserve disk space: {}", Path,
+                    std::strerror(errno)));
+  }
+  Registrar.registerMetric(Preallocations, {Metrics::LogTo::CARBON});
+  Registrar.registerMetric(PreallocatedBytes, {Metrics::LogTo::CARBON});
+  Registrar.registerMetric(UnreservedGrowths,
+                           {Metrics::LogTo::CARBON, Metrics::LogTo::LOG_MSG});
+}
+
+FilePreallocator::~FilePreallocator() { release(); }
+
+void FilePreallocator::reserve(std::uint64_t Size) {
+  std::lock_guard<std::mutex> Lock(FileMutex);
+  allocate(Size);
+}
+
+void FilePreallocator::update() {
+  std::lock_guard<std::mutex> Lock(FileMutex);
+  if (FileDescriptor < 0 or not Supported) {
+    return;
+  }
+  auto const Size = fileSize();
+  if (Size + Increment / 2 < ReservedSize) {
+    return;
+  }
+  if (Size > ReservedSize) {
+    ++UnreservedGrowths;
+  }
+  allocate(Size + Increment);
+}
+
+void FilePreallocator::release() {
+  std::lock_guard<std::mutex> Lock(FileMutex);
+  if (FileDescriptor < 0) {
+    return;
+  }
+  // Truncating to the current size frees the blocks reserved beyond it.
+  if (ReservedSize > 0 and
+      ftruncate(FileDescriptor, static_cast<off_t>(fileSize())) != 0) {
+    LOG_WARN("Unable to release the disk space reserved for \"{}\": {}", Path,
+             std::strerror(errno));
+  }
+  close(FileDescriptor);
+  FileDescriptor = -1;
+  ReservedSize = 0;
+}
+
+std::uint64_t FilePreallocator::reservedSize() const {
+  std::lock_guard<std::mutex> Lock(FileMutex);
+  return ReservedSize;
+}
+
+std::uint64_t FilePreallocator::fileSize() const {
+  struct stat FileStatus {};
+  if (fstat(FileDescriptor, &FileStatus) != 0) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(FileStatus.st_size);
+}
+
+std::uint64_t FilePreallocator::spaceToSpare() const {
+  struct statvfs FileSystemStatus {};
+  if (fstatvfs(FileDescriptor, &FileSystemStatus) != 0) {
+    return 0;
+  }
+  auto const BlockSize = static_cast<double>(FileSystemStatus.f_frsize);
+  auto const Available =
+      static_cast<double>(FileSystemStatus.f_bavail) * BlockSize;
+  auto const MinFree = static_cast<double>(FileSystemStatus.f_blocks) *
+                       BlockSize * MinFreeFraction;
+  return Available > MinFree ? static_cast<std::uint64_t>(Available - MinFree)
+                             : 0;
+}
+
+void FilePreallocator::allocate(std::uint64_t Size) {
+  if (FileDescriptor < 0 or not Supported or Size <= ReservedSize) {
+    return;
+  }
+  if (auto const Spare = spaceToSpare(); Size - ReservedSize > Spare) {
+    if (not LowSpaceReported) {
+      LOG_WARN("Reserving less disk space for \"{}\" than expected, to leave "
+               "{:.0f}% of the file system free.",
+               Path, MinFreeFraction * 100);
+      LowSpaceReported = true;
+    }
+    Size = ReservedSize + Spare;
+    if (Size <= ReservedSize) {
+      return;
+    }
+  }
+#ifdef __linux__
+  auto const Offset = ReservedSize;
+  if (fallocate(FileDescriptor, FALLOC_FL_KEEP_SIZE,
+                static_cast<off_t>(Offset),
+                static_cast<off_t>(Size - Offset)) != 0) {
+    if (errno == EOPNOTSUPP or errno == ENOSYS) {
+      LOG_WARN("The file system of \"{}\" does not support reserving disk "
+               "space; the file is not preallocated.",
+               Path);
+      Supported = false;
+    } else {
+      LOG_WARN("Unable to reserve {} bytes of disk space for \"{}\": {}",
+               Size - Offset, Path, std::strerror(errno));
+    }
+    return;
+  }
+  ReservedSize = Size;
+  ++Preallocations;
+  PreallocatedBytes += static_cast<int64_t>(Size - Offset);
+#else
+  Supported = false;
+#endif
+}
+
+std::uint64_t estimateFileSize(double ByteRate,
+                               std::chrono::milliseconds StartTime,
+                               time_point StopTime, std::uint64_t Increment,
+                               std::chrono::seconds Horizon) {
+  Increment = std::max(Increment, std::uint64_t(1));
+  if (StopTime == time_point::max() or ByteRate <= 0.0) {
+    return Increment;
+  }
+  auto const Duration =
+      std::min(std::chrono::duration<double>(StopTime - time_point(StartTime)),
+               std::chrono::duration<double>(Horizon))
+          .count();
+  if (Duration <= 0.0) {
+    return Increment;
+  }
+  auto const NrOfIncrements =
+      std::ceil(ByteRate * Duration / static_cast<double>(Increment));
+  return std::max(std::uint64_t(1),
+                  static_cast<std::uint64_t>(NrOfIncrements)) *
+         Increment;
+}
+
+} // namespace FileWriter
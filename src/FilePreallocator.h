@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+/// \file Reservation of disk space for the file being written.
+
+#pragma once
+
+#include "Metrics/Metric.h"
+#include "Metrics/Registrar.h"
+#include "TimeUtility.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace FileWriter {
+
+/// \brief Reserves disk space for a file ahead of it being written.
+///
+/// HDF5 extends a file a few MB at a time, which fragments it badly on some
+/// (parallel) file systems. The expected size of the file is reserved up
+/// front and a large increment is reserved whenever the file gets close to
+/// the end of the reserved space. The space is reserved without changing the
+/// size of the file (`FALLOC_FL_KEEP_SIZE`), so HDF5 does not notice it, and
+/// what was not used is released by release().
+///
+/// The file is opened separately and no HDF5 calls are made, so update() can
+/// be called from another thread than the one writing the file.
+///
+/// Space is only reserved as long as a fraction of the file system is left
+/// free, so that a large estimate does not fill up the disk for the other
+/// files on it.
+///
+/// \note Space is only reserved on Linux and on file systems that support
+/// `fallocate()`; elsewhere the class does nothing.
+class FilePreallocator {
+public:
+  /// \param Path The file, which must exist.
+  /// \param Increment The number of bytes reserved at a time once the file
+  /// gets close to the end of the reserved space.
+  /// \param MetricReg Registrar for the preallocation metrics.
+  /// \param MinFreeFraction The fraction of the file system that is left
+  /// free; reservations are cut short to leave this much.
+  /// \throw std::runtime_error If the file could not be opened.
+  FilePreallocator(std::string const &Path, std::uint64_t Increment,
+                   Metrics::Registrar const &MetricReg,
+                   double MinFreeFraction = 0.05);
+
+  /// \brief Releases the space that was not used, see release().
+  ~FilePreallocator();
+
+  FilePreallocator(FilePreallocator const &) = delete;
+  FilePreallocator &operator=(FilePreallocator const &) = delete;
+
+  /// \brief Make sure that the first \p Size bytes of the file are reserved.
+  void reserve(std::uint64_t Size);
+
+  /// \brief Reserve another increment if the file has grown to within half
+  /// an increment of the end of the reserved space. Called periodically.
+  void update();
+
+  /// \brief Release the space reserved beyond the end of the file.
+  ///
+  /// Should only be called once the file has been closed, as the size of the
+  /// file at this point is taken to be its final size. Nothing is reserved
+  /// after this.
+  void release();
+
+  /// \brief The number of bytes from the start of the file that are reserved.
+  std::uint64_t reservedSize() const;
+
+private:
+  std::uint64_t fileSize() const;
+  /// The number of bytes that can be reserved without leaving less than
+  /// MinFreeFraction of the file system free.
+  std::uint64_t spaceToSpare() const;
+  void allocate(std::uint64_t Size);
+
+  std::string const Path;
+  std::uint64_t const Increment;
+  double const MinFreeFraction;
+  bool LowSpaceReported{false};
+  mutable std::mutex FileMutex;
+  int FileDescriptor{-1};
+  std::uint64_t ReservedSize{0};
+  bool Supported{true};
+  Metrics::Metric Preallocations{
+      "preallocations",
+      "Number of times disk space was reserved for the file."};
+  Metrics::Metric PreallocatedBytes{
+      "preallocated_bytes", "Number of bytes reserved for the file."};
+  Metrics::Metric UnreservedGrowths{
+      "unreserved_growths",
+      "Number of times the file had grown beyond the reserved space.",
+      Metrics::Severity::WARNING};
+  Metrics::Registrar Registrar;
+};
+
+/// \brief The number of bytes to reserve up front for the file of a job.
+///
+/// Only the data expected within \p Horizon of the start of the job is
+/// reserved up front, also if the job runs for much longer; the rest is
+/// reserved by FilePreallocator::update() as the file grows.
+///
+/// \param ByteRate The expected rate at which data is written in bytes per
+/// second, e.g. the sum of the profiled rates of the streams.
+/// \param StartTime The start time of the job.
+/// \param StopTime The stop time of the job, time_point::max() if not known.
+/// \param Increment The number of bytes reserved at a time; the result is a
+/// multiple of this and at least one increment.
+/// \param Horizon The longest part of the job for which space is estimated.
+std::uint64_t estimateFileSize(double ByteRate,
+                               std::chrono::milliseconds StartTime,
+                               time_point StopTime, std::uint64_t Increment,
+                               std::chrono::seconds Horizon =
+                                   std::chrono::hours(1));
+
+} // namespace FileWriter
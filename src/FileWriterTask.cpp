@@ -35,6 +35,9 @@ std::vector<Source> &FileWriterTask::sources() { return SourceToModuleMap; }
 
 FileWriterTask::~FileWriterTask() {
   Logger->trace("~FileWriterTask");
+  // Writer modules may hold buffered data that they write when destructed,
+  // which has to happen before the file is closed.
+  SourceToModuleMap.clear();
   try {
     File.close();
   } catch (std::exception const &E) {
@@ -43,13 +46,16 @@ FileWriterTask::~FileWriterTask() {
   }
 }
 
-void FileWriterTask::setFilename(std::string const &Prefix,
-                                 std::string const &Name) {
+std::string outputFilename(std::string const &Prefix, std::string const &Name) {
   if (Prefix.empty()) {
-    Filename = Name;
-  } else {
-    Filename = Prefix + "/" + Name;
+    return Name;
   }
+  return Prefix + "/" + Name;
+}
+
+void FileWriterTask::setFilename(std::string const &Prefix,
+                                 std::string const &Name) {
+  Filename = outputFilename(Prefix, Name);
 }
 
 void FileWriterTask::addSource(Source &&Source) {
@@ -96,4 +102,14 @@ void FileWriterTask::setJobId(std::string const &Id) { JobId = Id; }
 
 std::string FileWriterTask::filename() const { return Filename; }
 
+void FileWriterTask::preallocate(std::uint64_t ExpectedSize,
+                                 std::uint64_t Increment,
+                                 Metrics::Registrar const &Registrar) {
+  File.preallocate(ExpectedSize, Increment, Registrar);
+}
+
+FilePreallocator *FileWriterTask::preallocator() {
+  return File.preallocator();
+}
+
 } // namespace FileWriter
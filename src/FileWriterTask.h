@@ -61,6 +61,8 @@ public:
 
   /// \brief Set the filename.
   ///
+  /// See outputFilename().
+  ///
   /// \param Prefix The path prefix.
   /// \param Name The filename (can include path).
   void setFilename(std::string const &Prefix, std::string const &Name);
@@ -85,6 +87,14 @@ public:
   /// \return The group.
   hdf5::node::Group hdfGroup() const;
 
+  /// \brief Reserve disk space for the file, see HDFFile::preallocate().
+  void preallocate(std::uint64_t ExpectedSize, std::uint64_t Increment,
+                   Metrics::Registrar const &Registrar);
+
+  /// \brief The preallocator of the file, nullptr if the file is not
+  /// preallocated.
+  FilePreallocator *preallocator();
+
 private:
   std::string Filename;
   std::vector<Source> SourceToModuleMap;
@@ -96,4 +106,10 @@ private:
   SharedLogger Logger;
 };
 
+/// \brief The name of the file written by a job.
+///
+/// \param Prefix The path prefix.
+/// \param Name The filename (can include path).
+std::string outputFilename(std::string const &Prefix, std::string const &Name);
+
 } // namespace FileWriter
@@ -9,6 +9,7 @@
 
 #include "FlatbufferMessage.h"
 #include "FlatbufferReader.h"
+#include "Tracing.h"
 
 namespace FileWriter {
 
@@ -20,16 +21,23 @@ FlatbufferMessage::FlatbufferMessage(uint8_t const *BufferPtr, size_t Size)
 
 FlatbufferMessage::FlatbufferMessage(FileWriter::Msg const &KafkaMessage)
     : DataPtr(std::make_unique<uint8_t[]>(KafkaMessage.size())),
-      DataSize(KafkaMessage.size()) {
+      DataSize(KafkaMessage.size()),
+      Partition(KafkaMessage.getMetaData().Partition),
+      Offset(KafkaMessage.getMetaData().Offset),
+      ConsumedAt(KafkaMessage.getMetaData().ConsumedAt),
+      Topic(KafkaMessage.getMetaData().Topic) {
   std::memcpy(DataPtr.get(), KafkaMessage.data(), DataSize);
   extractPacketInfo();
+  TRACE_PROBE5(flatbuffer_verified, Sourcename.c_str(), getTopic(), Partition,
+               Offset, DataSize);
 }
 
 FlatbufferMessage::FlatbufferMessage(FlatbufferMessage const &Other)
     : DataPtr(std::make_unique<uint8_t[]>(Other.size())),
       DataSize(Other.size()), SourceNameIDHash(Other.SourceNameIDHash),
       Sourcename(Other.Sourcename), ID(Other.ID), Timestamp(Other.Timestamp),
-      Valid(Other.Valid) {
+      Valid(Other.Valid), Partition(Other.Partition), Offset(Other.Offset),
+      ConsumedAt(Other.ConsumedAt), Topic(Other.Topic) {
   std::memcpy(DataPtr.get(), Other.data(), DataSize);
 }
 
@@ -81,6 +81,8 @@ public:
   /// \note Will make a copy of the data in the Kafka message.
   FlatbufferMessage(FlatbufferMessage const &Other);
 
+  FlatbufferMessage(FlatbufferMessage &&Other) noexcept = default;
+
   /// \\bried Default destructor.
   ~FlatbufferMessage() = default;
 
@@ -93,9 +95,15 @@ public:
     ID = Other.ID;
     Timestamp = Other.Timestamp;
     Valid = Other.Valid;
+    Partition = Other.Partition;
+    Offset = Other.Offset;
+    ConsumedAt = Other.ConsumedAt;
+    Topic = Other.Topic;
     return *this;
   }
 
+  FlatbufferMessage &operator=(FlatbufferMessage &&Other) noexcept = default;
+
   /// \brief Returns the state of the FlatbufferMessage.
   ///
   /// \return `true` if valid, `false` if not.
@@ -107,7 +115,7 @@ public:
   ///
   /// \return The source name if flatbuffer is valid, an empty string if it is
   /// not.
-  std::string getSourceName() const { return Sourcename; };
+  std::string const &getSourceName() const { return Sourcename; };
 
   /// \brief Get the timestamp of the flatbuffer.
   ///
@@ -127,7 +135,7 @@ public:
   ///
   /// \return Returns the four character flatbuffer ID or empty string if
   /// invalid.
-  std::string getFlatbufferID() const { return ID; };
+  std::string const &getFlatbufferID() const { return ID; };
 
   /// \brief Get pointer to flatbuffer.
   ///
@@ -141,6 +149,25 @@ public:
   /// not.
   size_t size() const { return DataSize; };
 
+  /// \brief The Kafka topic the message was consumed from, empty if it was
+  /// not consumed from Kafka.
+  char const *getTopic() const {
+    return Topic != nullptr ? Topic->c_str() : "";
+  };
+
+  /// \brief The Kafka partition the message was consumed from, -1 if it was
+  /// not consumed from Kafka.
+  std::int32_t getPartition() const { return Partition; };
+
+  /// \brief The Kafka offset of the message, -1 if it was not consumed from
+  /// Kafka.
+  std::int64_t getOffset() const { return Offset; };
+
+  /// \brief The time at which the message was consumed from Kafka.
+  std::chrono::steady_clock::time_point getConsumedAt() const {
+    return ConsumedAt;
+  };
+
 private:
   void extractPacketInfo();
   std::unique_ptr<uint8_t[]> DataPtr;
@@ -150,6 +177,10 @@ private:
   std::string ID;
   std::int64_t Timestamp{0};
   bool Valid{false};
+  std::int32_t Partition{-1};
+  std::int64_t Offset{-1};
+  std::chrono::steady_clock::time_point ConsumedAt;
+  std::shared_ptr<std::string const> Topic;
 };
 
 FlatbufferMessage::SrcHash calcSourceHash(std::string const &ID,
@@ -9,12 +9,14 @@
 
 #include "HDFFile.h"
 #include "Filesystem.h"
+#include "Tracing.h"
 #include "Version.h"
 #include "json.h"
 #include <date/date.h>
 #include <date/tz.h>
 #include <flatbuffers/flatbuffers.h>
 #include <fstream>
+#include <map>
 #include <stack>
 
 namespace FileWriter {
@@ -31,6 +33,76 @@ static size_t const MAX_DIMENSIONS_OF_ARRAY = 10;
 /// write
 static size_t const MAX_ALLOWED_STRING_LENGTH = 4 * 1024 * 1024;
 
+/// Static datasets up to this size are stored in the object header (compact
+/// layout) instead of in a separately allocated block of the file. The limit
+/// of HDF5 is 64 KiB, but large object headers slow down the iteration over
+/// the members of a group.
+static size_t const MAX_COMPACT_DATASET_SIZE = 8 * 1024;
+
+/// Groups with up to this many links (or objects with up to this many
+/// attributes) keep them in the object header. Larger ones use dense storage
+/// from the start instead of being converted when the default threshold of
+/// HDF5 (8) is crossed.
+static unsigned const MAX_COMPACT_STORAGE_ITEMS = 32;
+
+static size_t nrOfItems(nlohmann::json const &Value, std::string const &Key) {
+  auto Item = Value.find(Key);
+  if (Item == Value.end() or
+      not(Item->is_array() or Item->is_object())) {
+    return 0;
+  }
+  return Item->size();
+}
+
+/// \brief Select compact or dense storage of attributes from the number of
+/// attributes that will be written to the object.
+static void
+setAttributeStorage(hdf5::property::ObjectCreationList &CreationList,
+                    size_t NrOfAttributes) {
+  if (NrOfAttributes > MAX_COMPACT_STORAGE_ITEMS) {
+    CreationList.attribute_storage_thresholds(0, 0);
+  } else if (NrOfAttributes >
+             CreationList.attribute_storage_maximum_compact()) {
+    auto MaxCompact = static_cast<unsigned>(NrOfAttributes);
+    CreationList.attribute_storage_thresholds(MaxCompact, MaxCompact * 3 / 4);
+  }
+}
+
+/// \brief Group creation properties with link and attribute storage selected
+/// from the number of children and attributes of the group.
+static hdf5::property::GroupCreationList
+groupCreationList(nlohmann::json const &Value) {
+  hdf5::property::GroupCreationList CreationList;
+  auto NrOfLinks = nrOfItems(Value, "children");
+  if (NrOfLinks > MAX_COMPACT_STORAGE_ITEMS) {
+    CreationList.link_storage_thresholds(0, 0);
+  } else if (NrOfLinks > CreationList.link_storage_maximum_compact()) {
+    auto MaxCompact = static_cast<unsigned>(NrOfLinks);
+    CreationList.link_storage_thresholds(MaxCompact, MaxCompact * 3 / 4);
+  }
+  setAttributeStorage(CreationList, nrOfItems(Value, "attributes"));
+  return CreationList;
+}
+
+/// \brief Size in bytes of an element of a static dataset.
+///
+/// \return The size or 0 if the size is not known up front (variable length
+/// strings).
+static size_t elementSize(std::string const &DataType, hsize_t StringSize) {
+  static std::map<std::string, size_t> const Sizes{
+      {"uint8", 1}, {"uint16", 2}, {"uint32", 4}, {"uint64", 8},
+      {"int8", 1},  {"int16", 2},  {"int32", 4},  {"int64", 8},
+      {"float", 4}, {"double", 8}};
+  if (DataType == "string") {
+    return StringSize == H5T_VARIABLE ? 0 : StringSize;
+  }
+  auto Size = Sizes.find(DataType);
+  if (Size == Sizes.end()) {
+    return 0;
+  }
+  return Size->second;
+}
+
 template <typename T>
 static void writeAttribute(hdf5::node::Node const &Node,
                            const std::string &Name, T Value) {
@@ -603,17 +675,25 @@ void writeGenericDataset(const std::string &DataType,
                          const std::vector<hsize_t> &Sizes,
                          const std::vector<hsize_t> &Max, hsize_t ElementSize,
                          const nlohmann::json *Values,
-                         SharedLogger const &Logger) {
+                         SharedLogger const &Logger, size_t NrOfAttributes) {
   try {
 
     hdf5::property::DatasetCreationList DatasetCreationList;
     hdf5::dataspace::Dataspace Dataspace = hdf5::dataspace::Scalar();
+    bool Extensible{false};
     if (!Sizes.empty()) {
       Dataspace = hdf5::dataspace::Simple(Sizes, Max);
       if (Max[0] == H5S_UNLIMITED) {
         DatasetCreationList.chunk(Sizes);
+        Extensible = true;
       }
     }
+    auto DataSize = elementSize(DataType, ElementSize) * Dataspace.size();
+    if (not Extensible and DataSize > 0 and
+        DataSize <= MAX_COMPACT_DATASET_SIZE) {
+      DatasetCreationList.layout(hdf5::property::DatasetLayout::COMPACT);
+    }
+    setAttributeStorage(DatasetCreationList, NrOfAttributes);
 
     if (DataType == "uint8") {
       writeNumericDataset<uint8_t>(Parent, Name, DatasetCreationList, Dataspace,
@@ -751,7 +831,8 @@ void writeDataset(hdf5::node::Group const &Parent, const nlohmann::json *Values,
   }
 
   writeGenericDataset(DataType, Parent, Name, Sizes, Max, ElementSize,
-                      &DatasetValuesInnerObject, Logger);
+                      &DatasetValuesInnerObject, Logger,
+                      nrOfItems(*Values, "attributes"));
   auto dset = hdf5::node::Dataset(Parent.nodes[Name]);
 
   writeAttributesIfPresent(dset, *Values, Logger);
@@ -775,7 +856,8 @@ void createHDFStructures(
         if (auto NameMaybe = find<std::string>("name", *Value)) {
           auto Name = *NameMaybe;
           try {
-            hdf_this = Parent.create_group(Name, LinkCreationPropertyList);
+            hdf_this = Parent.create_group(Name, LinkCreationPropertyList,
+                                           groupCreationList(*Value));
             Path.push_back(Name);
           } catch (...) {
             Logger->critical("failed to create group  Name: {}", Name);
@@ -910,6 +992,7 @@ void HDFFile::init(const nlohmann::json &NexusStructure,
 
     RootGroup = H5File.root();
 
+    auto CreationStart = std::chrono::steady_clock::now();
     std::deque<std::string> path;
     if (NexusStructure.is_object()) {
       auto value = &NexusStructure;
@@ -932,6 +1015,11 @@ void HDFFile::init(const nlohmann::json &NexusStructure,
         fmt::format("kafka-to-nexus commit {:.7}", GetVersion()));
     writeHDFISO8601AttributeCurrentTime(RootGroup, "file_time", Logger);
     writeAttributesIfPresent(RootGroup, NexusStructure, Logger);
+    Logger->info("Created the static structure of file {} in {} ms",
+                 H5File.id().file_name().string(),
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - CreationStart)
+                     .count());
   } catch (std::exception const &E) {
     Logger->critical("Failed to initialize  file={}  trace:\n{}",
                      H5File.id().file_name().string(),
@@ -964,6 +1052,15 @@ void HDFFile::close() {
   }
 }
 
+void HDFFile::preallocate(std::uint64_t ExpectedSize, std::uint64_t Increment,
+                          Metrics::Registrar const &Registrar) {
+  Preallocator =
+      std::make_unique<FilePreallocator>(Filename, Increment, Registrar);
+  Preallocator->reserve(ExpectedSize);
+  Logger->info("Reserved {} bytes of disk space for file {}",
+               Preallocator->reservedSize(), Filename);
+}
+
 void HDFFile::reopen(std::string const &Filename) {
   try {
     hdf5::property::FileCreationList fcpl;
@@ -975,7 +1072,12 @@ void HDFFile::reopen(std::string const &Filename) {
       FAFL |= static_cast<hdf5::file::AccessFlagsBase>(
           hdf5::file::AccessFlags::SWMR_WRITE);
     }
+    auto OpenStart = std::chrono::steady_clock::now();
     H5File = hdf5::file::open(Filename, FAFL, fapl);
+    Logger->info("Reopened file {} in {} ms", Filename,
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - OpenStart)
+                     .count());
   } catch (std::exception const &E) {
     auto Trace = hdf5::error::print_nested(E);
     Logger->error(
@@ -990,7 +1092,9 @@ void HDFFile::reopen(std::string const &Filename) {
 void HDFFile::flush() {
   try {
     if (H5File.is_valid()) {
+      TRACE_PROBE1(hdf_flush_start, Filename.c_str());
       H5File.flush(hdf5::file::Scope::GLOBAL);
+      TRACE_PROBE1(hdf_flush_end, Filename.c_str());
     }
   } catch (const std::runtime_error &E) {
     std::throw_with_nested(std::runtime_error(
@@ -9,12 +9,14 @@
 
 #pragma once
 
+#include "FilePreallocator.h"
 #include "json.h"
 #include "logger.h"
 #include <H5Ipublic.h>
 #include <chrono>
 #include <deque>
 #include <h5cpp/hdf5.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -48,6 +50,21 @@ public:
   void close();
   void finalize();
 
+  /// \brief Reserve disk space for the file, see FilePreallocator.
+  ///
+  /// The space that is not used is released when the HDFFile is destroyed,
+  /// after the file has been closed for the last time.
+  ///
+  /// \param ExpectedSize The number of bytes to reserve up front.
+  /// \param Increment The number of bytes reserved at a time thereafter.
+  /// \param Registrar Registrar for the preallocation metrics.
+  void preallocate(std::uint64_t ExpectedSize, std::uint64_t Increment,
+                   Metrics::Registrar const &Registrar);
+
+  /// \brief The preallocator of the file, nullptr if preallocate() has not
+  /// been called.
+  FilePreallocator *preallocator() { return Preallocator.get(); }
+
   hdf5::file::File H5File;
   hdf5::node::Group RootGroup;
 
@@ -60,6 +77,7 @@ private:
   std::chrono::milliseconds SWMRFlushInterval{10000};
   std::chrono::time_point<CLOCK> SWMRFlushLast = CLOCK::now();
   SharedLogger Logger = getLogger();
+  std::unique_ptr<FilePreallocator> Preallocator;
 };
 
 bool findType(nlohmann::basic_json<> Attribute, std::string &DType);
@@ -103,13 +121,20 @@ void writeFixedSizeStringDataset(
     hdf5::dataspace::Dataspace &Dataspace, hsize_t ElementSize,
     const nlohmann::json *Values, SharedLogger const &Logger);
 
+/// \brief Write a static dataset.
+///
+/// Small datasets that can not be extended are written with compact layout.
+///
+/// \param NrOfAttributes Number of attributes that will be written to the
+/// dataset, used to select the attribute storage.
 void writeGenericDataset(const std::string &DataType,
                          hdf5::node::Group const &Parent,
                          const std::string &Name,
                          const std::vector<hsize_t> &Sizes,
                          const std::vector<hsize_t> &Max, hsize_t ElementSize,
                          const nlohmann::json *Values,
-                         SharedLogger const &Logger);
+                         SharedLogger const &Logger,
+                         size_t NrOfAttributes = 0);
 
 void writeDataset(hdf5::node::Group const &Parent, const nlohmann::json *Values,
                   SharedLogger const &Logger);
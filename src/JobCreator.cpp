@@ -12,7 +12,10 @@
 #include "JobCreator.h"
 #include "CommandParser.h"
 #include "FileWriterTask.h"
+#include "Kafka/MetaDataPrefetch.h"
 #include "Msg.h"
+#include "NeXusDataset/DatasetPool.h"
+#include "SourceProfile.h"
 #include "StreamController.h"
 #include "WriterModuleBase.h"
 #include "WriterRegistrar.h"
@@ -40,6 +43,35 @@ JobCreator::initializeHDF(FileWriterTask &Task,
   }
 }
 
+static void extractTopicNames(json const &Node,
+                              std::set<std::string> &TopicNames) {
+  if (find<std::string>("type", Node).value_or("") == "stream") {
+    if (auto StreamMaybe = find<json>("stream", Node)) {
+      if (auto TopicMaybe = find<std::string>("topic", *StreamMaybe)) {
+        TopicNames.insert(*TopicMaybe);
+      }
+    }
+  }
+  if (auto ChildrenMaybe = find<json>("children", Node)) {
+    if (ChildrenMaybe->is_array()) {
+      for (auto const &Child : *ChildrenMaybe) {
+        extractTopicNames(Child, TopicNames);
+      }
+    }
+  }
+}
+
+std::set<std::string>
+extractTopicNamesFromNexusStructure(std::string const &NexusStructureString) {
+  std::set<std::string> TopicNames;
+  try {
+    extractTopicNames(json::parse(NexusStructureString), TopicNames);
+  } catch (nlohmann::detail::exception const &) {
+    // The structure is validated (and errors reported) when creating the file
+  }
+  return TopicNames;
+}
+
 StreamSettings
 extractStreamInformationFromJsonForSource(StreamHDFInfo const &StreamInfo) {
   StreamSettings StreamSettings;
@@ -63,8 +95,9 @@ extractStreamInformationFromJsonForSource(StreamHDFInfo const &StreamInfo) {
   return StreamSettings;
 }
 
-void setUpHdfStructure(StreamSettings const &StreamSettings,
-                       std::unique_ptr<FileWriterTask> const &Task) {
+void setUpHdfStructure(StreamSettings &StreamSettings,
+                       std::unique_ptr<FileWriterTask> const &Task,
+                       SourceProfileStore const *Profiles) {
   WriterModule::Registry::FactoryAndID ModuleFactory;
   try {
     ModuleFactory = WriterModule::Registry::find(StreamSettings.Module);
@@ -89,10 +122,19 @@ void setUpHdfStructure(StreamSettings const &StreamSettings,
         " source: {}  what: {}",
         StreamSettings.Module, StreamSettings.Source, E.what())));
   }
+  if (Profiles != nullptr) {
+    if (auto Profile = Profiles->find(SourceProfileStore::key(
+            StreamSettings.Topic, StreamSettings.Source,
+            ModuleFactory.second))) {
+      HDFWriterModule->useSourceProfile(*Profile);
+    }
+  }
 
   auto StreamGroup = hdf5::node::get_group(
       RootGroup, StreamSettings.StreamHDFInfoObj.HDFParentName);
   HDFWriterModule->init_hdf({StreamGroup}, StreamSettings.Attributes);
+  StreamSettings.Writer = std::move(HDFWriterModule);
+  StreamSettings.FlatbufferID = ModuleFactory.second;
 }
 
 /// Helper to extract information about the provided streams.
@@ -100,6 +142,7 @@ void setUpHdfStructure(StreamSettings const &StreamSettings,
 static vector<StreamSettings>
 extractStreamInformationFromJson(std::unique_ptr<FileWriterTask> const &Task,
                                  std::vector<StreamHDFInfo> &StreamHDFInfoList,
+                                 SourceProfileStore const *Profiles,
                                  SharedLogger const &Logger) {
   Logger->info("Command contains {} streams", StreamHDFInfoList.size());
   std::vector<StreamSettings> StreamSettingsList;
@@ -109,7 +152,7 @@ extractStreamInformationFromJson(std::unique_ptr<FileWriterTask> const &Task,
           extractStreamInformationFromJsonForSource(StreamHDFInfo));
       Logger->info("Adding stream: {}",
                    StreamSettingsList.back().ConfigStreamJson);
-      setUpHdfStructure(StreamSettingsList.back(), Task);
+      setUpHdfStructure(StreamSettingsList.back(), Task, Profiles);
       StreamHDFInfo.InitialisedOk = true;
     } catch (json::parse_error const &E) {
       Logger->warn("Invalid json: {}", StreamHDFInfo.ConfigStream);
@@ -133,6 +176,23 @@ std::unique_ptr<IStreamController>
 JobCreator::createFileWritingJob(StartCommandInfo const &StartInfo,
                                  MainOpt &Settings, SharedLogger const &Logger,
                                  Metrics::Registrar Registrar) {
+  Settings.StreamerConfiguration.StartTimestamp = StartInfo.StartTime;
+  Settings.StreamerConfiguration.StopTimestamp = time_point(StartInfo.StopTime);
+  Settings.StreamerConfiguration.BrokerSettings.Address =
+      StartInfo.BrokerInfo.HostPort;
+
+  // Resolve topics, partitions and offsets while the file is being created.
+  auto Prefetch = std::make_unique<Kafka::MetaDataPrefetch>(
+      Settings.StreamerConfiguration.BrokerSettings,
+      extractTopicNamesFromNexusStructure(StartInfo.NexusStructure),
+      time_point(StartInfo.StartTime) -
+          Settings.StreamerConfiguration.BeforeStartTime);
+
+  std::shared_ptr<SourceProfileStore> Profiles;
+  if (not Settings.SourceProfileFile.empty()) {
+    Profiles = std::make_shared<SourceProfileStore>(Settings.SourceProfileFile);
+  }
+
   auto Task = std::make_unique<FileWriterTask>(Settings.ServiceID);
   Task->setJobId(StartInfo.JobID);
   Task->setFilename(Settings.HDFOutputPrefix, StartInfo.Filename);
@@ -141,7 +201,8 @@ JobCreator::createFileWritingJob(StartCommandInfo const &StartInfo,
       initializeHDF(*Task, StartInfo.NexusStructure, Settings.UseHdfSwmr);
 
   std::vector<StreamSettings> StreamSettingsList =
-      extractStreamInformationFromJson(Task, StreamHDFInfoList, Logger);
+      extractStreamInformationFromJson(Task, StreamHDFInfoList,
+                                       Profiles.get(), Logger);
 
   if (Settings.AbortOnUninitialisedStream) {
     for (auto const &Item : StreamHDFInfoList) {
@@ -154,47 +215,41 @@ JobCreator::createFileWritingJob(StartCommandInfo const &StartInfo,
     }
   }
 
-  addStreamSourceToWriterModule(StreamSettingsList, Task);
-
-  Settings.StreamerConfiguration.StartTimestamp = StartInfo.StartTime;
-  Settings.StreamerConfiguration.StopTimestamp = time_point(StartInfo.StopTime);
-  Settings.StreamerConfiguration.BrokerSettings.Address =
-      StartInfo.BrokerInfo.HostPort;
+  std::shared_ptr<NeXusDataset::DatasetPool> Pool;
+  if (Settings.MaxOpenDatasets > 0) {
+    Pool =
+        std::make_shared<NeXusDataset::DatasetPool>(Settings.MaxOpenDatasets);
+  }
+  addStreamSourceToWriterModule(StreamSettingsList, Task, Pool);
 
   Logger->info("Write file with job_id: {}", Task->jobID());
-  return std::make_unique<StreamController>(std::move(Task), Settings.ServiceID,
-                                            Settings.StreamerConfiguration,
-                                            Registrar);
+  return std::make_unique<StreamController>(
+      std::move(Task), Settings.ServiceID, Settings.StreamerConfiguration,
+      Registrar, std::move(Prefetch), std::move(Profiles));
 }
 
 void JobCreator::addStreamSourceToWriterModule(
-    vector<StreamSettings> const &StreamSettingsList,
-    std::unique_ptr<FileWriterTask> &Task) {
+    vector<StreamSettings> &StreamSettingsList,
+    std::unique_ptr<FileWriterTask> &Task,
+    std::shared_ptr<NeXusDataset::DatasetPool> const &Pool) {
   auto Logger = getLogger();
 
-  for (auto const &StreamSettings : StreamSettingsList) {
+  for (auto &StreamSettings : StreamSettingsList) {
     Logger->trace("Add Source: {}", StreamSettings.Topic);
-    WriterModule::Registry::FactoryAndID ModuleFactory;
-
-    try {
-      ModuleFactory = WriterModule::Registry::find(StreamSettings.Module);
-    } catch (std::exception const &E) {
-      Logger->info("WriterModule '{}' is not available, error {}",
-                   StreamSettings.Module, E.what());
-      continue;
-    }
-
-    auto AcceptedFlatbufferID = ModuleFactory.second;
-    auto HDFWriterModule = ModuleFactory.first();
+    // The module configured in setUpHdfStructure() is reused, so that the
+    // configuration of each stream is only parsed once.
+    auto HDFWriterModule = std::move(StreamSettings.Writer);
     if (!HDFWriterModule) {
-      Logger->info("Can not create a writer module for '{}'",
-                   StreamSettings.Module);
+      Logger->info("No writer module was set up for source '{}'",
+                   StreamSettings.Source);
       continue;
     }
 
     try {
+      if (Pool) {
+        HDFWriterModule->useDatasetPool(Pool);
+      }
       // Reopen the previously created HDF dataset.
-      HDFWriterModule->parse_config(StreamSettings.ConfigStreamJson);
       try {
         auto RootGroup = Task->hdfGroup();
         auto StreamGroup = hdf5::node::get_group(
@@ -212,7 +267,7 @@ void JobCreator::addStreamSourceToWriterModule(
       }
 
       // Create a Source instance for the stream and add to the task.
-      Source ThisSource(StreamSettings.Source, AcceptedFlatbufferID,
+      Source ThisSource(StreamSettings.Source, StreamSettings.FlatbufferID,
                         StreamSettings.Module, StreamSettings.Topic,
                         move(HDFWriterModule));
       Task->addSource(std::move(ThisSource));
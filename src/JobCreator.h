@@ -15,8 +15,11 @@
 #include "Metrics/Registrar.h"
 #include "States.h"
 #include "StreamController.h"
+#include "WriterModuleBase.h"
+#include "WriterRegistrar.h"
 #include "json.h"
 #include <memory>
+#include <set>
 
 namespace FileWriter {
 
@@ -28,6 +31,9 @@ struct StreamSettings {
   std::string Source;
   std::string ConfigStreamJson;
   std::string Attributes;
+  /// The writer module, configured and with its HDF structure created.
+  WriterModule::ptr Writer;
+  WriterModule::ModuleFlatbufferID FlatbufferID;
 };
 
 class IJobCreator {
@@ -55,8 +61,9 @@ public:
 
 private:
   static void addStreamSourceToWriterModule(
-      std::vector<StreamSettings> const &StreamSettingsList,
-      std::unique_ptr<FileWriterTask> &Task);
+      std::vector<StreamSettings> &StreamSettingsList,
+      std::unique_ptr<FileWriterTask> &Task,
+      std::shared_ptr<NeXusDataset::DatasetPool> const &Pool);
 
   static std::vector<StreamHDFInfo>
   initializeHDF(FileWriterTask &Task, std::string const &NexusStructureString,
@@ -70,4 +77,12 @@ private:
 StreamSettings
 extractStreamInformationFromJsonForSource(StreamHDFInfo const &StreamInfo);
 
+/// \brief Extract the names of the topics used by the streams in the NeXus
+/// structure.
+///
+/// \param NexusStructureString The NeXus structure JSON.
+/// \return The topic names, empty if the JSON could not be parsed.
+std::set<std::string>
+extractTopicNamesFromNexusStructure(std::string const &NexusStructureString);
+
 } // namespace FileWriter
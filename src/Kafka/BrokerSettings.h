@@ -32,6 +32,9 @@ struct BrokerSettings {
   duration KafkaErrorTimeout{
       30s}; // If there is an error with the Kafka broker when consuming data
             // (for writing files), wait this long before stopping
+  duration EndOfPartitionGrace{
+      1s}; // After the stop time, wait this long at the end of a partition
+           // for messages still on their way to the broker
   std::map<std::string, std::string> KafkaConfiguration = {
       {"metadata.request.timeout.ms", "2000"}, // 2 Secs
       {"socket.timeout.ms", "2000"},
@@ -49,6 +52,7 @@ struct BrokerSettings {
       {"heartbeat.interval.ms", "500"},     // 0.5 Secs
       {"statistics.interval.ms", "600000"}, // 1 Min
       {"api.version.request", "true"},
-      {"enable.auto.commit", "false"}};
+      {"enable.auto.commit", "false"},
+      {"enable.partition.eof", "true"}};
 };
 } // namespace Kafka
@@ -8,10 +8,13 @@
 // Screaming Udder!                              https://esss.se
 
 #include "Consumer.h"
+#include "FlatbufferMessage.h"
 #include "MetadataException.h"
+#include "Tracing.h"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <string_view>
 #include <thread>
 
 namespace {
@@ -32,6 +35,41 @@ findTopic(std::string const &Topic, RdKafka::Metadata const &KafkaMetadata) {
   }
   return *Iterator;
 }
+
+std::string headerValue(RdKafka::Header const &Header) {
+  if (Header.err() != RdKafka::ERR_NO_ERROR or Header.value() == nullptr) {
+    return {};
+  }
+  return {static_cast<char const *>(Header.value()), Header.value_size()};
+}
+
+/// Get the source name and flatbuffer ID of a message from its Kafka headers
+/// or, if not present, from its key. Does not touch the payload.
+///
+/// \param KafkaMsg The message to get the information from.
+/// \param MetaData Where to store the information.
+void extractRoutingInfo(RdKafka::Message &KafkaMsg,
+                        FileWriter::MessageMetaData &MetaData) {
+  if (auto Headers = KafkaMsg.headers(); Headers != nullptr) {
+    MetaData.SourceName = headerValue(Headers->get_last("source_name"));
+    MetaData.FlatbufferID = headerValue(Headers->get_last("schema_id"));
+    if (MetaData.hasRoutingInfo()) {
+      return;
+    }
+  }
+  MetaData.SourceName.clear();
+  MetaData.FlatbufferID.clear();
+  auto const IDLength = 4u;
+  if (KafkaMsg.key_pointer() == nullptr or KafkaMsg.key_len() <= IDLength + 1) {
+    return;
+  }
+  std::string_view Key(static_cast<char const *>(KafkaMsg.key_pointer()),
+                       KafkaMsg.key_len());
+  if (Key[IDLength] == ':') {
+    MetaData.FlatbufferID = Key.substr(0, IDLength);
+    MetaData.SourceName = Key.substr(IDLength + 1);
+  }
+}
 } // namespace
 
 namespace Kafka {
@@ -57,6 +95,7 @@ Consumer::~Consumer() {
 
 void Consumer::addTopic(const std::string &Topic) {
   Logger->info("Consumer::add_topic  {}", Topic);
+  ConsumedTopic = std::make_shared<std::string const>(Topic);
   std::vector<RdKafka::TopicPartition *> TopicPartitionsWithOffsets =
       queryWatermarkOffsets(Topic);
   assignToPartitions(Topic, TopicPartitionsWithOffsets);
@@ -113,6 +152,8 @@ void Consumer::addPartitionAtOffset(std::string const &Topic, int PartitionId,
                Topic, PartitionId, Offset);
   auto TopicPartition = std::unique_ptr<RdKafka::TopicPartition>(
       RdKafka::TopicPartition::create(Topic, PartitionId, Offset));
+  AssignedOffsets[{Topic, PartitionId}] = Offset;
+  ConsumedTopic = std::make_shared<std::string const>(Topic);
   auto ReturnCode = KafkaConsumer->assign({
       TopicPartition.get(),
   });
@@ -124,6 +165,34 @@ void Consumer::addPartitionAtOffset(std::string const &Topic, int PartitionId,
   }
 }
 
+bool Consumer::hasReachedHighWatermark(std::string const &Topic,
+                                       int PartitionId) {
+  int64_t Low, High;
+  auto ErrorCode = KafkaConsumer->query_watermark_offsets(
+      Topic, PartitionId, &Low, &High,
+      ConsumerBrokerSettings.MetadataTimeoutMS);
+  if (ErrorCode != RdKafka::ERR_NO_ERROR) {
+    Logger->debug(
+        "Unable to query watermark offsets for topic {} with error {} - {}",
+        Topic, ErrorCode, RdKafka::err2str(ErrorCode));
+    return false;
+  }
+  auto TopicPartition = std::unique_ptr<RdKafka::TopicPartition>(
+      RdKafka::TopicPartition::create(Topic, PartitionId));
+  std::vector<RdKafka::TopicPartition *> Partitions{TopicPartition.get()};
+  ErrorCode = KafkaConsumer->position(Partitions);
+  auto Position = TopicPartition->offset();
+  if (ErrorCode != RdKafka::ERR_NO_ERROR or Position < 0) {
+    // Nothing consumed yet, use the offset that consumption started at.
+    auto Assigned = AssignedOffsets.find({Topic, PartitionId});
+    if (Assigned == AssignedOffsets.end() or Assigned->second < 0) {
+      return false;
+    }
+    Position = Assigned->second;
+  }
+  return Position >= High;
+}
+
 std::vector<int32_t> Consumer::queryTopicPartitions(const std::string &Topic) {
   std::unique_ptr<RdKafka::Metadata> KafkaMetadata = getMetadata();
   auto const matchedTopic = findTopic(Topic, *KafkaMetadata);
@@ -179,14 +248,34 @@ std::unique_ptr<RdKafka::Metadata> Consumer::metadataCall() {
   }
 }
 
+void Consumer::setWantedSources(std::set<size_t> const &SourceHashes) {
+  WantedSources = SourceHashes;
+}
+
 std::pair<PollStatus, FileWriter::Msg> Consumer::poll() {
   auto KafkaMsg = std::unique_ptr<RdKafka::Message>(
       KafkaConsumer->consume(ConsumerBrokerSettings.PollTimeoutMS));
   switch (KafkaMsg->err()) {
   case RdKafka::ERR_NO_ERROR: {
+    if (TRACE_ENABLED(message_consumed)) {
+      // The accessors of RdKafka::Message are virtual calls.
+      TRACE_PROBE4(message_consumed,
+                   ConsumedTopic != nullptr ? ConsumedTopic->c_str() : "",
+                   KafkaMsg->partition(), KafkaMsg->offset(), KafkaMsg->len());
+    }
     auto MetaData = FileWriter::MessageMetaData{
         std::chrono::milliseconds(KafkaMsg->timestamp().timestamp),
         KafkaMsg->timestamp().type, KafkaMsg->offset(), KafkaMsg->partition()};
+    MetaData.ConsumedAt = std::chrono::steady_clock::now();
+    MetaData.Topic = ConsumedTopic;
+    extractRoutingInfo(*KafkaMsg, MetaData);
+    if (not WantedSources.empty() and MetaData.hasRoutingInfo() and
+        WantedSources.find(FileWriter::calcSourceHash(
+            MetaData.FlatbufferID, MetaData.SourceName)) ==
+            WantedSources.end()) {
+      // Not of interest, skip copying the payload.
+      return {PollStatus::Message, FileWriter::Msg(std::move(MetaData))};
+    }
     auto RetMsg =
         FileWriter::Msg(reinterpret_cast<const char *>(KafkaMsg->payload()),
                         KafkaMsg->len(), MetaData);
@@ -196,6 +285,9 @@ std::pair<PollStatus, FileWriter::Msg> Consumer::poll() {
     // No message or event within time out - this is usually normal (see
     // librdkafka docs)
     return {PollStatus::TimedOut, FileWriter::Msg()};
+  case RdKafka::ERR__PARTITION_EOF:
+    // All messages in the partition (at the time of the fetch) consumed
+    return {PollStatus::EndOfPartition, FileWriter::Msg()};
   default:
     // Everything else is an error
     return {PollStatus::Error, FileWriter::Msg()};
@@ -16,7 +16,9 @@
 #include "PollStatus.h"
 #include <chrono>
 #include <librdkafka/rdkafkacpp.h>
+#include <map>
 #include <memory>
+#include <set>
 
 namespace FileWriter {
 struct Msg;
@@ -34,6 +36,9 @@ public:
   queryTopicPartitions(const std::string &TopicName) = 0;
   virtual void addPartitionAtOffset(std::string const &Topic, int PartitionId,
                                     int64_t Offset) = 0;
+  virtual bool hasReachedHighWatermark(std::string const &Topic,
+                                       int PartitionId) = 0;
+  virtual void setWantedSources(std::set<size_t> const &SourceHashes) = 0;
 };
 
 class Consumer : public ConsumerInterface {
@@ -67,6 +72,29 @@ public:
   /// \param Topic The name of the topic to query.
   /// \return List of partition numbers on topic.
   std::vector<int32_t> queryTopicPartitions(const std::string &Topic) override;
+
+  /// Check with the broker if all messages currently in a partition have been
+  /// consumed.
+  ///
+  /// \note This is a blocking call.
+  /// \param Topic The name of the topic.
+  /// \param PartitionId The partition to check.
+  /// \return True if the consume position is at the high watermark, false if
+  /// not or if this could not be determined.
+  bool hasReachedHighWatermark(std::string const &Topic,
+                               int PartitionId) override;
+
+  /// Set the sources that messages are consumed for.
+  ///
+  /// Messages whose Kafka headers ("source_name" and "schema_id") or key
+  /// ("<schema_id>:<source_name>") identify a source that is not in this set
+  /// are returned by poll() without their payload. Messages without this
+  /// information are always returned in full.
+  ///
+  /// \param SourceHashes Hashes as calculated by FileWriter::calcSourceHash().
+  /// An empty set accepts all messages.
+  void setWantedSources(std::set<size_t> const &SourceHashes) override;
+
   /// Polls for any new messages.
   ///
   /// \return Any new messages consumed.
@@ -81,6 +109,10 @@ private:
   std::unique_ptr<RdKafka::Metadata> getMetadata();
   int id = 0;
   std::unique_ptr<KafkaEventCb> EventCallback;
+  std::map<std::pair<std::string, int>, int64_t> AssignedOffsets;
+  std::set<size_t> WantedSources;
+  /// Name of the topic being consumed, shared with the consumed messages.
+  std::shared_ptr<std::string const> ConsumedTopic;
   void assignToPartitions(
       const std::string &Topic,
       const std::vector<RdKafka::TopicPartition *> &TopicPartitionsWithOffsets);
@@ -112,5 +144,16 @@ public:
     UNUSED_ARG(PartitionId);
     UNUSED_ARG(Offset);
   };
+
+  bool hasReachedHighWatermark(std::string const &Topic,
+                               int PartitionId) override {
+    UNUSED_ARG(Topic);
+    UNUSED_ARG(PartitionId);
+    return false;
+  };
+
+  void setWantedSources(std::set<size_t> const &SourceHashes) override {
+    UNUSED_ARG(SourceHashes);
+  };
 };
 } // namespace Kafka
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "FetchTuning.h"
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+namespace Kafka {
+
+namespace {
+std::int64_t const MinFetchBytes{1024 * 1024};
+std::int64_t const MaxFetchBytes{52428800};
+std::int64_t const MaxFetchMinBytes{1024 * 1024};
+std::int64_t const MaxQueuedKBytes{2097151};
+double const FetchSeconds{0.5};
+double const QueueSeconds{2.0};
+double const FetchMinSeconds{0.01};
+double const HighByteRate{1024.0 * 1024.0};
+int const HighRateFetchWaitMs{100};
+int const LowRateFetchWaitMs{500};
+
+/// The value of an integer setting, \p Default if it is not set or invalid.
+std::int64_t configuredValue(std::map<std::string, std::string> const &Config,
+                             std::string const &Key, std::int64_t Default) {
+  auto Item = Config.find(Key);
+  if (Item == Config.end()) {
+    return Default;
+  }
+  try {
+    return std::stoll(Item->second);
+  } catch (std::exception const &) {
+    return Default;
+  }
+}
+} // namespace
+
+FetchSettings fetchSettingsForRate(double ByteRate,
+                                   std::uint64_t MaxMessageSize,
+                                   std::uint64_t MemoryBudget) {
+  auto const Budget = static_cast<double>(MemoryBudget);
+  if (ByteRate <= 0.0) {
+    ByteRate = Budget / QueueSeconds;
+  }
+  FetchSettings Result;
+  auto FetchLimit = std::clamp(static_cast<std::int64_t>(Budget / 2),
+                               MinFetchBytes, MaxFetchBytes);
+  auto FetchWanted =
+      std::max({static_cast<std::int64_t>(ByteRate * FetchSeconds),
+                static_cast<std::int64_t>(2 * MaxMessageSize), MinFetchBytes});
+  // A fetch has to hold at least the largest message, whatever the budget.
+  Result.FetchMaxBytes =
+      std::max(std::min(FetchWanted, FetchLimit),
+               static_cast<std::int64_t>(MaxMessageSize));
+
+  auto QueuedBytes = std::max(
+      Result.FetchMaxBytes,
+      static_cast<std::int64_t>(std::min(ByteRate * QueueSeconds, Budget)));
+  Result.QueuedMaxKBytes =
+      std::clamp<std::int64_t>((QueuedBytes + 1023) / 1024, 1, MaxQueuedKBytes);
+
+  Result.FetchMinBytes = std::clamp<std::int64_t>(
+      static_cast<std::int64_t>(ByteRate * FetchMinSeconds), 1,
+      MaxFetchMinBytes);
+  Result.FetchWaitMaxMs =
+      ByteRate >= HighByteRate ? HighRateFetchWaitMs : LowRateFetchWaitMs;
+  return Result;
+}
+
+FetchSettings applyFetchSettings(FetchSettings Fetch,
+                                 BrokerSettings &Settings) {
+  auto &Configuration = Settings.KafkaConfiguration;
+  // The maximum message sizes are left as configured, as lowering them would
+  // make the consumers fail on large messages. librdkafka refuses a
+  // `fetch.max.bytes` smaller than `message.max.bytes`, so the fetch size is
+  // raised instead.
+  Fetch.FetchMaxBytes = std::max(
+      {Fetch.FetchMaxBytes,
+       configuredValue(Configuration, "message.max.bytes", 0),
+       configuredValue(Configuration, "fetch.message.max.bytes", 0)});
+  Fetch.QueuedMaxKBytes =
+      std::max(Fetch.QueuedMaxKBytes,
+               std::min((Fetch.FetchMaxBytes + 1023) / 1024, MaxQueuedKBytes));
+  Configuration["fetch.max.bytes"] = std::to_string(Fetch.FetchMaxBytes);
+  Configuration["fetch.min.bytes"] = std::to_string(Fetch.FetchMinBytes);
+  Configuration["fetch.wait.max.ms"] = std::to_string(Fetch.FetchWaitMaxMs);
+  Configuration["queued.max.messages.kbytes"] =
+      std::to_string(Fetch.QueuedMaxKBytes);
+  Configuration["receive.message.max.bytes"] = std::to_string(
+      std::max(Fetch.FetchMaxBytes + 512,
+               configuredValue(Configuration, "receive.message.max.bytes", 0)));
+  return Fetch;
+}
+
+std::vector<std::uint64_t>
+splitMemoryBudget(std::vector<double> const &ByteRates,
+                  std::uint64_t MemoryBudget) {
+  auto NrOfKnown = std::count_if(ByteRates.begin(), ByteRates.end(),
+                                 [](auto Rate) { return Rate > 0.0; });
+  auto KnownSum = std::accumulate(
+      ByteRates.begin(), ByteRates.end(), 0.0,
+      [](double Sum, double Rate) { return Rate > 0.0 ? Sum + Rate : Sum; });
+  auto UnknownRate = NrOfKnown > 0 ? KnownSum / NrOfKnown : 1.0;
+  std::vector<double> Weights;
+  Weights.reserve(ByteRates.size());
+  for (auto Rate : ByteRates) {
+    Weights.push_back(Rate > 0.0 ? Rate : UnknownRate);
+  }
+  auto WeightSum = std::accumulate(Weights.begin(), Weights.end(), 0.0);
+  std::vector<std::uint64_t> Result;
+  Result.reserve(Weights.size());
+  for (auto Weight : Weights) {
+    Result.push_back(
+        static_cast<std::uint64_t>(MemoryBudget * (Weight / WeightSum)));
+  }
+  return Result;
+}
+
+} // namespace Kafka
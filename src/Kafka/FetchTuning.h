@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "BrokerSettings.h"
+#include <cstdint>
+#include <vector>
+
+namespace Kafka {
+
+/// \brief Fetch and queue settings of a single librdkafka consumer.
+struct FetchSettings {
+  std::int64_t FetchMaxBytes{0};
+  std::int64_t FetchMinBytes{1};
+  int FetchWaitMaxMs{500};
+  std::int64_t QueuedMaxKBytes{0};
+};
+
+/// \brief Derive the fetch settings of a consumer from the rate of the data
+/// that it is expected to receive.
+///
+/// A fetch holds about half a second of data and the local queue about two
+/// seconds, limited by the memory budget of the consumer. High rate consumers
+/// ask the broker to wait for more data per fetch, low rate consumers get
+/// their messages as soon as they are available.
+///
+/// \param ByteRate Expected bytes per second, 0 if not known. An unknown rate
+/// is assumed to use the full memory budget.
+/// \param MaxMessageSize Size of the largest expected message, 0 if not known.
+/// \param MemoryBudget Bytes that the consumer may use for fetched messages.
+FetchSettings fetchSettingsForRate(double ByteRate,
+                                   std::uint64_t MaxMessageSize,
+                                   std::uint64_t MemoryBudget);
+
+/// \brief Set the fetch settings in the librdkafka configuration.
+///
+/// The configured maximum message sizes are never lowered; the fetch and
+/// queue sizes are raised to hold them instead, and
+/// `receive.message.max.bytes` is raised to hold a fetch.
+///
+/// \return The settings as applied.
+FetchSettings applyFetchSettings(FetchSettings Fetch, BrokerSettings &Settings);
+
+/// \brief Split a memory budget between consumers (or groups of consumers)
+/// in proportion to their byte rates.
+///
+/// Consumers with an unknown rate (0) get the share of a consumer with the
+/// mean of the known rates.
+std::vector<std::uint64_t>
+splitMemoryBudget(std::vector<double> const &ByteRates,
+                  std::uint64_t MemoryBudget);
+
+} // namespace Kafka
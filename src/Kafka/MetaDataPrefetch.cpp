@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "MetaDataPrefetch.h"
+#include "MetaDataQuery.h"
+#include "MetadataException.h"
+#include "logger.h"
+#include <algorithm>
+#include <thread>
+
+namespace Kafka {
+
+namespace {
+/// \brief Call a metadata function, doubling the time-out on every failure
+/// until the max metadata time-out has been tried or until \p Stop is set.
+template <typename ReturnType, typename FuncType>
+std::optional<ReturnType> retryMetadataCall(BrokerSettings const &Settings,
+                                            std::atomic<bool> const &Stop,
+                                            FuncType MetadataCall) {
+  auto CurrentTimeOut = Settings.MinMetadataTimeout;
+  while (true) {
+    if (Stop) {
+      return std::nullopt;
+    }
+    try {
+      return MetadataCall(CurrentTimeOut);
+    } catch (MetadataException &E) {
+      if (CurrentTimeOut >= Settings.MaxMetadataTimeout) {
+        LOG_WARN("Prefetching of Kafka metadata failed, falling back on "
+                 "regular metadata calls. The failure message was: \"{}\".",
+                 E.what());
+        return std::nullopt;
+      }
+      CurrentTimeOut =
+          std::min(CurrentTimeOut * 2, Settings.MaxMetadataTimeout);
+    }
+  }
+}
+
+/// \brief Run a function in a detached thread.
+///
+/// \return The future result of the function.
+template <typename ReturnType, typename FuncType>
+std::shared_future<ReturnType> runDetached(FuncType Function) {
+  auto Promise = std::make_shared<std::promise<ReturnType>>();
+  auto Result = Promise->get_future().share();
+  std::thread([Promise, Function]() {
+    try {
+      Promise->set_value(Function());
+    } catch (...) {
+      Promise->set_exception(std::current_exception());
+    }
+  }).detach();
+  return Result;
+}
+} // namespace
+
+MetaDataPrefetch::MetaDataPrefetch(BrokerSettings const &Settings,
+                                   std::set<std::string> const &Topics,
+                                   time_point StartTime) {
+  TopicNames = runDetached<std::optional<std::set<std::string>>>(
+      [Settings, Stop = Stop]() {
+        return retryMetadataCall<std::set<std::string>>(
+            Settings, *Stop, [&Settings](duration TimeOut) {
+              return getTopicList(Settings.Address, TimeOut);
+            });
+      });
+  for (auto const &Topic : Topics) {
+    Offsets[Topic] = runDetached<std::optional<PartitionOffsets>>(
+        [Settings, Topic, StartTime, Stop = Stop]() {
+          auto Partitions = retryMetadataCall<std::vector<int>>(
+              Settings, *Stop, [&Settings, &Topic](duration TimeOut) {
+                return getPartitionsForTopic(Settings.Address, Topic,
+                                             TimeOut);
+              });
+          if (not Partitions) {
+            return std::optional<PartitionOffsets>();
+          }
+          return retryMetadataCall<PartitionOffsets>(
+              Settings, *Stop,
+              [&Settings, &Topic, &Partitions, StartTime](duration TimeOut) {
+                return getOffsetForTime(Settings.Address, Topic, *Partitions,
+                                        StartTime, TimeOut);
+              });
+        });
+  }
+}
+
+MetaDataPrefetch::~MetaDataPrefetch() { Stop->store(true); }
+
+std::optional<std::set<std::string>> MetaDataPrefetch::topicNames() {
+  return TopicNames.get();
+}
+
+std::optional<PartitionOffsets>
+MetaDataPrefetch::partitionOffsets(std::string const &Topic) {
+  auto Result = Offsets.find(Topic);
+  if (Result == Offsets.end()) {
+    return std::nullopt;
+  }
+  return Result->second.get();
+}
+
+} // namespace Kafka
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "BrokerSettings.h"
+#include "TimeUtility.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Kafka {
+
+using PartitionOffsets = std::vector<std::pair<int, int64_t>>;
+
+/// \brief Resolves the topic names on the broker and the partitions and start
+/// offsets of the topics used by a job, in the background.
+///
+/// Created as soon as the list of streams is known so that the Kafka metadata
+/// calls overlap with the creation of the HDF structure and the
+/// initialisation of the writer modules. Every topic is resolved in its own
+/// thread. A look-up that still fails after having reached the max metadata
+/// time-out is given up on; the caller is then expected to fall back on the
+/// regular metadata calls.
+///
+/// The threads are detached, so that destroying the prefetcher, e.g. when the
+/// job could not be created, does not wait for look-ups that are still being
+/// retried. They stop retrying once the prefetcher has been destroyed.
+class MetaDataPrefetch {
+public:
+  MetaDataPrefetch(BrokerSettings const &Settings,
+                   std::set<std::string> const &Topics, time_point StartTime);
+  /// \brief Tells the look-ups that are still running to stop retrying.
+  virtual ~MetaDataPrefetch();
+
+  /// \brief Get the names of all the topics on the broker.
+  ///
+  /// Blocks until the look-up has finished.
+  /// \return The topic names or std::nullopt if the look-up failed.
+  virtual std::optional<std::set<std::string>> topicNames();
+
+  /// \brief Get the partitions and start offsets of a topic.
+  ///
+  /// Blocks until the look-up has finished.
+  /// \return The partition/offset pairs or std::nullopt if the look-up failed
+  /// or if the topic was not part of the prefetch.
+  virtual std::optional<PartitionOffsets>
+  partitionOffsets(std::string const &Topic);
+
+private:
+  std::shared_ptr<std::atomic<bool>> Stop{
+      std::make_shared<std::atomic<bool>>(false)};
+  std::shared_future<std::optional<std::set<std::string>>> TopicNames;
+  std::map<std::string, std::shared_future<std::optional<PartitionOffsets>>>
+      Offsets;
+};
+
+} // namespace Kafka
@@ -60,6 +60,24 @@ struct MainOpt {
   /// commands.
   std::string HDFOutputPrefix;
 
+  /// \brief File in which the message rates and sizes of the sources are
+  /// kept between jobs.
+  ///
+  /// Used to pre-size chunks when a source is written again. Empty to disable.
+  std::string SourceProfileFile;
+
+  /// \brief Rewrite finished files into a layout that is faster to read.
+  ///
+  /// Done in a background thread while no file is being written.
+  bool OptimiseFinishedFiles = false;
+
+  /// \brief Maximum number of datasets kept open by the writer modules that
+  /// can close and reopen them (f142).
+  ///
+  /// Such writer modules buffer their updates and close the datasets of the
+  /// least recently written streams. 0 to keep all datasets open.
+  size_t MaxOpenDatasets = 0;
+
   /// Used for command line argument.
   bool ListWriterModules = false;
 
@@ -10,6 +10,8 @@
 #include "Master.h"
 #include "CommandListener.h"
 #include "CommandParser.h"
+#include "FileOptimiser.h"
+#include "FileWriterTask.h"
 #include "JobCreator.h"
 #include "Status/StatusReporter.h"
 #include "helper.h"
@@ -57,6 +59,9 @@ Master::Master(MainOpt &Config, std::unique_ptr<CommandListener> Listener,
     : Logger(getLogger()), MainConfig(Config), CmdListener(std::move(Listener)),
       Creator_(std::move(Creator)), Reporter(std::move(Reporter)),
       MasterMetricsRegistrar(Registrar) {
+  if (Config.OptimiseFinishedFiles) {
+    Optimiser = std::make_unique<FileOptimiser>();
+  }
   CmdListener->start();
   Logger->info("getFileWriterProcessId: {}", Config.ServiceID);
 }
@@ -81,6 +86,12 @@ void Master::startWriting(StartCommandInfo const &StartInfo) {
                StartInfo.JobID, StartInfo.StartTime.count());
   try {
     CurrentState = States::Writing();
+    if (Optimiser != nullptr) {
+      // HDF5 must not be used by two threads at the same time.
+      Optimiser->cancel();
+    }
+    CurrentFilename =
+        outputFilename(MainConfig.HDFOutputPrefix, StartInfo.Filename);
     Reporter->updateStatusInfo({StartInfo.JobID, StartInfo.Filename,
                                 StartInfo.StartTime, StartInfo.StopTime});
     CurrentStreamController = Creator_->createFileWritingJob(
@@ -138,7 +149,11 @@ bool Master::isWriting() const {
 }
 
 void Master::setToIdle() {
+  auto const FileWasWritten = CurrentStreamController != nullptr;
   CurrentStreamController.reset(nullptr);
+  if (FileWasWritten and Optimiser != nullptr) {
+    Optimiser->optimise(CurrentFilename);
+  }
   CurrentState = States::Idle();
   Reporter->resetStatusInfo();
 }
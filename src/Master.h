@@ -28,6 +28,7 @@ namespace FileWriter {
 class IJobCreator;
 class CommandListener;
 class IStreamController;
+class FileOptimiser;
 
 FileWriterState getNextState(Msg const &Command,
                              std::chrono::milliseconds TimeStamp,
@@ -60,6 +61,9 @@ private:
   std::unique_ptr<IStreamController> CurrentStreamController{nullptr};
   std::unique_ptr<Status::StatusReporter> Reporter;
   Metrics::Registrar MasterMetricsRegistrar;
+  /// Only set if finished files are to be optimised.
+  std::unique_ptr<FileOptimiser> Optimiser;
+  std::string CurrentFilename;
   FileWriterState CurrentState = States::Idle();
   virtual void startWriting(StartCommandInfo const &StartInfo);
   virtual void requestStopWriting(StopCommandInfo const &StopInfo);
@@ -24,6 +24,12 @@ struct InternalMetric {
         DescriptionString(MetricToGetDetailsFrom.getDescription()),
         LastValue(MetricToGetDetailsFrom.getCounterPtr()->load()),
         ValueSeverity(MetricToGetDetailsFrom.getSeverity()){};
+  InternalMetric(std::string MetricName, std::string MetricFullName,
+                 CounterType *CounterPtr, std::string Description,
+                 Severity Level)
+      : Name(std::move(MetricName)), FullName(std::move(MetricFullName)),
+        Counter(CounterPtr), DescriptionString(std::move(Description)),
+        LastValue(CounterPtr->load()), ValueSeverity(Level){};
   std::string const Name;
   std::string const FullName; // Including prefix from local registrar
   CounterType *Counter{nullptr};
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "MetricFamily.h"
+#include "Reporter.h"
+#include <algorithm>
+
+namespace Metrics {
+
+namespace {
+std::string joinName(std::string const &First, std::string const &Second) {
+  if (First.empty()) {
+    return Second;
+  }
+  return First + "." + Second;
+}
+} // namespace
+
+MetricFamily::MetricFamily(std::string FamilyPrefix,
+                           FamilyDefinition FamilyDef)
+    : Prefix(std::move(FamilyPrefix)), Definition(std::move(FamilyDef)),
+      FullName(joinName(Prefix, Definition.Name)),
+      LinesPerInstance(std::max<size_t>(
+          1, (Definition.Counters.size() + CountersPerLine - 1) /
+                 CountersPerLine)) {}
+
+MetricFamily::~MetricFamily() {
+  for (auto &CReporter : Reporters) {
+    CReporter->tryRemoveFamily(*this);
+  }
+}
+
+size_t
+MetricFamily::addInstance(std::vector<std::string> const &LabelValues) {
+  auto Path = Prefix;
+  for (auto const &Label : LabelValues) {
+    Path = joinName(Path, Label);
+  }
+  std::lock_guard<std::mutex> Lock(InstancesMutex);
+  size_t Instance{0};
+  if (FreeInstances.empty()) {
+    Instance = InUse.size();
+    if (Instance % InstancesPerChunk == 0) {
+      Chunks.emplace_back(
+          new CacheLine[InstancesPerChunk * LinesPerInstance]());
+    }
+    InUse.push_back(true);
+    InstancePaths.push_back(Path);
+  } else {
+    Instance = FreeInstances.back();
+    FreeInstances.pop_back();
+    InUse[Instance] = true;
+    InstancePaths[Instance] = Path;
+    for (size_t i = 0; i < Definition.Counters.size(); ++i) {
+      counterPtr(Instance, i)->store(0);
+    }
+  }
+  ++Generation;
+  return Instance;
+}
+
+void MetricFamily::removeInstance(size_t Instance) {
+  std::lock_guard<std::mutex> Lock(InstancesMutex);
+  InUse[Instance] = false;
+  FreeInstances.push_back(Instance);
+  ++Generation;
+}
+
+CounterType *MetricFamily::counter(size_t Instance, size_t CounterIndex) {
+  std::lock_guard<std::mutex> Lock(InstancesMutex);
+  return counterPtr(Instance, CounterIndex);
+}
+
+CounterType *MetricFamily::counterPtr(size_t Instance, size_t CounterIndex) {
+  auto &Chunk = Chunks[Instance / InstancesPerChunk];
+  auto &Line = Chunk[(Instance % InstancesPerChunk) * LinesPerInstance +
+                     CounterIndex / CountersPerLine];
+  return &Line.Counters[CounterIndex % CountersPerLine];
+}
+
+void MetricFamily::setReporters(
+    std::vector<std::shared_ptr<Reporter>> UsedReporters) {
+  Reporters = std::move(UsedReporters);
+}
+
+bool MetricFamily::reportsTo(LogTo SinkType) const {
+  return std::any_of(Definition.Counters.begin(), Definition.Counters.end(),
+                     [SinkType](auto const &Counter) {
+                       return std::find(Counter.Sinks.begin(),
+                                        Counter.Sinks.end(),
+                                        SinkType) != Counter.Sinks.end();
+                     });
+}
+
+void MetricFamily::forEachCounter(LogTo SinkType,
+                                  CounterCallback const &Callback) {
+  std::lock_guard<std::mutex> Lock(InstancesMutex);
+  for (size_t Instance = 0; Instance < InUse.size(); ++Instance) {
+    if (not InUse[Instance]) {
+      continue;
+    }
+    for (size_t i = 0; i < Definition.Counters.size(); ++i) {
+      auto const &Def = Definition.Counters[i];
+      if (std::find(Def.Sinks.begin(), Def.Sinks.end(), SinkType) ==
+          Def.Sinks.end()) {
+        continue;
+      }
+      Callback(Def.Name, joinName(InstancePaths[Instance], Def.Name),
+               counterPtr(Instance, i), Def.Description, Def.Level);
+    }
+  }
+}
+
+FamilyInstance::~FamilyInstance() {
+  if (UsedFamily != nullptr) {
+    UsedFamily->removeInstance(Index);
+  }
+}
+
+FamilyInstance::FamilyInstance(FamilyInstance &&Other) noexcept
+    : UsedFamily(std::move(Other.UsedFamily)), Index(Other.Index) {
+  Other.UsedFamily.reset();
+}
+
+FamilyInstance &FamilyInstance::operator=(FamilyInstance &&Other) noexcept {
+  if (this != &Other) {
+    if (UsedFamily != nullptr) {
+      UsedFamily->removeInstance(Index);
+    }
+    UsedFamily = std::move(Other.UsedFamily);
+    Index = Other.Index;
+    Other.UsedFamily.reset();
+  }
+  return *this;
+}
+
+Counter FamilyInstance::operator[](size_t CounterIndex) const {
+  if (UsedFamily == nullptr) {
+    return {};
+  }
+  return Counter(UsedFamily->counter(Index, CounterIndex));
+}
+
+} // namespace Metrics
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "Metric.h"
+#include "Sink.h"
+#include <array>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Metrics {
+
+/// \brief Light-weight handle to a counter of a MetricFamily instance.
+///
+/// Has the same counting interface as Metrics::Metric. A default constructed
+/// counter is not connected to any family and counts into a shared dummy.
+class Counter {
+public:
+  Counter() = default;
+  explicit Counter(CounterType *CounterPtr) : Value(CounterPtr) {}
+
+  int64_t operator++() {
+    Value->store(Value->load(MemoryOrder) + 1, MemoryOrder);
+    return Value->load(MemoryOrder);
+  };
+  int64_t operator++(int) {
+    Value->store(Value->load(MemoryOrder) + 1, MemoryOrder);
+    return Value->load(MemoryOrder);
+  };
+
+  template <typename CType> bool operator==(CType const &Rhs) const {
+    return Value->load(MemoryOrder) == Rhs;
+  };
+
+  template <typename CType> explicit operator CType() const {
+    return static_cast<CType>(Value->load());
+  }
+
+  int64_t operator=(int64_t const &NewValue) {
+    Value->store(NewValue, MemoryOrder);
+    return Value->load(MemoryOrder);
+  };
+  int64_t operator+=(int64_t AddValue) {
+    Value->store(AddValue + Value->load(MemoryOrder), MemoryOrder);
+    return Value->load(MemoryOrder);
+  };
+
+private:
+  static constexpr std::memory_order MemoryOrder{std::memory_order_relaxed};
+  inline static CounterType Unconnected{0};
+  CounterType *Value{&Unconnected};
+};
+
+/// \brief Definition of one of the counters of a MetricFamily.
+struct CounterDefinition {
+  std::string Name;
+  std::string Description;
+  Severity Level{Severity::DEBUG};
+  std::vector<LogTo> Sinks;
+};
+
+/// \brief Definition of a MetricFamily.
+///
+/// \note The name only identifies the family; it is not part of the names
+/// under which the counters are reported.
+struct FamilyDefinition {
+  std::string Name;
+  std::vector<CounterDefinition> Counters;
+};
+
+/// \brief A set of counters shared by many instances (e.g. partitions or
+/// sources) that only differ in their labels.
+///
+/// The counters of an instance are stored next to each other in cache line
+/// aligned rows, so that instances updated from different threads do not
+/// share cache lines. The family is added to the reporters once, instead of
+/// every counter of every instance being added separately. Counters are
+/// reported as "<prefix>.<label values>.<counter name>", which is the same
+/// name as the one given to a Metrics::Metric registered with a Registrar
+/// that has the label values as prefixes.
+class MetricFamily {
+public:
+  MetricFamily(std::string FamilyPrefix, FamilyDefinition Definition);
+  ~MetricFamily();
+  MetricFamily(MetricFamily const &) = delete;
+  MetricFamily &operator=(MetricFamily const &) = delete;
+
+  /// \brief Add an instance to the family.
+  ///
+  /// \param LabelValues The labels that identify the instance.
+  /// \return The index of the instance, used to get the counters.
+  size_t addInstance(std::vector<std::string> const &LabelValues);
+
+  /// \brief Remove an instance. Its row is reused by later instances.
+  void removeInstance(size_t Instance);
+
+  /// \brief Get a counter of an instance.
+  ///
+  /// \param Instance Index returned by addInstance().
+  /// \param CounterIndex Index of the counter in the family definition.
+  CounterType *counter(size_t Instance, size_t CounterIndex);
+
+  /// \brief Set the reporters from which the family has to be removed when
+  /// it is destructed.
+  void setReporters(std::vector<std::shared_ptr<Reporter>> UsedReporters);
+
+  std::string const &getFullName() const { return FullName; }
+
+  /// \brief Incremented every time an instance is added or removed.
+  uint64_t getGeneration() const { return Generation.load(); }
+
+  bool reportsTo(LogTo SinkType) const;
+
+  using CounterCallback =
+      std::function<void(std::string const &Name, std::string const &FullName,
+                         CounterType *CounterPtr,
+                         std::string const &Description, Severity Level)>;
+  /// \brief Call a function for every counter of every current instance that
+  /// is reported to a sink of the given type.
+  void forEachCounter(LogTo SinkType, CounterCallback const &Callback);
+
+private:
+  CounterType *counterPtr(size_t Instance, size_t CounterIndex);
+  static size_t const CountersPerLine{64 / sizeof(CounterType)};
+  static size_t const InstancesPerChunk{64};
+  struct alignas(64) CacheLine {
+    std::array<CounterType, CountersPerLine> Counters;
+  };
+  std::string const Prefix;
+  FamilyDefinition const Definition;
+  std::string const FullName;
+  size_t const LinesPerInstance;
+  std::mutex InstancesMutex;
+  std::vector<std::unique_ptr<CacheLine[]>> Chunks;
+  std::vector<std::string> InstancePaths;
+  std::vector<bool> InUse;
+  std::vector<size_t> FreeInstances;
+  std::atomic<uint64_t> Generation{0};
+  std::vector<std::shared_ptr<Reporter>> Reporters;
+};
+
+/// \brief An instance of a MetricFamily, removed from the family when
+/// destructed.
+class FamilyInstance {
+public:
+  FamilyInstance() = default;
+  FamilyInstance(std::shared_ptr<MetricFamily> Family, size_t Instance)
+      : UsedFamily(std::move(Family)), Index(Instance) {}
+  ~FamilyInstance();
+  FamilyInstance(FamilyInstance &&Other) noexcept;
+  FamilyInstance &operator=(FamilyInstance &&Other) noexcept;
+  FamilyInstance(FamilyInstance const &) = delete;
+  FamilyInstance &operator=(FamilyInstance const &) = delete;
+
+  /// \brief Get a counter, by its index in the family definition.
+  Counter operator[](size_t CounterIndex) const;
+
+private:
+  std::shared_ptr<MetricFamily> UsedFamily;
+  size_t Index{0};
+};
+
+} // namespace Metrics
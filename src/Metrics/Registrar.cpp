@@ -32,7 +32,44 @@ Registrar Registrar::getNewRegistrar(std::string const &MetricsPrefix) const {
     // cppcheck-suppress useStlAlgorithm
     Reporters.push_back(SinkTypeAndReporter.second);
   }
-  return {prependPrefix(MetricsPrefix), Reporters};
+  Registrar NewRegistrar(prependPrefix(MetricsPrefix), Reporters);
+  NewRegistrar.Families = Families;
+  return NewRegistrar;
+}
+
+Registrar
+Registrar::getLabelledRegistrar(std::string const &LabelName,
+                                std::string const &LabelValue) const {
+  auto NewRegistrar = getNewRegistrar(LabelValue);
+  NewRegistrar.FamilyPrefix = FamilyPrefix;
+  NewRegistrar.Labels = Labels;
+  NewRegistrar.Labels.emplace_back(LabelName, LabelValue);
+  NewRegistrar.Families = Families;
+  return NewRegistrar;
+}
+
+FamilyInstance
+Registrar::addFamilyInstance(FamilyDefinition const &Definition) const {
+  std::string Key = FamilyPrefix + "/" + Definition.Name;
+  std::vector<std::string> LabelValues;
+  for (auto const &Label : Labels) {
+    Key += "/" + Label.first;
+    LabelValues.push_back(Label.second);
+  }
+  std::lock_guard<std::mutex> Lock(Families->Mutex);
+  auto Family = Families->Families[Key].lock();
+  if (Family == nullptr) {
+    Family = std::make_shared<MetricFamily>(FamilyPrefix, Definition);
+    std::vector<std::shared_ptr<Reporter>> UsedReporters;
+    for (auto &SinkTypeAndReporter : ReporterList) {
+      if (SinkTypeAndReporter.second->addFamily(*Family)) {
+        UsedReporters.push_back(SinkTypeAndReporter.second);
+      }
+    }
+    Family->setReporters(UsedReporters);
+    Families->Families[Key] = Family;
+  }
+  return {Family, Family->addInstance(LabelValues)};
 }
 
 std::string Registrar::prependPrefix(std::string const &Name) const {
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "MetricFamily.h"
 #include "Reporter.h"
 #include "Sink.h"
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -17,7 +19,8 @@ class Registrar {
 public:
   Registrar(std::string MetricsPrefix,
             std::vector<std::shared_ptr<Reporter>> Reporters)
-      : Prefix(std::move(MetricsPrefix)) {
+      : Prefix(std::move(MetricsPrefix)), FamilyPrefix(Prefix),
+        Families(std::make_shared<FamilyMap>()) {
     for (auto const &NewReporter : Reporters) {
       ReporterList.emplace(NewReporter->getSinkType(), NewReporter);
     }
@@ -27,9 +30,34 @@ public:
 
   Registrar getNewRegistrar(std::string const &MetricsPrefix) const;
 
+  /// \brief Get a registrar that adds a label to the metric families.
+  ///
+  /// Metrics registered with registerMetric() get the label value as an
+  /// extra prefix, same as with getNewRegistrar(). Metric families are shared
+  /// with the other registrars created from the same unlabelled registrar.
+  ///
+  /// \param LabelName Name of the label, e.g. "topic" or "partition".
+  /// \param LabelValue Value of the label.
+  Registrar getLabelledRegistrar(std::string const &LabelName,
+                                 std::string const &LabelValue) const;
+
+  /// \brief Add an instance with the labels of this registrar to a metric
+  /// family.
+  ///
+  /// The family is created and added to the reporters on first use and
+  /// removed from them when its last instance is destructed.
+  FamilyInstance addFamilyInstance(FamilyDefinition const &Definition) const;
+
 private:
+  struct FamilyMap {
+    std::mutex Mutex;
+    std::map<std::string, std::weak_ptr<MetricFamily>> Families;
+  };
   std::string prependPrefix(std::string const &Name) const;
   std::string const Prefix;
+  std::string FamilyPrefix;
+  std::vector<std::pair<std::string, std::string>> Labels;
+  std::shared_ptr<FamilyMap> Families;
   /// List of reporters we might want to add a metric to
   std::map<LogTo, std::shared_ptr<Reporter>> ReporterList;
 };
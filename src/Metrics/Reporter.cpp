@@ -9,6 +9,15 @@ void Reporter::reportMetrics() {
     for (auto &MetricNameValue : MetricsToReportOn) {
       MetricSink->reportMetric(MetricNameValue.second);
     }
+    for (auto &PtrFamily : FamiliesToReportOn) {
+      auto &Reported = PtrFamily.second;
+      if (Reported.Generation != Reported.Family->getGeneration()) {
+        updateFamilyMetrics(Reported);
+      }
+      for (auto &CMetric : Reported.Metrics) {
+        MetricSink->reportMetric(CMetric);
+      }
+    }
   } else {
     std::string MetricsSinkName{"Unknown"};
     std::map<LogTo, std::string> SinkNameMap{
@@ -39,6 +48,49 @@ bool Reporter::tryRemoveMetric(std::string const &MetricName) {
   return static_cast<bool>(MetricsToReportOn.erase(MetricName));
 }
 
+bool Reporter::addFamily(MetricFamily &NewFamily) {
+  if (not NewFamily.reportsTo(getSinkType())) {
+    return false;
+  }
+  std::lock_guard<std::mutex> Lock(MetricsMapMutex);
+  ReportedFamily Reported;
+  Reported.Family = &NewFamily;
+  updateFamilyMetrics(Reported);
+  return FamiliesToReportOn.emplace(&NewFamily, std::move(Reported)).second;
+}
+
+bool Reporter::tryRemoveFamily(MetricFamily const &Family) {
+  std::lock_guard<std::mutex> Lock(MetricsMapMutex);
+  return static_cast<bool>(FamiliesToReportOn.erase(&Family));
+}
+
+void Reporter::updateFamilyMetrics(ReportedFamily &Reported) {
+  Reported.Generation = Reported.Family->getGeneration();
+  std::map<std::string, InternalMetric const *> OldMetrics;
+  for (auto const &CMetric : Reported.Metrics) {
+    OldMetrics.emplace(CMetric.FullName, &CMetric);
+  }
+  std::vector<InternalMetric> NewMetrics;
+  Reported.Family->forEachCounter(
+      getSinkType(),
+      [&NewMetrics](std::string const &Name, std::string const &FullName,
+                    CounterType *CounterPtr, std::string const &Description,
+                    Severity Level) {
+        NewMetrics.emplace_back(Name, FullName, CounterPtr, Description,
+                                Level);
+      });
+  for (auto &CMetric : NewMetrics) {
+    // Keep reporting differences relative to the previous report.
+    auto Old = OldMetrics.find(CMetric.FullName);
+    if (Old != OldMetrics.end() and Old->second->Counter == CMetric.Counter and
+        Old->second->LastValue <= CMetric.Counter->load()) {
+      CMetric.LastValue = Old->second->LastValue;
+      CMetric.LastTime = Old->second->LastTime;
+    }
+  }
+  Reported.Metrics = std::move(NewMetrics);
+}
+
 LogTo Reporter::getSinkType() { return MetricSink->getType(); }
 
 void Reporter::start() {
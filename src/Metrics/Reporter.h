@@ -10,11 +10,13 @@
 #pragma once
 
 #include "InternalMetric.h"
+#include "MetricFamily.h"
 #include "Sink.h"
 #include <asio.hpp>
 #include <map>
 #include <memory>
 #include <thread>
+#include <vector>
 
 namespace Metrics {
 
@@ -30,6 +32,16 @@ public:
   void reportMetrics();
   virtual bool addMetric(Metric &NewMetric, std::string const &NewName);
   virtual bool tryRemoveMetric(std::string const &MetricName);
+
+  /// \brief Report on all the current instances of a family.
+  ///
+  /// Families are kept by instance rather than by name, as a new family may
+  /// be added before an old family with the same name has removed itself.
+  ///
+  /// \note The family is expected to remove itself (tryRemoveFamily()) before
+  /// it is destructed.
+  virtual bool addFamily(MetricFamily &NewFamily);
+  virtual bool tryRemoveFamily(MetricFamily const &Family);
   LogTo getSinkType();
 
 private:
@@ -37,9 +49,17 @@ private:
   void start();
   void waitForStop();
 
+  struct ReportedFamily {
+    MetricFamily *Family{nullptr};
+    uint64_t Generation{0};
+    std::vector<InternalMetric> Metrics;
+  };
+  void updateFamilyMetrics(ReportedFamily &Reported);
+
   std::unique_ptr<Sink> MetricSink;
   std::mutex MetricsMapMutex; // lock when accessing MetricToReportOn
   std::map<std::string, InternalMetric> MetricsToReportOn; // MetricName: Metric
+  std::map<MetricFamily const *, ReportedFamily> FamiliesToReportOn;
   asio::io_context IO;
   std::chrono::milliseconds Period;
   asio::steady_timer AsioTimer;
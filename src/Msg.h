@@ -13,6 +13,7 @@
 #include <chrono>
 #include <librdkafka/rdkafkacpp.h>
 #include <memory>
+#include <string>
 
 namespace FileWriter {
 
@@ -26,13 +27,29 @@ struct MessageMetaData {
           MSG_TIMESTAMP_NOT_AVAILABLE};
   int64_t Offset{0};
   int32_t Partition{0};
+  /// Source name and flatbuffer ID as set by the producer in the Kafka headers
+  /// or key of the message, empty if not set.
+  std::string SourceName;
+  std::string FlatbufferID;
+  bool hasRoutingInfo() const {
+    return not SourceName.empty() and not FlatbufferID.empty();
+  }
+  /// Time at which the message was consumed.
+  std::chrono::steady_clock::time_point ConsumedAt;
+  /// Topic the message was consumed from, shared by the messages of a
+  /// consumer. Null if not known.
+  std::shared_ptr<std::string const> Topic;
 };
 
 struct Msg {
   Msg() = default;
   Msg(Msg &&Other) noexcept
       : DataPtr(std::move(Other.DataPtr)), Size(Other.Size),
-        MetaData(Other.MetaData) {}
+        MetaData(std::move(Other.MetaData)) {}
+  /// \brief A message without payload, for messages that are dropped based
+  /// on their meta-data only.
+  explicit Msg(MessageMetaData MessageInfo)
+      : MetaData(std::move(MessageInfo)) {}
   Msg(char const *Data, size_t Bytes, MessageMetaData MessageInfo = {})
       : DataPtr(std::make_unique<char[]>(Bytes)), Size(Bytes),
         MetaData(MessageInfo) {
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "DatasetPool.h"
+
+namespace NeXusDataset {
+
+DatasetPool::DatasetPool(size_t MaxOpenDatasets)
+    : MaxOpenDatasets(MaxOpenDatasets) {}
+
+void DatasetPool::use(Member &PoolMember) {
+  auto Item = Positions.find(&PoolMember);
+  if (Item != Positions.end()) {
+    OpenMembers.splice(OpenMembers.begin(), OpenMembers,
+                       Item->second.Position);
+    return;
+  }
+  closeLeastRecentlyUsed(PoolMember.nrOfDatasets());
+  PoolMember.openDatasets();
+  ++NrOfOpens;
+  // The member only knows how many datasets it opened once it has opened
+  // them the first time.
+  auto NrOfDatasets = PoolMember.nrOfDatasets();
+  closeLeastRecentlyUsed(NrOfDatasets);
+  OpenMembers.push_front(&PoolMember);
+  Positions[&PoolMember] = {OpenMembers.begin(), NrOfDatasets};
+  NrOfOpenDatasets += NrOfDatasets;
+}
+
+void DatasetPool::closeLeastRecentlyUsed(size_t NrOfNewDatasets) {
+  while (not OpenMembers.empty() and
+         NrOfOpenDatasets + NrOfNewDatasets > MaxOpenDatasets) {
+    auto LeastRecentlyUsed = OpenMembers.back();
+    remove(*LeastRecentlyUsed);
+    LeastRecentlyUsed->closeDatasets();
+  }
+}
+
+void DatasetPool::remove(Member &PoolMember) {
+  auto Item = Positions.find(&PoolMember);
+  if (Item == Positions.end()) {
+    return;
+  }
+  NrOfOpenDatasets -= Item->second.NrOfDatasets;
+  OpenMembers.erase(Item->second.Position);
+  Positions.erase(Item);
+}
+
+} // namespace NeXusDataset
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+namespace NeXusDataset {
+
+/// \brief Limits the number of datasets that are kept open.
+///
+/// Every open dataset has its own chunk cache and slows down the metadata
+/// operations of the HDF5 library, which adds up for files with thousands of
+/// streams. The datasets of a member of the pool are opened when the member
+/// is used and the datasets of the least recently used members are closed
+/// when more than the maximum number of datasets would otherwise be open.
+///
+/// \note Not thread safe; all members are expected to be used from the
+/// thread that writes the file.
+class DatasetPool {
+public:
+  /// \brief A user of the pool, e.g. a writer module, which can close and
+  /// reopen its datasets.
+  class Member {
+  public:
+    virtual ~Member() = default;
+
+    /// \brief The number of datasets opened by the last openDatasets(), or
+    /// an estimate if they have not been opened yet.
+    virtual size_t nrOfDatasets() const = 0;
+
+    /// \brief Open the datasets.
+    ///
+    /// \throw std::exception If the datasets could not be opened.
+    virtual void openDatasets() = 0;
+
+    /// \brief Close the datasets. Anything buffered must have been written.
+    virtual void closeDatasets() = 0;
+  };
+
+  /// \param MaxOpenDatasets Datasets are closed when more than this number
+  /// would be open. The datasets of the member being used are never closed,
+  /// even if it has more datasets than this.
+  explicit DatasetPool(size_t MaxOpenDatasets);
+
+  /// \brief Make sure that the datasets of a member are open.
+  ///
+  /// The datasets of the least recently used members are closed first, if
+  /// needed to stay below the maximum number of open datasets.
+  void use(Member &PoolMember);
+
+  /// \brief Forget about a member, e.g. when it is destroyed.
+  ///
+  /// The datasets of the member are not closed.
+  void remove(Member &PoolMember);
+
+  size_t nrOfOpenDatasets() const { return NrOfOpenDatasets; }
+
+  /// \brief The number of times that the datasets of a member were opened.
+  size_t nrOfOpens() const { return NrOfOpens; }
+
+private:
+  /// Close the datasets of the least recently used members until there is
+  /// room for this many more.
+  void closeLeastRecentlyUsed(size_t NrOfNewDatasets);
+
+  size_t MaxOpenDatasets;
+  size_t NrOfOpenDatasets{0};
+  size_t NrOfOpens{0};
+  /// The members with open datasets, the most recently used one first.
+  std::list<Member *> OpenMembers;
+  struct OpenMember {
+    std::list<Member *>::iterator Position;
+    size_t NrOfDatasets;
+  };
+  std::unordered_map<Member *, OpenMember> Positions;
+};
+
+} // namespace NeXusDataset
@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "DirectoryStore.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace NeXusDataset {
+
+namespace {
+std::runtime_error fileError(std::string const &What, fs::path const &Path) {
+  return std::runtime_error(fmt::format("Unable to {} \"{}\": {}", What,
+                                        Path.string(), std::strerror(errno)));
+}
+
+/// \brief Write a file next to its final location, sync it to disk and then
+/// rename it, so that a reader never sees a partially written file.
+void writeFile(fs::path const &FilePath, char const *Data, size_t Size) {
+  auto TemporaryPath = FilePath;
+  TemporaryPath += ".tmp";
+  auto FileDescriptor =
+      open(TemporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (FileDescriptor < 0) {
+    throw fileError("create", TemporaryPath);
+  }
+  while (Size > 0) {
+    auto Written = write(FileDescriptor, Data, Size);
+    if (Written < 0 and errno == EINTR) {
+      continue;
+    }
+    if (Written < 0) {
+      auto Error = fileError("write", TemporaryPath);
+      close(FileDescriptor);
+      throw Error;
+    }
+    Data += Written;
+    Size -= static_cast<size_t>(Written);
+  }
+  if (fsync(FileDescriptor) != 0) {
+    auto Error = fileError("sync", TemporaryPath);
+    close(FileDescriptor);
+    throw Error;
+  }
+  close(FileDescriptor);
+  fs::rename(TemporaryPath, FilePath);
+}
+
+/// \brief Sync the names of the files in a directory to disk.
+///
+/// Not every file system supports this, so failures are ignored.
+void syncDirectory(fs::path const &Path) {
+  auto FileDescriptor = open(Path.c_str(), O_RDONLY | O_DIRECTORY);
+  if (FileDescriptor < 0) {
+    return;
+  }
+  fsync(FileDescriptor);
+  close(FileDescriptor);
+}
+} // namespace
+
+ChunkWriterPool::ChunkWriterPool(size_t NrOfThreads) {
+  addThreads(NrOfThreads);
+}
+
+ChunkWriterPool::~ChunkWriterPool() {
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    RunThreads = false;
+  }
+  QueueCondition.notify_all();
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+}
+
+void ChunkWriterPool::run(std::function<void()> Task) {
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    Tasks.push_back(std::move(Task));
+  }
+  QueueCondition.notify_one();
+}
+
+void ChunkWriterPool::addThreads(size_t NrOfThreads) {
+  std::lock_guard<std::mutex> Lock(QueueMutex);
+  while (Workers.size() < NrOfThreads) {
+    Workers.emplace_back([this]() { runWorker(); });
+  }
+}
+
+size_t ChunkWriterPool::nrOfThreads() const {
+  std::lock_guard<std::mutex> Lock(QueueMutex);
+  return Workers.size();
+}
+
+std::shared_ptr<ChunkWriterPool> ChunkWriterPool::shared(size_t NrOfThreads) {
+  static std::mutex SharedMutex;
+  static std::weak_ptr<ChunkWriterPool> SharedPool;
+  std::lock_guard<std::mutex> Lock(SharedMutex);
+  auto Pool = SharedPool.lock();
+  if (not Pool) {
+    Pool = std::make_shared<ChunkWriterPool>(NrOfThreads);
+    SharedPool = Pool;
+  } else {
+    Pool->addThreads(NrOfThreads);
+  }
+  return Pool;
+}
+
+void ChunkWriterPool::runWorker() {
+  while (true) {
+    std::function<void()> Task;
+    {
+      std::unique_lock<std::mutex> Lock(QueueMutex);
+      QueueCondition.wait(
+          Lock, [this]() { return not RunThreads or not Tasks.empty(); });
+      if (Tasks.empty()) {
+        return;
+      }
+      Task = std::move(Tasks.front());
+      Tasks.pop_front();
+    }
+    Task();
+  }
+}
+
+DirectoryStoreBase::DirectoryStoreBase(fs::path Path, std::string DataType,
+                                       size_t ElementSize, size_t ChunkSize,
+                                       std::shared_ptr<ChunkWriterPool> Writers,
+                                       int CompressionLevel)
+    : Path(std::move(Path)), DataType(std::move(DataType)),
+      ElementSize(ElementSize), ChunkSize(std::max(ChunkSize, size_t(1))),
+      CompressionLevel(std::clamp(CompressionLevel, 0, 9)),
+      Writers(std::move(Writers)) {
+  try {
+    fs::create_directories(this->Path);
+    writeMetadata(0);
+  } catch (std::exception const &) {
+    std::throw_with_nested(std::runtime_error(fmt::format(
+        "Unable to create the directory store \"{}\".", this->Path.string())));
+  }
+  Buffer.reserve(this->ChunkSize * ElementSize);
+}
+
+DirectoryStoreBase::~DirectoryStoreBase() {
+  try {
+    flush();
+  } catch (std::exception const &) {
+    // Nothing more can be done about it here; the error has been reported by
+    // earlier calls to appendBytes() or flush() if there were any.
+  }
+  // The writers must be done with this store before it goes away.
+  waitForChunks();
+}
+
+void DirectoryStoreBase::appendBytes(char const *Data,
+                                     size_t NrOfNewElements) {
+  throwIfFailed();
+  auto const ChunkBytes = ChunkSize * ElementSize;
+  auto RemainingBytes = NrOfNewElements * ElementSize;
+  while (RemainingBytes > 0) {
+    auto BytesToCopy = std::min(ChunkBytes - Buffer.size(), RemainingBytes);
+    Buffer.insert(Buffer.end(), Data, Data + BytesToCopy);
+    Data += BytesToCopy;
+    RemainingBytes -= BytesToCopy;
+    if (Buffer.size() == ChunkBytes) {
+      queueChunk({NrOfFullChunks++, std::move(Buffer), true});
+      Buffer = std::vector<char>();
+      Buffer.reserve(ChunkBytes);
+    }
+  }
+  NrOfElements += NrOfNewElements;
+}
+
+void DirectoryStoreBase::flush() {
+  if (not Buffer.empty()) {
+    auto LastChunk = Buffer;
+    LastChunk.resize(ChunkSize * ElementSize, 0);
+    queueChunk({NrOfFullChunks, std::move(LastChunk), false});
+  }
+  // Also makes sure that the last chunk is written before it is written
+  // again when it is full.
+  waitForChunks();
+  throwIfFailed();
+  writeMetadata(NrOfElements);
+}
+
+void DirectoryStoreBase::updateMetadata() {
+  throwIfFailed();
+  size_t Shape{0};
+  {
+    std::lock_guard<std::mutex> Lock(ChunkMutex);
+    Shape = NrOfWrittenChunks * ChunkSize;
+  }
+  if (Shape > MetadataShape) {
+    writeMetadata(Shape);
+  }
+}
+
+void DirectoryStoreBase::queueChunk(Chunk NewChunk) {
+  {
+    std::lock_guard<std::mutex> Lock(ChunkMutex);
+    ++NrOfPendingChunks;
+  }
+  if (not Writers) {
+    try {
+      writeChunk(NewChunk);
+    } catch (std::exception const &) {
+      chunkWritten(NewChunk, std::current_exception());
+      throwIfFailed();
+    }
+    chunkWritten(NewChunk, nullptr);
+    return;
+  }
+  Writers->run([this, ChunkToWrite = std::move(NewChunk)]() {
+    std::exception_ptr Error;
+    try {
+      writeChunk(ChunkToWrite);
+    } catch (std::exception const &) {
+      Error = std::current_exception();
+    }
+    chunkWritten(ChunkToWrite, Error);
+  });
+}
+
+void DirectoryStoreBase::writeChunk(Chunk const &ChunkToWrite) {
+  auto ChunkPath = Path / std::to_string(ChunkToWrite.Index);
+  if (CompressionLevel == 0) {
+    writeFile(ChunkPath, ChunkToWrite.Data.data(), ChunkToWrite.Data.size());
+    return;
+  }
+  auto CompressedSize = compressBound(ChunkToWrite.Data.size());
+  std::vector<char> Compressed(CompressedSize);
+  if (compress2(reinterpret_cast<Bytef *>(Compressed.data()), &CompressedSize,
+                reinterpret_cast<Bytef const *>(ChunkToWrite.Data.data()),
+                ChunkToWrite.Data.size(), CompressionLevel) != Z_OK) {
+    throw std::runtime_error(
+        fmt::format("Unable to compress \"{}\".", ChunkPath.string()));
+  }
+  writeFile(ChunkPath, Compressed.data(), CompressedSize);
+}
+
+void DirectoryStoreBase::chunkWritten(Chunk const &WrittenChunk,
+                                      std::exception_ptr Error) {
+  std::lock_guard<std::mutex> Lock(ChunkMutex);
+  if (Error and not WriteError) {
+    WriteError = Error;
+  }
+  if (not Error and WrittenChunk.IsFull) {
+    WrittenOutOfOrder.insert(WrittenChunk.Index);
+    while (WrittenOutOfOrder.erase(NrOfWrittenChunks) > 0) {
+      ++NrOfWrittenChunks;
+    }
+  }
+  --NrOfPendingChunks;
+  // Notified while locked, as the store may be destroyed as soon as the
+  // last pending chunk is done.
+  DoneCondition.notify_all();
+}
+
+void DirectoryStoreBase::writeMetadata(size_t Shape) {
+  nlohmann::json Compressor = nullptr;
+  if (CompressionLevel > 0) {
+    Compressor = {{"id", "zlib"}, {"level", CompressionLevel}};
+  }
+  nlohmann::json Metadata{{"zarr_format", 2},
+                          {"shape", nlohmann::json::array({Shape})},
+                          {"chunks", nlohmann::json::array({ChunkSize})},
+                          {"dtype", DataType},
+                          {"compressor", Compressor},
+                          {"fill_value", 0},
+                          {"order", "C"},
+                          {"filters", nullptr}};
+  // The chunks that the metadata refers to must be on disk first.
+  syncDirectory(Path);
+  auto Text = Metadata.dump();
+  writeFile(Path / ".zarray", Text.data(), Text.size());
+  MetadataShape = Shape;
+}
+
+void DirectoryStoreBase::waitForChunks() {
+  std::unique_lock<std::mutex> Lock(ChunkMutex);
+  DoneCondition.wait(Lock, [this]() { return NrOfPendingChunks == 0; });
+}
+
+void DirectoryStoreBase::throwIfFailed() {
+  std::exception_ptr Error;
+  {
+    std::lock_guard<std::mutex> Lock(ChunkMutex);
+    std::swap(Error, WriteError);
+  }
+  if (Error) {
+    std::rethrow_exception(Error);
+  }
+}
+
+} // namespace NeXusDataset
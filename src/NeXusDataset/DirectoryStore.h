@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+/// \file Storage of one dimensional arrays as a directory of chunk files.
+
+#pragma once
+
+#include "ExtensibleDataset.h"
+#include "Filesystem.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace NeXusDataset {
+
+/// \brief Name of the attribute of an (empty) HDF5 dataset of which the data
+/// is kept in a directory store.
+///
+/// The value is the path of the store relative to the directory of the HDF5
+/// file.
+std::string const DirectoryStoreAttribute{"directory_store"};
+
+/// \brief The Zarr (version 2) data type of \p T, e.g. "<u4".
+template <typename T> std::string zarrDataType() {
+  static_assert(std::is_arithmetic_v<T>, "Only numbers can be stored.");
+  char Kind = 'u';
+  if (std::is_floating_point_v<T>) {
+    Kind = 'f';
+  } else if (std::is_signed_v<T>) {
+    Kind = 'i';
+  }
+  return std::string(1, sizeof(T) == 1 ? '|' : '<') + Kind +
+         std::to_string(sizeof(T));
+}
+
+/// \brief Threads that write the chunks of directory stores.
+///
+/// The threads are shared by the stores, so that the number of threads does
+/// not grow with the number of streams written to directory stores.
+class ChunkWriterPool {
+public:
+  explicit ChunkWriterPool(size_t NrOfThreads);
+
+  /// \brief Runs the tasks that are still queued and stops the threads.
+  ~ChunkWriterPool();
+
+  ChunkWriterPool(ChunkWriterPool const &) = delete;
+  ChunkWriterPool &operator=(ChunkWriterPool const &) = delete;
+
+  /// \brief Run a task on one of the threads.
+  void run(std::function<void()> Task);
+
+  /// \brief Start more threads if there are fewer than \p NrOfThreads.
+  void addThreads(size_t NrOfThreads);
+
+  size_t nrOfThreads() const;
+
+  /// \brief The pool shared by all stores of the process, with at least
+  /// \p NrOfThreads threads.
+  ///
+  /// The pool is created when first needed and stopped once no store uses
+  /// it anymore.
+  static std::shared_ptr<ChunkWriterPool> shared(size_t NrOfThreads);
+
+private:
+  void runWorker();
+
+  mutable std::mutex QueueMutex;
+  std::condition_variable QueueCondition;
+  std::deque<std::function<void()>> Tasks;
+  bool RunThreads{true};
+  std::vector<std::thread> Workers;
+};
+
+/// \brief A one dimensional array kept as a directory with one file per
+/// chunk, in the layout of a Zarr (version 2) array.
+///
+/// Full chunks are written by the threads of a ChunkWriterPool, so that
+/// writing is not limited to one thread as it is with HDF5. The directory
+/// holds the metadata in `.zarray` and the chunks, uncompressed or zlib
+/// compressed, in files named by their index. The last chunk is padded with
+/// zeros. Every chunk file is synced to disk before the metadata that refers
+/// to it is written.
+///
+/// \note The metadata is written by updateMetadata() for the full chunks
+/// written so far and by flush() and the destructor for all elements, when
+/// the last chunk is also written.
+class DirectoryStoreBase {
+public:
+  /// \brief Create the store, i.e. the directory and its metadata.
+  ///
+  /// \param Path The directory.
+  /// \param DataType The Zarr data type of the elements.
+  /// \param ElementSize The size of an element in bytes.
+  /// \param ChunkSize The number of elements per chunk.
+  /// \param Writers The threads that write chunks, nullptr to write them
+  /// from the calling thread.
+  /// \param CompressionLevel The zlib compression level (1 to 9) of the
+  /// chunks, 0 to not compress them.
+  /// \throw std::runtime_error If the store could not be created.
+  DirectoryStoreBase(fs::path Path, std::string DataType, size_t ElementSize,
+                     size_t ChunkSize, std::shared_ptr<ChunkWriterPool> Writers,
+                     int CompressionLevel);
+
+  /// \brief Flushes the store, see flush().
+  virtual ~DirectoryStoreBase();
+
+  DirectoryStoreBase(DirectoryStoreBase const &) = delete;
+  DirectoryStoreBase &operator=(DirectoryStoreBase const &) = delete;
+
+  /// \brief Write everything appended so far, including the last chunk and
+  /// the metadata, and wait for it to be written.
+  ///
+  /// \throw std::runtime_error If any chunk could not be written.
+  void flush();
+
+  /// \brief Write the metadata for the full chunks that have been written,
+  /// if there are more of them than when the metadata was last written.
+  ///
+  /// Does not wait for chunks to be written. Called periodically, so that
+  /// the store can be read while it is being written.
+  ///
+  /// \throw std::runtime_error If any chunk or the metadata could not be
+  /// written.
+  void updateMetadata();
+
+  /// \brief The number of elements appended.
+  size_t size() const { return NrOfElements; }
+
+  fs::path const &path() const { return Path; }
+
+protected:
+  /// \throw std::runtime_error If a previously appended chunk could not be
+  /// written.
+  void appendBytes(char const *Data, size_t NrOfNewElements);
+
+private:
+  struct Chunk {
+    size_t Index;
+    std::vector<char> Data;
+    bool IsFull;
+  };
+  void queueChunk(Chunk NewChunk);
+  void writeChunk(Chunk const &ChunkToWrite);
+  void chunkWritten(Chunk const &WrittenChunk, std::exception_ptr Error);
+  void writeMetadata(size_t Shape);
+  void waitForChunks();
+  void throwIfFailed();
+
+  fs::path const Path;
+  std::string const DataType;
+  size_t const ElementSize;
+  size_t const ChunkSize;
+  int const CompressionLevel;
+  size_t NrOfElements{0};
+  size_t NrOfFullChunks{0};
+  std::vector<char> Buffer;
+  /// The number of elements in the metadata that was last written.
+  size_t MetadataShape{0};
+
+  std::shared_ptr<ChunkWriterPool> Writers;
+  std::mutex ChunkMutex;
+  std::condition_variable DoneCondition;
+  size_t NrOfPendingChunks{0};
+  /// The number of full chunks, from the first one, that have been written.
+  size_t NrOfWrittenChunks{0};
+  /// Full chunks that have been written after a chunk that has not.
+  std::set<size_t> WrittenOutOfOrder;
+  std::exception_ptr WriteError;
+};
+
+/// \brief A directory store of elements of type \p T.
+template <typename T> class DirectoryStore : public DirectoryStoreBase {
+public:
+  /// \copydoc DirectoryStoreBase::DirectoryStoreBase
+  DirectoryStore(fs::path Path, size_t ChunkSize,
+                 std::shared_ptr<ChunkWriterPool> Writers =
+                     ChunkWriterPool::shared(4),
+                 int CompressionLevel = 0)
+      : DirectoryStoreBase(std::move(Path), zarrDataType<T>(), sizeof(T),
+                           ChunkSize, std::move(Writers), CompressionLevel) {}
+
+  void appendArray(ArrayAdapter<const T> const &NewData) {
+    appendBytes(reinterpret_cast<char const *>(NewData.data()),
+                NewData.size());
+  }
+};
+
+} // namespace NeXusDataset
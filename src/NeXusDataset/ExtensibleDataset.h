@@ -17,6 +17,7 @@
 #include "../logger.h"
 #include <h5cpp/dataspace/simple.hpp>
 #include <h5cpp/hdf5.hpp>
+#include <algorithm>
 
 /// \brief Used to write c-arrays to hdf5 files using h5cpp.
 ///
@@ -231,6 +232,16 @@ public:
     NrOfElements += 1;
   }
 
+  /// Overwrite the last element, e.g. to update a running total.
+  template <typename T> void replaceLastElement(T const &NewElement) {
+    if (NrOfElements == 0) {
+      throw std::runtime_error(
+          "ExtensibleDataset::replaceLastElement(): The dataset is empty.");
+    }
+    hdf5::dataspace::Hyperslab Selection{{NrOfElements - 1}, {1}};
+    write(NewElement, Selection);
+  }
+
 private:
   hdf5::dataspace::Simple ArrayDataSpace;
   hdf5::datatype::Datatype ArrayValueType{hdf5::datatype::create(DataType())};
@@ -320,10 +331,14 @@ public:
     Dataset::extent(CurrentExtent);
     hdf5::dataspace::Hyperslab Selection{{Origin}, {Shape}};
     write(NewData, Selection);
+    KnownExtent.clear();
   }
 
 protected:
   SharedLogger Logger = getLogger();
+  /// Extent of the dataset as last written by MultiDimDataset, empty if it
+  /// has to be read from the file.
+  hdf5::Dimensions KnownExtent;
 };
 
 /// h5cpp dataset class that implements methods for appending data.
@@ -387,6 +402,33 @@ public:
   /// \param CMode Should the dataset be opened or created.
   MultiDimDataset(hdf5::node::Group const &Parent, Mode CMode)
       : MultiDimDatasetBase(Parent, CMode) {}
+
+  /// \brief Append data of the element type of the dataset.
+  ///
+  /// Statically typed alternative to MultiDimDatasetBase::appendArray() for
+  /// the common case of the shape of the data matching that of the dataset.
+  /// The extent of the dataset is kept track of instead of being read from
+  /// the file on every call. Data of a different shape is handed over to
+  /// MultiDimDatasetBase::appendArray().
+  void appendTypedArray(ArrayAdapter<const DataType> const &NewData,
+                        hdf5::Dimensions const &Shape) {
+    if (KnownExtent.empty()) {
+      KnownExtent = get_extent();
+    }
+    if (not std::equal(Shape.begin(), Shape.end(), KnownExtent.begin() + 1,
+                       KnownExtent.end())) {
+      appendArray(NewData, Shape);
+      return;
+    }
+    hdf5::Dimensions Origin(KnownExtent.size(), 0);
+    Origin[0] = KnownExtent[0];
+    hdf5::Dimensions Block(KnownExtent);
+    Block[0] = 1;
+    ++KnownExtent[0];
+    Dataset::extent(KnownExtent);
+    hdf5::dataspace::Hyperslab Selection{{Origin}, {Block}};
+    write(NewData, Selection);
+  }
 };
 
 } // namespace NeXusDataset
\ No newline at end of file
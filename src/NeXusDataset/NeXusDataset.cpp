@@ -35,6 +35,15 @@ CueIndex::CueIndex(hdf5::node::Group const &Parent, Mode CMode,
                    size_t ChunkSize)
     : ExtensibleDataset<std::uint32_t>(Parent, "cue_index", CMode, ChunkSize) {}
 
+TimeDelta::TimeDelta(hdf5::node::Group const &Parent, Mode CMode,
+                     size_t ChunkSize)
+    : ExtensibleDataset<double>(Parent, "time_delta", CMode, ChunkSize) {
+  if (Mode::Create == CMode) {
+    auto UnitAttr = ExtensibleDataset::attributes.create<std::string>("units");
+    UnitAttr.write("ns");
+  }
+}
+
 CueTimestampZero::CueTimestampZero(hdf5::node::Group const &Parent, Mode CMode,
                                    size_t ChunkSize)
     : ExtensibleDataset<std::uint64_t>(Parent, "cue_timestamp_zero", CMode,
@@ -65,6 +74,11 @@ EventIndex::EventIndex(hdf5::node::Group const &Parent, Mode CMode,
     : ExtensibleDataset<std::uint32_t>(Parent, "event_index", CMode,
                                        ChunkSize) {}
 
+EventVetoed::EventVetoed(hdf5::node::Group const &Parent, Mode CMode,
+                         size_t ChunkSize)
+    : ExtensibleDataset<std::uint32_t>(Parent, "event_vetoed", CMode,
+                                       ChunkSize) {}
+
 EventTimeZero::EventTimeZero(hdf5::node::Group const &Parent, Mode CMode,
                              size_t ChunkSize)
     : ExtensibleDataset<std::uint64_t>(Parent, "event_time_zero", CMode,
@@ -43,6 +43,16 @@ public:
   Time(hdf5::node::Group const &Parent, Mode CMode, size_t ChunkSize = 1024);
 };
 
+class TimeDelta : public ExtensibleDataset<double> {
+public:
+  TimeDelta() = default;
+  /// \brief Create the time_delta dataset, holding the time (ns) between the
+  /// samples of each waveform written by the senv writer.
+  /// \throw std::runtime_error if dataset already exists.
+  TimeDelta(hdf5::node::Group const &Parent, Mode CMode,
+            size_t ChunkSize = 1024);
+};
+
 class CueIndex : public ExtensibleDataset<std::uint32_t> {
 public:
   CueIndex() = default;
@@ -87,6 +97,16 @@ public:
              size_t ChunkSize = 1024);
 };
 
+class EventVetoed : public ExtensibleDataset<std::uint32_t> {
+public:
+  EventVetoed() = default;
+  /// \brief Create the event_vetoed dataset, holding the number of events per
+  /// pulse that were discarded by the event filters of the ev42 writer.
+  /// \throw std::runtime_error if dataset already exists.
+  EventVetoed(hdf5::node::Group const &Parent, Mode CMode,
+              size_t ChunkSize = 1024);
+};
+
 class EventTimeZero : public ExtensibleDataset<std::uint64_t> {
 public:
   EventTimeZero() = default;
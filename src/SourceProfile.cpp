@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "SourceProfile.h"
+#include "helper.h"
+#include "json.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace FileWriter {
+
+using nlohmann::json;
+
+void SourceProfile::addMessage(std::size_t Size, std::int64_t Timestamp) {
+  if (Messages == 0) {
+    FirstTimestamp = Timestamp;
+  }
+  ++Messages;
+  Bytes += Size;
+  MaxMessageSize = std::max<std::uint64_t>(MaxMessageSize, Size);
+  LastTimestamp = Timestamp;
+}
+
+double SourceProfile::messageRate() const {
+  if (Messages < 2 or LastTimestamp <= FirstTimestamp) {
+    return 0.0;
+  }
+  return (Messages - 1) * 1e9 / double(LastTimestamp - FirstTimestamp);
+}
+
+double SourceProfile::meanMessageSize() const {
+  if (Messages == 0) {
+    return 0.0;
+  }
+  return double(Bytes) / Messages;
+}
+
+std::uint64_t chunkSizeForRate(double UnitsPerSecond, double TargetSeconds,
+                               std::uint64_t MinSize, std::uint64_t MaxSize) {
+  auto const Wanted = UnitsPerSecond * TargetSeconds;
+  std::uint64_t Result = MinSize;
+  while (Result < Wanted and Result < MaxSize) {
+    Result *= 2;
+  }
+  return std::min(Result, MaxSize);
+}
+
+SourceProfileStore::SourceProfileStore(std::string File)
+    : FileName(std::move(File)) {
+  if (FileName.empty()) {
+    return;
+  }
+  auto FileContents = readFileIntoVector(FileName);
+  if (FileContents.empty()) {
+    return;
+  }
+  try {
+    fromJsonString({FileContents.begin(), FileContents.end()});
+  } catch (std::exception const &E) {
+    LOG_WARN("Unable to load source profiles from \"{}\": {}", FileName,
+             E.what());
+  }
+}
+
+SourceProfileStore::~SourceProfileStore() {
+  try {
+    save();
+  } catch (std::exception const &E) {
+    LOG_WARN("Unable to save source profiles to \"{}\": {}", FileName,
+             E.what());
+  }
+}
+
+std::string SourceProfileStore::key(std::string const &Topic,
+                                    std::string const &Source,
+                                    std::string const &SchemaID) {
+  return Topic + ":" + Source + ":" + SchemaID;
+}
+
+std::optional<SourceProfile>
+SourceProfileStore::find(std::string const &Key) const {
+  std::lock_guard<std::mutex> Lock(ProfilesMutex);
+  auto Result = Profiles.find(Key);
+  if (Result == Profiles.end()) {
+    return std::nullopt;
+  }
+  return Result->second;
+}
+
+void SourceProfileStore::record(std::string const &Key,
+                                SourceProfile const &Profile) {
+  if (not Profile.isUsable()) {
+    return;
+  }
+  std::lock_guard<std::mutex> Lock(ProfilesMutex);
+  Profiles[Key] = Profile;
+}
+
+void SourceProfileStore::save() const {
+  if (FileName.empty()) {
+    return;
+  }
+  // Write to a temporary file first so that a crash does not leave a
+  // truncated profile file behind.
+  auto TempFileName = FileName + ".tmp";
+  {
+    std::ofstream OutFile(TempFileName, std::ios::trunc);
+    OutFile << toJsonString();
+    if (not OutFile.good()) {
+      throw std::runtime_error("Failed to write to \"" + TempFileName + "\".");
+    }
+  }
+  if (std::rename(TempFileName.c_str(), FileName.c_str()) != 0) {
+    throw std::runtime_error("Failed to rename \"" + TempFileName + "\".");
+  }
+}
+
+std::string SourceProfileStore::toJsonString() const {
+  std::lock_guard<std::mutex> Lock(ProfilesMutex);
+  auto Output = json::object();
+  for (auto const &Item : Profiles) {
+    Output[Item.first] = {{"messages", Item.second.Messages},
+                          {"bytes", Item.second.Bytes},
+                          {"max_message_size", Item.second.MaxMessageSize},
+                          {"first_timestamp", Item.second.FirstTimestamp},
+                          {"last_timestamp", Item.second.LastTimestamp}};
+  }
+  return Output.dump(2);
+}
+
+void SourceProfileStore::fromJsonString(std::string const &JsonString) {
+  auto Input = json::parse(JsonString);
+  std::map<std::string, SourceProfile> NewProfiles;
+  for (auto const &Item : Input.items()) {
+    SourceProfile Profile;
+    Profile.Messages = Item.value().at("messages").get<std::uint64_t>();
+    Profile.Bytes = Item.value().at("bytes").get<std::uint64_t>();
+    Profile.MaxMessageSize =
+        Item.value().at("max_message_size").get<std::uint64_t>();
+    Profile.FirstTimestamp =
+        Item.value().at("first_timestamp").get<std::int64_t>();
+    Profile.LastTimestamp =
+        Item.value().at("last_timestamp").get<std::int64_t>();
+    NewProfiles[Item.key()] = Profile;
+  }
+  std::lock_guard<std::mutex> Lock(ProfilesMutex);
+  Profiles = std::move(NewProfiles);
+}
+
+} // namespace FileWriter
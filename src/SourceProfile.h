@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace FileWriter {
+
+/// \brief Statistics of the messages of a single source (topic + source name
+/// + flatbuffer schema) as seen during a file-writing job.
+struct SourceProfile {
+  std::uint64_t Messages{0};
+  std::uint64_t Bytes{0};
+  std::uint64_t MaxMessageSize{0};
+  /// Flatbuffer timestamps (ns) of the first and last message.
+  std::int64_t FirstTimestamp{0};
+  std::int64_t LastTimestamp{0};
+
+  void addMessage(std::size_t Size, std::int64_t Timestamp);
+
+  /// \brief Message rate in Hz based on the flatbuffer timestamps.
+  ///
+  /// \return 0 if the rate can not be determined.
+  double messageRate() const;
+
+  double meanMessageSize() const;
+
+  /// \brief Expected number of bytes per second.
+  double byteRate() const { return messageRate() * meanMessageSize(); }
+
+  /// \brief True if there is enough data for the rates to be meaningful.
+  bool isUsable() const { return Messages > 1 and messageRate() > 0.0; }
+};
+
+/// \brief Size (bytes or elements) of a chunk that holds about \p
+/// TargetSeconds worth of data, rounded up to a power of two and limited to
+/// [\p MinSize, \p MaxSize].
+std::uint64_t chunkSizeForRate(double UnitsPerSecond, double TargetSeconds,
+                               std::uint64_t MinSize, std::uint64_t MaxSize);
+
+/// \brief Local store of source profiles recorded by previous jobs.
+///
+/// Profiles are loaded from a JSON file when a job starts and are used to
+/// pre-size chunks in the writer modules. The profiles of the current job are
+/// recorded as its partitions finish and written back to the file when the
+/// last user of the store releases it, i.e. at the end of the job.
+class SourceProfileStore {
+public:
+  /// \param FileName The file to load profiles from and save them to. An empty
+  /// file name results in a store that is neither loaded nor saved.
+  explicit SourceProfileStore(std::string FileName);
+  ~SourceProfileStore();
+  SourceProfileStore(SourceProfileStore const &) = delete;
+  SourceProfileStore &operator=(SourceProfileStore const &) = delete;
+
+  static std::string key(std::string const &Topic, std::string const &Source,
+                         std::string const &SchemaID);
+
+  /// \brief Get the profile recorded for a source by a previous job.
+  std::optional<SourceProfile> find(std::string const &Key) const;
+
+  /// \brief Record the profile of a source. Profiles without enough data to
+  /// determine a rate do not replace a previously recorded profile.
+  void record(std::string const &Key, SourceProfile const &Profile);
+
+  void save() const;
+
+  std::string toJsonString() const;
+  void fromJsonString(std::string const &JsonString);
+
+private:
+  std::string FileName;
+  mutable std::mutex ProfilesMutex;
+  std::map<std::string, SourceProfile> Profiles;
+};
+
+} // namespace FileWriter
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "DecodePool.h"
+
+namespace Stream {
+
+DecodePool::DecodePool(size_t NrOfThreads, size_t MinMessageSize)
+    : MinSize(MinMessageSize) {
+  for (size_t i = 0; i < NrOfThreads; ++i) {
+    Workers.emplace_back([this]() { runWorker(); });
+  }
+}
+
+DecodePool::~DecodePool() {
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    RunThreads = false;
+  }
+  QueueCondition.notify_all();
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+}
+
+std::future<FileWriter::FlatbufferMessage>
+DecodePool::decode(FileWriter::Msg Message) {
+  std::packaged_task<FileWriter::FlatbufferMessage()> Task(
+      [Message{std::move(Message)}]() {
+        return FileWriter::FlatbufferMessage(Message);
+      });
+  auto Result = Task.get_future();
+  if (Workers.empty()) {
+    Task();
+    return Result;
+  }
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    Tasks.emplace_back(std::move(Task));
+  }
+  QueueCondition.notify_one();
+  return Result;
+}
+
+void DecodePool::runWorker() {
+  while (true) {
+    std::packaged_task<FileWriter::FlatbufferMessage()> Task;
+    {
+      std::unique_lock<std::mutex> Lock(QueueMutex);
+      QueueCondition.wait(
+          Lock, [this]() { return not RunThreads or not Tasks.empty(); });
+      if (not RunThreads) {
+        return;
+      }
+      Task = std::move(Tasks.front());
+      Tasks.pop_front();
+    }
+    Task();
+  }
+}
+
+} // namespace Stream
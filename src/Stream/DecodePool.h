@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "FlatbufferMessage.h"
+#include "Msg.h"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Stream {
+
+/// \brief A small pool of helper threads that verify large flatbuffer
+/// messages and extract their meta-data.
+///
+/// Shared by all the partitions of a job so that a few large messages (e.g.
+/// NDAr frames) do not cap the throughput of a partition at the speed of a
+/// single core. Results are returned as futures; it is up to the caller to
+/// keep them in order.
+class DecodePool {
+public:
+  /// \param NrOfThreads Number of helper threads.
+  /// \param MinMessageSize Messages smaller than this (in bytes) are not worth
+  /// the hand-off and should be decoded by the caller.
+  DecodePool(size_t NrOfThreads, size_t MinMessageSize);
+  ~DecodePool();
+  DecodePool(DecodePool const &) = delete;
+  DecodePool &operator=(DecodePool const &) = delete;
+
+  bool shouldDecodeInParallel(size_t MessageSize) const {
+    return not Workers.empty() and MessageSize >= MinSize;
+  }
+
+  /// \brief Queue a Kafka message for verification.
+  ///
+  /// \return A future holding the flatbuffer message or, if the message is
+  /// not a valid flatbuffer, the FileWriter::FlatbufferError thrown.
+  std::future<FileWriter::FlatbufferMessage> decode(FileWriter::Msg Message);
+
+  size_t size() const { return Workers.size(); }
+
+private:
+  void runWorker();
+  size_t const MinSize;
+  bool RunThreads{true};
+  std::mutex QueueMutex;
+  std::condition_variable QueueCondition;
+  std::deque<std::packaged_task<FileWriter::FlatbufferMessage()>> Tasks;
+  std::vector<std::thread> Workers;
+};
+
+} // namespace Stream
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "FlatbufferMessage.h"
+#include <chrono>
 #include <memory>
 
 namespace WriterModule {
@@ -29,8 +30,16 @@ public:
           FileWriter::FlatbufferMessage const &Msg)
       : FbMsg(Msg), DestPtr(DestinationModule) {}
 
-  FileWriter::FlatbufferMessage const FbMsg{};
-  DestPtrType const DestPtr{nullptr};
+  Message(WriterModule::Base *DestinationModule,
+          FileWriter::FlatbufferMessage &&Msg)
+      : FbMsg(std::move(Msg)), DestPtr(DestinationModule) {}
+
+  FileWriter::FlatbufferMessage FbMsg{};
+  DestPtrType DestPtr{nullptr};
+  /// Set by SourceFilter when the message is passed on for writing.
+  std::chrono::steady_clock::time_point RoutedAt;
+  /// Set by MessageWriter when the message is queued for writing.
+  std::chrono::steady_clock::time_point QueuedAt;
 };
 
 } // namespace Stream
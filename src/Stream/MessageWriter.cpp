@@ -11,7 +11,9 @@
 ///
 
 #include "MessageWriter.h"
+#include "Tracing.h"
 #include "WriterModuleBase.h"
+#include <algorithm>
 
 namespace Stream {
 
@@ -25,9 +27,23 @@ ModuleHash generateSrcHash(std::string const &Source,
 static const ModuleHash UnknownModuleHash{
     generateSrcHash("Unknown source", "Unknown fb-id")};
 
-MessageWriter::MessageWriter(Metrics::Registrar const &MetricReg)
-    : Registrar(MetricReg.getNewRegistrar("writer")) {
+/// Max number of messages taken from the queue at a time.
+static size_t const BulkSize{64};
+
+/// Max number of messages written before yielding to other tasks.
+static size_t const MaxMessagesPerTask{1024};
+
+MessageWriter::MessageWriter(Metrics::Registrar const &MetricReg,
+                             size_t MaxQueuedMessages,
+                             WatchdogSettings WatchdogConfig)
+    : MaxQueuedMessages(std::max(MaxQueuedMessages, size_t(1))),
+      MessageQueue(MaxQueuedMessages), Bulk(BulkSize),
+      Registrar(MetricReg.getNewRegistrar("writer")),
+      Watchdog(std::move(WatchdogConfig), Registrar,
+               [this]() { return QueuedMessages.load(); }) {
+  BulkDestinations.reserve(BulkSize);
   Registrar.registerMetric(WritesDone, {Metrics::LogTo::CARBON});
+  Registrar.registerMetric(QueueFull, {Metrics::LogTo::CARBON});
   Registrar.registerMetric(WriteErrors,
                            {Metrics::LogTo::CARBON, Metrics::LogTo::LOG_MSG});
   ModuleErrorCounters[UnknownModuleHash] = std::make_unique<Metrics::Metric>(
@@ -36,15 +52,116 @@ MessageWriter::MessageWriter(Metrics::Registrar const &MetricReg)
                            {Metrics::LogTo::LOG_MSG});
 }
 
-void MessageWriter::addMessage(Message const &Msg) {
-  Executor.sendWork([=]() { writeMsgImpl(Msg.DestPtr, Msg.FbMsg); });
+void MessageWriter::addMessage(Message Msg) {
+  Msg.QueuedAt = WriteWatchdog::Clock::now();
+  Watchdog.messageQueued(Msg.QueuedAt);
+  TRACE_PROBE6(message_enqueued, Msg.FbMsg.getSourceName().c_str(),
+               Msg.FbMsg.getTopic(), Msg.FbMsg.getPartition(),
+               Msg.FbMsg.getOffset(), Msg.FbMsg.data(), Msg.FbMsg.size());
+  if (QueuedMessages.fetch_add(1) >= MaxQueuedMessages) {
+    QueueFull++;
+    do {
+      QueuedMessages--;
+      ++WaitingProducers;
+      {
+        std::unique_lock<std::mutex> Lock(RoomMutex);
+        RoomAvailable.wait(
+            Lock, [this]() { return QueuedMessages < MaxQueuedMessages; });
+      }
+      --WaitingProducers;
+    } while (QueuedMessages.fetch_add(1) >= MaxQueuedMessages);
+  }
+  // Can only fail if memory can not be allocated.
+  if (not MessageQueue.enqueue(std::move(Msg))) {
+    QueuedMessages--;
+    throw std::bad_alloc();
+  }
+  if (not WriteScheduled.exchange(true)) {
+    Executor.sendWork([=]() { writeQueuedMessages(); });
+  }
+}
+
+void MessageWriter::writeQueuedMessages() {
+  // Cleared before emptying the queue so that a message added after the last
+  // dequeue will schedule a new call.
+  WriteScheduled = false;
+  size_t MessagesWritten{0};
+  while (MessagesWritten < MaxMessagesPerTask) {
+    auto NrOfMessages = MessageQueue.try_dequeue_bulk(Bulk.begin(), BulkSize);
+    if (NrOfMessages == 0) {
+      return;
+    }
+    QueuedMessages -= NrOfMessages;
+    if (WaitingProducers > 0) {
+      // Taking the lock ensures that a producer is either waiting or will
+      // see the new queue size when it checks it.
+      std::lock_guard<std::mutex> Lock(RoomMutex);
+      RoomAvailable.notify_all();
+    }
+    BulkDestinations.clear();
+    for (size_t i = 0; i < NrOfMessages; ++i) {
+      if (TRACE_ENABLED(message_dequeued)) {
+        TRACE_PROBE6(message_dequeued, Bulk[i].FbMsg.getSourceName().c_str(),
+                     Bulk[i].FbMsg.getTopic(), Bulk[i].FbMsg.getPartition(),
+                     Bulk[i].FbMsg.getOffset(), Bulk[i].FbMsg.data(),
+                     Bulk[i].FbMsg.size());
+      }
+      if (std::find(BulkDestinations.begin(), BulkDestinations.end(),
+                    Bulk[i].DestPtr) == BulkDestinations.end()) {
+        BulkDestinations.push_back(Bulk[i].DestPtr);
+        WrittenModules.insert(Bulk[i].DestPtr);
+      }
+    }
+    for (auto CDest : BulkDestinations) {
+      for (size_t i = 0; i < NrOfMessages; ++i) {
+        if (Bulk[i].DestPtr == CDest) {
+          writeMsgImpl(CDest, Bulk[i].FbMsg);
+          Watchdog.messageWritten({Bulk[i].FbMsg.getConsumedAt(),
+                                   Bulk[i].RoutedAt, Bulk[i].QueuedAt,
+                                   WriteWatchdog::Clock::now()});
+        }
+      }
+    }
+    for (size_t i = 0; i < NrOfMessages; ++i) {
+      Bulk[i] = Message();
+    }
+    MessagesWritten += NrOfMessages;
+  }
+  if (not WriteScheduled.exchange(true)) {
+    Executor.sendWork([=]() { writeQueuedMessages(); });
+  }
+}
+
+void MessageWriter::flushModules() {
+  if (not FlushScheduled.exchange(true)) {
+    Executor.sendWork([=]() { flushModulesImpl(); });
+  }
+}
+
+void MessageWriter::flushModulesImpl() {
+  FlushScheduled = false;
+  for (auto Module : WrittenModules) {
+    try {
+      Module->flush();
+    } catch (std::exception &E) {
+      WriteErrors++;
+      Log->error("Unable to write the buffered data of a writer module: {}",
+                 E.what());
+    }
+  }
 }
 
 void MessageWriter::writeMsgImpl(WriterModule::Base *ModulePtr,
                                  FileWriter::FlatbufferMessage const &Msg) {
+  auto WriteStart = Watchdog.writeStarted();
+  TRACE_PROBE6(module_write_start, Msg.getSourceName().c_str(),
+               Msg.getTopic(), Msg.getPartition(), Msg.getOffset(), Msg.data(),
+               Msg.size());
   try {
     ModulePtr->write(Msg);
     WritesDone++;
+    TRACE_PROBE6(module_write_end, Msg.getSourceName().c_str(), Msg.getTopic(),
+                 Msg.getPartition(), Msg.getOffset(), Msg.data(), Msg.size());
   } catch (WriterModule::WriterException &E) {
     WriteErrors++;
     auto UsedHash = UnknownModuleHash;
@@ -63,10 +180,15 @@ void MessageWriter::writeMsgImpl(WriterModule::Base *ModulePtr,
       }
     }
     (*ModuleErrorCounters[UsedHash])++;
+    TRACE_PROBE6(module_write_end, Msg.getSourceName().c_str(), Msg.getTopic(),
+                 Msg.getPartition(), Msg.getOffset(), Msg.data(), 0);
   } catch (std::exception &E) {
     WriteErrors++;
     Log->critical("Unknown file writing error: {}", E.what());
+    TRACE_PROBE6(module_write_end, Msg.getSourceName().c_str(), Msg.getTopic(),
+                 Msg.getPartition(), Msg.getOffset(), Msg.data(), 0);
   }
+  Watchdog.writeDone(WriteStart);
 }
 
 } // namespace Stream
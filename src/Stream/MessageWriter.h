@@ -16,9 +16,16 @@
 #include "Metrics/Metric.h"
 #include "Metrics/Registrar.h"
 #include "ThreadedExecutor.h"
+#include "WriteWatchdog.h"
 #include "logger.h"
+#include <atomic>
+#include <concurrentqueue/concurrentqueue.h>
+#include <condition_variable>
 #include <map>
+#include <mutex>
+#include <set>
 #include <thread>
+#include <vector>
 
 namespace WriterModule {
 class Base;
@@ -26,32 +33,81 @@ class Base;
 
 namespace Stream {
 
+/// \brief Writes messages to their writer modules on a separate thread.
+///
+/// Messages are moved into a queue that the writer thread empties in bulk.
+/// The number of queued messages is bounded by a counter rather than by the
+/// capacity of the queue, as the queue reserves a block of slots per producer
+/// thread and could otherwise be "full" with only a few messages in it. The
+/// queue memory is allocated up front and reused, so adding a message does
+/// not normally allocate memory. If the queue is full, addMessage() blocks
+/// until the writer thread has made room.
 class MessageWriter {
 public:
-  explicit MessageWriter(Metrics::Registrar const &MetricReg);
+  /// \param MetricReg Registrar for the metrics of the writer.
+  /// \param MaxQueuedMessages Number of messages that can be waiting to be
+  /// written before addMessage() blocks.
+  /// \param Watchdog Settings of the watchdog that reports stalled writes.
+  explicit MessageWriter(Metrics::Registrar const &MetricReg,
+                         size_t MaxQueuedMessages = 1024,
+                         WatchdogSettings Watchdog = {});
 
-  virtual void addMessage(Message const &Msg);
+  virtual void addMessage(Message Msg);
 
   using ModuleHash = size_t;
 
+  /// \brief Let the writer modules that messages have been written to write
+  /// the data they have buffered for too long, see WriterModule::Base::flush().
+  ///
+  /// Called periodically; the modules are flushed on the writer thread.
+  void flushModules();
+
   auto nrOfWritesDone() const { return int64_t(WritesDone); };
   auto nrOfWriteErrors() const { return int64_t(WriteErrors); };
   auto nrOfWriterModulesWithErrors() const {
     return ModuleErrorCounters.size();
   }
+  auto nrOfWriteStalls() const { return Watchdog.nrOfStalls(); }
 
 protected:
   virtual void writeMsgImpl(WriterModule::Base *ModulePtr,
                             FileWriter::FlatbufferMessage const &Msg);
 
+  /// \brief Write the messages in the queue, grouped by writer module.
+  ///
+  /// Messages for the same writer module are written in the order they were
+  /// added.
+  void writeQueuedMessages();
+
+  void flushModulesImpl();
+
   SharedLogger Log{getLogger()};
   Metrics::Metric WritesDone{"writes_done",
                              "Number of completed writes to HDF file."};
   Metrics::Metric WriteErrors{"write_errors",
                               "Number of failed HDF file writes.",
                               Metrics::Severity::ERROR};
+  Metrics::Metric QueueFull{
+      "queue_full",
+      "Number of times a message had to wait for room in the write queue."};
   std::map<ModuleHash, std::unique_ptr<Metrics::Metric>> ModuleErrorCounters;
+  size_t const MaxQueuedMessages;
+  std::atomic<size_t> QueuedMessages{0};
+  /// Producers blocked in addMessage() wait for the writer thread to signal
+  /// that there is room in the queue. The counter lets the writer thread
+  /// skip locking the mutex when no producer is waiting.
+  std::atomic<size_t> WaitingProducers{0};
+  std::mutex RoomMutex;
+  std::condition_variable RoomAvailable;
+  moodycamel::ConcurrentQueue<Message> MessageQueue;
+  std::atomic_bool WriteScheduled{false};
+  std::vector<Message> Bulk;
+  std::vector<Message::DestPtrType> BulkDestinations;
+  /// Writer modules that messages have been written to, see flushModules().
+  std::set<Message::DestPtrType> WrittenModules;
+  std::atomic_bool FlushScheduled{false};
   Metrics::Registrar Registrar;
+  WriteWatchdog Watchdog;
   static bool const LowPriorityExecutorExit{true};
   ThreadedExecutor Executor{
       MessageWriter::LowPriorityExecutorExit}; // Must be last to prevent
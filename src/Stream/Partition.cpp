@@ -9,17 +9,61 @@
 
 #include "Partition.h"
 #include "Msg.h"
+#include <algorithm>
 
 namespace Stream {
 
+namespace {
+enum PartitionCounter : size_t {
+  TimeoutsIndex,
+  KafkaErrorsIndex,
+  ReceivedIndex,
+  ProcessedIndex,
+  BadOffsetsIndex,
+  FlatbufferErrorsIndex,
+  SkippedIndex,
+  BadTimestampsIndex
+};
+
+/// The high watermark is queried at most this often, even if there is no
+/// grace period at the end of the partition.
+duration const MinWatermarkPeriod{100ms};
+
+using Metrics::LogTo;
+using Metrics::Severity;
+Metrics::FamilyDefinition const PartitionFamily{
+    "partition",
+    {{"timeouts", "Timeouts when polling for messages.", Severity::DEBUG,
+      {LogTo::CARBON}},
+     {"kafka_errors", "Errors received when polling for messages.",
+      Severity::ERROR, {LogTo::CARBON, LogTo::LOG_MSG}},
+     {"received", "Number of messages received from broker.", Severity::DEBUG,
+      {LogTo::CARBON}},
+     {"processed", "Number of messages queued up for writing.",
+      Severity::DEBUG, {LogTo::CARBON}},
+     {"bad_offsets", "Number of messages received with bad offsets.",
+      Severity::ERROR, {LogTo::CARBON, LogTo::LOG_MSG}},
+     {"flatbuffer_errors",
+      "Errors when creating flatbuffer message from Kafka message.",
+      Severity::ERROR, {LogTo::CARBON, LogTo::LOG_MSG}},
+     {"skipped",
+      "Number of messages dropped based on their Kafka headers or key.",
+      Severity::DEBUG, {LogTo::CARBON}},
+     {"bad_timestamps", "Number of messages received with bad timestamps.",
+      Severity::ERROR, {LogTo::CARBON, LogTo::LOG_MSG}}}};
+} // namespace
+
 Partition::Partition(std::unique_ptr<Kafka::ConsumerInterface> Consumer,
                      int Partition, std::string TopicName, SrcToDst const &Map,
                      MessageWriter *Writer, Metrics::Registrar RegisterMetric,
                      time_point Start, time_point Stop, duration StopLeeway,
-                     duration KafkaErrorTimeout)
+                     duration KafkaErrorTimeout,
+                     std::shared_ptr<FileWriter::SourceProfileStore> Profiles,
+                     std::shared_ptr<DecodePool> Decoders)
     : ConsumerPtr(std::move(Consumer)), PartitionID(Partition),
       Topic(std::move(TopicName)), StopTime(Stop), StopTimeLeeway(StopLeeway),
-      StopTester(Stop, StopLeeway, KafkaErrorTimeout) {
+      StopTester(Stop, StopLeeway, KafkaErrorTimeout),
+      ProfileStore(std::move(Profiles)), DecodeHelpers(std::move(Decoders)) {
   // Stop time is reduced if it is too close to max to avoid overflow.
   if (time_point::max() - StopTime <= StopTimeLeeway) {
     StopTime -= StopTimeLeeway;
@@ -39,33 +83,50 @@ Partition::Partition(std::unique_ptr<Kafka::ConsumerInterface> Consumer,
                             std::make_unique<SourceFilter>(
                                 Start, Stop,
                                 SrcDestInfo.AcceptsRepeatedTimestamps, Writer,
-                                RegisterMetric.getNewRegistrar(
+                                RegisterMetric.getLabelledRegistrar(
+                                    "source",
                                     SrcDestInfo.getMetricsNameString())));
     }
     TempFilterMap[SrcDestInfo.WriteHash]->addDestinationPtr(
         SrcDestInfo.Destination);
     WriterToSourceHashMap[SrcDestInfo.WriteHash] = SrcDestInfo.SrcHash;
+    ProfileKeys[SrcDestInfo.SrcHash] = FileWriter::SourceProfileStore::key(
+        Topic, SrcDestInfo.SourceName, SrcDestInfo.FlatbufferId);
   }
   for (auto &Item : TempFilterMap) {
     auto UsedHash = WriterToSourceHashMap[Item.first];
     MsgFilters.emplace_back(UsedHash, std::move(Item.second));
   }
 
-  RegisterMetric.registerMetric(KafkaTimeouts, {Metrics::LogTo::CARBON});
-  RegisterMetric.registerMetric(
-      KafkaErrors, {Metrics::LogTo::CARBON, Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(MessagesReceived, {Metrics::LogTo::CARBON});
-  RegisterMetric.registerMetric(MessagesProcessed, {Metrics::LogTo::CARBON});
-  RegisterMetric.registerMetric(
-      BadOffsets, {Metrics::LogTo::CARBON, Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(
-      FlatbufferErrors, {Metrics::LogTo::CARBON, Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(
-      BadTimestamps, {Metrics::LogTo::CARBON, Metrics::LogTo::LOG_MSG});
+  PartitionMetrics = RegisterMetric.addFamilyInstance(PartitionFamily);
+  KafkaTimeouts = PartitionMetrics[TimeoutsIndex];
+  KafkaErrors = PartitionMetrics[KafkaErrorsIndex];
+  MessagesReceived = PartitionMetrics[ReceivedIndex];
+  MessagesProcessed = PartitionMetrics[ProcessedIndex];
+  BadOffsets = PartitionMetrics[BadOffsetsIndex];
+  FlatbufferErrors = PartitionMetrics[FlatbufferErrorsIndex];
+  MessagesSkipped = PartitionMetrics[SkippedIndex];
+  BadTimestamps = PartitionMetrics[BadTimestampsIndex];
+}
+
+Partition::~Partition() {
+  Executor.sendWork([=]() {
+    for (auto &Filter : MsgFilters) {
+      recordProfile(Filter.first, *Filter.second);
+    }
+  });
 }
 
 void Partition::start() { addPollTask(); }
 
+void Partition::recordProfile(FileWriter::FlatbufferMessage::SrcHash Hash,
+                              SourceFilter const &Filter) {
+  if (ProfileStore == nullptr) {
+    return;
+  }
+  ProfileStore->record(ProfileKeys[Hash], Filter.getProfile());
+}
+
 void Partition::setStopTime(time_point Stop) {
   Executor.sendWork([=]() {
     StopTime = Stop;
@@ -97,6 +158,16 @@ bool Partition::shouldStopBasedOnPollStatus(Kafka::PollStatus CStatus) {
   return false;
 }
 
+bool Partition::shouldQueryHighWatermark() {
+  auto Now = std::chrono::system_clock::now();
+  if (Now < NextWatermarkQuery) {
+    return false;
+  }
+  NextWatermarkQuery =
+      Now + std::max(StopTester.getEndOfPartitionGrace(), MinWatermarkPeriod);
+  return true;
+}
+
 void Partition::pollForMessage() {
   auto Msg = ConsumerPtr->poll();
   switch (Msg.first) {
@@ -114,29 +185,66 @@ void Partition::pollForMessage() {
     break;
   }
   if (shouldStopBasedOnPollStatus(Msg.first)) {
+    forwardDecodedMessages(true);
     HasFinished = true;
     return;
   }
 
   if (Msg.first == Kafka::PollStatus::Message) {
-    processMessage(Msg.second);
-    if (MsgFilters.empty() or
-        Msg.second.getMetaData().timestamp() > StopTime + StopTimeLeeway) {
+    auto MessageTime = Msg.second.getMetaData().timestamp();
+    StopTester.setLastMessageTime(MessageTime);
+    if (DecodeHelpers != nullptr and
+        isWantedSource(Msg.second.getMetaData()) and
+        DecodeHelpers->shouldDecodeInParallel(Msg.second.size())) {
+      queueMessage(std::move(Msg.second));
+    } else {
+      processMessage(Msg.second);
+    }
+    if (MsgFilters.empty() or MessageTime > StopTime + StopTimeLeeway) {
+      forwardDecodedMessages(true);
       LOG_INFO("Done consuming data from partition {} of topic {}.",
                PartitionID, Topic);
       HasFinished = true;
       return;
     }
+  } else if (StopTester.hasReachedEndAfterStop() and
+             shouldQueryHighWatermark() and
+             ConsumerPtr->hasReachedHighWatermark(Topic, PartitionID)) {
+    forwardDecodedMessages(true);
+    LOG_INFO("Done consuming data from partition {} of topic {} as there is "
+             "no more data before the stop time.",
+             PartitionID, Topic);
+    HasFinished = true;
+    return;
   }
+  forwardDecodedMessages(false);
   addPollTask();
 }
 
-void Partition::processMessage(FileWriter::Msg const &Message) {
-  if (CurrentOffset != 0 and
-      CurrentOffset + 1 != Message.getMetaData().Offset) {
+void Partition::checkOffset(std::int64_t Offset) {
+  if (CurrentOffset != 0 and CurrentOffset + 1 != Offset) {
     BadOffsets++;
   }
-  CurrentOffset = Message.getMetaData().Offset;
+  CurrentOffset = Offset;
+}
+
+bool Partition::isWantedSource(
+    FileWriter::MessageMetaData const &MetaData) const {
+  if (not MetaData.hasRoutingInfo()) {
+    return true;
+  }
+  auto Hash =
+      FileWriter::calcSourceHash(MetaData.FlatbufferID, MetaData.SourceName);
+  return std::any_of(MsgFilters.begin(), MsgFilters.end(),
+                     [Hash](auto &Item) { return Item.first == Hash; });
+}
+
+void Partition::processMessage(FileWriter::Msg const &Message) {
+  checkOffset(Message.getMetaData().Offset);
+  if (not isWantedSource(Message.getMetaData())) {
+    MessagesSkipped++;
+    return;
+  }
   FileWriter::FlatbufferMessage FbMsg;
   try {
     FbMsg = FileWriter::FlatbufferMessage(Message);
@@ -144,6 +252,45 @@ void Partition::processMessage(FileWriter::Msg const &Message) {
     FlatbufferErrors++;
     return;
   }
+  if (not DecodedMessages.empty()) {
+    // Messages received earlier are still being decoded, keep the order.
+    std::promise<FileWriter::FlatbufferMessage> Decoded;
+    Decoded.set_value(std::move(FbMsg));
+    DecodedMessages.emplace_back(Decoded.get_future());
+    forwardDecodedMessages(false);
+    return;
+  }
+  forwardMessage(FbMsg);
+}
+
+void Partition::queueMessage(FileWriter::Msg &&Message) {
+  checkOffset(Message.getMetaData().Offset);
+  DecodedMessages.emplace_back(DecodeHelpers->decode(std::move(Message)));
+  forwardDecodedMessages(false);
+}
+
+void Partition::forwardDecodedMessages(bool WaitForAll) {
+  auto const MaxQueuedMessages =
+      DecodeHelpers == nullptr ? 0 : 2 * DecodeHelpers->size();
+  while (not DecodedMessages.empty()) {
+    if (not WaitForAll and DecodedMessages.size() <= MaxQueuedMessages and
+        DecodedMessages.front().wait_for(0ms) != std::future_status::ready) {
+      return;
+    }
+    auto Decoded = std::move(DecodedMessages.front());
+    DecodedMessages.pop_front();
+    FileWriter::FlatbufferMessage FbMsg;
+    try {
+      FbMsg = Decoded.get();
+    } catch (FileWriter::FlatbufferError &E) {
+      FlatbufferErrors++;
+      continue;
+    }
+    forwardMessage(FbMsg);
+  }
+}
+
+void Partition::forwardMessage(FileWriter::FlatbufferMessage const &FbMsg) {
   if (std::any_of(MsgFilters.begin(), MsgFilters.end(), [&FbMsg](auto &Item) {
         return Item.first == FbMsg.getSourceHash();
       })) {
@@ -154,10 +301,15 @@ void Partition::processMessage(FileWriter::Msg const &Message) {
       CFilter.second->filterMessage(FbMsg);
     }
   }
-  MsgFilters.erase(
-      std::remove_if(MsgFilters.begin(), MsgFilters.end(),
-                     [](auto &Item) { return Item.second->hasFinished(); }),
-      MsgFilters.end());
+  MsgFilters.erase(std::remove_if(MsgFilters.begin(), MsgFilters.end(),
+                                  [this](auto &Item) {
+                                    if (Item.second->hasFinished()) {
+                                      recordProfile(Item.first, *Item.second);
+                                      return true;
+                                    }
+                                    return false;
+                                  }),
+                   MsgFilters.end());
 }
 
 } // namespace Stream
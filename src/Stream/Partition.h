@@ -9,15 +9,18 @@
 
 #pragma once
 
+#include "DecodePool.h"
 #include "FlatbufferMessage.h"
 #include "Kafka/Consumer.h"
 #include "Message.h"
 #include "MessageWriter.h"
 #include "PartitionFilter.h"
 #include "SourceFilter.h"
+#include "SourceProfile.h"
 #include "Stream/MessageWriter.h"
 #include "ThreadedExecutor.h"
 #include "TimeUtility.h"
+#include <deque>
 
 namespace Stream {
 
@@ -43,8 +46,10 @@ public:
   Partition(std::unique_ptr<Kafka::ConsumerInterface> Consumer, int Partition,
             std::string TopicName, SrcToDst const &Map, MessageWriter *Writer,
             Metrics::Registrar RegisterMetric, time_point Start,
-            time_point Stop, duration StopLeeway, duration KafkaErrorTimeout);
-  virtual ~Partition() = default;
+            time_point Stop, duration StopLeeway, duration KafkaErrorTimeout,
+            std::shared_ptr<FileWriter::SourceProfileStore> Profiles = nullptr,
+            std::shared_ptr<DecodePool> Decoders = nullptr);
+  virtual ~Partition();
 
   /// \brief Must be called after the constructor.
   /// \note This function exist in order to make unit testing possible.
@@ -52,38 +57,64 @@ public:
 
   void setStopTime(time_point Stop);
 
+  /// \brief Set the time to wait at the end of the partition after the stop
+  /// time before checking the high watermark. Must be called before start().
+  void setEndOfPartitionGrace(duration Grace) {
+    StopTester.setEndOfPartitionGrace(Grace);
+  }
+
   virtual bool hasFinished() const;
   auto getPartitionID() const { return PartitionID; }
   auto getTopicName() const { return Topic; }
 
 protected:
-  Metrics::Metric KafkaTimeouts{"timeouts",
-                                "Timeouts when polling for messages."};
-  Metrics::Metric KafkaErrors{"kafka_errors",
-                              "Errors received when polling for messages.",
-                              Metrics::Severity::ERROR};
-  Metrics::Metric MessagesReceived{"received",
-                                   "Number of messages received from broker."};
-  Metrics::Metric MessagesProcessed{
-      "processed", "Number of messages queued up for writing."};
-  Metrics::Metric BadOffsets{"bad_offsets",
-                             "Number of messages received with bad offsets.",
-                             Metrics::Severity::ERROR};
-
-  Metrics::Metric FlatbufferErrors{
-      "flatbuffer_errors",
-      "Errors when creating flatbuffer message from Kafka message.",
-      Metrics::Severity::ERROR};
-
-  Metrics::Metric BadTimestamps{
-      "bad_timestamps", "Number of messages received with bad timestamps.",
-      Metrics::Severity::ERROR};
+  Metrics::FamilyInstance PartitionMetrics;
+  Metrics::Counter KafkaTimeouts;
+  Metrics::Counter KafkaErrors;
+  Metrics::Counter MessagesReceived;
+  Metrics::Counter MessagesProcessed;
+  Metrics::Counter BadOffsets;
+  Metrics::Counter FlatbufferErrors;
+  Metrics::Counter MessagesSkipped;
+  Metrics::Counter BadTimestamps;
 
   virtual void pollForMessage();
   virtual void addPollTask();
   virtual bool shouldStopBasedOnPollStatus(Kafka::PollStatus CStatus);
 
+  /// \brief Limit the (blocking) high watermark queries to one per grace
+  /// period.
+  bool shouldQueryHighWatermark();
+
   virtual void processMessage(FileWriter::Msg const &Message);
+
+  /// \brief Have a (large) message verified by the decode pool.
+  ///
+  /// The message is handed over to the source filters by
+  /// forwardDecodedMessages() once it and all messages received before it
+  /// have been decoded.
+  void queueMessage(FileWriter::Msg &&Message);
+
+  /// \brief Hand decoded messages over to the source filters, in the order
+  /// in which they were received.
+  ///
+  /// \param WaitForAll Block until all queued messages have been handed over.
+  /// If false, only the messages that are ready are handed over unless the
+  /// queue is full.
+  void forwardDecodedMessages(bool WaitForAll);
+  void forwardMessage(FileWriter::FlatbufferMessage const &Message);
+  void checkOffset(std::int64_t Offset);
+
+  /// \brief Check if a message is wanted based on the source name and
+  /// flatbuffer ID in its Kafka headers or key.
+  ///
+  /// \return False if the message is known to be of no interest, true if it
+  /// is or if it has to be decoded to find out.
+  bool isWantedSource(FileWriter::MessageMetaData const &MetaData) const;
+
+  /// \brief Hand the statistics of a source over to the profile store.
+  void recordProfile(FileWriter::FlatbufferMessage::SrcHash Hash,
+                     SourceFilter const &Filter);
   std::unique_ptr<Kafka::ConsumerInterface> ConsumerPtr;
   int PartitionID{-1};
   std::string Topic{"not_initialized"};
@@ -92,9 +123,14 @@ protected:
   time_point StopTime;
   duration StopTimeLeeway;
   PartitionFilter StopTester;
+  time_point NextWatermarkQuery;
   std::vector<std::pair<FileWriter::FlatbufferMessage::SrcHash,
                         std::unique_ptr<SourceFilter>>>
       MsgFilters;
+  std::shared_ptr<FileWriter::SourceProfileStore> ProfileStore;
+  std::map<FileWriter::FlatbufferMessage::SrcHash, std::string> ProfileKeys;
+  std::shared_ptr<DecodePool> DecodeHelpers;
+  std::deque<std::future<FileWriter::FlatbufferMessage>> DecodedMessages;
   ThreadedExecutor Executor; // Must be last
 };
 
@@ -9,6 +9,7 @@
 
 #include "PartitionFilter.h"
 #include "Kafka/PollStatus.h"
+#include <algorithm>
 
 namespace Stream {
 
@@ -26,7 +27,12 @@ bool PartitionFilter::shouldStopPartition(Kafka::PollStatus CurrentPollStatus) {
   switch (CurrentPollStatus) {
   case Kafka::PollStatus::Message:
     HasError = false;
+    AtEndOfPartition = false;
     return false;
+  case Kafka::PollStatus::EndOfPartition:
+    HasError = false;
+    AtEndOfPartition = true;
+    return std::chrono::system_clock::now() > StopTime + StopLeeway;
   case Kafka::PollStatus::TimedOut:
     HasError = false;
     return std::chrono::system_clock::now() > StopTime + StopLeeway;
@@ -42,4 +48,16 @@ bool PartitionFilter::shouldStopPartition(Kafka::PollStatus CurrentPollStatus) {
   return false;
 }
 
+bool PartitionFilter::hasReachedEndAfterStop() const {
+  auto Now = std::chrono::system_clock::now();
+  if (not AtEndOfPartition or Now <= StopTime) {
+    return false;
+  }
+  // A message just after the stop time does not mean that all messages
+  // before it have arrived, as the producers of a partition may be out of
+  // step, so the grace period applies to the last message time as well.
+  auto const Grace = std::min(EndOfPartitionGrace, StopLeeway);
+  return std::max(Now, LastMessageTime) - StopTime > Grace;
+}
+
 } // namespace Stream
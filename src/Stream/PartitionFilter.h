@@ -32,6 +32,11 @@ public:
                   duration ErrorTimeOut);
   /// \brief Update the stop time.
   void setStopTime(time_point Stop) { StopTime = Stop; }
+
+  /// \brief Set the time allowed at the end of the partition for messages
+  /// still on their way to the broker, see hasReachedEndAfterStop().
+  void setEndOfPartitionGrace(duration Grace) { EndOfPartitionGrace = Grace; }
+  duration getEndOfPartitionGrace() const { return EndOfPartitionGrace; }
   /// \brief Applies the stop logic to the current poll status.
   /// \param CurrentPollStatus The current (last) poll status.
   /// \return Returns true if consumption from this topic + partition should
@@ -41,12 +46,35 @@ public:
   /// \brief Check if we currently have an error state.
   bool hasErrorState() const { return HasError; }
 
+  /// \brief Register the (Kafka) timestamp of the last message consumed.
+  void setLastMessageTime(time_point MessageTime) {
+    LastMessageTime = MessageTime;
+  }
+
+  /// \brief Check if the end of the partition has been reached and if no
+  /// more messages with a timestamp before the stop time are expected.
+  ///
+  /// This is the case once the current time or the timestamp of the last
+  /// message is more than a grace period (capped by the stop leeway) past
+  /// the stop time, which allows for messages still on their way to the
+  /// broker. If this returns true, the consumer should be used to confirm
+  /// that the partition has been consumed up to its high watermark.
+  ///
+  /// \note Messages with a timestamp before the stop time that reach the
+  /// broker after the partition was finished are not written: those that
+  /// arrive more than the grace period late when the partition is idle, or
+  /// after a message more than the stop leeway past the stop time.
+  bool hasReachedEndAfterStop() const;
+
 protected:
   bool HasError{false};
+  bool AtEndOfPartition{false};
+  time_point LastMessageTime;
   time_point ErrorTime;
   time_point StopTime{time_point::max()};
   duration StopLeeway{10s};
   duration ErrorTimeOut{10s};
+  duration EndOfPartitionGrace{1s};
 };
 
 } // namespace Stream
@@ -8,21 +8,52 @@
 // Screaming Udder!                              https://esss.se
 
 #include "SourceFilter.h"
+#include "Tracing.h"
 
 namespace Stream {
 
+namespace {
+enum SourceCounter : size_t {
+  FlatbufferInvalidIndex,
+  UnorderedTimestampIndex,
+  RepeatedTimestampIndex,
+  ReceivedIndex,
+  SentIndex,
+  DiscardedIndex
+};
+
+using Metrics::LogTo;
+using Metrics::Severity;
+Metrics::FamilyDefinition const SourceFamily{
+    "source",
+    {{"flatbuffer_invalid", "Flatbuffer failed validation.", Severity::ERROR,
+      {LogTo::LOG_MSG}},
+     {"unordered_timestamp",
+      "Timestamp of message not in chronological order.", Severity::ERROR,
+      {LogTo::LOG_MSG}},
+     {"repeated_timestamp", "Got message with repeated timestamp.",
+      Severity::DEBUG, {LogTo::LOG_MSG}},
+     {"received", "Number of messages received/processed.", Severity::DEBUG,
+      {LogTo::LOG_MSG}},
+     {"sent", "Number of messages queued up for writing.", Severity::DEBUG,
+      {LogTo::LOG_MSG}},
+     {"discarded", "Number of messages discarded for whatever reason.",
+      Severity::DEBUG, {LogTo::LOG_MSG}}}};
+} // namespace
+
 SourceFilter::SourceFilter(time_point StartTime, time_point StopTime,
                            bool AcceptRepeatedTimestamps,
                            MessageWriter *Destination,
                            Metrics::Registrar RegisterMetric)
     : Start(StartTime), Stop(StopTime),
       WriteRepeatedTimestamps(AcceptRepeatedTimestamps), Dest(Destination) {
-  RegisterMetric.registerMetric(FlatbufferInvalid, {Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(UnorderedTimestamp, {Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(MessagesReceived, {Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(MessagesTransmitted, {Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(MessagesDiscarded, {Metrics::LogTo::LOG_MSG});
-  RegisterMetric.registerMetric(RepeatedTimestamp, {Metrics::LogTo::LOG_MSG});
+  SourceMetrics = RegisterMetric.addFamilyInstance(SourceFamily);
+  FlatbufferInvalid = SourceMetrics[FlatbufferInvalidIndex];
+  UnorderedTimestamp = SourceMetrics[UnorderedTimestampIndex];
+  RepeatedTimestamp = SourceMetrics[RepeatedTimestampIndex];
+  MessagesReceived = SourceMetrics[ReceivedIndex];
+  MessagesTransmitted = SourceMetrics[SentIndex];
+  MessagesDiscarded = SourceMetrics[DiscardedIndex];
 }
 
 SourceFilter::~SourceFilter() { sendBufferedMessage(); }
@@ -33,18 +64,22 @@ bool SourceFilter::hasFinished() const { return IsDone; }
 
 void SourceFilter::sendBufferedMessage() {
   if (BufferedMessage.isValid()) {
-    sendMessage(BufferedMessage);
+    sendMessage(std::move(BufferedMessage));
     BufferedMessage = FileWriter::FlatbufferMessage();
   }
 }
 
 bool SourceFilter::filterMessage(FileWriter::FlatbufferMessage InMsg) {
+  TRACE_PROBE7(message_routed, InMsg.getSourceName().c_str(),
+               InMsg.getTopic(), InMsg.getPartition(), InMsg.getOffset(),
+               InMsg.data(), InMsg.size(), InMsg.getTimestamp());
   MessagesReceived++;
   if (not InMsg.isValid()) {
     MessagesDiscarded++;
     FlatbufferInvalid++;
     return false;
   }
+  Profile.addMessage(InMsg.size(), InMsg.getTimestamp());
 
   if (InMsg.getTimestamp() == CurrentTimeStamp) {
     RepeatedTimestamp++;
@@ -63,14 +98,14 @@ bool SourceFilter::filterMessage(FileWriter::FlatbufferMessage InMsg) {
     if (BufferedMessage.isValid()) {
       MessagesDiscarded++;
     }
-    BufferedMessage = InMsg;
+    BufferedMessage = std::move(InMsg);
     return false;
   }
   if (TempMsgTime > Stop) {
     IsDone = true;
   }
   sendBufferedMessage();
-  sendMessage(InMsg);
+  sendMessage(std::move(InMsg));
   return true;
 }
 
@@ -12,6 +12,7 @@
 #include "FlatbufferMessage.h"
 #include "Metrics/Metric.h"
 #include "Metrics/Registrar.h"
+#include "SourceProfile.h"
 #include "Stream/MessageWriter.h"
 #include "TimeUtility.h"
 
@@ -38,12 +39,25 @@ public:
   time_point getStopTime() const { return Stop; }
   virtual bool hasFinished() const;
 
+  /// \brief Statistics of the valid messages received by this filter.
+  FileWriter::SourceProfile const &getProfile() const { return Profile; }
+
 protected:
-  void sendMessage(FileWriter::FlatbufferMessage const &Msg) {
+  void sendMessage(FileWriter::FlatbufferMessage &&Msg) {
     ++MessagesTransmitted;
-    for (auto &CDest : DestIDs) {
-      Dest->addMessage({CDest, Msg});
+    if (DestIDs.empty()) {
+      return;
+    }
+    auto RoutedAt = std::chrono::steady_clock::now();
+    for (auto CDest = DestIDs.begin(); CDest != DestIDs.end() - 1; ++CDest) {
+      Message Copy{*CDest, Msg};
+      Copy.RoutedAt = RoutedAt;
+      Dest->addMessage(std::move(Copy));
     }
+    // The last destination gets the original, saving a copy of the buffer.
+    Message Original{DestIDs.back(), std::move(Msg)};
+    Original.RoutedAt = RoutedAt;
+    Dest->addMessage(std::move(Original));
   }
 
   void sendBufferedMessage();
@@ -55,24 +69,14 @@ protected:
   bool IsDone{false};
   FileWriter::FlatbufferMessage BufferedMessage;
   std::vector<Message::DestPtrType> DestIDs;
-  Metrics::Metric FlatbufferInvalid{"flatbuffer_invalid",
-                                    "Flatbuffer failed validation.",
-                                    Metrics::Severity::ERROR};
-  Metrics::Metric UnorderedTimestamp{
-      "unordered_timestamp", "Timestamp of message not in chronological order.",
-      Metrics::Severity::ERROR};
-  Metrics::Metric RepeatedTimestamp{"repeated_timestamp",
-                                    "Got message with repeated timestamp.",
-                                    Metrics::Severity::DEBUG};
-  Metrics::Metric MessagesReceived{"received",
-                                   "Number of messages received/processed.",
-                                   Metrics::Severity::DEBUG};
-  Metrics::Metric MessagesTransmitted{
-      "sent", "Number of messages queued up for writing.",
-      Metrics::Severity::DEBUG};
-  Metrics::Metric MessagesDiscarded{
-      "discarded", "Number of messages discarded for whatever reason.",
-      Metrics::Severity::DEBUG};
+  FileWriter::SourceProfile Profile;
+  Metrics::FamilyInstance SourceMetrics;
+  Metrics::Counter FlatbufferInvalid;
+  Metrics::Counter UnorderedTimestamp;
+  Metrics::Counter RepeatedTimestamp;
+  Metrics::Counter MessagesReceived;
+  Metrics::Counter MessagesTransmitted;
+  Metrics::Counter MessagesDiscarded;
 };
 
 } // namespace Stream
@@ -9,6 +9,7 @@
 
 #include "Topic.h"
 #include "Kafka/ConsumerFactory.h"
+#include "Kafka/FetchTuning.h"
 #include "Kafka/MetaDataQuery.h"
 #include "logger.h"
 #include <Kafka/MetadataException.h>
@@ -20,19 +21,33 @@ Topic::Topic(Kafka::BrokerSettings const &Settings, std::string const &Topic,
              Metrics::Registrar &RegisterMetric, time_point StartTime,
              duration StartTimeLeeway, time_point StopTime,
              duration StopTimeLeeway,
-             std::unique_ptr<Kafka::ConsumerFactoryInterface> CreateConsumers)
+             std::unique_ptr<Kafka::ConsumerFactoryInterface> CreateConsumers,
+             std::shared_ptr<FileWriter::SourceProfileStore> Profiles,
+             std::shared_ptr<DecodePool> Decoders)
     : KafkaSettings(Settings), TopicName(Topic), DataMap(std::move(Map)),
       WriterPtr(Writer), StartConsumeTime(StartTime),
       StartLeeway(StartTimeLeeway), StopConsumeTime(StopTime),
       StopLeeway(StopTimeLeeway),
       CurrentMetadataTimeOut(Settings.MinMetadataTimeout),
-      Registrar(RegisterMetric.getNewRegistrar(Topic)),
-      ConsumerCreator(std::move(CreateConsumers)) {}
+      Registrar(RegisterMetric.getLabelledRegistrar("topic", Topic)),
+      ConsumerCreator(std::move(CreateConsumers)),
+      ProfileStore(std::move(Profiles)), DecodeHelpers(std::move(Decoders)) {
+  for (auto CMetric :
+       {&FetchMaxBytes, &FetchMinBytes, &FetchWaitMaxMs, &QueuedMaxKBytes}) {
+    Registrar.registerMetric(*CMetric, {Metrics::LogTo::CARBON});
+  }
+}
 
 void Topic::start() {
   Executor.sendWork([=]() { initMetadataCalls(KafkaSettings, TopicName); });
 }
 
+void Topic::start(
+    std::vector<std::pair<int, int64_t>> const &PartitionOffsets) {
+  Executor.sendWork(
+      [=]() { createStreams(KafkaSettings, TopicName, PartitionOffsets); });
+}
+
 void Topic::initMetadataCalls(Kafka::BrokerSettings const &Settings,
                               std::string const &Topic) {
   Executor.sendWork([=]() {
@@ -47,6 +62,59 @@ void Topic::setStopTime(std::chrono::system_clock::time_point StopTime) {
   }
 }
 
+double Topic::profiledByteRate() const {
+  if (ProfileStore == nullptr) {
+    return 0.0;
+  }
+  double Result{0.0};
+  for (auto const &SrcDestInfo : DataMap) {
+    auto Profile = ProfileStore->find(FileWriter::SourceProfileStore::key(
+        TopicName, SrcDestInfo.SourceName, SrcDestInfo.FlatbufferId));
+    if (not Profile or not Profile->isUsable()) {
+      return 0.0;
+    }
+    Result += Profile->byteRate();
+  }
+  return Result;
+}
+
+std::uint64_t Topic::profiledMaxMessageSize() const {
+  std::uint64_t Result{0};
+  if (ProfileStore == nullptr) {
+    return Result;
+  }
+  for (auto const &SrcDestInfo : DataMap) {
+    if (auto Profile = ProfileStore->find(FileWriter::SourceProfileStore::key(
+            TopicName, SrcDestInfo.SourceName, SrcDestInfo.FlatbufferId))) {
+      Result = std::max(Result, Profile->MaxMessageSize);
+    }
+  }
+  return Result;
+}
+
+Kafka::BrokerSettings
+Topic::consumerSettings(Kafka::BrokerSettings const &Settings,
+                        size_t NrOfConsumers) {
+  if (ConsumerMemoryBudget == 0 or NrOfConsumers == 0) {
+    return Settings;
+  }
+  auto Fetch = Kafka::fetchSettingsForRate(
+      profiledByteRate() / NrOfConsumers, profiledMaxMessageSize(),
+      ConsumerMemoryBudget / NrOfConsumers);
+  auto Result = Settings;
+  Fetch = Kafka::applyFetchSettings(Fetch, Result);
+  FetchMaxBytes = Fetch.FetchMaxBytes;
+  FetchMinBytes = Fetch.FetchMinBytes;
+  FetchWaitMaxMs = Fetch.FetchWaitMaxMs;
+  QueuedMaxKBytes = Fetch.QueuedMaxKBytes;
+  LOG_DEBUG("Fetch settings of the consumers of topic \"{}\": "
+            "fetch.max.bytes={} fetch.min.bytes={} fetch.wait.max.ms={} "
+            "queued.max.messages.kbytes={}",
+            TopicName, Fetch.FetchMaxBytes, Fetch.FetchMinBytes,
+            Fetch.FetchWaitMaxMs, Fetch.QueuedMaxKBytes);
+  return Result;
+}
+
 void Topic::getPartitionsForTopic(Kafka::BrokerSettings const &Settings,
                                   std::string const &Topic) {
   try {
@@ -124,15 +192,22 @@ void Topic::checkIfDoneTask() {
 void Topic::createStreams(
     Kafka::BrokerSettings const &Settings, std::string const &Topic,
     std::vector<std::pair<int, int64_t>> const &PartitionOffsets) {
+  std::set<FileWriter::FlatbufferMessage::SrcHash> WantedSources;
+  for (auto const &SrcDestInfo : DataMap) {
+    WantedSources.insert(SrcDestInfo.SrcHash);
+  }
+  auto ConsumerSettings = consumerSettings(Settings, PartitionOffsets.size());
   for (const auto &CParOffset : PartitionOffsets) {
-    auto CRegistrar = Registrar.getNewRegistrar(
-        "partition_" + std::to_string(CParOffset.first));
-    auto Consumer = ConsumerCreator->createConsumer(Settings);
+    auto CRegistrar = Registrar.getLabelledRegistrar(
+        "partition", "partition_" + std::to_string(CParOffset.first));
+    auto Consumer = ConsumerCreator->createConsumer(ConsumerSettings);
+    Consumer->setWantedSources(WantedSources);
     Consumer->addPartitionAtOffset(Topic, CParOffset.first, CParOffset.second);
     auto TempPartition = std::make_unique<Partition>(
         std::move(Consumer), CParOffset.first, Topic, DataMap, WriterPtr,
         CRegistrar, StartConsumeTime, StopConsumeTime, StopLeeway,
-        Settings.KafkaErrorTimeout);
+        Settings.KafkaErrorTimeout, ProfileStore, DecodeHelpers);
+    TempPartition->setEndOfPartitionGrace(Settings.EndOfPartitionGrace);
     TempPartition->start();
     ConsumerThreads.emplace_back(std::move(TempPartition));
   }
@@ -28,14 +28,36 @@ public:
         time_point StartTime, duration StartTimeLeeway, time_point StopTime,
         duration StopTimeLeeway,
         std::unique_ptr<Kafka::ConsumerFactoryInterface> CreateConsumers =
-            std::make_unique<Kafka::ConsumerFactory>());
+            std::make_unique<Kafka::ConsumerFactory>(),
+        std::shared_ptr<FileWriter::SourceProfileStore> Profiles = nullptr,
+        std::shared_ptr<DecodePool> Decoders = nullptr);
 
   /// \brief Must be called after the constructor.
   /// \note This function exist in order to make unit testing possible.
   void start();
 
+  /// \brief Alternative to start() for when the partitions and their start
+  /// offsets have already been resolved, e.g. by Kafka::MetaDataPrefetch.
+  ///
+  /// \param PartitionOffsets Partition id and start offset pairs.
+  void start(std::vector<std::pair<int, int64_t>> const &PartitionOffsets);
+
   void setStopTime(std::chrono::system_clock::time_point StopTime);
 
+  /// \brief Expected bytes per second of the topic, based on the profiles of
+  /// its sources recorded by previous jobs.
+  ///
+  /// \return 0 if the rate of any of the sources is not known.
+  double profiledByteRate() const;
+
+  /// \brief Set the memory budget shared by the consumers of the topic.
+  ///
+  /// Must be called before start(). With a budget of 0, the fetch settings of
+  /// the consumers are used as configured.
+  void setConsumerMemoryBudget(std::uint64_t Budget) {
+    ConsumerMemoryBudget = Budget;
+  }
+
   bool isDone() { return IsDone.load(); };
 
   virtual ~Topic() = default;
@@ -81,8 +103,29 @@ protected:
   void checkIfDone();
   virtual void checkIfDoneTask();
 
+  /// \brief Settings of the consumers of the topic, with the fetch settings
+  /// derived from the profiled rate and the memory budget.
+  Kafka::BrokerSettings consumerSettings(Kafka::BrokerSettings const &Settings,
+                                         size_t NrOfConsumers);
+  std::uint64_t profiledMaxMessageSize() const;
+  std::uint64_t ConsumerMemoryBudget{0};
+  Metrics::Metric FetchMaxBytes{"fetch_max_bytes",
+                                "fetch.max.bytes of the consumers.",
+                                Metrics::Severity::INFO};
+  Metrics::Metric FetchMinBytes{"fetch_min_bytes",
+                                "fetch.min.bytes of the consumers.",
+                                Metrics::Severity::INFO};
+  Metrics::Metric FetchWaitMaxMs{"fetch_wait_max_ms",
+                                 "fetch.wait.max.ms of the consumers.",
+                                 Metrics::Severity::INFO};
+  Metrics::Metric QueuedMaxKBytes{
+      "queued_max_kbytes", "queued.max.messages.kbytes of the consumers.",
+      Metrics::Severity::INFO};
+
   std::vector<std::unique_ptr<Partition>> ConsumerThreads;
   std::unique_ptr<Kafka::ConsumerFactoryInterface> ConsumerCreator;
+  std::shared_ptr<FileWriter::SourceProfileStore> ProfileStore;
+  std::shared_ptr<DecodePool> DecodeHelpers;
   ThreadedExecutor Executor; // Must be last
 };
 } // namespace Stream
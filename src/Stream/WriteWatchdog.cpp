@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "WriteWatchdog.h"
+#include "Filesystem.h"
+#include <algorithm>
+#include <fstream>
+
+namespace Stream {
+
+namespace {
+double toSeconds(std::chrono::steady_clock::duration Duration) {
+  return std::chrono::duration<double>(Duration).count();
+}
+
+/// \brief Wall clock time in milliseconds of a steady clock time, given the
+/// time of a sample on both clocks. 0 if the time is not set.
+int64_t toMilliseconds(std::chrono::system_clock::time_point SampleTime,
+                       std::chrono::steady_clock::time_point SampleSteadyTime,
+                       std::chrono::steady_clock::time_point Time) {
+  if (Time == std::chrono::steady_clock::time_point()) {
+    return 0;
+  }
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             (SampleTime - (SampleSteadyTime - Time)).time_since_epoch())
+      .count();
+}
+
+/// Buckets per max message age; the age of the oldest message is known to
+/// within this fraction of the max age.
+int64_t const BucketsPerMaxAge{64};
+
+uint64_t packBucket(uint32_t BucketNumber, uint32_t Count) {
+  return (uint64_t(BucketNumber) << 32) | Count;
+}
+uint32_t bucketNumberOf(uint64_t Bucket) { return uint32_t(Bucket >> 32); }
+uint32_t countOf(uint64_t Bucket) { return uint32_t(Bucket); }
+} // namespace
+
+WriteWatchdog::WriteWatchdog(WatchdogSettings UsedSettings,
+                             Metrics::Registrar const &MetricReg,
+                             std::function<size_t()> QueueDepth)
+    : Settings(std::move(UsedSettings)), GetQueueDepth(std::move(QueueDepth)),
+      BucketWidth(std::max<Clock::duration>(
+          Settings.MaxMessageAge / BucketsPerMaxAge,
+          std::chrono::milliseconds(1))),
+      // Twice the max age, so that the age of the oldest message is still
+      // known once it is older than the max age.
+      NrOfBuckets(2 * (Settings.MaxMessageAge / BucketWidth) + 2),
+      QueuedPerBucket(new std::atomic<uint64_t>[NrOfBuckets]()),
+      History(std::max<size_t>(
+          1, Settings.HistoryLength / std::max(Settings.SampleInterval,
+                                               std::chrono::milliseconds(1)))),
+      Registrar(MetricReg.getNewRegistrar("watchdog")) {
+  Registrar.registerMetric(Stalls,
+                           {Metrics::LogTo::CARBON, Metrics::LogTo::LOG_MSG});
+  WatchdogThread = std::thread([this]() { run(); });
+}
+
+WriteWatchdog::~WriteWatchdog() {
+  {
+    std::lock_guard<std::mutex> Lock(RunMutex);
+    RunThread = false;
+  }
+  RunCondition.notify_all();
+  WatchdogThread.join();
+}
+
+void WriteWatchdog::writeDone(Clock::time_point StartTime) {
+  auto WriteTime = (Clock::now() - StartTime).count();
+  CurrentWriteStart.store(0, MemoryOrder);
+  WritesSinceSample.fetch_add(1, MemoryOrder);
+  WriteTimeSinceSample.fetch_add(WriteTime, MemoryOrder);
+  auto PreviousMax = MaxWriteTimeSinceSample.load(MemoryOrder);
+  while (PreviousMax < WriteTime and
+         not MaxWriteTimeSinceSample.compare_exchange_weak(
+             PreviousMax, WriteTime, MemoryOrder)) {
+  }
+}
+
+void WriteWatchdog::messageQueued(Clock::time_point QueuedAt) {
+  auto Number = bucketNumber(QueuedAt);
+  auto &Bucket = QueuedPerBucket[Number % NrOfBuckets];
+  auto Previous = Bucket.load(MemoryOrder);
+  uint64_t Next{0};
+  do {
+    Next = bucketNumberOf(Previous) == Number
+               ? Previous + 1
+               : packBucket(Number, 1);
+  } while (not Bucket.compare_exchange_weak(Previous, Next, MemoryOrder));
+  if (bucketNumberOf(Previous) != Number and countOf(Previous) > 0) {
+    OverflowMessages.fetch_add(countOf(Previous), MemoryOrder);
+  }
+}
+
+void WriteWatchdog::messageWritten(MessageStages const &Stages) {
+  auto Number = bucketNumber(Stages.Queued);
+  auto &Bucket = QueuedPerBucket[Number % NrOfBuckets];
+  auto Previous = Bucket.load(MemoryOrder);
+  while (bucketNumberOf(Previous) == Number and countOf(Previous) > 0 and
+         not Bucket.compare_exchange_weak(Previous, Previous - 1,
+                                          MemoryOrder)) {
+  }
+  if (bucketNumberOf(Previous) != Number or countOf(Previous) == 0) {
+    // The bucket has been reused and the message counted as overflow.
+    OverflowMessages.fetch_sub(1, MemoryOrder);
+  }
+  LastConsumed.store(Stages.Consumed.time_since_epoch().count(), MemoryOrder);
+  LastRouted.store(Stages.Routed.time_since_epoch().count(), MemoryOrder);
+  LastQueued.store(Stages.Queued.time_since_epoch().count(), MemoryOrder);
+  LastWritten.store(Stages.Written.time_since_epoch().count(), MemoryOrder);
+}
+
+uint32_t WriteWatchdog::bucketNumber(Clock::time_point Time) const {
+  return static_cast<uint32_t>(Time.time_since_epoch() / BucketWidth);
+}
+
+WriteWatchdog::Clock::duration
+WriteWatchdog::oldestPendingAge(Clock::time_point Now) const {
+  auto const MaxAge = BucketWidth * int64_t(NrOfBuckets);
+  if (OverflowMessages.load(MemoryOrder) > 0) {
+    return MaxAge;
+  }
+  auto NewestBucket = bucketNumber(Now);
+  int32_t OldestBucketAge{0};
+  bool Pending{false};
+  for (size_t i = 0; i < NrOfBuckets; ++i) {
+    auto Bucket = QueuedPerBucket[i].load(MemoryOrder);
+    if (countOf(Bucket) > 0) {
+      // Negative for a message queued after Now was sampled.
+      auto BucketAge = int32_t(NewestBucket - bucketNumberOf(Bucket));
+      OldestBucketAge = std::max(OldestBucketAge, BucketAge);
+      Pending = true;
+    }
+  }
+  if (not Pending) {
+    return Clock::duration(0);
+  }
+  auto BucketStart = Now - Now.time_since_epoch() % BucketWidth -
+                     BucketWidth * int64_t(OldestBucketAge);
+  return std::min(MaxAge, std::max(Clock::duration(0), Now - BucketStart));
+}
+
+void WriteWatchdog::run() {
+  std::unique_lock<std::mutex> Lock(RunMutex);
+  while (not RunCondition.wait_for(Lock, Settings.SampleInterval,
+                                   [this]() { return not RunThread; })) {
+    checkWriter(Clock::now());
+  }
+}
+
+void WriteWatchdog::checkWriter(Clock::time_point Now) {
+  HistorySample Sample;
+  Sample.Time = std::chrono::system_clock::now();
+  Sample.SteadyTime = Now;
+  Sample.QueueDepth = GetQueueDepth();
+  Sample.Writes = WritesSinceSample.exchange(0, MemoryOrder);
+  Sample.TotalWriteTime =
+      Clock::duration(WriteTimeSinceSample.exchange(0, MemoryOrder));
+  Sample.MaxWriteTime =
+      Clock::duration(MaxWriteTimeSinceSample.exchange(0, MemoryOrder));
+  if (auto WriteStart = CurrentWriteStart.load(MemoryOrder); WriteStart != 0) {
+    Sample.CurrentWriteTime =
+        Now - Clock::time_point(Clock::duration(WriteStart));
+  }
+  Sample.OldestMessageAge = oldestPendingAge(Now);
+  Sample.LastMessage = {
+      Clock::time_point(Clock::duration(LastConsumed.load(MemoryOrder))),
+      Clock::time_point(Clock::duration(LastRouted.load(MemoryOrder))),
+      Clock::time_point(Clock::duration(LastQueued.load(MemoryOrder))),
+      Clock::time_point(Clock::duration(LastWritten.load(MemoryOrder)))};
+  History[NextSample] = Sample;
+  NextSample = (NextSample + 1) % History.size();
+  HistoryFull = HistoryFull or NextSample == 0;
+
+  auto WriteStalled = Sample.CurrentWriteTime > Settings.StallTimeout;
+  auto MessageStalled = Sample.OldestMessageAge > Settings.MaxMessageAge;
+  if (not WriteStalled and not MessageStalled) {
+    if (Stalled) {
+      Log->info("File writing recovered after {:.1f} s of stall.",
+                toSeconds(Now - StallStart));
+      Stalled = false;
+    }
+    return;
+  }
+  if (Stalled) {
+    return;
+  }
+  Stalled = true;
+  StallStart = Now;
+  Stalls++;
+  std::string Reason;
+  if (WriteStalled) {
+    Reason = fmt::format("A write to file has been in progress for {:.1f} s",
+                         toSeconds(Sample.CurrentWriteTime));
+  } else {
+    Reason = fmt::format("The oldest message has been queued for {:.1f} s",
+                         toSeconds(Sample.OldestMessageAge));
+  }
+  Log->critical("File writing stalled: {}. Queue depth: {}.", Reason,
+                Sample.QueueDepth);
+  dumpHistory(Reason);
+}
+
+void WriteWatchdog::writeHistory(std::ostream &Output) const {
+  Output << "time_ms,queue_depth,writes,total_write_time_s,"
+            "max_write_time_s,current_write_time_s,oldest_message_age_s,"
+            "last_consumed_ms,last_routed_ms,last_queued_ms,last_written_ms\n";
+  auto NrOfSamples = HistoryFull ? History.size() : NextSample;
+  auto FirstSample = HistoryFull ? NextSample : 0;
+  for (size_t i = 0; i < NrOfSamples; ++i) {
+    auto const &Sample = History[(FirstSample + i) % History.size()];
+    auto StageTime = [&Sample](Clock::time_point Time) {
+      return toMilliseconds(Sample.Time, Sample.SteadyTime, Time);
+    };
+    Output << std::chrono::duration_cast<std::chrono::milliseconds>(
+                  Sample.Time.time_since_epoch())
+                  .count()
+           << "," << Sample.QueueDepth << "," << Sample.Writes << ","
+           << toSeconds(Sample.TotalWriteTime) << ","
+           << toSeconds(Sample.MaxWriteTime) << ","
+           << toSeconds(Sample.CurrentWriteTime) << ","
+           << toSeconds(Sample.OldestMessageAge) << ","
+           << StageTime(Sample.LastMessage.Consumed) << ","
+           << StageTime(Sample.LastMessage.Routed) << ","
+           << StageTime(Sample.LastMessage.Queued) << ","
+           << StageTime(Sample.LastMessage.Written) << "\n";
+  }
+}
+
+void WriteWatchdog::dumpHistory(std::string const &Reason) {
+  auto FileName =
+      fs::path(Settings.DumpDirectory) /
+      fmt::format("write_stall_{}.csv",
+                  std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count());
+  std::ofstream Output(FileName.string());
+  if (not Output) {
+    Log->error("Unable to dump writer history to \"{}\".", FileName.string());
+    return;
+  }
+  Output << "# " << Reason << "\n";
+  writeHistory(Output);
+  Log->info("Dumped writer history to \"{}\".", FileName.string());
+}
+
+} // namespace Stream
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "Metrics/Metric.h"
+#include "Metrics/Registrar.h"
+#include "logger.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Stream {
+
+struct WatchdogSettings {
+  /// A single write taking longer than this is reported as a stall.
+  std::chrono::milliseconds StallTimeout{10000};
+  /// A message waiting longer than this to be written is reported as a stall.
+  std::chrono::milliseconds MaxMessageAge{30000};
+  /// How often the writer is checked and a sample added to the history.
+  std::chrono::milliseconds SampleInterval{100};
+  /// Length of the history kept for dumping.
+  std::chrono::milliseconds HistoryLength{60000};
+  /// Directory to dump the history to on a stall.
+  std::string DumpDirectory{"."};
+};
+
+/// \brief Times at which a message passed the stages of the pipeline.
+struct MessageStages {
+  std::chrono::steady_clock::time_point Consumed;
+  std::chrono::steady_clock::time_point Routed;
+  std::chrono::steady_clock::time_point Queued;
+  std::chrono::steady_clock::time_point Written;
+};
+
+/// \brief Watches the writer thread for writes or messages that take too
+/// long.
+///
+/// The writer reports every message that is queued, the start and end of
+/// every write and the stages of every message written. Queued messages are
+/// counted in buckets by the time they were queued, so that the age of the
+/// oldest message not yet written is known for the whole queue. Messages
+/// still pending when their bucket is reused are moved to an overflow count,
+/// for which the age is taken to be the full span of the buckets. A separate
+/// thread samples these at a fixed interval into a ring buffer (the "flight
+/// recorder"). When a threshold is exceeded, an alert is logged, the stall
+/// metric is incremented and the ring buffer is dumped to a CSV file. This
+/// is done once per stall; a new stall is only reported after the writer has
+/// recovered.
+class WriteWatchdog {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// \param Settings Thresholds and history settings.
+  /// \param MetricReg Registrar for the stall metric.
+  /// \param QueueDepth Returns the (approximate) number of queued messages.
+  WriteWatchdog(WatchdogSettings Settings, Metrics::Registrar const &MetricReg,
+                std::function<size_t()> QueueDepth);
+  ~WriteWatchdog();
+  WriteWatchdog(WriteWatchdog const &) = delete;
+  WriteWatchdog &operator=(WriteWatchdog const &) = delete;
+
+  /// \brief Called by the writer thread before a write.
+  ///
+  /// \return The start time, to be passed to writeDone().
+  Clock::time_point writeStarted() {
+    auto Now = Clock::now();
+    CurrentWriteStart.store(Now.time_since_epoch().count(), MemoryOrder);
+    return Now;
+  }
+
+  /// \brief Called by the writer thread after a write, successful or not.
+  void writeDone(Clock::time_point StartTime);
+
+  /// \brief Called when a message is queued for writing.
+  void messageQueued(Clock::time_point QueuedAt);
+
+  /// \brief Called by the writer thread once a queued message has been
+  /// written, successfully or not.
+  void messageWritten(MessageStages const &Stages);
+
+  auto nrOfStalls() const { return int64_t(Stalls); }
+
+  /// \brief Sample the writer and check for stalls, called periodically by
+  /// the watchdog thread.
+  void checkWriter(Clock::time_point Now);
+
+  /// \brief Write the history to the given stream as CSV, oldest first.
+  void writeHistory(std::ostream &Output) const;
+
+private:
+  void run();
+  void dumpHistory(std::string const &Reason);
+  /// \brief The number of the time bucket of a time, modulo 2^32.
+  uint32_t bucketNumber(Clock::time_point Time) const;
+
+  /// \brief The age of the oldest message not yet written, zero if there is
+  /// none.
+  Clock::duration oldestPendingAge(Clock::time_point Now) const;
+
+  struct HistorySample {
+    std::chrono::system_clock::time_point Time;
+    Clock::time_point SteadyTime;
+    size_t QueueDepth{0};
+    int64_t Writes{0};
+    Clock::duration TotalWriteTime{0};
+    Clock::duration MaxWriteTime{0};
+    Clock::duration CurrentWriteTime{0};
+    Clock::duration OldestMessageAge{0};
+    MessageStages LastMessage;
+  };
+
+  static constexpr std::memory_order MemoryOrder{std::memory_order_relaxed};
+  WatchdogSettings const Settings;
+  std::function<size_t()> GetQueueDepth;
+  SharedLogger Log{getLogger()};
+
+  // Updated by the writer thread, reset by the watchdog thread.
+  std::atomic<Clock::rep> CurrentWriteStart{0};
+  Clock::duration const BucketWidth;
+  size_t const NrOfBuckets;
+  /// Bucket number in the upper and message count in the lower 32 bits, so
+  /// that both are updated together when a bucket is reused.
+  std::unique_ptr<std::atomic<uint64_t>[]> QueuedPerBucket;
+  /// Messages still pending in a bucket when it was reused.
+  std::atomic<int64_t> OverflowMessages{0};
+  std::atomic<Clock::rep> LastConsumed{0};
+  std::atomic<Clock::rep> LastRouted{0};
+  std::atomic<Clock::rep> LastQueued{0};
+  std::atomic<Clock::rep> LastWritten{0};
+  std::atomic<int64_t> WritesSinceSample{0};
+  std::atomic<Clock::rep> WriteTimeSinceSample{0};
+  std::atomic<Clock::rep> MaxWriteTimeSinceSample{0};
+
+  // Only used by the watchdog thread.
+  std::vector<HistorySample> History;
+  size_t NextSample{0};
+  bool HistoryFull{false};
+  bool Stalled{false};
+  Clock::time_point StallStart;
+
+  Metrics::Metric Stalls{"write_stalls",
+                         "Number of times a write to file or a queued "
+                         "message took longer than allowed.",
+                         Metrics::Severity::ERROR};
+  Metrics::Registrar Registrar;
+
+  std::mutex RunMutex;
+  std::condition_variable RunCondition;
+  bool RunThread{true};
+  std::thread WatchdogThread; // Must be last
+};
+
+} // namespace Stream
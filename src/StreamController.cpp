@@ -1,19 +1,94 @@
 #include "StreamController.h"
+#include "FilePreallocator.h"
 #include "FileWriterTask.h"
+#include "Filesystem.h"
 #include "Kafka/ConsumerFactory.h"
+#include "Kafka/FetchTuning.h"
 #include "Kafka/MetaDataQuery.h"
 #include "Kafka/MetadataException.h"
 #include "Stream/Partition.h"
 #include "helper.h"
+#include <algorithm>
+#include <numeric>
 
 namespace FileWriter {
+
+namespace {
+Stream::WatchdogSettings makeWatchdogSettings(StreamerOptions const &Settings,
+                                              std::string const &Filename) {
+  Stream::WatchdogSettings Watchdog;
+  Watchdog.StallTimeout = Settings.WriteStallTimeout;
+  Watchdog.MaxMessageAge = Settings.MaxMessageAge;
+  Watchdog.DumpDirectory = Settings.StallDumpDirectory;
+  if (Watchdog.DumpDirectory.empty()) {
+    // Next to the file being written.
+    auto FileDirectory = fs::path(Filename).parent_path();
+    if (not FileDirectory.empty()) {
+      Watchdog.DumpDirectory = FileDirectory.string();
+    }
+  }
+  return Watchdog;
+}
+} // namespace
+
+std::map<std::string, Stream::SrcToDst>
+mapSourcesToTopics(std::vector<Source> &Sources,
+                   std::set<std::string> const &KnownTopicNames) {
+  std::map<std::string, Stream::SrcToDst> TopicSrcMap;
+  for (auto &Src : Sources) {
+    if (KnownTopicNames.find(Src.topic()) != KnownTopicNames.end()) {
+      auto Writer = Src.getWriterPtr();
+      TopicSrcMap[Src.topic()].push_back(
+          {Src.getSrcHash(), Src.getModuleHash(), Writer, Src.sourcename(),
+           Src.flatbufferID(), Src.writerModuleID(),
+           Writer->acceptsRepeatedTimestamps()});
+    } else {
+      LOG_ERROR("Unable to set up consumer for source {} on topic {} as this "
+                "topic does not exist.",
+                Src.sourcename(), Src.topic());
+    }
+  }
+  // Merged sources are added once all sources configured as streams are
+  // known, so that they can not take the place of one.
+  for (auto &Src : Sources) {
+    auto SrcMapIt = TopicSrcMap.find(Src.topic());
+    if (SrcMapIt == TopicSrcMap.end()) {
+      continue;
+    }
+    auto &SrcMap = SrcMapIt->second;
+    auto Writer = Src.getWriterPtr();
+    for (auto const &Name : Writer->mergedSources()) {
+      auto const WriteHash = calcSourceHash(Src.writerModuleID(), Name);
+      if (std::any_of(SrcMap.begin(), SrcMap.end(), [&](auto const &Item) {
+            return Item.WriteHash == WriteHash;
+          })) {
+        LOG_ERROR("Unable to merge source {} on topic {} into source {} as it "
+                  "is also written by another {} writer module.",
+                  Name, Src.topic(), Src.sourcename(), Src.writerModuleID());
+        continue;
+      }
+      SrcMap.push_back({calcSourceHash(Src.flatbufferID(), Name), WriteHash,
+                        Writer, Name, Src.flatbufferID(), Src.writerModuleID(),
+                        Writer->acceptsRepeatedTimestamps()});
+    }
+  }
+  return TopicSrcMap;
+}
+
 StreamController::StreamController(
     std::unique_ptr<FileWriterTask> FileWriterTask, std::string ServiceID,
     FileWriter::StreamerOptions const &Settings,
-    Metrics::Registrar const &Registrar)
+    Metrics::Registrar const &Registrar,
+    std::unique_ptr<Kafka::MetaDataPrefetch> Prefetch,
+    std::shared_ptr<SourceProfileStore> Profiles)
 
-    : WriterTask(std::move(FileWriterTask)), StreamMetricRegistrar(Registrar),
-      WriterThread(Registrar.getNewRegistrar("stream")),
+    : MetaDataPrefetcher(std::move(Prefetch)),
+      ProfileStore(std::move(Profiles)),
+      DecodeHelpers(std::make_shared<Stream::DecodePool>(
+          Settings.DecodeThreads, Settings.DecodeMinMessageSize)),
+      WriterTask(std::move(FileWriterTask)), StreamMetricRegistrar(Registrar),
+      WriterThread(Registrar.getNewRegistrar("stream"), 1024,
+                   makeWatchdogSettings(Settings, WriterTask->filename())),
       ServiceId(std::move(ServiceID)), KafkaSettings(Settings) {
   Executor.sendLowPriorityWork([=]() {
     CurrentMetadataTimeOut = Settings.BrokerSettings.MinMetadataTimeout;
@@ -33,6 +108,7 @@ void StreamController::setStopTime(std::chrono::milliseconds const &StopTime) {
   for (auto &s : Streamers) {
     s->setStopTime(CStopTime);
   }
+  Executor.sendWork([=]() { reserveDiskSpace(time_point(StopTime)); });
 }
 using duration = std::chrono::system_clock::duration;
 bool StreamController::isDoneWriting() {
@@ -44,6 +120,12 @@ bool StreamController::isDoneWriting() {
 std::string StreamController::getJobId() const { return WriterTask->jobID(); }
 
 void StreamController::getTopicNames() {
+  if (MetaDataPrefetcher != nullptr) {
+    if (auto TopicNames = MetaDataPrefetcher->topicNames()) {
+      Executor.sendLowPriorityWork([=]() { initStreams(*TopicNames); });
+      return;
+    }
+  }
   try {
     auto TopicNames = Kafka::getTopicList(KafkaSettings.BrokerSettings.Address,
                                           CurrentMetadataTimeOut);
@@ -64,19 +146,9 @@ void StreamController::getTopicNames() {
 }
 
 void StreamController::initStreams(std::set<std::string> KnownTopicNames) {
-  std::map<std::string, Stream::SrcToDst> TopicSrcMap;
-  for (auto &Src : WriterTask->sources()) {
-    if (KnownTopicNames.find(Src.topic()) != KnownTopicNames.end()) {
-      TopicSrcMap[Src.topic()].push_back(
-          {Src.getSrcHash(), Src.getModuleHash(), Src.getWriterPtr(),
-           Src.sourcename(), Src.flatbufferID(), Src.writerModuleID(),
-           Src.getWriterPtr()->acceptsRepeatedTimestamps()});
-    } else {
-      LOG_ERROR("Unable to set up consumer for source {} on topic {} as this "
-                "topic does not exist.",
-                Src.sourcename(), Src.topic());
-    }
-  }
+  auto TopicSrcMap = mapSourcesToTopics(WriterTask->sources(), KnownTopicNames);
+  std::vector<std::pair<std::string, std::unique_ptr<Stream::Topic>>> Topics;
+  std::vector<double> TopicByteRates;
   for (auto &CItem : TopicSrcMap) {
     auto CStartTime =
         std::chrono::system_clock::time_point(KafkaSettings.StartTimestamp);
@@ -85,14 +157,70 @@ void StreamController::initStreams(std::set<std::string> KnownTopicNames) {
     auto CTopic = std::make_unique<Stream::Topic>(
         KafkaSettings.BrokerSettings, CItem.first, CItem.second, &WriterThread,
         StreamMetricRegistrar, CStartTime, KafkaSettings.BeforeStartTime,
-        CStopTime, KafkaSettings.AfterStopTime);
-    CTopic->start();
+        CStopTime, KafkaSettings.AfterStopTime,
+        std::make_unique<Kafka::ConsumerFactory>(), ProfileStore,
+        DecodeHelpers);
+    TopicByteRates.push_back(CTopic->profiledByteRate());
+    Topics.emplace_back(CItem.first, std::move(CTopic));
+  }
+  auto Budgets = Kafka::splitMemoryBudget(TopicByteRates,
+                                          KafkaSettings.ConsumerMemoryBudget);
+  if (KafkaSettings.PreallocationIncrement > 0) {
+    preallocateFile(TopicByteRates);
+  }
+  for (size_t i = 0; i < Topics.size(); ++i) {
+    auto &CTopic = Topics[i].second;
+    CTopic->setConsumerMemoryBudget(Budgets[i]);
+    std::optional<Kafka::PartitionOffsets> PrefetchedOffsets;
+    if (MetaDataPrefetcher != nullptr) {
+      PrefetchedOffsets = MetaDataPrefetcher->partitionOffsets(Topics[i].first);
+    }
+    if (PrefetchedOffsets) {
+      CTopic->start(*PrefetchedOffsets);
+    } else {
+      CTopic->start();
+    }
     Streamers.emplace_back(std::move(CTopic));
   }
+  MetaDataPrefetcher.reset();
   Executor.sendLowPriorityWork([=]() { checkIfStreamsAreDone(); });
 }
 using std::chrono_literals::operator""ms;
+void StreamController::preallocateFile(
+    std::vector<double> const &TopicByteRates) {
+  ExpectedByteRate =
+      std::accumulate(TopicByteRates.begin(), TopicByteRates.end(), 0.0);
+  // A rate of 0 means that not all sources of the topic have been profiled.
+  if (TopicByteRates.empty() or
+      std::any_of(TopicByteRates.begin(), TopicByteRates.end(),
+                  [](auto Rate) { return Rate <= 0.0; })) {
+    ExpectedByteRate = KafkaSettings.ExpectedByteRate;
+  }
+  try {
+    WriterTask->preallocate(
+        estimateFileSize(ExpectedByteRate, KafkaSettings.StartTimestamp,
+                         KafkaSettings.StopTimestamp,
+                         KafkaSettings.PreallocationIncrement),
+        KafkaSettings.PreallocationIncrement, StreamMetricRegistrar);
+  } catch (std::exception const &E) {
+    LOG_WARN("Unable to reserve disk space for the file of job {}: {}",
+             getJobId(), E.what());
+  }
+}
+
+void StreamController::reserveDiskSpace(time_point StopTime) {
+  if (auto Preallocator = WriterTask->preallocator()) {
+    Preallocator->reserve(estimateFileSize(
+        ExpectedByteRate, KafkaSettings.StartTimestamp, StopTime,
+        KafkaSettings.PreallocationIncrement));
+  }
+}
+
 void StreamController::checkIfStreamsAreDone() {
+  if (auto Preallocator = WriterTask->preallocator()) {
+    Preallocator->update();
+  }
+  WriterThread.flushModules();
   Streamers.erase(
       std::remove_if(Streamers.begin(), Streamers.end(),
                      [](auto const &Elem) { return Elem->isDone(); }),
@@ -12,16 +12,31 @@
 
 #pragma once
 
+#include "Kafka/MetaDataPrefetch.h"
 #include "MainOpt.h"
 #include "Metrics/Registrar.h"
+#include "SourceProfile.h"
 #include "Stream/Topic.h"
 #include "ThreadedExecutor.h"
 #include <atomic>
+#include <map>
 #include <set>
 #include <vector>
 
 namespace FileWriter {
 class FileWriterTask;
+class Source;
+
+/// \brief The sources to consume from each of the known topics, including
+/// the sources that writer modules merge into their own.
+///
+/// A merged source that has the same name and writer module as another
+/// source of the topic, e.g. one that is also configured as a stream of its
+/// own, would share its source filter. It is not merged and an error is
+/// logged.
+std::map<std::string, Stream::SrcToDst>
+mapSourcesToTopics(std::vector<Source> &Sources,
+                   std::set<std::string> const &KnownTopicNames);
 
 class IStreamController {
 public:
@@ -37,7 +52,9 @@ public:
   StreamController(std::unique_ptr<FileWriterTask> FileWriterTask,
                    std::string ServiceID,
                    FileWriter::StreamerOptions const &Settings,
-                   Metrics::Registrar const &Registrar);
+                   Metrics::Registrar const &Registrar,
+                   std::unique_ptr<Kafka::MetaDataPrefetch> Prefetch = nullptr,
+                   std::shared_ptr<SourceProfileStore> Profiles = nullptr);
   ~StreamController() override;
   StreamController(const StreamController &) = delete;
   StreamController(StreamController &&) = delete;
@@ -73,9 +90,18 @@ private:
   void getTopicNames();
   void initStreams(std::set<std::string> KnownTopicNames);
   void checkIfStreamsAreDone();
+  /// \brief Reserve disk space for the expected size of the file.
+  void preallocateFile(std::vector<double> const &TopicByteRates);
+  /// \brief Reserve disk space up to the expected size at the stop time.
+  void reserveDiskSpace(time_point StopTime);
   std::chrono::system_clock::duration CurrentMetadataTimeOut;
   std::atomic<bool> StreamersRemaining{true};
+  /// Bytes per second used to estimate the size of the file.
+  double ExpectedByteRate{0.0};
   std::vector<std::unique_ptr<Stream::Topic>> Streamers;
+  std::unique_ptr<Kafka::MetaDataPrefetch> MetaDataPrefetcher;
+  std::shared_ptr<SourceProfileStore> ProfileStore;
+  std::shared_ptr<Stream::DecodePool> DecodeHelpers;
   std::unique_ptr<FileWriterTask> WriterTask{nullptr};
   Metrics::Registrar StreamMetricRegistrar;
   Stream::MessageWriter WriterThread;
@@ -11,6 +11,8 @@
 
 #include "Kafka/BrokerSettings.h"
 #include "TimeUtility.h"
+#include <cstdint>
+#include <string>
 
 namespace FileWriter {
 
@@ -21,6 +23,26 @@ struct StreamerOptions {
   time_point StopTimestamp{time_point::max()};
   std::chrono::milliseconds BeforeStartTime{1000};
   std::chrono::milliseconds AfterStopTime{1000};
+  /// Number of helper threads used for verifying large flatbuffers.
+  size_t DecodeThreads{2};
+  /// Flatbuffers of at least this many bytes are verified by the helpers.
+  size_t DecodeMinMessageSize{1024 * 1024};
+  /// A write to file taking longer than this is reported as a stall.
+  std::chrono::milliseconds WriteStallTimeout{10000};
+  /// A message waiting longer than this to be written is reported as a stall.
+  std::chrono::milliseconds MaxMessageAge{30000};
+  /// Directory to dump the recent writer history to on a stall. The
+  /// directory of the file being written if empty.
+  std::string StallDumpDirectory;
+  /// Bytes shared by all consumers for fetched messages, split between the
+  /// topics by their profiled rates. 0 to use the configured fetch settings.
+  std::uint64_t ConsumerMemoryBudget{0};
+  /// Bytes of disk space reserved at a time for the file, with the expected
+  /// size of the file reserved up front. 0 to not reserve disk space.
+  std::uint64_t PreallocationIncrement{0};
+  /// Bytes per second used to estimate the size of the file if not all
+  /// streams have been profiled.
+  double ExpectedByteRate{0.0};
 };
 
 } // namespace FileWriter
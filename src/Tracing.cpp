@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "Tracing.h"
+
+TRACE_DEFINE_SEMAPHORE(message_consumed)
+TRACE_DEFINE_SEMAPHORE(flatbuffer_verified)
+TRACE_DEFINE_SEMAPHORE(message_routed)
+TRACE_DEFINE_SEMAPHORE(message_enqueued)
+TRACE_DEFINE_SEMAPHORE(message_dequeued)
+TRACE_DEFINE_SEMAPHORE(module_write_start)
+TRACE_DEFINE_SEMAPHORE(module_write_end)
+TRACE_DEFINE_SEMAPHORE(hdf_flush_start)
+TRACE_DEFINE_SEMAPHORE(hdf_flush_end)
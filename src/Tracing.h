@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+/// \file
+/// \brief Static (USDT) tracepoints that bpftrace, perf or SystemTap can
+/// attach to.
+///
+/// A probe compiles to a single nop, but its arguments are evaluated every
+/// time the probe is passed, whether or not a tracer is attached. Probe
+/// arguments should therefore be cheap to evaluate (numbers and pointers to
+/// existing strings). Arguments that take more work are only evaluated if
+/// TRACE_ENABLED() is true for the probe, which checks the semaphore that a
+/// tracer increments when it attaches. Every probe needs a semaphore, see
+/// TRACE_DECLARE_SEMAPHORE(). Messages are identified by their topic,
+/// partition and offset. The probes are compiled out if <sys/sdt.h> is not
+/// available. See documentation/tracing.md for the list of probes.
+
+#pragma once
+
+#ifdef HAVE_USDT_PROBES
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define TRACE_SEMAPHORE(Name) kafka_to_nexus_##Name##_semaphore
+#define TRACE_DECLARE_SEMAPHORE(Name)                                          \
+  extern "C" unsigned short TRACE_SEMAPHORE(Name)
+#define TRACE_DEFINE_SEMAPHORE(Name)                                           \
+  extern "C" {                                                                 \
+  unsigned short TRACE_SEMAPHORE(Name) __attribute__((section(".probes")));    \
+  }
+#define TRACE_ENABLED(Name) __builtin_expect(TRACE_SEMAPHORE(Name) != 0, 0)
+#define TRACE_PROBE1(Name, A1) DTRACE_PROBE1(kafka_to_nexus, Name, A1)
+#define TRACE_PROBE2(Name, A1, A2) DTRACE_PROBE2(kafka_to_nexus, Name, A1, A2)
+#define TRACE_PROBE3(Name, A1, A2, A3)                                         \
+  DTRACE_PROBE3(kafka_to_nexus, Name, A1, A2, A3)
+#define TRACE_PROBE4(Name, A1, A2, A3, A4)                                     \
+  DTRACE_PROBE4(kafka_to_nexus, Name, A1, A2, A3, A4)
+#define TRACE_PROBE5(Name, A1, A2, A3, A4, A5)                                 \
+  DTRACE_PROBE5(kafka_to_nexus, Name, A1, A2, A3, A4, A5)
+#define TRACE_PROBE6(Name, A1, A2, A3, A4, A5, A6)                             \
+  DTRACE_PROBE6(kafka_to_nexus, Name, A1, A2, A3, A4, A5, A6)
+#define TRACE_PROBE7(Name, A1, A2, A3, A4, A5, A6, A7)                         \
+  DTRACE_PROBE7(kafka_to_nexus, Name, A1, A2, A3, A4, A5, A6, A7)
+#else
+#define TRACE_DECLARE_SEMAPHORE(Name) static_assert(true, "")
+#define TRACE_DEFINE_SEMAPHORE(Name)
+#define TRACE_ENABLED(Name) false
+#define TRACE_PROBE1(Name, A1)                                                 \
+  do {                                                                         \
+  } while (false)
+#define TRACE_PROBE2(Name, A1, A2) TRACE_PROBE1(Name, A1)
+#define TRACE_PROBE3(Name, A1, A2, A3) TRACE_PROBE1(Name, A1)
+#define TRACE_PROBE4(Name, A1, A2, A3, A4) TRACE_PROBE1(Name, A1)
+#define TRACE_PROBE5(Name, A1, A2, A3, A4, A5) TRACE_PROBE1(Name, A1)
+#define TRACE_PROBE6(Name, A1, A2, A3, A4, A5, A6) TRACE_PROBE1(Name, A1)
+#define TRACE_PROBE7(Name, A1, A2, A3, A4, A5, A6, A7) TRACE_PROBE1(Name, A1)
+#endif
+
+TRACE_DECLARE_SEMAPHORE(message_consumed);
+TRACE_DECLARE_SEMAPHORE(flatbuffer_verified);
+TRACE_DECLARE_SEMAPHORE(message_routed);
+TRACE_DECLARE_SEMAPHORE(message_enqueued);
+TRACE_DECLARE_SEMAPHORE(message_dequeued);
+TRACE_DECLARE_SEMAPHORE(module_write_start);
+TRACE_DECLARE_SEMAPHORE(module_write_end);
+TRACE_DECLARE_SEMAPHORE(hdf_flush_start);
+TRACE_DECLARE_SEMAPHORE(hdf_flush_end);
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "FrameTransform.h"
+#include <algorithm>
+#include <fmt/format.h>
+#include <stdexcept>
+
+namespace WriterModule {
+namespace NDAr {
+
+FrameTransform::FrameTransform(hdf5::Dimensions RoiOffset,
+                               hdf5::Dimensions RoiSize,
+                               hdf5::Dimensions Binning)
+    : Offset(std::move(RoiOffset)), Size(std::move(RoiSize)),
+      Bins(std::move(Binning)) {
+  if (Offset.size() != Size.size()) {
+    throw std::runtime_error(
+        "The ROI offset and size must have the same number of dimensions.");
+  }
+  for (auto const &Parameter : {Offset, Bins}) {
+    if (Parameter.size() > 2) {
+      throw std::runtime_error("ROI and binning are only supported for one "
+                               "and two dimensional frames.");
+    }
+  }
+  if (std::any_of(Size.begin(), Size.end(),
+                  [](auto Value) { return Value == 0; })) {
+    throw std::runtime_error("The ROI size must be at least one pixel.");
+  }
+  if (std::any_of(Bins.begin(), Bins.end(),
+                  [](auto Value) { return Value == 0; })) {
+    throw std::runtime_error("The binning must be at least one pixel.");
+  }
+  std::uint64_t PixelsPerBin{1};
+  for (auto Value : Bins) {
+    if (Value > MaxPixelsPerBin / PixelsPerBin) {
+      throw std::runtime_error(fmt::format(
+          "A bin can have at most {} pixels.", MaxPixelsPerBin));
+    }
+    PixelsPerBin *= Value;
+  }
+}
+
+FrameTransform::Region2D
+FrameTransform::region(hdf5::Dimensions const &FrameShape) const {
+  if (FrameShape.empty() or FrameShape.size() > 2) {
+    throw std::runtime_error(fmt::format(
+        "ROI and binning are not supported for frames with {} dimensions.",
+        FrameShape.size()));
+  }
+  auto const Rank = FrameShape.size();
+  if ((not Offset.empty() and Offset.size() != Rank) or
+      (not Bins.empty() and Bins.size() != Rank)) {
+    throw std::runtime_error(fmt::format(
+        "The ROI or binning does not match frames with {} dimensions.", Rank));
+  }
+  // A one dimensional frame is a single row.
+  auto Last = [Rank](hdf5::Dimensions const &Dims, size_t Default) {
+    return Dims.empty() ? Default : Dims[Rank - 1];
+  };
+  auto First = [Rank](hdf5::Dimensions const &Dims, size_t Default) {
+    return Dims.empty() or Rank == 1 ? Default : Dims[0];
+  };
+  Region2D Result;
+  auto const FrameRows = First(FrameShape, 1);
+  Result.FrameCols = Last(FrameShape, 1);
+  Result.FirstRow = First(Offset, 0);
+  Result.FirstCol = Last(Offset, 0);
+  Result.Rows = First(Size, FrameRows);
+  Result.Cols = Last(Size, Result.FrameCols);
+  Result.RowBin = First(Bins, 1);
+  Result.ColBin = Last(Bins, 1);
+  if (Result.FirstRow + Result.Rows > FrameRows or
+      Result.FirstCol + Result.Cols > Result.FrameCols) {
+    throw std::runtime_error("The ROI is outside of the frame.");
+  }
+  if (Result.Rows < Result.RowBin or Result.Cols < Result.ColBin) {
+    throw std::runtime_error("The bins are larger than the ROI.");
+  }
+  return Result;
+}
+
+hdf5::Dimensions
+FrameTransform::outputShape(hdf5::Dimensions const &FrameShape) const {
+  auto Region = region(FrameShape);
+  if (FrameShape.size() == 1) {
+    return {Region.Cols / Region.ColBin};
+  }
+  return {Region.Rows / Region.RowBin, Region.Cols / Region.ColBin};
+}
+
+} // namespace NDAr
+} // namespace WriterModule
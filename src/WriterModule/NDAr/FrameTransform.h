@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+/// \file
+/// \brief Region of interest cropping and binning of area detector frames.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <h5cpp/hdf5.hpp>
+#include <limits>
+#include <type_traits>
+
+namespace WriterModule {
+namespace NDAr {
+
+/// \brief The type that the pixels of a bin are summed in.
+template <typename InType, typename OutType>
+using BinSumType = std::conditional_t<
+    std::is_floating_point_v<InType> or std::is_floating_point_v<OutType>,
+    double,
+    std::conditional_t<std::is_unsigned_v<InType>, std::uint64_t,
+                       std::int64_t>>;
+
+/// \brief The max number of pixels in a bin, so that the sum of a bin of up
+/// to 32 bit integers can not overflow its 64 bit sum.
+constexpr std::uint64_t MaxPixelsPerBin{std::uint64_t(1) << 31};
+
+/// \brief Whether the sum of a bin can overflow its type, which is only the
+/// case for 64 bit integer input.
+template <typename InType, typename SumType>
+constexpr bool BinSumCanOverflow =
+    std::is_integral_v<InType> and sizeof(InType) >= sizeof(SumType);
+
+/// \brief Add to a sum, clamping at the limits of its type.
+template <typename SumType> void addClamped(SumType &Sum, SumType Value) {
+  if constexpr (std::is_integral_v<SumType>) {
+    if (__builtin_add_overflow(Sum, Value, &Sum)) {
+      Sum = Value < 0 ? std::numeric_limits<SumType>::lowest()
+                      : std::numeric_limits<SumType>::max();
+    }
+  } else {
+    Sum += Value;
+  }
+}
+
+/// \brief Convert a sum to the output type, clamping it to the range of the
+/// output type.
+template <typename OutType, typename SumType>
+OutType clampTo(SumType Sum) {
+  using Limits = std::numeric_limits<OutType>;
+  if constexpr (std::is_floating_point_v<OutType>) {
+    return static_cast<OutType>(Sum);
+  } else if constexpr (std::is_floating_point_v<SumType>) {
+    if (Sum != Sum) {
+      return OutType(0); // NaN
+    }
+    if (Sum <= static_cast<SumType>(Limits::lowest())) {
+      return Limits::lowest();
+    }
+    if (Sum >= static_cast<SumType>(Limits::max())) {
+      return Limits::max();
+    }
+    return static_cast<OutType>(Sum);
+  } else {
+    if constexpr (std::is_signed_v<SumType>) {
+      if (Sum < 0) {
+        if constexpr (std::is_unsigned_v<OutType>) {
+          return OutType(0);
+        } else if (Sum < static_cast<SumType>(Limits::lowest())) {
+          return Limits::lowest();
+        }
+        return static_cast<OutType>(Sum);
+      }
+    }
+    if (static_cast<std::uint64_t>(Sum) >
+        static_cast<std::uint64_t>(Limits::max())) {
+      return Limits::max();
+    }
+    return static_cast<OutType>(Sum);
+  }
+}
+
+/// \brief Crops frames to a region of interest (ROI) and sums blocks of
+/// pixels (binning).
+///
+/// Works on one and two dimensional frames; a one dimensional frame is
+/// handled as a single row. Binning is applied to the ROI (or to the full
+/// frame if no ROI is set); pixels that do not fill a complete bin at the
+/// end of a row or column are dropped. The sums are computed in 64 bit
+/// integers (or doubles for floating point data), which can hold the sum of
+/// any bin of up to 32 bit integers without a check per pixel. Each sum is
+/// clamped to the range of the element type of the output, so that it does
+/// not wrap around.
+class FrameTransform {
+public:
+  FrameTransform() = default;
+
+  /// \param RoiOffset Index of the first pixel of the ROI in each dimension.
+  /// Empty for no ROI.
+  /// \param RoiSize Size of the ROI in each dimension. Empty for no ROI.
+  /// \param Binning Number of pixels per bin in each dimension. Empty for no
+  /// binning.
+  /// \throw std::runtime_error If the parameters are not consistent or if a
+  /// bin has more than MaxPixelsPerBin pixels.
+  FrameTransform(hdf5::Dimensions RoiOffset, hdf5::Dimensions RoiSize,
+                 hdf5::Dimensions Binning);
+
+  bool isEnabled() const { return not(Offset.empty() and Bins.empty()); }
+
+  /// \brief The shape of the output frames for input frames of the given
+  /// shape.
+  ///
+  /// \throw std::runtime_error If the frame can not be transformed, e.g. if
+  /// the ROI is outside of the frame.
+  hdf5::Dimensions outputShape(hdf5::Dimensions const &FrameShape) const;
+
+  /// \brief Crop and bin a frame.
+  ///
+  /// \param Frame The frame, in row major order.
+  /// \param FrameShape Shape of the frame.
+  /// \param Output Where to write the result, must hold as many elements as
+  /// given by outputShape().
+  template <typename OutType, typename InType>
+  void apply(InType const *Frame, hdf5::Dimensions const &FrameShape,
+             OutType *Output) const {
+    using SumType = BinSumType<InType, OutType>;
+    auto Region = region(FrameShape);
+    auto const OutRows = Region.Rows / Region.RowBin;
+    auto const OutCols = Region.Cols / Region.ColBin;
+    for (size_t OutRow = 0; OutRow < OutRows; ++OutRow) {
+      auto const FirstRow = Region.FirstRow + OutRow * Region.RowBin;
+      InType const *FirstInRow =
+          Frame + FirstRow * Region.FrameCols + Region.FirstCol;
+      OutType *OutPixels = Output + OutRow * OutCols;
+      if (Region.RowBin == 1 and Region.ColBin == 1) {
+        for (size_t Col = 0; Col < OutCols; ++Col) {
+          OutPixels[Col] =
+              clampTo<OutType>(static_cast<SumType>(FirstInRow[Col]));
+        }
+        continue;
+      }
+      for (size_t Col = 0; Col < OutCols; ++Col) {
+        SumType Sum{0};
+        for (size_t Row = 0; Row < Region.RowBin; ++Row) {
+          auto const *InBin =
+              FirstInRow + Row * Region.FrameCols + Col * Region.ColBin;
+          if constexpr (BinSumCanOverflow<InType, SumType>) {
+            for (size_t i = 0; i < Region.ColBin; ++i) {
+              addClamped(Sum, static_cast<SumType>(InBin[i]));
+            }
+          } else {
+            for (size_t i = 0; i < Region.ColBin; ++i) {
+              Sum += static_cast<SumType>(InBin[i]);
+            }
+          }
+        }
+        OutPixels[Col] = clampTo<OutType>(Sum);
+      }
+    }
+  }
+
+private:
+  struct Region2D {
+    size_t FrameCols{1};
+    size_t FirstRow{0};
+    size_t FirstCol{0};
+    size_t Rows{1};
+    size_t Cols{1};
+    size_t RowBin{1};
+    size_t ColBin{1};
+  };
+  /// \brief The ROI and binning as two dimensional parameters.
+  Region2D region(hdf5::Dimensions const &FrameShape) const;
+
+  hdf5::Dimensions Offset;
+  hdf5::Dimensions Size;
+  hdf5::Dimensions Bins;
+};
+
+} // namespace NDAr
+} // namespace WriterModule
@@ -16,8 +16,10 @@
 
 #include "HDFFile.h"
 #include "NDAr_Writer.h"
+#include "WriterModuleConfig.h"
 #include "WriterRegistrar.h"
 #include <NDAr_NDArray_schema_generated.h>
+#include <fmt/format.h>
 
 namespace WriterModule {
 namespace NDAr {
@@ -33,53 +35,98 @@ std::uint64_t NDAr_Writer::epicsTimeToNsec(std::uint64_t sec,
   return (sec + TimeDiffUNIXtoEPICSepoch) * NSecMultiplier + nsec;
 }
 
+/// \brief Call \p Func with a value of the C++ type that corresponds to
+/// \p ElementType.
+///
+/// Used to instantiate the typed value dataset once, when the HDF structure is
+/// created or reopened.
+template <typename FuncType>
+auto withElementType(NDAr_Writer::Type ElementType, FuncType &&Func) {
+  using Type = NDAr_Writer::Type;
+  switch (ElementType) {
+  case Type::c_string:
+    return Func(char());
+  case Type::int8:
+    return Func(std::int8_t());
+  case Type::uint8:
+    return Func(std::uint8_t());
+  case Type::int16:
+    return Func(std::int16_t());
+  case Type::uint16:
+    return Func(std::uint16_t());
+  case Type::int32:
+    return Func(std::int32_t());
+  case Type::uint32:
+    return Func(std::uint32_t());
+  case Type::int64:
+    return Func(std::int64_t());
+  case Type::uint64:
+    return Func(std::uint64_t());
+  case Type::float32:
+    return Func(float());
+  case Type::float64:
+  default:
+    return Func(double());
+  }
+}
+
 /// \brief Parse config JSON structure.
 ///
 /// The default is to use double as the element type.
 void NDAr_Writer::parse_config(std::string const &ConfigurationStream) {
-  auto Config = nlohmann::json::parse(ConfigurationStream);
-  try {
-    CueInterval = Config["cue_interval"].get<uint64_t>();
-  } catch (...) {
-    // Do nothing
+  auto ParsedConfig = parseConfig(ConfigurationStream);
+  if (not ParsedConfig) {
+    Logger->error("NDAr configuration is not valid JSON, using the defaults.");
+    return;
   }
-  try {
-    auto DataType = Config["type"].get<std::string>();
-    std::map<std::string, NDAr_Writer::Type> TypeMap{
-        {"int8", Type::int8},         {"uint8", Type::uint8},
-        {"int16", Type::int16},       {"uint16", Type::uint16},
-        {"int32", Type::int32},       {"uint32", Type::uint32},
-        {"int64", Type::int64},       {"uint64", Type::uint64},
-        {"float32", Type::float32},   {"float64", Type::float64},
-        {"c_string", Type::c_string},
-    };
-    try {
-      ElementType = TypeMap.at(DataType);
-    } catch (std::out_of_range &E) {
+  static std::map<std::string, NDAr_Writer::Type> const TypeMap{
+      {"int8", Type::int8},         {"uint8", Type::uint8},
+      {"int16", Type::int16},       {"uint16", Type::uint16},
+      {"int32", Type::int32},       {"uint32", Type::uint32},
+      {"int64", Type::int64},       {"uint64", Type::uint64},
+      {"float32", Type::float32},   {"float64", Type::float64},
+      {"c_string", Type::c_string},
+  };
+  auto setType = [this](std::string const &DataType) {
+    if (auto TypeIt = TypeMap.find(DataType); TypeIt != TypeMap.end()) {
+      ElementType = TypeIt->second;
+    } else {
       Logger->error("Unknown type ({}), using the default (double).", DataType);
     }
-  } catch (nlohmann::json::exception &E) {
-    Logger->warn("Unable to extract data type, using the default "
-                 "(double). Error was: {}",
-                 E.what());
-  }
-
+  };
+  // The chunk size is either the full chunk shape or the size of the first
+  // dimension.
+  auto setChunkSize = [this](nlohmann::json const &Value) {
+    if (auto Shape = getValue<hdf5::Dimensions>(Value)) {
+      ChunkSize = *Shape;
+    } else if (auto Size = getValue<hsize_t>(Value)) {
+      ChunkSize = hdf5::Dimensions{*Size};
+    } else {
+      Logger->warn("Unable to extract chunk size, using the default (64). "
+                   "This might be very inefficient.");
+    }
+  };
+  hdf5::Dimensions RoiOffset;
+  hdf5::Dimensions RoiSize;
+  hdf5::Dimensions Binning;
+  ConfigSchema Schema;
+  Schema.add({"cue_interval"}, CueInterval)
+      .add<std::string>({"type"}, setType)
+      .add({"array_size"}, ArrayShape)
+      .add<nlohmann::json>({"chunk_size"}, setChunkSize)
+      .add({"roi", "offset"}, RoiOffset)
+      .add({"roi", "size"}, RoiSize)
+      .add({"binning"}, Binning);
+  auto Errors = Schema.apply(*ParsedConfig);
   try {
-    ArrayShape = Config["array_size"].get<hdf5::Dimensions>();
-  } catch (nlohmann::json::exception &E) {
-    Logger->warn(
-        "Unable to extract array size, using the default (1x1). Error was: {}",
-        E.what());
+    Transform = FrameTransform(RoiOffset, RoiSize, Binning);
+  } catch (std::exception const &E) {
+    Transform = FrameTransform();
+    Errors.push_back(fmt::format(
+        "{} The region of interest and binning are ignored.", E.what()));
   }
-
-  auto JsonChunkSize = Config["chunk_size"];
-  if (JsonChunkSize.is_array()) {
-    ChunkSize = Config["chunk_size"].get<hdf5::Dimensions>();
-  } else if (JsonChunkSize.is_number_integer()) {
-    ChunkSize = hdf5::Dimensions{JsonChunkSize.get<hsize_t>()};
-  } else {
-    Logger->warn("Unable to extract chunk size, using the default (64). "
-                 "This might be very inefficient.");
+  for (auto const &Error : Errors) {
+    Logger->error("NDAr configuration: {}", Error);
   }
   Logger->info("Using a cue interval of {}.", CueInterval);
 }
@@ -117,8 +164,10 @@ NDAr_Writer::init_hdf(hdf5::node::Group &HDFGroup,
 
 WriterModule::InitResult NDAr_Writer::reopen(hdf5::node::Group &HDFGroup) {
   try {
-    Values = std::make_unique<NeXusDataset::MultiDimDatasetBase>(
-        HDFGroup, NeXusDataset::Mode::Open);
+    Values = withElementType(ElementType, [&](auto Value) -> ValuesVariant {
+      return NeXusDataset::MultiDimDataset<decltype(Value)>(
+          HDFGroup, NeXusDataset::Mode::Open);
+    });
     Timestamp = NeXusDataset::Time(HDFGroup, NeXusDataset::Mode::Open);
     CueTimestampIndex =
         NeXusDataset::CueIndex(HDFGroup, NeXusDataset::Mode::Open);
@@ -132,25 +181,30 @@ WriterModule::InitResult NDAr_Writer::reopen(hdf5::node::Group &HDFGroup) {
   }
   return WriterModule::InitResult::OK;
 }
-template <typename DataType, class DatasetType>
-void appendData(DatasetType &Dataset, const std::uint8_t *Pointer, size_t Size,
+
+NeXusDataset::MultiDimDatasetBase &NDAr_Writer::values() {
+  return std::visit(
+      [](auto &Dataset) -> NeXusDataset::MultiDimDatasetBase & {
+        return Dataset;
+      },
+      Values);
+}
+
+template <typename DataType>
+void appendData(NeXusDataset::MultiDimDatasetBase &Dataset,
+                const std::uint8_t *Pointer, size_t Size,
                 hdf5::Dimensions const &Shape) {
-  Dataset->appendArray(
+  Dataset.appendArray(
       ArrayAdapter<DataType>(reinterpret_cast<DataType *>(Pointer), Size),
       Shape);
 }
 
-void NDAr_Writer::write(const FileWriter::FlatbufferMessage &Message) {
-  auto NDAr = FB_Tables::GetNDArray(Message.data());
-  auto DataShape = hdf5::Dimensions(NDAr->dims()->begin(), NDAr->dims()->end());
-  auto CurrentTimestamp =
-      epicsTimeToNsec(NDAr->epicsTS()->secPastEpoch(), NDAr->epicsTS()->nsec());
-  FB_Tables::DType Type = NDAr->dataType();
-  auto DataPtr = NDAr->pData()->Data();
-  auto NrOfElements =
-      std::accumulate(std::cbegin(DataShape), std::cend(DataShape), size_t(1),
-                      std::multiplies<>());
-
+/// \brief Append an array of a type other than the element type of the
+/// dataset, relying on HDF5 for the type conversion.
+void appendConvertedData(NeXusDataset::MultiDimDatasetBase &Values,
+                         FB_Tables::DType Type, const std::uint8_t *DataPtr,
+                         size_t NrOfElements,
+                         hdf5::Dimensions const &DataShape) {
   switch (Type) {
   case FB_Tables::DType::Int8:
     appendData<const std::int8_t>(Values, DataPtr, NrOfElements, DataShape);
@@ -182,6 +236,132 @@ void NDAr_Writer::write(const FileWriter::FlatbufferMessage &Message) {
   default:
     throw WriterModule::WriterException("Error in flatbuffer.");
   }
+}
+
+/// \brief True if elements of the flatbuffer data type \p Type are stored as
+/// \p DataType.
+template <typename DataType> constexpr bool isDType(FB_Tables::DType) {
+  return false;
+}
+template <> constexpr bool isDType<std::int8_t>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Int8;
+}
+template <> constexpr bool isDType<std::uint8_t>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Uint8;
+}
+template <> constexpr bool isDType<std::int16_t>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Int16;
+}
+template <> constexpr bool isDType<std::uint16_t>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Uint16;
+}
+template <> constexpr bool isDType<std::int32_t>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Int32;
+}
+template <> constexpr bool isDType<std::uint32_t>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Uint32;
+}
+template <> constexpr bool isDType<float>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Float32;
+}
+template <> constexpr bool isDType<double>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::Float64;
+}
+template <> constexpr bool isDType<char>(FB_Tables::DType Type) {
+  return Type == FB_Tables::DType::c_string;
+}
+
+/// \brief Append an array to a dataset of a known type.
+///
+/// Arrays of the same type as the dataset are appended directly; anything
+/// else goes through the (slower) converting path.
+template <typename DataType>
+void appendValues(NeXusDataset::MultiDimDataset<DataType> &Dataset,
+                  FB_Tables::DType Type, const std::uint8_t *DataPtr,
+                  size_t NrOfElements, hdf5::Dimensions const &DataShape) {
+  if (isDType<DataType>(Type)) {
+    Dataset.appendTypedArray(
+        {reinterpret_cast<DataType const *>(DataPtr), NrOfElements},
+        DataShape);
+  } else {
+    appendConvertedData(Dataset, Type, DataPtr, NrOfElements, DataShape);
+  }
+}
+
+/// \brief Call \p Func with a value of the C++ type of the flatbuffer data
+/// type \p Type.
+template <typename FuncType>
+void withFrameType(FB_Tables::DType Type, FuncType &&Func) {
+  switch (Type) {
+  case FB_Tables::DType::Int8:
+    return Func(std::int8_t());
+  case FB_Tables::DType::Uint8:
+    return Func(std::uint8_t());
+  case FB_Tables::DType::Int16:
+    return Func(std::int16_t());
+  case FB_Tables::DType::Uint16:
+    return Func(std::uint16_t());
+  case FB_Tables::DType::Int32:
+    return Func(std::int32_t());
+  case FB_Tables::DType::Uint32:
+    return Func(std::uint32_t());
+  case FB_Tables::DType::Float32:
+    return Func(float());
+  case FB_Tables::DType::Float64:
+    return Func(double());
+  case FB_Tables::DType::c_string:
+    return Func(char());
+  default:
+    throw WriterModule::WriterException("Error in flatbuffer.");
+  }
+}
+
+/// \brief Crop and bin a frame into the element type of the dataset and
+/// append it.
+template <typename DataType>
+void appendTransformed(NeXusDataset::MultiDimDataset<DataType> &Dataset,
+                       FrameTransform const &Transform,
+                       std::vector<std::uint8_t> &Buffer,
+                       FB_Tables::DType Type, const std::uint8_t *DataPtr,
+                       hdf5::Dimensions const &DataShape) {
+  auto OutputShape = Transform.outputShape(DataShape);
+  auto NrOfElements =
+      std::accumulate(std::cbegin(OutputShape), std::cend(OutputShape),
+                      size_t(1), std::multiplies<>());
+  Buffer.resize(NrOfElements * sizeof(DataType));
+  auto Output = reinterpret_cast<DataType *>(Buffer.data());
+  withFrameType(Type, [&](auto Value) {
+    Transform.apply(reinterpret_cast<decltype(Value) const *>(DataPtr),
+                    DataShape, Output);
+  });
+  Dataset.appendTypedArray({Output, NrOfElements}, OutputShape);
+}
+
+void NDAr_Writer::write(const FileWriter::FlatbufferMessage &Message) {
+  auto NDAr = FB_Tables::GetNDArray(Message.data());
+  auto DataShape = hdf5::Dimensions(NDAr->dims()->begin(), NDAr->dims()->end());
+  auto CurrentTimestamp =
+      epicsTimeToNsec(NDAr->epicsTS()->secPastEpoch(), NDAr->epicsTS()->nsec());
+  FB_Tables::DType Type = NDAr->dataType();
+  auto DataPtr = NDAr->pData()->Data();
+  auto NrOfElements =
+      std::accumulate(std::cbegin(DataShape), std::cend(DataShape), size_t(1),
+                      std::multiplies<>());
+
+  if (Transform.isEnabled()) {
+    std::visit(
+        [&](auto &Dataset) {
+          appendTransformed(Dataset, Transform, TransformBuffer, Type, DataPtr,
+                            DataShape);
+        },
+        Values);
+  } else {
+    std::visit(
+        [&](auto &Dataset) {
+          appendValues(Dataset, Type, DataPtr, NrOfElements, DataShape);
+        },
+        Values);
+  }
   Timestamp.appendElement(CurrentTimestamp);
   if (++CueCounter == CueInterval) {
     CueTimestampIndex.appendElement(Timestamp.dataspace().size() - 1);
@@ -190,68 +370,13 @@ void NDAr_Writer::write(const FileWriter::FlatbufferMessage &Message) {
   }
 }
 
-template <typename Type>
-std::unique_ptr<NeXusDataset::MultiDimDatasetBase>
-makeIt(hdf5::node::Group const &Parent, hdf5::Dimensions const &Shape,
-       hdf5::Dimensions const &ChunkSize) {
-  return std::make_unique<NeXusDataset::MultiDimDataset<Type>>(
-      Parent, NeXusDataset::Mode::Create, Shape, ChunkSize);
-}
-
 void NDAr_Writer::initValueDataset(hdf5::node::Group &Parent) {
-  using OpenFuncType =
-      std::function<std::unique_ptr<NeXusDataset::MultiDimDatasetBase>()>;
-  std::map<Type, OpenFuncType> CreateValuesMap{
-      {Type::c_string,
-       [&Parent, this]() {
-         return makeIt<char>(Parent, this->ArrayShape, this->ChunkSize);
-       }},
-      {Type::int8,
-       [&Parent, this]() {
-         return makeIt<std::int8_t>(Parent, this->ArrayShape, this->ChunkSize);
-       }},
-      {Type::uint8,
-       [&Parent, this]() {
-         return makeIt<std::uint8_t>(Parent, this->ArrayShape, this->ChunkSize);
-       }},
-      {Type::int16,
-       [&Parent, this]() {
-         return makeIt<std::int16_t>(Parent, this->ArrayShape, this->ChunkSize);
-       }},
-      {Type::uint16,
-       [&Parent, this]() {
-         return makeIt<std::uint16_t>(Parent, this->ArrayShape,
-                                      this->ChunkSize);
-       }},
-      {Type::int32,
-       [&Parent, this]() {
-         return makeIt<std::int32_t>(Parent, this->ArrayShape, this->ChunkSize);
-       }},
-      {Type::uint32,
-       [&Parent, this]() {
-         return makeIt<std::uint32_t>(Parent, this->ArrayShape,
-                                      this->ChunkSize);
-       }},
-      {Type::int64,
-       [&Parent, this]() {
-         return makeIt<std::int64_t>(Parent, this->ArrayShape, this->ChunkSize);
-       }},
-      {Type::uint64,
-       [&Parent, this]() {
-         return makeIt<std::uint64_t>(Parent, this->ArrayShape,
-                                      this->ChunkSize);
-       }},
-      {Type::float32,
-       [&Parent, this]() {
-         return makeIt<std::float_t>(Parent, this->ArrayShape, this->ChunkSize);
-       }},
-      {Type::float64,
-       [&Parent, this]() {
-         return makeIt<std::double_t>(Parent, this->ArrayShape,
-                                      this->ChunkSize);
-       }},
-  };
-  Values = CreateValuesMap.at(ElementType)();
+  auto Shape = Transform.isEnabled() ? Transform.outputShape(ArrayShape)
+                                     : ArrayShape;
+  Values = withElementType(ElementType, [&](auto Value) -> ValuesVariant {
+    return NeXusDataset::MultiDimDataset<decltype(Value)>(
+        Parent, NeXusDataset::Mode::Create, Shape, ChunkSize);
+  });
 }
 } // namespace NDAr
 } // namespace WriterModule
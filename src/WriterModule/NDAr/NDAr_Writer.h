@@ -15,10 +15,13 @@
 #pragma once
 
 #include "FlatbufferMessage.h"
+#include "FrameTransform.h"
 #include "HDFFile.h"
 #include "Msg.h"
 #include "NeXusDataset/NeXusDataset.h"
 #include "WriterModuleBase.h"
+#include <variant>
+#include <vector>
 
 namespace WriterModule {
 namespace NDAr {
@@ -59,7 +62,27 @@ protected:
   } ElementType{Type::float64};
   hdf5::Dimensions ArrayShape{1, 1};
   hdf5::Dimensions ChunkSize{64};
-  std::unique_ptr<NeXusDataset::MultiDimDatasetBase> Values;
+  /// Region of interest and binning applied to the frames before writing.
+  FrameTransform Transform;
+  std::vector<std::uint8_t> TransformBuffer;
+  /// The value dataset, typed by the element type of the stream so that
+  /// arrays of that type are appended without any type dispatch.
+  using ValuesVariant = std::variant<
+      NeXusDataset::MultiDimDataset<double>,
+      NeXusDataset::MultiDimDataset<float>,
+      NeXusDataset::MultiDimDataset<std::int8_t>,
+      NeXusDataset::MultiDimDataset<std::uint8_t>,
+      NeXusDataset::MultiDimDataset<std::int16_t>,
+      NeXusDataset::MultiDimDataset<std::uint16_t>,
+      NeXusDataset::MultiDimDataset<std::int32_t>,
+      NeXusDataset::MultiDimDataset<std::uint32_t>,
+      NeXusDataset::MultiDimDataset<std::int64_t>,
+      NeXusDataset::MultiDimDataset<std::uint64_t>,
+      NeXusDataset::MultiDimDataset<char>>;
+  ValuesVariant Values;
+
+  /// \brief Type-erased access to the value dataset.
+  NeXusDataset::MultiDimDatasetBase &values();
   NeXusDataset::Time Timestamp;
   int CueInterval{1000};
   int CueCounter{0};
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "EventBanks.h"
+#include <algorithm>
+#include <fmt/format.h>
+
+namespace WriterModule {
+namespace ev42 {
+
+EventBanks::EventBanks(std::vector<BankDefinition> Definitions) {
+  std::sort(Definitions.begin(), Definitions.end(),
+            [](auto const &A, auto const &B) {
+              return A.MinDetectorId < B.MinDetectorId;
+            });
+  for (auto &Bank : Definitions) {
+    if (Bank.MinDetectorId > Bank.MaxDetectorId) {
+      Errors.push_back(fmt::format(
+          "Detector bank \"{}\" has no detector IDs; the bank is ignored.",
+          Bank.Name));
+      continue;
+    }
+    if (not Banks.empty() and
+        Bank.MinDetectorId <= Banks.back().MaxDetectorId) {
+      Errors.push_back(
+          fmt::format("Detector banks \"{}\" and \"{}\" overlap; \"{}\" is "
+                      "ignored.",
+                      Banks.back().Name, Bank.Name, Bank.Name));
+      continue;
+    }
+    Banks.push_back(std::move(Bank));
+  }
+  BankSizes.assign(Banks.size() + 1, 0);
+  TimeOfFlightBuffers.resize(Banks.size());
+  DetectorIdBuffers.resize(Banks.size());
+}
+
+void EventBanks::split(ArrayAdapter<const std::uint32_t> TimeOfFlight,
+                       ArrayAdapter<const std::uint32_t> DetectorId) {
+  if (Banks.empty()) {
+    return;
+  }
+  auto const NrOfEvents = std::min(TimeOfFlight.size(), DetectorId.size());
+  auto const NrOfBanks = static_cast<std::uint32_t>(Banks.size());
+  auto const *Ids = DetectorId.data();
+  EventBank.assign(NrOfEvents, 0);
+  auto *EventBankPtr = EventBank.data();
+
+  // Index of the last bank starting at or below the detector ID.
+  for (size_t Bank = 1; Bank < Banks.size(); ++Bank) {
+    auto const Min = Banks[Bank].MinDetectorId;
+    for (size_t i = 0; i < NrOfEvents; ++i) {
+      EventBankPtr[i] += static_cast<std::uint32_t>(Ids[i] >= Min);
+    }
+  }
+  // Events below the first bank or above the end of their bank go to the
+  // "outside" bucket.
+  auto const FirstMin = Banks.front().MinDetectorId;
+  for (size_t i = 0; i < NrOfEvents; ++i) {
+    auto const Bank = EventBankPtr[i];
+    auto const Outside =
+        Ids[i] < FirstMin or Ids[i] > Banks[Bank].MaxDetectorId;
+    EventBankPtr[i] = Outside ? NrOfBanks : Bank;
+  }
+
+  std::fill(BankSizes.begin(), BankSizes.end(), 0);
+  for (size_t i = 0; i < NrOfEvents; ++i) {
+    ++BankSizes[EventBankPtr[i]];
+  }
+  for (size_t Bank = 0; Bank < Banks.size(); ++Bank) {
+    if (TimeOfFlightBuffers[Bank].size() < BankSizes[Bank]) {
+      TimeOfFlightBuffers[Bank].resize(BankSizes[Bank]);
+      DetectorIdBuffers[Bank].resize(BankSizes[Bank]);
+    }
+  }
+  std::vector<size_t> Positions(Banks.size() + 1, 0);
+  auto const *Tofs = TimeOfFlight.data();
+  for (size_t i = 0; i < NrOfEvents; ++i) {
+    auto const Bank = EventBankPtr[i];
+    if (Bank == NrOfBanks) {
+      continue;
+    }
+    auto const Position = Positions[Bank]++;
+    TimeOfFlightBuffers[Bank][Position] = Tofs[i];
+    DetectorIdBuffers[Bank][Position] = Ids[i];
+  }
+}
+
+} // namespace ev42
+} // namespace WriterModule
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "NeXusDataset/ExtensibleDataset.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace WriterModule {
+namespace ev42 {
+
+/// \brief A detector bank, i.e. a range of detector IDs written to its own
+/// NXevent_data group.
+struct BankDefinition {
+  std::string Name;
+  std::uint32_t MinDetectorId{0};
+  std::uint32_t MaxDetectorId{0}; // Inclusive
+};
+
+/// \brief Splits the events of a message into detector banks.
+///
+/// The events are assigned to banks in one pass per bank over the detector
+/// IDs, without branches, so that the compiler can vectorise it. They are
+/// then counted and copied to per bank buffers. The buffers are reused
+/// between messages. Events keep their order within a bank. Events with
+/// detector IDs outside of all banks are dropped.
+class EventBanks {
+public:
+  EventBanks() = default;
+
+  /// \brief Banks without detector IDs and banks that overlap a bank with
+  /// lower detector IDs are ignored, see errors().
+  explicit EventBanks(std::vector<BankDefinition> Definitions);
+
+  /// \brief Descriptions of the banks that were ignored as they were not
+  /// valid.
+  std::vector<std::string> const &errors() const { return Errors; }
+
+  size_t size() const { return Banks.size(); }
+  bool empty() const { return Banks.empty(); }
+  BankDefinition const &operator[](size_t Bank) const { return Banks[Bank]; }
+
+  void split(ArrayAdapter<const std::uint32_t> TimeOfFlight,
+             ArrayAdapter<const std::uint32_t> DetectorId);
+
+  /// \brief Time of flight of the events of a bank from the last split().
+  ArrayAdapter<const std::uint32_t> timeOfFlight(size_t Bank) const {
+    return {TimeOfFlightBuffers[Bank].data(), BankSizes[Bank]};
+  }
+
+  /// \brief Detector IDs of the events of a bank from the last split().
+  ArrayAdapter<const std::uint32_t> detectorId(size_t Bank) const {
+    return {DetectorIdBuffers[Bank].data(), BankSizes[Bank]};
+  }
+
+  /// \brief Number of events in the last split() that were not in any bank.
+  size_t eventsOutsideBanks() const { return BankSizes.back(); }
+
+private:
+  std::vector<std::string> Errors;
+  std::vector<BankDefinition> Banks; // Sorted by detector ID
+  std::vector<std::uint32_t> EventBank;
+  std::vector<size_t> BankSizes; // Last entry: events outside the banks
+  std::vector<std::vector<std::uint32_t>> TimeOfFlightBuffers;
+  std::vector<std::vector<std::uint32_t>> DetectorIdBuffers;
+};
+
+} // namespace ev42
+} // namespace WriterModule
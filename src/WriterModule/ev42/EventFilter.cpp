@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "EventFilter.h"
+#include "WriterModuleConfig.h"
+#include <algorithm>
+#include <fmt/format.h>
+
+namespace WriterModule {
+namespace ev42 {
+
+EventFilter::EventFilter(nlohmann::json const &Config) {
+  std::vector<std::vector<std::uint32_t>> IdRanges;
+  std::vector<std::uint32_t> MaskedIds;
+  ConfigSchema Schema;
+  Schema
+      .add<std::uint32_t>({"time_of_flight_min"},
+                          [this](std::uint32_t Value) {
+                            MinTimeOfFlight = Value;
+                            Enabled = true;
+                          })
+      .add<std::uint32_t>({"time_of_flight_max"},
+                          [this](std::uint32_t Value) {
+                            MaxTimeOfFlight = Value;
+                            Enabled = true;
+                          })
+      .add({"detector_id_ranges"}, IdRanges)
+      .add({"masked_detector_ids"}, MaskedIds);
+  Errors = Schema.apply(Config);
+  if (MinTimeOfFlight > MaxTimeOfFlight) {
+    Errors.push_back(fmt::format("The time of flight window [{}, {}] is "
+                                 "empty; the window is ignored.",
+                                 MinTimeOfFlight, MaxTimeOfFlight));
+    MinTimeOfFlight = 0;
+    MaxTimeOfFlight = std::numeric_limits<std::uint32_t>::max();
+    Enabled = false;
+  }
+  for (auto const &Range : IdRanges) {
+    if (Range.size() != 2) {
+      Errors.push_back(
+          fmt::format("A detector ID range should be [first, last], not "
+                      "{} values; the range is ignored.",
+                      Range.size()));
+      continue;
+    }
+    AcceptedIdRanges.emplace_back(Range[0], Range[1]);
+    Enabled = true;
+  }
+  auto const TooLarge = std::remove_if(
+      MaskedIds.begin(), MaskedIds.end(), [this](std::uint32_t Id) {
+        if (Id <= MaxMaskedId) {
+          return false;
+        }
+        Errors.push_back(
+            fmt::format("The masked detector ID {} is larger than the "
+                        "largest ID that can be masked ({}) and is ignored.",
+                        Id, MaxMaskedId));
+        return true;
+      });
+  MaskedIds.erase(TooLarge, MaskedIds.end());
+  if (not MaskedIds.empty()) {
+    auto const LargestId =
+        *std::max_element(MaskedIds.begin(), MaskedIds.end());
+    NrOfMaskBits = std::uint64_t(LargestId) + 1;
+    Mask.assign((NrOfMaskBits + 63) / 64, 0);
+    for (auto Id : MaskedIds) {
+      Mask[Id / 64] |= std::uint64_t(1) << (Id % 64);
+    }
+    Enabled = true;
+  }
+}
+
+void EventFilter::apply(ArrayAdapter<const std::uint32_t> TimeOfFlight,
+                        ArrayAdapter<const std::uint32_t> DetectorId) {
+  auto const NrOfEvents = std::min(TimeOfFlight.size(), DetectorId.size());
+  auto const *Tofs = TimeOfFlight.data();
+  auto const *Ids = DetectorId.data();
+  Keep.resize(NrOfEvents);
+  auto *KeepPtr = Keep.data();
+
+  for (size_t i = 0; i < NrOfEvents; ++i) {
+    KeepPtr[i] = static_cast<std::uint8_t>((Tofs[i] >= MinTimeOfFlight) &
+                                           (Tofs[i] <= MaxTimeOfFlight));
+  }
+  if (not AcceptedIdRanges.empty()) {
+    InRange.assign(NrOfEvents, 0);
+    auto *InRangePtr = InRange.data();
+    for (auto const &Range : AcceptedIdRanges) {
+      for (size_t i = 0; i < NrOfEvents; ++i) {
+        InRangePtr[i] |= static_cast<std::uint8_t>((Ids[i] >= Range.first) &
+                                                   (Ids[i] <= Range.second));
+      }
+    }
+    for (size_t i = 0; i < NrOfEvents; ++i) {
+      KeepPtr[i] &= InRangePtr[i];
+    }
+  }
+  if (not Mask.empty()) {
+    auto const LastWord = Mask.size() - 1;
+    auto const *MaskPtr = Mask.data();
+    for (size_t i = 0; i < NrOfEvents; ++i) {
+      auto const Id = Ids[i];
+      auto const Word = std::min<size_t>(Id / 64, LastWord);
+      auto const IsMasked = static_cast<std::uint8_t>(
+          (Id < NrOfMaskBits) & ((MaskPtr[Word] >> (Id % 64)) & 1));
+      KeepPtr[i] &= static_cast<std::uint8_t>(IsMasked ^ 1);
+    }
+  }
+
+  if (KeptTimeOfFlight.size() < NrOfEvents) {
+    KeptTimeOfFlight.resize(NrOfEvents);
+    KeptDetectorId.resize(NrOfEvents);
+  }
+  auto *KeptTofPtr = KeptTimeOfFlight.data();
+  auto *KeptIdPtr = KeptDetectorId.data();
+  size_t Kept{0};
+  for (size_t i = 0; i < NrOfEvents; ++i) {
+    // Always written, only kept (by moving on) if the event is kept.
+    KeptTofPtr[Kept] = Tofs[i];
+    KeptIdPtr[Kept] = Ids[i];
+    Kept += KeepPtr[i];
+  }
+  NrOfKept = Kept;
+  NrOfVetoed = static_cast<std::uint32_t>(NrOfEvents - Kept);
+}
+
+} // namespace ev42
+} // namespace WriterModule
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "NeXusDataset/ExtensibleDataset.h"
+#include "json.h"
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace WriterModule {
+namespace ev42 {
+
+/// \brief Discards (vetoes) events that are known to be of no interest before
+/// they are written.
+///
+/// An event is kept if its time of flight is inside the time of flight window,
+/// its detector ID is in one of the accepted ranges (if any are given) and it
+/// is not masked. The decision is made for all events of a message in
+/// branch-free passes, one per criterion, and the kept events are then
+/// compacted into buffers that are reused between messages. The loops are
+/// simple enough for the compiler to vectorise.
+class EventFilter {
+public:
+  EventFilter() = default;
+
+  /// \brief Set up the filter from the "event_filter" object of the ev42
+  /// configuration.
+  ///
+  /// Settings of the wrong type, an empty time of flight window and masked
+  /// detector IDs that are too large are ignored, see errors().
+  explicit EventFilter(nlohmann::json const &Config);
+
+  /// \brief Descriptions of the settings that were ignored as they were not
+  /// valid.
+  std::vector<std::string> const &errors() const { return Errors; }
+
+  /// \brief The largest detector ID that can be masked.
+  ///
+  /// The mask takes one bit per detector ID up to the largest masked ID,
+  /// which limits it to 8 MB.
+  static constexpr std::uint32_t MaxMaskedId{(1u << 26) - 1};
+
+  /// \brief True if any events can be vetoed.
+  bool isEnabled() const { return Enabled; }
+
+  void apply(ArrayAdapter<const std::uint32_t> TimeOfFlight,
+             ArrayAdapter<const std::uint32_t> DetectorId);
+
+  /// \brief Time of flight of the events kept by the last apply().
+  ArrayAdapter<const std::uint32_t> timeOfFlight() const {
+    return {KeptTimeOfFlight.data(), NrOfKept};
+  }
+
+  /// \brief Detector IDs of the events kept by the last apply().
+  ArrayAdapter<const std::uint32_t> detectorId() const {
+    return {KeptDetectorId.data(), NrOfKept};
+  }
+
+  /// \brief Number of events vetoed by the last apply().
+  std::uint32_t vetoed() const { return NrOfVetoed; }
+
+private:
+  std::vector<std::string> Errors;
+  bool Enabled{false};
+  std::uint32_t MinTimeOfFlight{0};
+  std::uint32_t MaxTimeOfFlight{std::numeric_limits<std::uint32_t>::max()};
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> AcceptedIdRanges;
+  /// One bit per detector ID, set if masked. IDs after the end are not masked.
+  std::vector<std::uint64_t> Mask;
+  std::uint64_t NrOfMaskBits{0};
+  std::vector<std::uint8_t> Keep;
+  std::vector<std::uint8_t> InRange;
+  std::vector<std::uint32_t> KeptTimeOfFlight;
+  std::vector<std::uint32_t> KeptDetectorId;
+  size_t NrOfKept{0};
+  std::uint32_t NrOfVetoed{0};
+};
+
+} // namespace ev42
+} // namespace WriterModule
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "EventMerger.h"
+#include <algorithm>
+
+namespace WriterModule {
+namespace ev42 {
+
+EventMerger::EventMerger(std::vector<std::string> SourceNames, size_t Window)
+    : Window(std::max(Window, size_t(1))) {
+  for (auto &Name : SourceNames) {
+    if (SourceIndices.emplace(Name, Sources.size()).second) {
+      Sources.push_back(std::move(Name));
+    }
+  }
+  Pending.resize(Sources.size());
+}
+
+bool EventMerger::add(std::string const &SourceName, std::uint64_t PulseTime,
+                      ArrayAdapter<const std::uint32_t> TimeOfFlight,
+                      ArrayAdapter<const std::uint32_t> DetectorId) {
+  auto Index = SourceIndices.find(SourceName);
+  if (Index == SourceIndices.end()) {
+    return false;
+  }
+  auto &Queue = Pending[Index->second];
+  // A pulse may be split over several messages.
+  if (Queue.empty() or Queue.back().PulseTime != PulseTime) {
+    Queue.push_back({PulseTime, {}, {}});
+  }
+  auto &Events = Queue.back();
+  Events.TimeOfFlight.insert(Events.TimeOfFlight.end(), TimeOfFlight.data(),
+                             TimeOfFlight.data() + TimeOfFlight.size());
+  Events.DetectorId.insert(Events.DetectorId.end(), DetectorId.data(),
+                           DetectorId.data() + DetectorId.size());
+  return true;
+}
+
+bool EventMerger::next(bool Flush) {
+  auto Earliest = Pending.end();
+  bool WindowIsFull{false};
+  for (auto Queue = Pending.begin(); Queue != Pending.end(); ++Queue) {
+    if (Queue->empty()) {
+      continue;
+    }
+    if (Earliest == Pending.end() or
+        Queue->front().PulseTime < Earliest->front().PulseTime) {
+      Earliest = Queue;
+    }
+    WindowIsFull = WindowIsFull or Queue->size() > Window;
+  }
+  if (Earliest == Pending.end()) {
+    return false;
+  }
+  auto const NextPulseTime = Earliest->front().PulseTime;
+  if (not Flush and not WindowIsFull) {
+    // Complete once every source has moved on to a later pulse.
+    auto IsComplete = std::all_of(
+        Pending.begin(), Pending.end(), [NextPulseTime](auto const &Queue) {
+          return not Queue.empty() and Queue.back().PulseTime > NextPulseTime;
+        });
+    if (not IsComplete) {
+      return false;
+    }
+  }
+  TimeOfFlightBuffer.clear();
+  DetectorIdBuffer.clear();
+  for (auto &Queue : Pending) {
+    if (Queue.empty() or Queue.front().PulseTime != NextPulseTime) {
+      continue;
+    }
+    auto const &Events = Queue.front();
+    TimeOfFlightBuffer.insert(TimeOfFlightBuffer.end(),
+                              Events.TimeOfFlight.begin(),
+                              Events.TimeOfFlight.end());
+    DetectorIdBuffer.insert(DetectorIdBuffer.end(), Events.DetectorId.begin(),
+                            Events.DetectorId.end());
+    Queue.pop_front();
+  }
+  if (HasMerged and NextPulseTime <= LatestPulseTime) {
+    ++LatePulses;
+  }
+  PulseTime = NextPulseTime;
+  LatestPulseTime = std::max(LatestPulseTime, NextPulseTime);
+  HasMerged = true;
+  return true;
+}
+
+} // namespace ev42
+} // namespace WriterModule
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include "NeXusDataset/ExtensibleDataset.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WriterModule {
+namespace ev42 {
+
+/// \brief Merges the events of several sources, e.g. one per readout board,
+/// into a single time ordered sequence of pulses.
+///
+/// The events of each source are buffered per pulse. The pending pulses of
+/// the sources are merged like sorted lists in a k-way merge: the earliest
+/// pulse of all sources is taken next and the events of all sources with that
+/// pulse time are concatenated, in the order in which the sources were given.
+/// A pulse is only merged once every source has sent a later pulse, so that
+/// it is complete. If a source falls behind by more than the window, the
+/// earliest pulse is merged without waiting for it; events of that source
+/// which then arrive for an already merged pulse end up in a late pulse of
+/// their own.
+///
+/// \note The messages of each source are expected to be in the order of
+/// their pulse times.
+class EventMerger {
+public:
+  EventMerger() = default;
+
+  /// \param SourceNames The sources to merge.
+  /// \param Window The maximum number of pulses buffered for a source before
+  /// the earliest pulse is merged without waiting for the other sources.
+  EventMerger(std::vector<std::string> SourceNames, size_t Window);
+
+  bool isEnabled() const { return not Sources.empty(); }
+  std::vector<std::string> const &sources() const { return Sources; }
+
+  /// \brief Buffer the events of a message.
+  ///
+  /// \return False if the source is not one of the merged sources, in which
+  /// case the events are ignored.
+  bool add(std::string const &SourceName, std::uint64_t PulseTime,
+           ArrayAdapter<const std::uint32_t> TimeOfFlight,
+           ArrayAdapter<const std::uint32_t> DetectorId);
+
+  /// \brief Merge the next pulse, if it is complete or the window is full.
+  ///
+  /// \param Flush Merge the next pulse even if it is not complete, e.g. when
+  /// no more messages will arrive.
+  /// \return True if a pulse was merged; see pulseTime(), timeOfFlight() and
+  /// detectorId().
+  bool next(bool Flush = false);
+
+  /// \brief Pulse time of the pulse merged by the last next().
+  std::uint64_t pulseTime() const { return PulseTime; }
+
+  /// \brief Time of flight of the events merged by the last next().
+  ArrayAdapter<const std::uint32_t> timeOfFlight() const {
+    return {TimeOfFlightBuffer.data(), TimeOfFlightBuffer.size()};
+  }
+
+  /// \brief Detector IDs of the events merged by the last next().
+  ArrayAdapter<const std::uint32_t> detectorId() const {
+    return {DetectorIdBuffer.data(), DetectorIdBuffer.size()};
+  }
+
+  /// \brief Number of merged pulses that were not later than all pulses
+  /// merged before them.
+  size_t latePulses() const { return LatePulses; }
+
+private:
+  struct Pulse {
+    std::uint64_t PulseTime;
+    std::vector<std::uint32_t> TimeOfFlight;
+    std::vector<std::uint32_t> DetectorId;
+  };
+  std::vector<std::string> Sources;
+  std::unordered_map<std::string, size_t> SourceIndices;
+  std::vector<std::deque<Pulse>> Pending; // Per source, earliest first
+  size_t Window{1};
+  std::uint64_t PulseTime{0};
+  std::uint64_t LatestPulseTime{0};
+  bool HasMerged{false};
+  size_t LatePulses{0};
+  std::vector<std::uint32_t> TimeOfFlightBuffer;
+  std::vector<std::uint32_t> DetectorIdBuffer;
+};
+
+} // namespace ev42
+} // namespace WriterModule
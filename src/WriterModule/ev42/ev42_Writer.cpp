@@ -10,6 +10,7 @@
 #include <ev42_events_generated.h>
 
 #include "HDFFile.h"
+#include "WriterModuleConfig.h"
 #include "WriterRegistrar.h"
 #include "ev42_Writer.h"
 #include "helper.h"
@@ -37,44 +38,145 @@ struct append_ret {
   explicit operator bool() const { return status == 0; }
 };
 
-void ev42_Writer::parse_config(std::string const &ConfigurationStream) {
-  auto ConfigurationStreamJson = json::parse(ConfigurationStream);
+ev42_Writer::~ev42_Writer() {
   try {
-    EventIndexInterval =
-        ConfigurationStreamJson["nexus"]["indices"]["index_every_kb"]
-            .get<uint64_t>() *
-        1024;
-    Logger->trace("Event index interval: {}", EventIndexInterval);
-  } catch (...) { /* it's ok if not found */
+    writeMergedPulses(true);
+  } catch (std::exception const &E) {
+    Logger->error("Unable to write the merged events of \"{}\": {}",
+                  SourceName, E.what());
   }
-  try {
-    EventIndexInterval =
-        ConfigurationStreamJson["nexus"]["indices"]["index_every_mb"]
-            .get<uint64_t>() *
-        1024 * 1024;
-    Logger->trace("Event index interval: {}", EventIndexInterval);
-  } catch (...) { /* it's ok if not found */
+}
+
+void ev42_Writer::parse_config(std::string const &ConfigurationStream) {
+  auto ParsedConfig = parseConfig(ConfigurationStream);
+  if (not ParsedConfig) {
+    Logger->error("ev42 configuration is not valid JSON, using the defaults.");
+    return;
   }
-  try {
-    ChunkSizeBytes =
-        ConfigurationStreamJson["nexus"]["chunk"]["chunk_kb"].get<uint64_t>() *
-        1024;
-    Logger->trace("chunk_bytes: {}", ChunkSizeBytes);
-  } catch (...) { /* it's ok if not found */
+  auto const &ConfigurationStreamJson = *ParsedConfig;
+  auto setChunkSize = [this](uint64_t Bytes) {
+    ChunkSizeBytes = Bytes;
+    ChunkSizeConfigured = true;
+  };
+  std::vector<std::string> MergeSources;
+  size_t MergeWindow = 16;
+  auto setMergeSources = [this, &MergeSources](json const &Sources) {
+    for (auto const &Source : Sources) {
+      if (Source.is_string()) {
+        MergeSources.push_back(Source.get<std::string>());
+      } else {
+        Logger->error("ev42 configuration: The sources to merge should be "
+                      "strings, not {}.",
+                      Source.dump());
+      }
+    }
+  };
+  std::vector<BankDefinition> BankDefinitions;
+  auto addBanks = [this, &BankDefinitions](json const &Banks) {
+    if (not Banks.is_array()) {
+      Logger->error("ev42 configuration: The detector banks should be an "
+                    "array, not {}.",
+                    Banks.dump());
+      return;
+    }
+    for (auto const &Bank : Banks) {
+      std::optional<std::string> Name;
+      std::optional<uint32_t> Min;
+      std::optional<uint32_t> Max;
+      ConfigSchema BankSchema;
+      BankSchema.add({"name"}, Name)
+          .add({"detector_id_min"}, Min)
+          .add({"detector_id_max"}, Max);
+      for (auto const &Error : BankSchema.apply(Bank)) {
+        Logger->error("ev42 configuration: {}", Error);
+      }
+      if (not(Name and Min and Max)) {
+        Logger->error("ev42 configuration: Ignoring the detector bank {}, "
+                      "which needs a name, detector_id_min and "
+                      "detector_id_max.",
+                      Bank.dump());
+        continue;
+      }
+      BankDefinitions.push_back({*Name, *Min, *Max});
+    }
+  };
+  std::optional<json> FilterConfig;
+  ConfigSchema Schema;
+  Schema
+      .add<uint64_t>({"nexus", "indices", "index_every_kb"},
+                     [this](uint64_t KiB) { EventIndexInterval = KiB * 1024; })
+      .add<uint64_t>(
+          {"nexus", "indices", "index_every_mb"},
+          [this](uint64_t MiB) { EventIndexInterval = MiB * 1024 * 1024; })
+      .add<uint64_t>(
+          {"nexus", "chunk", "chunk_kb"},
+          [&setChunkSize](uint64_t KiB) { setChunkSize(KiB * 1024); })
+      .add<uint64_t>(
+          {"nexus", "chunk", "chunk_mb"},
+          [&setChunkSize](uint64_t MiB) { setChunkSize(MiB * 1024 * 1024); })
+      .add({"adc_pulse_debug"}, RecordAdcPulseDebugData)
+      .add({"directory_store", "enabled"}, UseDirectoryStore)
+      .add({"directory_store", "threads"}, DirectoryStoreThreads)
+      .add({"directory_store", "compression_level"}, DirectoryStoreCompression)
+      .add({"source"}, SourceName)
+      .add<json>({"merge", "sources"}, setMergeSources)
+      .add({"merge", "window"}, MergeWindow)
+      .add<json>({"banks"}, addBanks)
+      .add({"event_filter"}, FilterConfig);
+  for (auto const &Error : Schema.apply(ConfigurationStreamJson)) {
+    Logger->error("ev42 configuration: {}", Error);
   }
-  try {
-    ChunkSizeBytes =
-        ConfigurationStreamJson["nexus"]["chunk"]["chunk_mb"].get<uint64_t>() *
-        1024 * 1024;
-    Logger->trace("chunk_bytes: {}", ChunkSizeBytes);
-  } catch (...) { /* it's ok if not found */
+  Logger->trace("Event index interval: {}  chunk_bytes: {}  "
+                "adc_pulse_debug: {}",
+                EventIndexInterval, ChunkSizeBytes, RecordAdcPulseDebugData);
+  if (not BankDefinitions.empty()) {
+    Banks = EventBanks(std::move(BankDefinitions));
+    for (auto const &Error : Banks.errors()) {
+      Logger->error("ev42 configuration: {}", Error);
+    }
+    Logger->trace("Splitting events into {} detector banks", Banks.size());
   }
-  try {
-    RecordAdcPulseDebugData =
-        ConfigurationStreamJson["adc_pulse_debug"].get<bool>();
-    Logger->trace("adc_pulse_debug: {}", RecordAdcPulseDebugData);
-  } catch (...) { /* it's ok if not found */
+  if (FilterConfig) {
+    Filter = EventFilter(*FilterConfig);
+    for (auto const &Error : Filter.errors()) {
+      Logger->error("ev42 configuration of event_filter: {}", Error);
+    }
+    Logger->trace("event_filter enabled: {}", Filter.isEnabled());
+  }
+  if (not MergeSources.empty()) {
+    MergeSources.insert(MergeSources.begin(), SourceName);
+    Merger = EventMerger(std::move(MergeSources), MergeWindow);
+    Logger->trace("Merging the events of {} sources", Merger.sources().size());
+  }
+  if (RecordAdcPulseDebugData and
+      (not Banks.empty() or Filter.isEnabled() or Merger.isEnabled())) {
+    Logger->warn("ADC pulse debug data can not be split into detector "
+                 "banks, filtered or merged and will not be written.");
+    RecordAdcPulseDebugData = false;
+  }
+}
+
+std::vector<std::string> ev42_Writer::mergedSources() const {
+  std::vector<std::string> Result;
+  for (auto const &Name : Merger.sources()) {
+    if (Name != SourceName) {
+      Result.push_back(Name);
+    }
   }
+  return Result;
+}
+
+void ev42_Writer::useSourceProfile(FileWriter::SourceProfile const &Profile) {
+  if (ChunkSizeConfigured) {
+    return;
+  }
+  // Time of flight and detector id take up 4 bytes each per event in the
+  // message and in the file, i.e. each of the two large datasets grows by
+  // about half of the message byte rate. Aim for a couple of seconds of data
+  // per chunk.
+  ChunkSizeBytes = FileWriter::chunkSizeForRate(Profile.byteRate() / 2, 2.0,
+                                                1 << 16, 1 << 22);
+  Logger->trace("chunk_bytes from source profile: {}", ChunkSizeBytes);
 }
 
 void ev42_Writer::createAdcDatasets(hdf5::node::Group &HDFGroup) const {
@@ -108,43 +210,93 @@ void ev42_Writer::createAdcDatasets(hdf5::node::Group &HDFGroup) const {
       ChunkSizeFor64BitTypes);    // NOLINT(bugprone-unused-raii)
 }
 
-WriterModule::InitResult
-ev42_Writer::init_hdf(hdf5::node::Group &HDFGroup,
-                      std::string const &HDFAttributes) {
+/// \brief The path of the directory store of a dataset, relative to the
+/// directory of the file: `<file name>.chunks/<group path>/<dataset name>`.
+static std::string directoryStorePath(hdf5::node::Group const &HDFGroup,
+                                      std::string const &DatasetName) {
+  auto FileName = fs::path(HDFGroup.link().file().path().string()).filename();
+  auto GroupPath = static_cast<std::string>(HDFGroup.link().path());
+  return (fs::path(FileName.string() + ".chunks") /
+          fs::path(GroupPath).relative_path() / DatasetName)
+      .string();
+}
+
+static std::unique_ptr<NeXusDataset::DirectoryStore<uint32_t>>
+openDirectoryStore(hdf5::node::Dataset &Dataset, size_t ChunkSize,
+                   size_t NrOfThreads, int CompressionLevel) {
+  std::string RelativePath;
+  Dataset.attributes[NeXusDataset::DirectoryStoreAttribute].read(RelativePath);
+  auto FilePath = fs::path(Dataset.link().file().path().string());
+  std::shared_ptr<NeXusDataset::ChunkWriterPool> Writers;
+  if (NrOfThreads > 0) {
+    Writers = NeXusDataset::ChunkWriterPool::shared(NrOfThreads);
+  }
+  return std::make_unique<NeXusDataset::DirectoryStore<uint32_t>>(
+      FilePath.parent_path() / RelativePath, ChunkSize, Writers,
+      CompressionLevel);
+}
+
+void ev42_Writer::createEventDatasets(hdf5::node::Group &HDFGroup) const {
   auto Create = NeXusDataset::Mode::Create;
   size_t Chunk32Bit = ChunkSizeBytes / 4;
   size_t Chunk64Bit = ChunkSizeBytes / 8;
-  try {
 
-    NeXusDataset::EventTimeOffset( // NOLINT(bugprone-unused-raii)
-        HDFGroup,                  // NOLINT(bugprone-unused-raii)
-        Create,                    // NOLINT(bugprone-unused-raii)
-        Chunk32Bit);               // NOLINT(bugprone-unused-raii)
+  NeXusDataset::EventTimeOffset EventTimeOffset(HDFGroup, Create, Chunk32Bit);
+  NeXusDataset::EventId EventId(HDFGroup, Create, Chunk32Bit);
+  if (UseDirectoryStore) {
+    // The data is written elsewhere; the datasets tell readers where.
+    auto addStorePath = [&HDFGroup](hdf5::node::Dataset &Dataset,
+                                    std::string const &Name) {
+      Dataset.attributes
+          .create<std::string>(NeXusDataset::DirectoryStoreAttribute)
+          .write(directoryStorePath(HDFGroup, Name));
+    };
+    addStorePath(EventTimeOffset, "event_time_offset");
+    addStorePath(EventId, "event_id");
+  }
 
-    NeXusDataset::EventId( // NOLINT(bugprone-unused-raii)
-        HDFGroup,          // NOLINT(bugprone-unused-raii)
-        Create,            // NOLINT(bugprone-unused-raii)
-        Chunk32Bit);       // NOLINT(bugprone-unused-raii)
+  NeXusDataset::EventTimeZero( // NOLINT(bugprone-unused-raii)
+      HDFGroup,                // NOLINT(bugprone-unused-raii)
+      Create,                  // NOLINT(bugprone-unused-raii)
+      Chunk64Bit);             // NOLINT(bugprone-unused-raii)
 
-    NeXusDataset::EventTimeZero( // NOLINT(bugprone-unused-raii)
-        HDFGroup,                // NOLINT(bugprone-unused-raii)
-        Create,                  // NOLINT(bugprone-unused-raii)
-        Chunk64Bit);             // NOLINT(bugprone-unused-raii)
+  NeXusDataset::EventIndex( // NOLINT(bugprone-unused-raii)
+      HDFGroup,             // NOLINT(bugprone-unused-raii)
+      Create,               // NOLINT(bugprone-unused-raii)
+      Chunk32Bit);          // NOLINT(bugprone-unused-raii)
 
-    NeXusDataset::EventIndex( // NOLINT(bugprone-unused-raii)
-        HDFGroup,             // NOLINT(bugprone-unused-raii)
-        Create,               // NOLINT(bugprone-unused-raii)
-        Chunk32Bit);          // NOLINT(bugprone-unused-raii)
+  NeXusDataset::CueIndex( // NOLINT(bugprone-unused-raii)
+      HDFGroup,           // NOLINT(bugprone-unused-raii)
+      Create,             // NOLINT(bugprone-unused-raii)
+      Chunk32Bit);        // NOLINT(bugprone-unused-raii)
 
-    NeXusDataset::CueIndex( // NOLINT(bugprone-unused-raii)
-        HDFGroup,           // NOLINT(bugprone-unused-raii)
-        Create,             // NOLINT(bugprone-unused-raii)
-        Chunk32Bit);        // NOLINT(bugprone-unused-raii)
+  NeXusDataset::CueTimestampZero( // NOLINT(bugprone-unused-raii)
+      HDFGroup,                   // NOLINT(bugprone-unused-raii)
+      Create,                     // NOLINT(bugprone-unused-raii)
+      Chunk64Bit);                // NOLINT(bugprone-unused-raii)
+}
+
+WriterModule::InitResult
+ev42_Writer::init_hdf(hdf5::node::Group &HDFGroup,
+                      std::string const &HDFAttributes) {
+  try {
+    if (Banks.empty()) {
+      createEventDatasets(HDFGroup);
+    }
+    for (size_t i = 0; i < Banks.size(); ++i) {
+      auto BankGroup = HDFGroup.create_group(Banks[i].Name);
+      auto ClassAttribute =
+          BankGroup.attributes.create<std::string>("NX_class");
+      ClassAttribute.write("NXevent_data");
+      createEventDatasets(BankGroup);
+    }
 
-    NeXusDataset::CueTimestampZero( // NOLINT(bugprone-unused-raii)
-        HDFGroup,                   // NOLINT(bugprone-unused-raii)
-        Create,                     // NOLINT(bugprone-unused-raii)
-        Chunk64Bit);                // NOLINT(bugprone-unused-raii)
+    if (Filter.isEnabled()) {
+      NeXusDataset::EventVetoed(      // NOLINT(bugprone-unused-raii)
+          HDFGroup,                   // NOLINT(bugprone-unused-raii)
+          NeXusDataset::Mode::Create, // NOLINT(bugprone-unused-raii)
+          ChunkSizeBytes / 4);        // NOLINT(bugprone-unused-raii)
+    }
 
     if (RecordAdcPulseDebugData) {
       createAdcDatasets(HDFGroup);
@@ -154,7 +306,7 @@ ev42_Writer::init_hdf(hdf5::node::Group &HDFGroup,
       Logger->info("NX_class already specified!");
     } else {
       auto ClassAttribute = HDFGroup.attributes.create<std::string>("NX_class");
-      ClassAttribute.write("NXevent_data");
+      ClassAttribute.write(Banks.empty() ? "NXevent_data" : "NXcollection");
     }
     auto AttributesJson = nlohmann::json::parse(HDFAttributes);
     FileWriter::writeAttributes(HDFGroup, &AttributesJson, Logger);
@@ -167,15 +319,42 @@ ev42_Writer::init_hdf(hdf5::node::Group &HDFGroup,
   return WriterModule::InitResult::OK;
 }
 
-WriterModule::InitResult ev42_Writer::reopen(hdf5::node::Group &HDFGroup) {
+EventDatasets
+ev42_Writer::openEventDatasets(hdf5::node::Group const &HDFGroup) const {
   auto Open = NeXusDataset::Mode::Open;
+  EventDatasets Datasets;
+  Datasets.EventTimeOffset = NeXusDataset::EventTimeOffset(HDFGroup, Open);
+  Datasets.EventId = NeXusDataset::EventId(HDFGroup, Open);
+  Datasets.EventTimeZero = NeXusDataset::EventTimeZero(HDFGroup, Open);
+  Datasets.EventIndex = NeXusDataset::EventIndex(HDFGroup, Open);
+  Datasets.CueIndex = NeXusDataset::CueIndex(HDFGroup, Open);
+  Datasets.CueTimestampZero = NeXusDataset::CueTimestampZero(HDFGroup, Open);
+  if (Datasets.EventId.attributes.exists(
+          NeXusDataset::DirectoryStoreAttribute)) {
+    Datasets.EventTimeOffsetStore =
+        openDirectoryStore(Datasets.EventTimeOffset, ChunkSizeBytes / 4,
+                           DirectoryStoreThreads, DirectoryStoreCompression);
+    Datasets.EventIdStore =
+        openDirectoryStore(Datasets.EventId, ChunkSizeBytes / 4,
+                           DirectoryStoreThreads, DirectoryStoreCompression);
+  }
+  return Datasets;
+}
+
+WriterModule::InitResult ev42_Writer::reopen(hdf5::node::Group &HDFGroup) {
   try {
-    EventTimeOffset = NeXusDataset::EventTimeOffset(HDFGroup, Open);
-    EventId = NeXusDataset::EventId(HDFGroup, Open);
-    EventTimeZero = NeXusDataset::EventTimeZero(HDFGroup, Open);
-    EventIndex = NeXusDataset::EventIndex(HDFGroup, Open);
-    CueIndex = NeXusDataset::CueIndex(HDFGroup, Open);
-    CueTimestampZero = NeXusDataset::CueTimestampZero(HDFGroup, Open);
+    if (Banks.empty()) {
+      Events = openEventDatasets(HDFGroup);
+    }
+    BankEvents.clear();
+    for (size_t i = 0; i < Banks.size(); ++i) {
+      BankEvents.push_back(
+          openEventDatasets(HDFGroup.get_group(Banks[i].Name)));
+    }
+    if (Filter.isEnabled()) {
+      EventVetoed =
+          NeXusDataset::EventVetoed(HDFGroup, NeXusDataset::Mode::Open);
+    }
     if (RecordAdcPulseDebugData) {
       reopenAdcDatasets(HDFGroup);
     }
@@ -200,32 +379,114 @@ void ev42_Writer::reopenAdcDatasets(const hdf5::node::Group &HDFGroup) {
 
 void ev42_Writer::write(FlatbufferMessage const &Message) {
   auto EventMsgFlatbuffer = GetEventMessage(Message.data());
-  EventTimeOffset.appendArray(
-      getFBVectorAsArrayAdapter(EventMsgFlatbuffer->time_of_flight()));
-  EventId.appendArray(
-      getFBVectorAsArrayAdapter(EventMsgFlatbuffer->detector_id()));
   if (EventMsgFlatbuffer->time_of_flight()->size() !=
       EventMsgFlatbuffer->detector_id()->size()) {
     Logger->warn("written data lengths differ");
   }
-  auto CurrentRefTime = EventMsgFlatbuffer->pulse_time();
-  auto CurrentNumberOfEvents = EventMsgFlatbuffer->detector_id()->size();
-  EventTimeZero.appendElement(CurrentRefTime);
-  EventIndex.appendElement(EventsWritten);
-  EventsWritten += CurrentNumberOfEvents;
-  if (EventsWritten > LastEventIndex + EventIndexInterval) {
-    auto LastRefTimeOffset = EventMsgFlatbuffer->time_of_flight()->operator[](
-        CurrentNumberOfEvents - 1);
-    CueTimestampZero.appendElement(CurrentRefTime + LastRefTimeOffset);
-    CueIndex.appendElement(EventsWritten - 1);
-    LastEventIndex = EventsWritten - 1;
+  auto TimeOfFlight =
+      getFBVectorAsArrayAdapter(EventMsgFlatbuffer->time_of_flight());
+  auto DetectorId =
+      getFBVectorAsArrayAdapter(EventMsgFlatbuffer->detector_id());
+  auto PulseTime = EventMsgFlatbuffer->pulse_time();
+  if (Merger.isEnabled()) {
+    Merger.add(Message.getSourceName(), PulseTime, TimeOfFlight, DetectorId);
+    writeMergedPulses(false);
+    return;
   }
+  writeEvents(TimeOfFlight, DetectorId, PulseTime);
 
   if (RecordAdcPulseDebugData) {
     writeAdcPulseData(Message);
   }
 }
 
+void ev42_Writer::flush() {
+  auto updateMetadata = [](EventDatasets &Datasets) {
+    if (Datasets.EventIdStore) {
+      Datasets.EventTimeOffsetStore->updateMetadata();
+      Datasets.EventIdStore->updateMetadata();
+    }
+  };
+  updateMetadata(Events);
+  for (auto &Datasets : BankEvents) {
+    updateMetadata(Datasets);
+  }
+}
+
+void ev42_Writer::writeEvents(ArrayAdapter<const uint32_t> TimeOfFlight,
+                              ArrayAdapter<const uint32_t> DetectorId,
+                              uint64_t PulseTime) {
+  if (Filter.isEnabled()) {
+    Filter.apply(TimeOfFlight, DetectorId);
+    TimeOfFlight = Filter.timeOfFlight();
+    DetectorId = Filter.detectorId();
+    // Written with the index entry of the pulse and updated in place if
+    // the pulse continues in the next message.
+    if (VetoedPulseTime != PulseTime) {
+      PulseVetoed = Filter.vetoed();
+      EventVetoed.appendElement(PulseVetoed);
+      VetoedPulseTime = PulseTime;
+    } else {
+      PulseVetoed += Filter.vetoed();
+      EventVetoed.replaceLastElement(PulseVetoed);
+    }
+  }
+  if (Banks.empty()) {
+    appendEvents(Events, TimeOfFlight, DetectorId, PulseTime);
+  } else {
+    Banks.split(TimeOfFlight, DetectorId);
+    for (size_t i = 0; i < Banks.size(); ++i) {
+      appendEvents(BankEvents[i], Banks.timeOfFlight(i), Banks.detectorId(i),
+                   PulseTime);
+    }
+  }
+}
+
+void ev42_Writer::writeMergedPulses(bool Flush) {
+  while (Merger.next(Flush)) {
+    writeEvents(Merger.timeOfFlight(), Merger.detectorId(),
+                Merger.pulseTime());
+  }
+  if (Merger.latePulses() > ReportedLatePulses) {
+    if (ReportedLatePulses == 0) {
+      Logger->warn("Events of \"{}\" arrived after the merge window had "
+                   "passed their pulse and were written out of order.",
+                   SourceName);
+    }
+    ReportedLatePulses = Merger.latePulses();
+  }
+}
+
+void ev42_Writer::appendEvents(EventDatasets &Datasets,
+                               ArrayAdapter<const uint32_t> TimeOfFlight,
+                               ArrayAdapter<const uint32_t> DetectorId,
+                               uint64_t PulseTime) {
+  if (Datasets.EventIdStore) {
+    Datasets.EventTimeOffsetStore->appendArray(TimeOfFlight);
+    Datasets.EventIdStore->appendArray(DetectorId);
+  } else {
+    Datasets.EventTimeOffset.appendArray(TimeOfFlight);
+    Datasets.EventId.appendArray(DetectorId);
+  }
+  auto CurrentNumberOfEvents = DetectorId.size();
+  // The events of a pulse may be split over several consecutive messages. As
+  // they follow each other in the event datasets, they share the index entry
+  // written for the first of them.
+  if (Datasets.LastPulseTime != PulseTime) {
+    Datasets.EventTimeZero.appendElement(PulseTime);
+    Datasets.EventIndex.appendElement(Datasets.EventsWritten);
+    Datasets.LastPulseTime = PulseTime;
+  }
+  Datasets.EventsWritten += CurrentNumberOfEvents;
+  if (CurrentNumberOfEvents > 0 and
+      Datasets.EventsWritten > Datasets.LastEventIndex + EventIndexInterval) {
+    auto LastRefTimeOffset = TimeOfFlight.data()[CurrentNumberOfEvents - 1];
+    Datasets.CueTimestampZero.appendElement(PulseTime + LastRefTimeOffset);
+    Datasets.CueIndex.appendElement(Datasets.EventsWritten - 1);
+    Datasets.LastEventIndex = Datasets.EventsWritten - 1;
+  }
+}
+
 void ev42_Writer::writeAdcPulseData(FlatbufferMessage const &Message) {
   auto EventMsgFlatbuffer = GetEventMessage(Message.data());
   if (EventMsgFlatbuffer->facility_specific_data_type() !=
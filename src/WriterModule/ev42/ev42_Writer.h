@@ -7,39 +7,95 @@
 //
 // Screaming Udder!                              https://esss.se
 
+#include "EventBanks.h"
+#include "EventFilter.h"
+#include "EventMerger.h"
 #include "FlatbufferMessage.h"
 #include "NeXusDataset/AdcDatasets.h"
+#include "NeXusDataset/DirectoryStore.h"
 #include "NeXusDataset/NeXusDataset.h"
 #include "WriterModuleBase.h"
+#include <optional>
 
 namespace WriterModule {
 namespace ev42 {
 
 using FlatbufferMessage = FileWriter::FlatbufferMessage;
 
+/// \brief The datasets of an NXevent_data group.
+struct EventDatasets {
+  NeXusDataset::EventTimeOffset EventTimeOffset;
+  NeXusDataset::EventId EventId;
+  NeXusDataset::EventTimeZero EventTimeZero;
+  NeXusDataset::EventIndex EventIndex;
+  NeXusDataset::CueIndex CueIndex;
+  NeXusDataset::CueTimestampZero CueTimestampZero;
+  uint64_t EventsWritten = 0;
+  uint64_t LastEventIndex = 0;
+  /// Pulse time of the last entry in event_time_zero.
+  std::optional<uint64_t> LastPulseTime;
+  /// Set if event_time_offset and event_id are written to directory stores
+  /// instead of to the (then empty) HDF5 datasets.
+  std::unique_ptr<NeXusDataset::DirectoryStore<uint32_t>> EventTimeOffsetStore;
+  std::unique_ptr<NeXusDataset::DirectoryStore<uint32_t>> EventIdStore;
+};
+
 class ev42_Writer : public WriterModule::Base {
 public:
   ev42_Writer() : WriterModule::Base(true) {}
+  /// Writes the pulses still buffered for merging.
+  ~ev42_Writer() override;
   void parse_config(std::string const &ConfigurationStream) override;
+  std::vector<std::string> mergedSources() const override;
+  void useSourceProfile(FileWriter::SourceProfile const &Profile) override;
   InitResult init_hdf(hdf5::node::Group &HDFGroup,
                       std::string const &HDFAttributes) override;
   WriterModule::InitResult reopen(hdf5::node::Group &HDFGroup) override;
   void write(FlatbufferMessage const &Message) override;
+  /// Updates the metadata of the directory stores, if used.
+  void flush() override;
 
-  NeXusDataset::EventTimeOffset EventTimeOffset;
-  NeXusDataset::EventId EventId;
-  NeXusDataset::EventTimeZero EventTimeZero;
-  NeXusDataset::EventIndex EventIndex;
-  NeXusDataset::CueIndex CueIndex;
-  NeXusDataset::CueTimestampZero CueTimestampZero;
+  EventDatasets Events;
+  /// If detector banks are configured, the events are written to one
+  /// NXevent_data sub-group per bank instead of to Events.
+  EventBanks Banks;
+  std::vector<EventDatasets> BankEvents;
+  /// Applied before the events are split into banks.
+  EventFilter Filter;
+  /// If other sources are merged into this stream, the events are written
+  /// per merged pulse instead of per message.
+  EventMerger Merger;
+  NeXusDataset::EventVetoed EventVetoed;
   hsize_t ChunkSizeBytes = 1 << 16;
-  uint64_t EventsWritten = 0;
-  uint64_t LastEventIndex = 0;
+  bool ChunkSizeConfigured = false;
   uint64_t EventIndexInterval = std::numeric_limits<uint64_t>::max();
+  /// Write event_time_offset and event_id to directory stores next to the
+  /// file, from a pool of at least DirectoryStoreThreads threads shared by
+  /// all stores, or from the writer thread if 0.
+  bool UseDirectoryStore = false;
+  size_t DirectoryStoreThreads = 4;
+  /// zlib compression level of the chunks of the directory stores, 0 for
+  /// none.
+  int DirectoryStoreCompression = 0;
 
 private:
+  void createEventDatasets(hdf5::node::Group &HDFGroup) const;
+  EventDatasets openEventDatasets(hdf5::node::Group const &HDFGroup) const;
+  void writeEvents(ArrayAdapter<const uint32_t> TimeOfFlight,
+                   ArrayAdapter<const uint32_t> DetectorId, uint64_t PulseTime);
+  void writeMergedPulses(bool Flush);
+  void appendEvents(EventDatasets &Datasets,
+                    ArrayAdapter<const uint32_t> TimeOfFlight,
+                    ArrayAdapter<const uint32_t> DetectorId,
+                    uint64_t PulseTime);
   void createAdcDatasets(hdf5::node::Group &HDFGroup) const;
   bool RecordAdcPulseDebugData = false;
+  std::string SourceName;
+  size_t ReportedLatePulses = 0;
+  /// The number of vetoed events of the last pulse, the last entry of
+  /// event_vetoed.
+  uint32_t PulseVetoed = 0;
+  std::optional<uint64_t> VetoedPulseTime;
   NeXusDataset::Amplitude AmplitudeDataset;
   NeXusDataset::PeakArea PeakAreaDataset;
   NeXusDataset::Background BackgroundDataset;
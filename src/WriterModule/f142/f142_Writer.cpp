@@ -8,11 +8,14 @@
 // Screaming Udder!                              https://esss.se
 
 #include "f142_Writer.h"
+#include "WriterModuleConfig.h"
 #include "WriterRegistrar.h"
 #include "json.h"
+#include <H5Fpublic.h>
 #include <algorithm>
 #include <cctype>
 #include <f142_logdata_generated.h>
+#include <fmt/format.h>
 
 namespace WriterModule {
 namespace f142 {
@@ -28,48 +31,66 @@ std::string f142_Writer::findDataType(nlohmann::basic_json<> const &Attribute) {
     return InString;
   };
 
-  if (Attribute.find("type") != Attribute.end()) {
-    return toLower(Attribute.find("type").value().get<std::string>());
-  }
-  if (Attribute.find("dtype") != Attribute.end()) {
-    return toLower(Attribute.find("dtype").value().get<std::string>());
+  for (auto const &Key : {"type", "dtype"}) {
+    auto Value = Attribute.find(Key);
+    if (Value != Attribute.end() and Value->is_string()) {
+      return toLower(Value->get<std::string>());
+    }
   }
   Logger->warn("Unable to find data type in JSON structure, using the default "
                "(double).");
   return "double";
 }
 
-template <typename Type>
-void makeIt(hdf5::node::Group const &Parent, hdf5::Dimensions const &Shape,
-            hdf5::Dimensions const &ChunkSize) {
-  NeXusDataset::MultiDimDataset<Type>( // NOLINT(bugprone-unused-raii)
-      Parent, NeXusDataset::Mode::Create, Shape,
-      ChunkSize); // NOLINT(bugprone-unused-raii)
+/// \brief Call \p Func with a value of the C++ type that corresponds to
+/// \p ElementType.
+///
+/// Used to instantiate the typed value dataset once, when the HDF structure is
+/// created or reopened.
+template <typename FuncType>
+auto withElementType(Type ElementType, FuncType &&Func) {
+  switch (ElementType) {
+  case Type::int8:
+    return Func(std::int8_t());
+  case Type::uint8:
+    return Func(std::uint8_t());
+  case Type::int16:
+    return Func(std::int16_t());
+  case Type::uint16:
+    return Func(std::uint16_t());
+  case Type::int32:
+    return Func(std::int32_t());
+  case Type::uint32:
+    return Func(std::uint32_t());
+  case Type::int64:
+    return Func(std::int64_t());
+  case Type::uint64:
+    return Func(std::uint64_t());
+  case Type::float32:
+    return Func(float());
+  case Type::float64:
+  default:
+    return Func(double());
+  }
 }
 
 void initValueDataset(hdf5::node::Group &Parent, Type ElementType,
+                      f142_Writer::ArrayLayout Layout,
                       hdf5::Dimensions const &Shape,
                       hdf5::Dimensions const &ChunkSize,
                       std::optional<std::string> const &ValueUnits) {
-  using OpenFuncType = std::function<void()>;
-  std::map<Type, OpenFuncType> CreateValuesMap{
-      {Type::int8, [&]() { makeIt<std::int8_t>(Parent, Shape, ChunkSize); }},
-      {Type::uint8, [&]() { makeIt<std::uint8_t>(Parent, Shape, ChunkSize); }},
-      {Type::int16, [&]() { makeIt<std::int16_t>(Parent, Shape, ChunkSize); }},
-      {Type::uint16,
-       [&]() { makeIt<std::uint16_t>(Parent, Shape, ChunkSize); }},
-      {Type::int32, [&]() { makeIt<std::int32_t>(Parent, Shape, ChunkSize); }},
-      {Type::uint32,
-       [&]() { makeIt<std::uint32_t>(Parent, Shape, ChunkSize); }},
-      {Type::int64, [&]() { makeIt<std::int64_t>(Parent, Shape, ChunkSize); }},
-      {Type::uint64,
-       [&]() { makeIt<std::uint64_t>(Parent, Shape, ChunkSize); }},
-      {Type::float32,
-       [&]() { makeIt<std::float_t>(Parent, Shape, ChunkSize); }},
-      {Type::float64,
-       [&]() { makeIt<std::double_t>(Parent, Shape, ChunkSize); }},
-  };
-  CreateValuesMap.at(ElementType)();
+  withElementType(ElementType, [&](auto Value) {
+    using DataType = decltype(Value);
+    if (Layout == f142_Writer::ArrayLayout::Ragged) {
+      NeXusDataset::ExtensibleDataset<DataType>( // NOLINT(bugprone-unused-raii)
+          Parent, "value", NeXusDataset::Mode::Create,
+          ChunkSize[0] * ChunkSize[1]); // NOLINT(bugprone-unused-raii)
+    } else {
+      NeXusDataset::MultiDimDataset<DataType>( // NOLINT(bugprone-unused-raii)
+          Parent, NeXusDataset::Mode::Create, Shape,
+          ChunkSize); // NOLINT(bugprone-unused-raii)
+    }
+  });
 
   if (ValueUnits) {
     Parent["value"].attributes.create_from<std::string>("units", *ValueUnits);
@@ -78,9 +99,14 @@ void initValueDataset(hdf5::node::Group &Parent, Type ElementType,
 
 /// Parse the configuration for this stream.
 void f142_Writer::parse_config(std::string const &ConfigurationStream) {
-  auto ConfigurationStreamJson = json::parse(ConfigurationStream);
+  auto ParsedConfig = parseConfig(ConfigurationStream);
+  if (not ParsedConfig) {
+    Logger->error("f142 configuration is not valid JSON, using the defaults.");
+    return;
+  }
+  auto const &ConfigurationStreamJson = *ParsedConfig;
 
-  std::map<std::string, Type> TypeMap{
+  static std::map<std::string, Type> const TypeMap{
       {"int8", Type::int8},       {"uint8", Type::uint8},
       {"int16", Type::int16},     {"uint16", Type::uint16},
       {"int32", Type::int32},     {"uint32", Type::uint32},
@@ -89,32 +115,54 @@ void f142_Writer::parse_config(std::string const &ConfigurationStream) {
       {"float", Type::float32},   {"double", Type::float64},
       {"short", Type::int16},     {"int", Type::int32},
       {"long", Type::int64}};
+  static std::map<std::string, ArrayLayout> const LayoutMap{
+      {"padded", ArrayLayout::Padded}, {"ragged", ArrayLayout::Ragged}};
 
-  try {
-    ElementType = TypeMap.at(findDataType(ConfigurationStreamJson));
-  } catch (std::out_of_range &E) {
+  auto DataType = findDataType(ConfigurationStreamJson);
+  if (auto TypeIt = TypeMap.find(DataType); TypeIt != TypeMap.end()) {
+    ElementType = TypeIt->second;
+  } else {
     Logger->warn("Unknown data type with name \"{}\". Using double.",
-                 findDataType(ConfigurationStreamJson));
+                 DataType);
   }
 
-  if (auto ArraySizeMaybe =
-          find<uint64_t>("array_size", ConfigurationStreamJson)) {
-    ArraySize = size_t(*ArraySizeMaybe);
+  std::string LayoutName{"padded"};
+  ConfigSchema Schema;
+  Schema.add({"array_size"}, ArraySize)
+      .add({"value_units"}, ValueUnits)
+      .add({"array_layout"}, LayoutName)
+      .add({"nexus.cue_interval"}, ValueIndexInterval)
+      .add({"nexus.buffer_size"}, BufferSize)
+      .add<uint64_t>({"nexus.buffer_max_age_ms"},
+                     [this](uint64_t Age) {
+                       MaxBufferAge = std::chrono::milliseconds(Age);
+                     })
+      .add<uint64_t>({"nexus.chunk_size"}, [this](uint64_t Size) {
+        ChunkSize = Size;
+        ChunkSizeConfigured = true;
+      });
+  for (auto const &Error : Schema.apply(ConfigurationStreamJson)) {
+    Logger->error("f142 configuration: {}", Error);
   }
-
-  ValueUnits = find<std::string>("value_units", ConfigurationStreamJson);
-
-  try {
-    ValueIndexInterval =
-        ConfigurationStreamJson["nexus.cue_interval"].get<uint64_t>();
-    Logger->trace("Value index interval: {}", ValueIndexInterval);
-  } catch (...) { /* it's ok if not found */
+  if (auto LayoutIt = LayoutMap.find(LayoutName); LayoutIt != LayoutMap.end()) {
+    Layout = LayoutIt->second;
+  } else {
+    Logger->error("Unknown array layout \"{}\". Using \"padded\".",
+                  LayoutName);
   }
-  try {
-    ChunkSize = ConfigurationStreamJson["nexus.chunk_size"].get<uint64_t>();
-    Logger->trace("Chunk size: {}", ChunkSize);
-  } catch (...) { /* it's ok if not found */
+  Logger->trace("Value index interval: {}  chunk size: {}", ValueIndexInterval,
+                ChunkSize);
+}
+
+void f142_Writer::useSourceProfile(FileWriter::SourceProfile const &Profile) {
+  if (ChunkSizeConfigured) {
+    return;
   }
+  // Slow process variables are otherwise given the same (large) chunks as
+  // fast ones, which wastes space when there are many of them in a file.
+  ChunkSize = FileWriter::chunkSizeForRate(Profile.messageRate(), 600.0, 64,
+                                           64 * 1024);
+  Logger->trace("Chunk size from source profile: {}", ChunkSize);
 }
 
 /// \brief Implement the writer module interface, forward to the CREATE case
@@ -130,11 +178,16 @@ InitResult f142_Writer::init_hdf(hdf5::node::Group &HDFGroup,
                                    ChunkSize); // NOLINT(bugprone-unused-raii)
     NeXusDataset::CueIndex(HDFGroup, Create,
                            ChunkSize); // NOLINT(bugprone-unused-raii)
-    initValueDataset(HDFGroup, ElementType,
+    initValueDataset(HDFGroup, ElementType, Layout,
                      {
                          ArraySize,
                      },
                      {ChunkSize, ArraySize}, ValueUnits);
+    if (Layout == ArrayLayout::Ragged) {
+      NeXusDataset::ExtensibleDataset<std::uint64_t>(
+          HDFGroup, "value_index", Create,
+          ChunkSize); // NOLINT(bugprone-unused-raii)
+    }
 
     NeXusDataset::AlarmTime(HDFGroup, Create);
     NeXusDataset::AlarmStatus(HDFGroup, Create);
@@ -156,18 +209,22 @@ InitResult f142_Writer::init_hdf(hdf5::node::Group &HDFGroup,
   return InitResult::OK;
 }
 
+void f142_Writer::useDatasetPool(
+    std::shared_ptr<NeXusDataset::DatasetPool> const &SharedPool) {
+  Pool = SharedPool;
+}
+
 /// \brief Implement the writer module interface, forward to the OPEN case of
 /// `init_hdf`.
 InitResult f142_Writer::reopen(hdf5::node::Group &HDFGroup) {
-  auto Open = NeXusDataset::Mode::Open;
   try {
-    Timestamp = NeXusDataset::Time(HDFGroup, Open);
-    CueIndex = NeXusDataset::CueIndex(HDFGroup, Open);
-    CueTimestampZero = NeXusDataset::CueTimestampZero(HDFGroup, Open);
-    Values = NeXusDataset::MultiDimDatasetBase(HDFGroup, Open);
-    AlarmTime = NeXusDataset::AlarmTime(HDFGroup, Open);
-    AlarmStatus = NeXusDataset::AlarmStatus(HDFGroup, Open);
-    AlarmSeverity = NeXusDataset::AlarmSeverity(HDFGroup, Open);
+    if (Pool) {
+      File = HDFGroup.link().file();
+      GroupPath = static_cast<std::string>(HDFGroup.link().path());
+      Pool->use(*this);
+    } else {
+      openDatasets(HDFGroup);
+    }
   } catch (std::exception &E) {
     Logger->error(
         "Failed to reopen datasets in HDF file with error message: \"{}\"",
@@ -177,6 +234,75 @@ InitResult f142_Writer::reopen(hdf5::node::Group &HDFGroup) {
   return InitResult::OK;
 }
 
+size_t f142_Writer::nrOfDatasets() const { return NrOfOpenDatasets; }
+
+void f142_Writer::openDatasets() {
+  auto HDFGroup = hdf5::node::get_group(File.root(), GroupPath);
+  // Counted rather than assumed, as the datasets depend on the layout.
+  auto CountOpenDatasets = [this]() {
+    return H5Fget_obj_count(static_cast<hid_t>(File), H5F_OBJ_DATASET);
+  };
+  auto const OpenBefore = CountOpenDatasets();
+  openDatasets(HDFGroup);
+  auto const Opened = CountOpenDatasets() - OpenBefore;
+  NrOfOpenDatasets = Opened > 0 ? static_cast<size_t>(Opened) : 0;
+}
+
+void f142_Writer::openDatasets(hdf5::node::Group &HDFGroup) {
+  auto Open = NeXusDataset::Mode::Open;
+  Timestamp = NeXusDataset::Time(HDFGroup, Open);
+  CueIndex = NeXusDataset::CueIndex(HDFGroup, Open);
+  CueTimestampZero = NeXusDataset::CueTimestampZero(HDFGroup, Open);
+  if (Layout == ArrayLayout::Ragged) {
+    Ragged =
+        withElementType(ElementType, [&](auto Value) -> RaggedValuesVariant {
+          using DataType = decltype(Value);
+          return RaggedValues<DataType>{
+              NeXusDataset::ExtensibleDataset<DataType>(HDFGroup, "value",
+                                                        Open),
+              {}};
+        });
+    ValueIndex = NeXusDataset::ExtensibleDataset<std::uint64_t>(
+        HDFGroup, "value_index", Open);
+    NrOfValues = HDFGroup.get_dataset("value").dataspace().size();
+  } else {
+    Values = withElementType(ElementType, [&](auto Value) -> ValuesVariant {
+      return NeXusDataset::MultiDimDataset<decltype(Value)>(HDFGroup, Open);
+    });
+  }
+  AlarmTime = NeXusDataset::AlarmTime(HDFGroup, Open);
+  AlarmStatus = NeXusDataset::AlarmStatus(HDFGroup, Open);
+  AlarmSeverity = NeXusDataset::AlarmSeverity(HDFGroup, Open);
+}
+
+void f142_Writer::closeDatasets() {
+  // Nothing is buffered in the ragged value buffers at this point, unless
+  // writing them failed, see writeBufferedMessages().
+  if (not TimestampBuffer.empty()) {
+    Logger->error("Discarding {} f142 updates that could not be written.",
+                  TimestampBuffer.size());
+    TimestampBuffer.clear();
+    ValueIndexBuffer.clear();
+  }
+  Timestamp = NeXusDataset::Time();
+  CueIndex = NeXusDataset::CueIndex();
+  CueTimestampZero = NeXusDataset::CueTimestampZero();
+  Values = ValuesVariant();
+  Ragged = RaggedValuesVariant();
+  ValueIndex = NeXusDataset::ExtensibleDataset<std::uint64_t>();
+  AlarmTime = NeXusDataset::AlarmTime();
+  AlarmStatus = NeXusDataset::AlarmStatus();
+  AlarmSeverity = NeXusDataset::AlarmSeverity();
+}
+
+NeXusDataset::MultiDimDatasetBase &f142_Writer::values() {
+  return std::visit(
+      [](auto &Dataset) -> NeXusDataset::MultiDimDatasetBase & {
+        return Dataset;
+      },
+      Values);
+}
+
 template <typename DataType, class DatasetType>
 void appendData(DatasetType &Dataset, const void *Pointer, size_t Size) {
   Dataset.appendArray(
@@ -198,42 +324,11 @@ void appendScalarData(DatasetType &Dataset, const LogData *LogDataMessage) {
   Dataset.appendArray(ArrayAdapter<const DataType>(&ScalarValue, 1), {1});
 }
 
-std::unordered_map<AlarmStatus, std::string> AlarmStatusToString{
-    {AlarmStatus::NO_ALARM, "NO_ALARM"},
-    {AlarmStatus::WRITE_ACCESS, "WRITE_ACCESS"},
-    {AlarmStatus::READ_ACCESS, "READ_ACCESS"},
-    {AlarmStatus::READ, "READ"},
-    {AlarmStatus::WRITE, "WRITE"},
-    {AlarmStatus::HWLIMIT, "HWLIMIT"},
-    {AlarmStatus::DISABLE, "DISABLE"},
-    {AlarmStatus::BAD_SUB, "BAD_SUB"},
-    {AlarmStatus::TIMED, "TIMED"},
-    {AlarmStatus::SOFT, "SOFT"},
-    {AlarmStatus::SIMM, "SIMM"},
-    {AlarmStatus::LINK, "LINK"},
-    {AlarmStatus::LOW, "LOW"},
-    {AlarmStatus::LOLO, "LOLO"},
-    {AlarmStatus::HIGH, "HIGH"},
-    {AlarmStatus::HIHI, "HIHI"},
-    {AlarmStatus::SCAN, "SCAN"},
-    {AlarmStatus::STATE, "STATE"},
-    {AlarmStatus::COS, "COS"},
-    {AlarmStatus::UDF, "UDF"},
-    {AlarmStatus::CALC, "CALC"},
-    {AlarmStatus::COMM, "COMM"},
-    {AlarmStatus::NO_CHANGE, "NO_CHANGE"}};
-
-std::unordered_map<AlarmSeverity, std::string> AlarmSeverityToString{
-    {AlarmSeverity::NO_ALARM, "NO_ALARM"},
-    {AlarmSeverity::MINOR, "MINOR"},
-    {AlarmSeverity::MAJOR, "MAJOR"},
-    {AlarmSeverity::INVALID, "INVALID"},
-    {AlarmSeverity::NO_CHANGE, "NO_CHANGE"}};
-
-void f142_Writer::write(FlatbufferMessage const &Message) {
-  auto LogDataMessage = GetLogData(Message.data());
+/// \brief Append a value of a type other than the element type of the
+/// dataset, relying on HDF5 for the type conversion.
+void appendConvertedValue(NeXusDataset::MultiDimDatasetBase &Values,
+                          const LogData *LogDataMessage) {
   size_t NrOfElements{1};
-  Timestamp.appendElement(LogDataMessage->timestamp());
   auto Type = LogDataMessage->value_type();
 
   // Note that we are using our knowledge about flatbuffers here to minimise
@@ -322,6 +417,281 @@ void f142_Writer::write(FlatbufferMessage const &Message) {
     throw WriterModule::WriterException(
         "Unknown data type in f142 flatbuffer.");
   }
+}
+
+template <typename DataType> struct FlatbufferValueTypes;
+template <> struct FlatbufferValueTypes<std::int8_t> {
+  using Scalar = Byte;
+  using Array = ArrayByte;
+};
+template <> struct FlatbufferValueTypes<std::uint8_t> {
+  using Scalar = UByte;
+  using Array = ArrayUByte;
+};
+template <> struct FlatbufferValueTypes<std::int16_t> {
+  using Scalar = Short;
+  using Array = ArrayShort;
+};
+template <> struct FlatbufferValueTypes<std::uint16_t> {
+  using Scalar = UShort;
+  using Array = ArrayUShort;
+};
+template <> struct FlatbufferValueTypes<std::int32_t> {
+  using Scalar = Int;
+  using Array = ArrayInt;
+};
+template <> struct FlatbufferValueTypes<std::uint32_t> {
+  using Scalar = UInt;
+  using Array = ArrayUInt;
+};
+template <> struct FlatbufferValueTypes<std::int64_t> {
+  using Scalar = Long;
+  using Array = ArrayLong;
+};
+template <> struct FlatbufferValueTypes<std::uint64_t> {
+  using Scalar = ULong;
+  using Array = ArrayULong;
+};
+template <> struct FlatbufferValueTypes<float> {
+  using Scalar = Float;
+  using Array = ArrayFloat;
+};
+template <> struct FlatbufferValueTypes<double> {
+  using Scalar = Double;
+  using Array = ArrayDouble;
+};
+
+/// \brief Append the value of a message to a dataset of a known type.
+///
+/// Values of the same type as the dataset are appended directly; anything
+/// else goes through the (slower) converting path.
+template <typename DataType>
+void appendValue(NeXusDataset::MultiDimDataset<DataType> &Dataset,
+                 const LogData *LogDataMessage) {
+  using ValueTypes = FlatbufferValueTypes<DataType>;
+  if (auto Scalar = LogDataMessage->value_as<typename ValueTypes::Scalar>()) {
+    DataType const Value = Scalar->value();
+    Dataset.appendTypedArray({&Value, 1}, {1});
+  } else if (auto Array =
+                 LogDataMessage->value_as<typename ValueTypes::Array>()) {
+    auto Elements = Array->value();
+    if (Elements == nullptr) {
+      throw WriterModule::WriterException("Missing array in f142 flatbuffer.");
+    }
+    Dataset.appendTypedArray({Elements->data(), Elements->size()},
+                             {Elements->size()});
+  } else {
+    appendConvertedValue(Dataset, LogDataMessage);
+  }
+}
+
+/// \brief Call \p Func with a pointer to, and the number of, the values of a
+/// message if they are of type \p DataType.
+///
+/// \return True if the values are of type \p DataType.
+template <typename DataType, typename FuncType>
+bool visitValuesOfType(const LogData *LogDataMessage, FuncType &Func) {
+  using ValueTypes = FlatbufferValueTypes<DataType>;
+  if (auto Scalar = LogDataMessage->value_as<typename ValueTypes::Scalar>()) {
+    DataType const Value = Scalar->value();
+    Func(&Value, 1);
+    return true;
+  }
+  if (auto Array = LogDataMessage->value_as<typename ValueTypes::Array>()) {
+    auto Elements = Array->value();
+    if (Elements == nullptr) {
+      throw WriterModule::WriterException("Missing array in f142 flatbuffer.");
+    }
+    Func(Elements->data(), Elements->size());
+    return true;
+  }
+  return false;
+}
+
+/// \brief Call \p Func with a pointer to, and the number of, the values of a
+/// message, whatever their type.
+template <typename FuncType>
+void visitValues(const LogData *LogDataMessage, FuncType &&Func) {
+  if (not(visitValuesOfType<double>(LogDataMessage, Func) or
+          visitValuesOfType<float>(LogDataMessage, Func) or
+          visitValuesOfType<std::int8_t>(LogDataMessage, Func) or
+          visitValuesOfType<std::uint8_t>(LogDataMessage, Func) or
+          visitValuesOfType<std::int16_t>(LogDataMessage, Func) or
+          visitValuesOfType<std::uint16_t>(LogDataMessage, Func) or
+          visitValuesOfType<std::int32_t>(LogDataMessage, Func) or
+          visitValuesOfType<std::uint32_t>(LogDataMessage, Func) or
+          visitValuesOfType<std::int64_t>(LogDataMessage, Func) or
+          visitValuesOfType<std::uint64_t>(LogDataMessage, Func))) {
+    throw WriterModule::WriterException(
+        "Unknown data type in f142 flatbuffer.");
+  }
+}
+
+void f142_Writer::bufferRagged(LogData const *LogDataMessage) {
+  if (TimestampBuffer.empty()) {
+    BufferedSince = std::chrono::steady_clock::now();
+  }
+  std::visit(
+      [this, LogDataMessage](auto &Dataset) {
+        visitValues(LogDataMessage, [&](auto const *Data, size_t Size) {
+          // Values of another type than that of the dataset are converted
+          // here, instead of by HDF5.
+          Dataset.Buffer.insert(Dataset.Buffer.end(), Data, Data + Size);
+          ValueIndexBuffer.push_back(NrOfValues);
+          NrOfValues += Size;
+        });
+        TimestampBuffer.push_back(LogDataMessage->timestamp());
+        if (Dataset.Buffer.size() >= ChunkSize * ArraySize or
+            TimestampBuffer.size() >= ChunkSize or bufferIsTooOld()) {
+          writeRaggedBuffers();
+        }
+      },
+      Ragged);
+}
+
+bool f142_Writer::bufferIsTooOld() const {
+  return std::chrono::steady_clock::now() - BufferedSince >= MaxBufferAge;
+}
+
+void f142_Writer::flush() {
+  if (Pool) {
+    if (not BufferedMessages.empty() and bufferIsTooOld()) {
+      writeBufferedMessages();
+    }
+  } else if (Layout == ArrayLayout::Ragged and not TimestampBuffer.empty() and
+             bufferIsTooOld()) {
+    writeRaggedBuffers();
+  }
+}
+
+void f142_Writer::writeRaggedBuffers() {
+  if (TimestampBuffer.empty()) {
+    return;
+  }
+  std::visit(
+      [](auto &Dataset) {
+        using DataType = typename decltype(Dataset.Buffer)::value_type;
+        if (not Dataset.Buffer.empty()) {
+          Dataset.Dataset.appendArray(ArrayAdapter<const DataType>(
+              Dataset.Buffer.data(), Dataset.Buffer.size()));
+          Dataset.Buffer.clear();
+        }
+      },
+      Ragged);
+  ValueIndex.appendArray(ArrayAdapter<const std::uint64_t>(
+      ValueIndexBuffer.data(), ValueIndexBuffer.size()));
+  ValueIndexBuffer.clear();
+  Timestamp.appendArray(ArrayAdapter<const std::uint64_t>(
+      TimestampBuffer.data(), TimestampBuffer.size()));
+  TimestampBuffer.clear();
+}
+
+f142_Writer::~f142_Writer() {
+  try {
+    if (Pool) {
+      writeBufferedMessages();
+    } else if (Layout == ArrayLayout::Ragged) {
+      writeRaggedBuffers();
+    }
+  } catch (std::exception const &E) {
+    Logger->error("Unable to write the buffered f142 values: {}",
+                  hdf5::error::print_nested(E));
+  }
+  if (Pool) {
+    Pool->remove(*this);
+  }
+}
+
+std::unordered_map<AlarmStatus, std::string> AlarmStatusToString{
+    {AlarmStatus::NO_ALARM, "NO_ALARM"},
+    {AlarmStatus::WRITE_ACCESS, "WRITE_ACCESS"},
+    {AlarmStatus::READ_ACCESS, "READ_ACCESS"},
+    {AlarmStatus::READ, "READ"},
+    {AlarmStatus::WRITE, "WRITE"},
+    {AlarmStatus::HWLIMIT, "HWLIMIT"},
+    {AlarmStatus::DISABLE, "DISABLE"},
+    {AlarmStatus::BAD_SUB, "BAD_SUB"},
+    {AlarmStatus::TIMED, "TIMED"},
+    {AlarmStatus::SOFT, "SOFT"},
+    {AlarmStatus::SIMM, "SIMM"},
+    {AlarmStatus::LINK, "LINK"},
+    {AlarmStatus::LOW, "LOW"},
+    {AlarmStatus::LOLO, "LOLO"},
+    {AlarmStatus::HIGH, "HIGH"},
+    {AlarmStatus::HIHI, "HIHI"},
+    {AlarmStatus::SCAN, "SCAN"},
+    {AlarmStatus::STATE, "STATE"},
+    {AlarmStatus::COS, "COS"},
+    {AlarmStatus::UDF, "UDF"},
+    {AlarmStatus::CALC, "CALC"},
+    {AlarmStatus::COMM, "COMM"},
+    {AlarmStatus::NO_CHANGE, "NO_CHANGE"}};
+
+std::unordered_map<AlarmSeverity, std::string> AlarmSeverityToString{
+    {AlarmSeverity::NO_ALARM, "NO_ALARM"},
+    {AlarmSeverity::MINOR, "MINOR"},
+    {AlarmSeverity::MAJOR, "MAJOR"},
+    {AlarmSeverity::INVALID, "INVALID"},
+    {AlarmSeverity::NO_CHANGE, "NO_CHANGE"}};
+
+void f142_Writer::write(FlatbufferMessage const &Message) {
+  if (not Pool) {
+    writeMessage(Message);
+    return;
+  }
+  // Rarely updated streams then only need their datasets (re)opened once for
+  // many updates.
+  size_t const MaxBufferedBytes{1024 * 1024};
+  if (BufferedMessages.empty()) {
+    BufferedSince = std::chrono::steady_clock::now();
+  }
+  BufferedMessages.push_back(Message);
+  BufferedBytes += Message.size();
+  if (BufferedMessages.size() >= BufferSize or
+      BufferedBytes >= MaxBufferedBytes or bufferIsTooOld()) {
+    writeBufferedMessages();
+  }
+}
+
+void f142_Writer::writeBufferedMessages() {
+  if (BufferedMessages.empty()) {
+    return;
+  }
+  auto Messages = std::move(BufferedMessages);
+  BufferedMessages.clear();
+  BufferedBytes = 0;
+  Pool->use(*this);
+  size_t NrOfErrors{0};
+  for (auto const &Message : Messages) {
+    try {
+      writeMessage(Message);
+    } catch (std::exception const &E) {
+      Logger->debug("Unable to write buffered f142 update: {}", E.what());
+      ++NrOfErrors;
+    }
+  }
+  // Write everything now, as the datasets may be closed before the next
+  // updates arrive, which discards the ragged buffers.
+  if (Layout == ArrayLayout::Ragged) {
+    writeRaggedBuffers();
+  }
+  if (NrOfErrors > 0) {
+    throw WriterModule::WriterException(fmt::format(
+        "{} of {} buffered f142 updates could not be written.", NrOfErrors,
+        Messages.size()));
+  }
+}
+
+void f142_Writer::writeMessage(FlatbufferMessage const &Message) {
+  auto LogDataMessage = GetLogData(Message.data());
+  if (Layout == ArrayLayout::Ragged) {
+    bufferRagged(LogDataMessage);
+  } else {
+    Timestamp.appendElement(LogDataMessage->timestamp());
+    std::visit([LogDataMessage](
+                   auto &Dataset) { appendValue(Dataset, LogDataMessage); },
+               Values);
+  }
 
   // AlarmStatus::NO_CHANGE is not a real EPICS alarm status value, it is used
   // by the Forwarder to indicate that the alarm has not changed from the
@@ -11,6 +11,7 @@
 
 #include "FlatbufferMessage.h"
 #include "WriterModuleBase.h"
+#include <NeXusDataset/DatasetPool.h>
 #include <NeXusDataset/EpicsAlarmDatasets.h>
 #include <NeXusDataset/NeXusDataset.h>
 #include <array>
@@ -18,27 +19,48 @@
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <optional>
+#include <variant>
 #include <vector>
 
+struct LogData;
+
 namespace WriterModule {
 namespace f142 {
 using FlatbufferMessage = FileWriter::FlatbufferMessage;
 
-class f142_Writer : public WriterModule::Base {
+class f142_Writer : public WriterModule::Base,
+                    public NeXusDataset::DatasetPool::Member {
 public:
   /// Implements writer module interface.
   InitResult init_hdf(hdf5::node::Group &HDFGroup,
                       std::string const &HDFAttributes) override;
   /// Implements writer module interface.
   void parse_config(std::string const &ConfigurationStream) override;
+  void useSourceProfile(FileWriter::SourceProfile const &Profile) override;
+  /// \brief Buffer the updates and only keep the datasets open while
+  /// writing the buffered updates, if the pool needs the room.
+  void useDatasetPool(std::shared_ptr<NeXusDataset::DatasetPool> const
+                          &SharedPool) override;
   /// Implements writer module interface.
   WriterModule::InitResult reopen(hdf5::node::Group &HDFGroup) override;
 
   /// Write an incoming message which should contain a flatbuffer.
   void write(FlatbufferMessage const &Message) override;
 
+  /// \brief Write the buffered updates or values if the oldest of them has
+  /// been buffered for longer than the maximum buffer age.
+  void flush() override;
+
   f142_Writer() : WriterModule::Base(false) {}
-  ~f142_Writer() override = default;
+  /// Writes the values that are still buffered.
+  ~f142_Writer() override;
+
+  /// Implements dataset pool member interface.
+  size_t nrOfDatasets() const override;
+  /// Implements dataset pool member interface.
+  void openDatasets() override;
+  /// Implements dataset pool member interface.
+  void closeDatasets() override;
 
   enum class Type {
     int8,
@@ -53,13 +75,110 @@ public:
     float64,
   };
 
+  /// \brief How array values are stored.
+  enum class ArrayLayout {
+    /// Two dimensional "value" dataset with one row per update, padded with
+    /// zeros to the length of the longest array.
+    Padded,
+    /// The values of all updates concatenated in a one dimensional "value"
+    /// dataset, with the position of the first value of every update in
+    /// "value_index".
+    Ragged,
+  };
+
 protected:
   SharedLogger Logger = spdlog::get("filewriterlogger");
   std::string findDataType(nlohmann::basic_json<> const &Attribute);
 
+  void openDatasets(hdf5::node::Group &HDFGroup);
+
+  /// \brief Write a message to the datasets, which must be open.
+  void writeMessage(FlatbufferMessage const &Message);
+
+  /// \brief Write the updates buffered while using a dataset pool.
+  void writeBufferedMessages();
+
+  /// Shared by the writer modules of the file, if the number of open
+  /// datasets is limited.
+  std::shared_ptr<NeXusDataset::DatasetPool> Pool;
+  std::vector<FlatbufferMessage> BufferedMessages;
+  size_t BufferedBytes{0};
+  /// Number of updates buffered before they are written, if using a pool.
+  size_t BufferSize{256};
+  /// Where to reopen the datasets, if using a pool.
+  hdf5::file::File File;
+  std::string GroupPath;
+  /// Number of datasets opened by openDatasets() the last time.
+  size_t NrOfOpenDatasets{0};
+
   Type ElementType{Type::float64};
 
-  NeXusDataset::MultiDimDatasetBase Values;
+  /// The value dataset, typed by the element type of the stream so that
+  /// values of that type are appended without any type dispatch.
+  using ValuesVariant = std::variant<
+      NeXusDataset::MultiDimDataset<double>,
+      NeXusDataset::MultiDimDataset<float>,
+      NeXusDataset::MultiDimDataset<std::int8_t>,
+      NeXusDataset::MultiDimDataset<std::uint8_t>,
+      NeXusDataset::MultiDimDataset<std::int16_t>,
+      NeXusDataset::MultiDimDataset<std::uint16_t>,
+      NeXusDataset::MultiDimDataset<std::int32_t>,
+      NeXusDataset::MultiDimDataset<std::uint32_t>,
+      NeXusDataset::MultiDimDataset<std::int64_t>,
+      NeXusDataset::MultiDimDataset<std::uint64_t>>;
+  ValuesVariant Values;
+
+  /// \brief Type-erased access to the value dataset.
+  NeXusDataset::MultiDimDatasetBase &values();
+
+  ArrayLayout Layout{ArrayLayout::Padded};
+
+  /// \brief The value dataset of the ragged layout and the values that have
+  /// not been written to it yet.
+  template <typename DataType> struct RaggedValues {
+    NeXusDataset::ExtensibleDataset<DataType> Dataset;
+    std::vector<DataType> Buffer;
+  };
+  using RaggedValuesVariant =
+      std::variant<RaggedValues<double>, RaggedValues<float>,
+                   RaggedValues<std::int8_t>, RaggedValues<std::uint8_t>,
+                   RaggedValues<std::int16_t>, RaggedValues<std::uint16_t>,
+                   RaggedValues<std::int32_t>, RaggedValues<std::uint32_t>,
+                   RaggedValues<std::int64_t>, RaggedValues<std::uint64_t>>;
+  RaggedValuesVariant Ragged;
+
+  /// Position in the value dataset of the first value of every update
+  /// (ragged layout).
+  NeXusDataset::ExtensibleDataset<std::uint64_t> ValueIndex;
+
+  /// \brief Buffer an update (ragged layout), writing the buffers when they
+  /// hold a chunk worth of values or updates.
+  void bufferRagged(LogData const *LogDataMessage);
+
+  /// \brief True if the oldest buffered value has been buffered for longer
+  /// than the maximum buffer age.
+  bool bufferIsTooOld() const;
+
+  /// \brief Write the buffered updates (ragged layout).
+  ///
+  /// Values are written before their index and timestamps, so that a reader
+  /// of the file never sees an update of which the values are missing.
+  void writeRaggedBuffers();
+
+  /// Timestamps of the buffered updates (ragged layout).
+  std::vector<std::uint64_t> TimestampBuffer;
+
+  /// Value index of the buffered updates (ragged layout).
+  std::vector<std::uint64_t> ValueIndexBuffer;
+
+  /// Updates and values are buffered for at most this long, see flush().
+  std::chrono::milliseconds MaxBufferAge{5000};
+
+  /// When the oldest of the buffered updates or values was buffered.
+  std::chrono::steady_clock::time_point BufferedSince;
+
+  /// Number of values written to, or buffered for, the value dataset.
+  std::uint64_t NrOfValues{0};
 
   /// Timestamps of the f142 updates.
   NeXusDataset::Time Timestamp;
@@ -83,6 +202,7 @@ protected:
   uint64_t ValueIndexInterval = std::numeric_limits<uint64_t>::max();
   size_t ArraySize{1};
   size_t ChunkSize{64 * 1024};
+  bool ChunkSizeConfigured{false};
   std::optional<std::string> ValueUnits;
 };
 
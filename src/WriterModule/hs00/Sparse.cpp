@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "Sparse.h"
+#include "Exceptions.h"
+#include <fmt/format.h>
+
+namespace WriterModule {
+namespace hs00 {
+
+StorageMode storageModeFromString(std::string const &Name) {
+  if (Name == "dense") {
+    return StorageMode::Dense;
+  }
+  if (Name == "sparse") {
+    return StorageMode::Sparse;
+  }
+  if (Name == "auto") {
+    return StorageMode::Auto;
+  }
+  throw UnexpectedJsonInput(fmt::format(
+      "Unknown storage \"{}\", expected \"dense\", \"sparse\" or \"auto\"",
+      Name));
+}
+
+void toHistogramPositions(std::vector<uint32_t> const &SlicePositions,
+                          std::vector<uint32_t> const &SliceOffsets,
+                          std::vector<uint32_t> const &SliceSizes,
+                          std::vector<size_t> const &HistogramSizes,
+                          std::vector<uint64_t> &Positions) {
+  auto const NrOfDims = HistogramSizes.size();
+  std::vector<uint64_t> Strides(NrOfDims, 1);
+  for (size_t i = NrOfDims; i-- > 1;) {
+    Strides[i - 1] = Strides[i] * HistogramSizes[i];
+  }
+  uint64_t SliceOrigin{0};
+  for (size_t i = 0; i < NrOfDims; ++i) {
+    SliceOrigin += SliceOffsets[i] * Strides[i];
+  }
+  Positions.resize(SlicePositions.size());
+  for (size_t j = 0; j < SlicePositions.size(); ++j) {
+    uint64_t Remaining = SlicePositions[j];
+    uint64_t Result = SliceOrigin;
+    for (size_t i = NrOfDims; i-- > 0;) {
+      Result += (Remaining % SliceSizes[i]) * Strides[i];
+      Remaining /= SliceSizes[i];
+    }
+    Positions[j] = Result;
+  }
+}
+
+} // namespace hs00
+} // namespace WriterModule
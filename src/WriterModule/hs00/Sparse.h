@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace WriterModule {
+namespace hs00 {
+
+/// \brief How the histograms are stored in the file.
+enum class StorageMode {
+  /// Every histogram is a row of the N-D "histograms" dataset.
+  Dense,
+  /// Only the non-zero bins are stored, in coordinate format.
+  Sparse,
+  /// Sparse if the first message is sparse enough, dense otherwise.
+  Auto
+};
+
+/// \brief Get the storage mode from its name ("dense", "sparse" or "auto").
+///
+/// \throw UnexpectedJsonInput If the name is not known.
+StorageMode storageModeFromString(std::string const &Name);
+
+/// \brief Find the positions of the non-zero elements of an array.
+///
+/// The elements are counted and compacted in two passes without branches,
+/// which lets the compiler vectorise the scan of the (mostly zero) data.
+///
+/// \param Positions Replaced by the positions of the non-zero elements.
+template <typename T>
+void findNonZero(T const *Data, size_t Size, std::vector<uint32_t> &Positions) {
+  size_t Count{0};
+  for (size_t i = 0; i < Size; ++i) {
+    Count += static_cast<size_t>(Data[i] != T(0));
+  }
+  Positions.resize(Count);
+  size_t j{0};
+  for (size_t i = 0; j < Count; ++i) {
+    Positions[j] = static_cast<uint32_t>(i);
+    j += static_cast<size_t>(Data[i] != T(0));
+  }
+}
+
+/// \brief Convert positions in a slice of a histogram to positions in the
+/// full histogram. Both are flat, row-major positions.
+///
+/// \param Positions Replaced by the positions in the full histogram.
+void toHistogramPositions(std::vector<uint32_t> const &SlicePositions,
+                          std::vector<uint32_t> const &SliceOffsets,
+                          std::vector<uint32_t> const &SliceSizes,
+                          std::vector<size_t> const &HistogramSizes,
+                          std::vector<uint64_t> &Positions);
+
+} // namespace hs00
+} // namespace WriterModule
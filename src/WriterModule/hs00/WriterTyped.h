@@ -12,11 +12,14 @@
 #include "Exceptions.h"
 #include "FlatbufferMessage.h"
 #include "HistogramRecord.h"
+#include "NeXusDataset/ExtensibleDataset.h"
 #include "Shape.h"
+#include "Sparse.h"
 #include "WriterUntyped.h"
 #include "helper.h"
 #include "json.h"
 #include "logger.h"
+#include <algorithm>
 #include <flatbuffers/flatbuffers.h>
 #include <h5cpp/hdf5.hpp>
 #include <type_traits>
@@ -57,13 +60,48 @@ public:
   int copyLatestToData(size_t HDFIndex);
 
 private:
+  /// \brief Create the "data" dataset for the latest full histogram.
+  ///
+  /// Created with the other datasets, as datasets can not be created once
+  /// the file is in SWMR mode.
+  void createLatestDataset(hdf5::node::Group &Parent);
+
+  /// \brief Dimensions of the histograms, with the number of histogram rows
+  /// in use as the first dimension.
+  hdf5::Dimensions histogramDimensions() const;
+
+  void writeSparse(uint64_t Timestamp, std::vector<uint32_t> const &Offsets,
+                   std::vector<uint32_t> const &Sizes,
+                   flatbuffers::Vector<DataType> const &Data,
+                   flatbuffers::Vector<ErrorType> const *Errors);
+
   Shape<EdgeType> TheShape;
   std::string CreatedFromJson;
+  StorageMode Storage{StorageMode::Dense};
+  double SparseMaxDensity{0.05};
+  double ExpectedDensity{1.0};
+  bool KeepLatest{true};
+  bool UseSparse{false};
   hdf5::node::Dataset Dataset;
+  hdf5::node::Dataset DatasetLatest;
   hdf5::node::Dataset DatasetErrors;
   hdf5::node::Dataset DatasetTimestamps;
   hdf5::node::Dataset DatasetInfo;
   hdf5::node::Dataset DatasetInfoTimestamp;
+  NeXusDataset::ExtensibleDataset<uint64_t> SparseIndices;
+  NeXusDataset::ExtensibleDataset<DataType> SparseValues;
+  NeXusDataset::ExtensibleDataset<ErrorType> SparseErrors;
+  NeXusDataset::ExtensibleDataset<uint64_t> SparseOffsets;
+  NeXusDataset::ExtensibleDataset<uint64_t> SparseTimestamps;
+  uint64_t NrOfSparseEntries{0};
+  size_t NrOfSparseRows{0};
+  std::vector<uint32_t> NonZero;
+  std::vector<uint64_t> SparsePositions;
+  std::vector<DataType> SparseValueBuffer;
+  std::vector<ErrorType> SparseErrorBuffer;
+  /// Histograms that are not complete yet, only used with sparse storage if
+  /// the latest histogram is kept.
+  std::map<uint64_t, std::vector<DataType>> PartialHistograms;
 
   // clang-format off
   using FlatbufferDataType =
@@ -100,7 +138,7 @@ template <typename DataType, typename EdgeType, typename ErrorType>
 int WriterTyped<DataType, EdgeType, ErrorType>::copyLatestToData(
     size_t HDFIndex) {
   Logger->trace("WriterTyped copyLatestToData");
-  if (Dataset.is_valid()) {
+  if (Dataset.is_valid() and DatasetLatest.is_valid()) {
     Logger->trace("Found valid dataset");
     auto Type = hdf5::datatype::create<DataType>().native_type();
     auto SpaceIn = hdf5::dataspace::Simple(Dataset.dataspace());
@@ -121,34 +159,7 @@ int WriterTyped<DataType, EdgeType, ErrorType>::copyLatestToData(
     }
     DimsMem.at(0) = 1;
     auto SpaceMem = hdf5::dataspace::Simple(DimsMem, DimsMem);
-    hdf5::property::DatasetCreationList DCPL;
-    hdf5::Dimensions DimsOut;
-    hdf5::dataspace::Simple SpaceOut;
-    {
-      DimsOut.resize(DimsMem.size() - 1);
-      for (size_t I = 1; I < DimsMem.size(); ++I) {
-        DimsOut.at(I - 1) = DimsMem.at(I);
-      }
-      SpaceOut = hdf5::dataspace::Simple(DimsOut, DimsOut);
-    }
-    bool found = false;
-    try {
-      Logger->trace("Attempting to get latest dataset");
-      Dataset.link().parent().get_dataset("data");
-      found = true;
-    } catch (...) {
-      Logger->trace("Failed to get latest dataset");
-    }
-    if (!found) {
-      Logger->trace("Dataset \"data\" not yet present");
-      for (size_t I = 0; I < DimsOut.size(); ++I) {
-        Logger->trace("I: {}: {}", I, DimsOut.at(I));
-      }
-      Dataset.link().parent().create_dataset("data", Type, SpaceOut, DCPL);
-      Dataset.link().file().flush(hdf5::file::Scope::GLOBAL);
-      Logger->trace("Dataset \"data\" created");
-    }
-    auto Latest = Dataset.link().parent().get_dataset("data");
+    auto SpaceOut = hdf5::dataspace::Simple(DatasetLatest.dataspace());
     if (Dims.at(0) > 0) {
       size_t N = std::accumulate(DimsMem.cbegin(), DimsMem.cend(), size_t(1),
                                  std::multiplies<>());
@@ -159,7 +170,7 @@ int WriterTyped<DataType, EdgeType, ErrorType>::copyLatestToData(
         S += Buffer.at(I);
       }
       Logger->trace("copy latest histogram.  sum: {}", S);
-      Latest.write(Buffer, Type, SpaceMem, SpaceOut);
+      DatasetLatest.write(Buffer, Type, SpaceMem, SpaceOut);
     } else {
       Logger->trace("No entries so far");
     }
@@ -167,6 +178,71 @@ int WriterTyped<DataType, EdgeType, ErrorType>::copyLatestToData(
   return 0;
 }
 
+template <typename DataType, typename EdgeType, typename ErrorType>
+void WriterTyped<DataType, EdgeType, ErrorType>::createLatestDataset(
+    hdf5::node::Group &Parent) {
+  hdf5::Dimensions DimsOut;
+  for (auto const &Dim : TheShape.getDimensions()) {
+    DimsOut.push_back(Dim.getSize());
+  }
+  DatasetLatest = Parent.create_dataset(
+      "data", hdf5::datatype::create<DataType>().native_type(),
+      hdf5::dataspace::Simple(DimsOut, DimsOut),
+      hdf5::property::DatasetCreationList());
+}
+
+template <typename DataType, typename EdgeType, typename ErrorType>
+hdf5::Dimensions
+WriterTyped<DataType, EdgeType, ErrorType>::histogramDimensions() const {
+  if (not UseSparse) {
+    return hdf5::dataspace::Simple(Dataset.dataspace()).current_dimensions();
+  }
+  hdf5::Dimensions Dims{NrOfSparseRows};
+  for (auto const &Dim : TheShape.getDimensions()) {
+    Dims.push_back(Dim.getSize());
+  }
+  return Dims;
+}
+
+template <typename DataType, typename EdgeType, typename ErrorType>
+void WriterTyped<DataType, EdgeType, ErrorType>::writeSparse(
+    uint64_t Timestamp, std::vector<uint32_t> const &Offsets,
+    std::vector<uint32_t> const &Sizes,
+    flatbuffers::Vector<DataType> const &Data,
+    flatbuffers::Vector<ErrorType> const *Errors) {
+  std::vector<size_t> HistogramSizes;
+  for (auto const &Dim : TheShape.getDimensions()) {
+    HistogramSizes.push_back(Dim.getSize());
+  }
+  findNonZero(Data.data(), Data.size(), NonZero);
+  toHistogramPositions(NonZero, Offsets, Sizes, HistogramSizes,
+                       SparsePositions);
+  SparseValueBuffer.resize(NonZero.size());
+  SparseErrorBuffer.resize(NonZero.size());
+  for (size_t i = 0; i < NonZero.size(); ++i) {
+    SparseValueBuffer[i] = Data.Get(NonZero[i]);
+    SparseErrorBuffer[i] = Errors != nullptr ? Errors->Get(NonZero[i]) : 0;
+  }
+  SparseOffsets.appendElement(NrOfSparseEntries);
+  SparseTimestamps.appendElement(Timestamp);
+  if (not NonZero.empty()) {
+    SparseIndices.appendArray(ArrayAdapter<const uint64_t>(
+        SparsePositions.data(), SparsePositions.size()));
+    SparseValues.appendArray(ArrayAdapter<const DataType>(
+        SparseValueBuffer.data(), SparseValueBuffer.size()));
+    SparseErrors.appendArray(ArrayAdapter<const ErrorType>(
+        SparseErrorBuffer.data(), SparseErrorBuffer.size()));
+    NrOfSparseEntries += NonZero.size();
+  }
+  if (KeepLatest) {
+    auto &Histogram = PartialHistograms[Timestamp];
+    Histogram.resize(TheShape.getTotalItems());
+    for (size_t i = 0; i < NonZero.size(); ++i) {
+      Histogram[SparsePositions[i]] = SparseValueBuffer[i];
+    }
+  }
+}
+
 template <typename DataType, typename EdgeType, typename ErrorType>
 typename WriterTyped<DataType, EdgeType, ErrorType>::ptr
 WriterTyped<DataType, EdgeType, ErrorType>::createFromJson(json const &Json) {
@@ -178,6 +254,15 @@ WriterTyped<DataType, EdgeType, ErrorType>::createFromJson(json const &Json) {
   try {
     auto &TheWriterTyped = *TheWriterTypedPtr;
     TheWriterTyped.TheShape = Shape<EdgeType>::createFromJson(Json.at("shape"));
+    TheWriterTyped.Storage =
+        storageModeFromString(Json.value("storage", std::string("dense")));
+    TheWriterTyped.SparseMaxDensity = Json.value("sparse_max_density", 0.05);
+    TheWriterTyped.ExpectedDensity = Json.value("expected_density", 1.0);
+    TheWriterTyped.KeepLatest = Json.value("latest", true);
+    TheWriterTyped.UseSparse =
+        TheWriterTyped.Storage == StorageMode::Sparse or
+        (TheWriterTyped.Storage == StorageMode::Auto and
+         TheWriterTyped.ExpectedDensity <= TheWriterTyped.SparseMaxDensity);
     TheWriterTyped.CreatedFromJson = Json.dump();
   } catch (json::out_of_range const &) {
     std::throw_with_nested(UnexpectedJsonInput());
@@ -195,8 +280,24 @@ WriterTyped<DataType, EdgeType, ErrorType>::createFromHDF(
       WriterTyped<DataType, EdgeType, ErrorType>::createFromJson(
           json::parse(JsonString));
   auto &TheWriterTyped = *TheWriterTypedPtr;
-  TheWriterTyped.Dataset = Group.get_dataset("histograms");
-  TheWriterTyped.DatasetErrors = Group.get_dataset("errors");
+  // The storage was selected when the file was created.
+  TheWriterTyped.UseSparse = Group.nodes.exists("sparse_indices");
+  if (not TheWriterTyped.UseSparse) {
+    TheWriterTyped.Dataset = Group.get_dataset("histograms");
+    TheWriterTyped.DatasetErrors = Group.get_dataset("errors");
+  } else {
+    using NeXusDataset::Mode;
+    TheWriterTyped.SparseIndices = {Group, "sparse_indices", Mode::Open};
+    TheWriterTyped.SparseValues = {Group, "sparse_values", Mode::Open};
+    TheWriterTyped.SparseErrors = {Group, "sparse_errors", Mode::Open};
+    TheWriterTyped.SparseOffsets = {Group, "sparse_offsets", Mode::Open};
+    TheWriterTyped.SparseTimestamps = {Group, "sparse_timestamps", Mode::Open};
+    TheWriterTyped.NrOfSparseEntries =
+        TheWriterTyped.SparseIndices.dataspace().size();
+  }
+  if (TheWriterTyped.KeepLatest and Group.nodes.exists("data")) {
+    TheWriterTyped.DatasetLatest = Group.get_dataset("data");
+  }
   TheWriterTyped.DatasetTimestamps = Group.get_dataset("timestamps");
   TheWriterTyped.DatasetInfo = Group.get_dataset("info");
   TheWriterTyped.DatasetInfoTimestamp = Group.get_dataset("info_timestamp");
@@ -208,7 +309,19 @@ void WriterTyped<DataType, EdgeType, ErrorType>::createHDFStructure(
     hdf5::node::Group &Group, size_t ChunkBytes) {
   Group.attributes.create_from("created_from_json", CreatedFromJson);
   this->ChunkBytes = ChunkBytes;
-  {
+  Logger->debug("Using {} storage for histograms",
+                UseSparse ? "sparse" : "dense");
+  if (UseSparse) {
+    using NeXusDataset::Mode;
+    SparseIndices = {Group, "sparse_indices", Mode::Create,
+                     std::max<size_t>(1, ChunkBytes / sizeof(uint64_t))};
+    SparseValues = {Group, "sparse_values", Mode::Create,
+                    std::max<size_t>(1, ChunkBytes / sizeof(DataType))};
+    SparseErrors = {Group, "sparse_errors", Mode::Create,
+                    std::max<size_t>(1, ChunkBytes / sizeof(ErrorType))};
+    SparseOffsets = {Group, "sparse_offsets", Mode::Create, 4 * 1024};
+    SparseTimestamps = {Group, "sparse_timestamps", Mode::Create, 4 * 1024};
+  } else {
     auto Type = hdf5::datatype::create<DataType>().native_type();
     auto const &Dims = TheShape.getDimensions();
     std::vector<hsize_t> SizeNow{0};
@@ -236,11 +349,13 @@ void WriterTyped<DataType, EdgeType, ErrorType>::createHDFStructure(
                        "with gzip support?");
     }
     Dataset = Group.create_dataset("histograms", Type, Space, DCPL);
-    copyLatestToData(0);
     DatasetErrors = Group.create_dataset(
         "errors", hdf5::datatype::create<ErrorType>().native_type(), Space,
         DCPL);
   }
+  if (KeepLatest) {
+    createLatestDataset(Group);
+  }
   {
     hdf5::property::DatasetCreationList DCPL;
     DCPL.chunk({4 * 1024, 2});
@@ -304,13 +419,9 @@ void WriterTyped<DataType, EdgeType, ErrorType>::write(
     FlatbufferMessage const &Message, bool DoFlushEachWrite) {
   using WriterModule::WriterException;
 
-  if (!Dataset.is_valid()) {
+  if (!Dataset.is_valid() && !SparseIndices.is_valid()) {
     throw WriterException("Invalid dataset");
   }
-  auto Dims = hdf5::dataspace::Simple(Dataset.dataspace()).current_dimensions();
-  if (Dims.empty()) {
-    throw WriterException("Dims is empty");
-  }
   auto EvMsg = GetEventHistogram(Message.data());
   uint64_t Timestamp = EvMsg->timestamp();
   if (Timestamp == 0) {
@@ -341,6 +452,10 @@ void WriterTyped<DataType, EdgeType, ErrorType>::write(
   if (!MsgShape) {
     throw WriterException("Missing current_shape");
   }
+  auto Dims = histogramDimensions();
+  if (Dims.empty()) {
+    throw WriterException("Dims is empty");
+  }
   if (MsgShape->size() != Dims.size() - 1) {
     throw WriterException("Wrong size of shape");
   }
@@ -382,6 +497,7 @@ void WriterTyped<DataType, EdgeType, ErrorType>::write(
   if (HistogramRecords.find(Timestamp) == HistogramRecords.end()) {
     if (HistogramRecords.size() >= MaxNumberHistoric) {
       auto ReuseHDFIndex = HistogramRecords.begin()->second.getHDFIndex();
+      PartialHistograms.erase(HistogramRecords.begin()->first);
       HistogramRecords.erase(HistogramRecords.begin());
       HistogramRecords[Timestamp] =
           HistogramRecord::create(ReuseHDFIndex, TheShape.getTotalItems());
@@ -391,7 +507,9 @@ void WriterTyped<DataType, EdgeType, ErrorType>::write(
       AddNewRow = true;
     }
   }
-  if (AddNewRow) {
+  if (AddNewRow and UseSparse) {
+    ++NrOfSparseRows;
+  } else if (AddNewRow) {
     Dims.at(0) += 1;
     Dataset.extent(Dims);
     DatasetErrors.extent(Dims);
@@ -407,8 +525,12 @@ void WriterTyped<DataType, EdgeType, ErrorType>::write(
   }
   Record.addSlice(TheSlice);
   hdf5::dataspace::Simple DSPMem;
-  auto DSPFile = Dataset.dataspace();
-  {
+  if (UseSparse) {
+    writeSparse(Timestamp, TheOffsets,
+                std::vector<uint32_t>(MsgShape->begin(), MsgShape->end()),
+                *DataPtr, ErrorsPtr);
+  } else {
+    auto DSPFile = Dataset.dataspace();
     std::vector<hsize_t> Offset(Dims.size());
     Offset.at(0) = Record.getHDFIndex();
     std::vector<hsize_t> Block(Dims.size());
@@ -426,14 +548,14 @@ void WriterTyped<DataType, EdgeType, ErrorType>::write(
     DSPFile.selection(hdf5::dataspace::SelectionOperation::SET,
                       hdf5::dataspace::Hyperslab(Offset, Block, Count, Stride));
     DSPMem = hdf5::dataspace::Simple(Block, Block);
-  }
-  Dataset.write(*DataPtr->data(),
-                hdf5::datatype::create<DataType>().native_type(), DSPMem,
-                DSPFile);
-  if (ErrorsPtr) {
-    DatasetErrors.write(*ErrorsPtr->data(),
-                        hdf5::datatype::create<ErrorType>().native_type(),
-                        DSPMem, DSPFile);
+    Dataset.write(*DataPtr->data(),
+                  hdf5::datatype::create<DataType>().native_type(), DSPMem,
+                  DSPFile);
+    if (ErrorsPtr) {
+      DatasetErrors.write(*ErrorsPtr->data(),
+                          hdf5::datatype::create<ErrorType>().native_type(),
+                          DSPMem, DSPFile);
+    }
   }
   Record.addToItemsWritten(DataPtr->size());
   {
@@ -485,12 +607,23 @@ void WriterTyped<DataType, EdgeType, ErrorType>::write(
     }
   }
 
-  if (Record.isFull()) {
-    copyLatestToData(Record.getHDFIndex());
+  if (Record.isFull() and KeepLatest) {
+    if (not DatasetLatest.is_valid()) {
+      throw WriterException("The \"data\" dataset is missing");
+    }
+    if (UseSparse) {
+      auto &Histogram = PartialHistograms[Timestamp];
+      DatasetLatest.write(Histogram,
+                          hdf5::datatype::create<DataType>().native_type(),
+                          DatasetLatest.dataspace(), DatasetLatest.dataspace());
+      PartialHistograms.erase(Timestamp);
+    } else {
+      copyLatestToData(Record.getHDFIndex());
+    }
   }
 
   if (DoFlushEachWrite) {
-    Dataset.link().file().flush(hdf5::file::Scope::GLOBAL);
+    DatasetTimestamps.link().file().flush(hdf5::file::Scope::GLOBAL);
   }
   Logger->trace("hs00 -------------------------------   DONE");
 }
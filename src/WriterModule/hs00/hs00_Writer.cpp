@@ -15,8 +15,11 @@ namespace WriterModule {
 namespace hs00 {
 
 void hs00_Writer::parse_config(std::string const &ConfigurationStream) {
-  TheWriterUntyped = WriterUntyped::createFromJson(
-      WriterUntyped::json::parse(ConfigurationStream));
+  // The configuration is the full histogram definition, which is validated
+  // by createFromJson() and is required, so a bad one should fail the stream.
+  auto Json = WriterUntyped::json::parse(ConfigurationStream);
+  TheWriterUntyped = WriterUntyped::createFromJson(Json);
+  DoFlushEachWrite = Json.value("flush_each_write", DoFlushEachWrite);
 }
 
 WriterModule::InitResult hs00_Writer::init_hdf(hdf5::node::Group &HDFGroup,
@@ -31,7 +31,8 @@ public:
   WriterUntyped::ptr TheWriterUntyped;
 
   hsize_t ChunkBytes = 1 << 21;
-  bool DoFlushEachWrite = true;
+  /// Flush the file after every message, see the "flush_each_write" option.
+  bool DoFlushEachWrite = false;
   uint64_t TotalWrittenBytes = 0;
 
 private:
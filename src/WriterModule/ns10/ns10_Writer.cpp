@@ -10,6 +10,7 @@
 #include "ns10_Writer.h"
 #include "FlatbufferMessage.h"
 #include "HDFFile.h"
+#include "WriterModuleConfig.h"
 #include "WriterRegistrar.h"
 #include <ns10_cache_entry_generated.h>
 
@@ -20,26 +21,29 @@ static WriterModule::Registry::Registrar<ns10_Writer> RegisterWriter("ns10",
                                                                      "ns10");
 
 void ns10_Writer::parse_config(std::string const &ConfigurationStream) {
-  auto Config = nlohmann::json::parse(ConfigurationStream);
-  try {
-    CueInterval = Config["cue_interval"].get<uint64_t>();
-  } catch (std::exception const &Exception) {
-    Logger->warn("Unable to extract cue interval from JSON.");
+  auto ParsedConfig = parseConfig(ConfigurationStream);
+  if (not ParsedConfig) {
+    Logger->error("ns10 configuration is not valid JSON, using the defaults.");
+    return;
   }
-
-  Logger->info("Using a cue interval of {}.", CueInterval);
-
-  auto JsonChunkSize = Config["chunk_size"];
-  if (JsonChunkSize.is_array()) {
-    ChunkSize = Config["chunk_size"].get<hdf5::Dimensions>();
-  } else if (JsonChunkSize.is_number_integer()) {
-    ChunkSize = hdf5::Dimensions{JsonChunkSize.get<hsize_t>()};
-  } else {
-    Logger->warn("Unable to extract chunk size, using the existing value");
+  auto setChunkSize = [this](nlohmann::json const &Value) {
+    if (auto Shape = getValue<hdf5::Dimensions>(Value)) {
+      ChunkSize = *Shape;
+    } else if (auto Size = getValue<hsize_t>(Value)) {
+      ChunkSize = hdf5::Dimensions{*Size};
+    } else {
+      Logger->warn("Unable to extract chunk size, using the existing value");
+    }
+  };
+  ConfigSchema Schema;
+  Schema.add({"cue_interval"}, CueInterval)
+      .add<nlohmann::json>({"chunk_size"}, setChunkSize)
+      .add({"source"}, Sourcename);
+  for (auto const &Error : Schema.apply(*ParsedConfig)) {
+    Logger->error("ns10 configuration: {}", Error);
   }
-  try {
-    Sourcename = Config["source"];
-  } catch (std::exception const &Exception) {
+  Logger->info("Using a cue interval of {}.", CueInterval);
+  if (Sourcename.empty()) {
     Logger->error("Key \"source\" is not specified in JSON command");
   }
 }
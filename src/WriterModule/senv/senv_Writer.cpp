@@ -15,9 +15,14 @@
 #include "helper.h"
 
 #include "HDFFile.h"
+#include "WriterModuleConfig.h"
 #include "WriterRegistrar.h"
 #include "senv_Writer.h"
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <map>
+#include <numeric>
 #include <senv_data_generated.h>
 
 namespace WriterModule {
@@ -27,9 +32,39 @@ namespace senv {
 static WriterModule::Registry::Registrar<senv_Writer>
     RegisterSenvWriter("senv", "senv");
 
-void senv_Writer::parse_config(std::string const &) {
-  Logger->trace("There are currently no runtime configurable options in the "
-                "FastSampleEnvironmentWriter class.");
+void senv_Writer::parse_config(std::string const &ConfigurationStream) {
+  auto ParsedConfig = parseConfig(ConfigurationStream);
+  if (not ParsedConfig) {
+    Logger->error("senv configuration is not valid JSON, using the defaults.");
+    return;
+  }
+  static std::map<std::string, WaveformLayout> const LayoutMap{
+      {"samples", WaveformLayout::Samples},
+      {"packets", WaveformLayout::Packets}};
+  auto setLayout = [this](std::string const &LayoutName) {
+    if (auto LayoutIt = LayoutMap.find(LayoutName);
+        LayoutIt != LayoutMap.end()) {
+      Layout = LayoutIt->second;
+    } else {
+      Logger->error("Unknown layout ({}), using the default (samples).",
+                    LayoutName);
+    }
+  };
+  auto setTolerance = [this](double Tolerance) {
+    if (Tolerance >= 0.0) {
+      TimestampTolerance = Tolerance;
+    } else {
+      Logger->error("The timestamp tolerance can not be negative, using the "
+                    "default ({}).",
+                    TimestampTolerance);
+    }
+  };
+  ConfigSchema Schema;
+  Schema.add<std::string>({"layout"}, setLayout);
+  Schema.add<double>({"timestamp_tolerance"}, setTolerance);
+  for (auto const &Error : Schema.apply(*ParsedConfig)) {
+    Logger->error("senv configuration: {}", Error);
+  }
 }
 
 WriterModule::InitResult
@@ -42,10 +77,17 @@ senv_Writer::init_hdf(hdf5::node::Group &HDFGroup,
         CurrentGroup,               // NOLINT(bugprone-unused-raii)
         NeXusDataset::Mode::Create, // NOLINT(bugprone-unused-raii)
         DefaultChunkSize);          // NOLINT(bugprone-unused-raii)
-    NeXusDataset::Time(             // NOLINT(bugprone-unused-raii)
-        CurrentGroup,               // NOLINT(bugprone-unused-raii)
-        NeXusDataset::Mode::Create, // NOLINT(bugprone-unused-raii)
-        DefaultChunkSize);          // NOLINT(bugprone-unused-raii)
+    if (Layout == WaveformLayout::Samples) {
+      NeXusDataset::Time(             // NOLINT(bugprone-unused-raii)
+          CurrentGroup,               // NOLINT(bugprone-unused-raii)
+          NeXusDataset::Mode::Create, // NOLINT(bugprone-unused-raii)
+          DefaultChunkSize);          // NOLINT(bugprone-unused-raii)
+    } else {
+      NeXusDataset::TimeDelta(        // NOLINT(bugprone-unused-raii)
+          CurrentGroup,               // NOLINT(bugprone-unused-raii)
+          NeXusDataset::Mode::Create, // NOLINT(bugprone-unused-raii)
+          DefaultChunkSize);          // NOLINT(bugprone-unused-raii)
+    }
     NeXusDataset::CueIndex(         // NOLINT(bugprone-unused-raii)
         CurrentGroup,               // NOLINT(bugprone-unused-raii)
         NeXusDataset::Mode::Create, // NOLINT(bugprone-unused-raii)
@@ -72,7 +114,12 @@ WriterModule::InitResult senv_Writer::reopen(hdf5::node::Group &HDFGroup) {
   try {
     auto &CurrentGroup = HDFGroup;
     Value = NeXusDataset::UInt16Value(CurrentGroup, NeXusDataset::Mode::Open);
-    Timestamp = NeXusDataset::Time(CurrentGroup, NeXusDataset::Mode::Open);
+    if (Layout == WaveformLayout::Samples) {
+      Timestamp = NeXusDataset::Time(CurrentGroup, NeXusDataset::Mode::Open);
+    } else {
+      SampleTimeDelta =
+          NeXusDataset::TimeDelta(CurrentGroup, NeXusDataset::Mode::Open);
+    }
     CueTimestampIndex =
         NeXusDataset::CueIndex(CurrentGroup, NeXusDataset::Mode::Open);
     CueTimestamp =
@@ -106,13 +153,33 @@ void senv_Writer::write(const FileWriter::FlatbufferMessage &Message) {
   }
   ArrayAdapter<const std::uint16_t> CArray(TempDataPtr, TempDataSize);
   auto CueIndexValue = Value.dataspace().size();
+  auto HasTimestamps =
+      flatbuffers::IsFieldPresent(FbPointer,
+                                  SampleEnvironmentData::VT_TIMESTAMPS) and
+      FbPointer->Values()->size() == FbPointer->Timestamps()->size();
+  if (Layout == WaveformLayout::Packets) {
+    if (HasTimestamps) {
+      ArrayAdapter<const std::uint64_t> Timestamps(
+          FbPointer->Timestamps()->data(), FbPointer->Timestamps()->size());
+      if (not timestampsAreEven(FbPointer->PacketTimestamp(),
+                                FbPointer->TimeDelta(), Timestamps)) {
+        writeSamplesAsPackets(CArray, Timestamps, CueIndexValue);
+        return;
+      }
+    }
+    // The time of every sample follows from the packet timestamp and the time
+    // delta, which saves writing a timestamp per sample.
+    CueTimestampIndex.appendElement(static_cast<std::uint32_t>(CueIndexValue));
+    CueTimestamp.appendElement(FbPointer->PacketTimestamp());
+    SampleTimeDelta.appendElement(FbPointer->TimeDelta());
+    Value.appendArray(CArray);
+    return;
+  }
   CueTimestampIndex.appendElement(static_cast<std::uint32_t>(CueIndexValue));
   CueTimestamp.appendElement(FbPointer->PacketTimestamp());
   Value.appendArray(CArray);
   // Time-stamps are available in the flatbuffer
-  if (flatbuffers::IsFieldPresent(FbPointer,
-                                  SampleEnvironmentData::VT_TIMESTAMPS) and
-      FbPointer->Values()->size() == FbPointer->Timestamps()->size()) {
+  if (HasTimestamps) {
     auto TimestampPtr = FbPointer->Timestamps()->data();
     auto TimestampSize = FbPointer->Timestamps()->size();
     ArrayAdapter<const std::uint64_t> TSArray(TimestampPtr, TimestampSize);
@@ -124,5 +191,44 @@ void senv_Writer::write(const FileWriter::FlatbufferMessage &Message) {
   }
 }
 
+bool senv_Writer::timestampsAreEven(
+    std::uint64_t PacketTimestamp, double TimeDelta,
+    ArrayAdapter<const std::uint64_t> const &Timestamps) const {
+  auto const Tolerance = TimestampTolerance * std::abs(TimeDelta);
+  for (size_t i = 0; i < Timestamps.size(); ++i) {
+    // Relative to the packet timestamp, as a double can not hold a timestamp
+    // in ns since the epoch exactly.
+    auto Offset =
+        static_cast<std::int64_t>(Timestamps.data()[i] - PacketTimestamp);
+    // Half a ns for the rounding of the calculated timestamps.
+    if (std::abs(static_cast<double>(Offset) - i * TimeDelta) >
+        Tolerance + 0.5) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void senv_Writer::writeSamplesAsPackets(
+    ArrayAdapter<const std::uint16_t> const &Samples,
+    ArrayAdapter<const std::uint64_t> const &Timestamps,
+    std::uint64_t FirstIndex) {
+  if (not UnevenTimestampsReported) {
+    Logger->warn("The sample timestamps of a waveform do not follow from its "
+                 "packet timestamp and time delta within the tolerance; "
+                 "writing every sample as a packet of its own. Use the "
+                 "\"samples\" layout or a larger \"timestamp_tolerance\" "
+                 "for such data.");
+    UnevenTimestampsReported = true;
+  }
+  std::vector<std::uint32_t> Indices(Samples.size());
+  std::iota(Indices.begin(), Indices.end(),
+            static_cast<std::uint32_t>(FirstIndex));
+  CueTimestampIndex.appendArray(Indices);
+  CueTimestamp.appendArray(Timestamps);
+  SampleTimeDelta.appendArray(std::vector<double>(Samples.size(), 0.0));
+  Value.appendArray(Samples);
+}
+
 } // namespace senv
 } // namespace WriterModule
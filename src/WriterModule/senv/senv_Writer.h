@@ -35,7 +35,7 @@ public:
   senv_Writer() : FileWriterBase(false) {}
   ~senv_Writer() override = default;
 
-  void parse_config(std::string const &) override;
+  void parse_config(std::string const &ConfigurationStream) override;
 
   InitResult init_hdf(hdf5::node::Group &HDFGroup,
                       std::string const &HDFAttributes) override;
@@ -44,9 +44,38 @@ public:
 
   void write(FlatbufferMessage const &Message) override;
 
+  /// \brief How the samples of the waveforms are stored.
+  enum class WaveformLayout {
+    /// Every sample has a timestamp in the "time" dataset.
+    Samples,
+    /// Only the timestamp ("cue_timestamp_zero") and time between the samples
+    /// ("time_delta") of every waveform are stored, "cue_index" is the
+    /// position of its first sample in "raw_value".
+    Packets
+  };
+
 protected:
+  /// \brief Write the samples of a waveform in the packets layout when their
+  /// timestamps are not evenly spaced, as packets of one sample each.
+  void
+  writeSamplesAsPackets(ArrayAdapter<const std::uint16_t> const &Samples,
+                        ArrayAdapter<const std::uint64_t> const &Timestamps,
+                        std::uint64_t FirstIndex);
+
+  /// \brief Check if the sample timestamps of a waveform follow from its
+  /// packet timestamp and time delta, within the timestamp tolerance.
+  bool timestampsAreEven(std::uint64_t PacketTimestamp, double TimeDelta,
+                         ArrayAdapter<const std::uint64_t> const &Timestamps)
+      const;
+
+  WaveformLayout Layout{WaveformLayout::Samples};
+  /// Fraction of the time between the samples by which the timestamp of a
+  /// sample may differ from the one calculated in the packets layout.
+  double TimestampTolerance{0.1};
+  bool UnevenTimestampsReported{false};
   NeXusDataset::UInt16Value Value;
   NeXusDataset::Time Timestamp;
+  NeXusDataset::TimeDelta SampleTimeDelta;
   NeXusDataset::CueIndex CueTimestampIndex;
   NeXusDataset::CueTimestampZero CueTimestamp;
   SharedLogger Logger = spdlog::get("filewriterlogger");
@@ -10,9 +10,15 @@
 #pragma once
 
 #include "FlatbufferMessage.h"
+#include "SourceProfile.h"
 #include <h5cpp/hdf5.hpp>
 #include <memory>
 #include <string>
+#include <vector>
+
+namespace NeXusDataset {
+class DatasetPool;
+}
 
 namespace WriterModule {
 
@@ -42,6 +48,29 @@ public:
   /// stream.
   virtual void parse_config(std::string const &ConfigurationStream) = 0;
 
+  /// \brief Use the statistics recorded for this source by a previous job,
+  /// e.g. to pre-size chunks.
+  ///
+  /// Called after parse_config() and before init_hdf(), only if a profile is
+  /// available. Settings given explicitly in the configuration should take
+  /// precedence over the profile.
+  virtual void useSourceProfile(FileWriter::SourceProfile const &) {}
+
+  /// \brief Share a limited number of open datasets with the other writer
+  /// modules of the file.
+  ///
+  /// Called before reopen(), only if the number of open datasets is limited.
+  /// Writer modules that do not support this keep their datasets open.
+  virtual void
+  useDatasetPool(std::shared_ptr<NeXusDataset::DatasetPool> const &) {}
+
+  /// \brief The names of other sources, on the same topic and with the same
+  /// schema, of which the messages are passed to this module too.
+  ///
+  /// Called after parse_config(). Most modules only write the source of their
+  /// stream.
+  virtual std::vector<std::string> mergedSources() const { return {}; }
+
   /// \brief Initialise the HDF file.
   ///
   /// Called before any data has arrived with the json configuration of this
@@ -75,6 +104,12 @@ public:
   /// \param msg The message to process
   virtual void write(FileWriter::FlatbufferMessage const &Message) = 0;
 
+  /// \brief Write data that the module has buffered for too long.
+  ///
+  /// Called periodically from the thread that calls write(), so that buffered
+  /// data reaches the file also when the stream has gone quiet.
+  virtual void flush() {}
+
 private:
   bool WriteRepeatedTimestamps;
 };
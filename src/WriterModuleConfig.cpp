@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "WriterModuleConfig.h"
+#include <fmt/format.h>
+
+namespace WriterModule {
+
+std::optional<nlohmann::json> parseConfig(std::string const &Configuration) {
+  auto Config = nlohmann::json::parse(Configuration, nullptr, false);
+  if (Config.is_discarded()) {
+    return std::nullopt;
+  }
+  return Config;
+}
+
+nlohmann::json const *findValue(nlohmann::json const &Json,
+                                std::vector<std::string> const &Keys) {
+  auto Current = &Json;
+  for (auto const &Key : Keys) {
+    if (not Current->is_object()) {
+      return nullptr;
+    }
+    auto Item = Current->find(Key);
+    if (Item == Current->end()) {
+      return nullptr;
+    }
+    Current = &(*Item);
+  }
+  return Current;
+}
+
+std::vector<std::string>
+ConfigSchema::apply(nlohmann::json const &Config) const {
+  std::vector<std::string> Errors;
+  for (auto const &CurrentSetting : Settings) {
+    auto Value = findValue(Config, CurrentSetting.Keys);
+    if (Value == nullptr) {
+      continue;
+    }
+    if (auto ExpectedType = CurrentSetting.Apply(*Value);
+        not ExpectedType.empty()) {
+      Errors.push_back(fmt::format("The setting \"{}\" should be {}, not {}.",
+                                   fmt::join(CurrentSetting.Keys, "/"),
+                                   ExpectedType, Value->dump()));
+    }
+  }
+  return Errors;
+}
+
+} // namespace WriterModule
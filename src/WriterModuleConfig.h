@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+/// \file Declarative, non-throwing parsing of the stream configuration of
+/// writer modules.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fmt/format.h>
+#include <functional>
+#include <limits>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace WriterModule {
+
+/// \brief Parse a stream configuration without throwing.
+///
+/// \return The configuration or an empty optional if it is not valid JSON.
+std::optional<nlohmann::json> parseConfig(std::string const &Configuration);
+
+/// \brief Find a value in nested JSON objects without throwing.
+///
+/// \param Keys The key in each level of nesting, e.g. {"nexus", "chunk",
+/// "chunk_kb"}.
+/// \return The value or nullptr if any of the keys is missing.
+nlohmann::json const *findValue(nlohmann::json const &Json,
+                                std::vector<std::string> const &Keys);
+
+template <typename T> struct IsVector : std::false_type {};
+template <typename T, typename Allocator>
+struct IsVector<std::vector<T, Allocator>> : std::true_type {};
+
+/// \brief Check, without throwing, if a JSON value can be converted to \p T.
+///
+/// Integers must be in the range of \p T, as the conversion would silently
+/// truncate them.
+template <typename T> bool hasType(nlohmann::json const &Value) {
+  if constexpr (std::is_same_v<T, nlohmann::json>) {
+    return true;
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return Value.is_boolean();
+  } else if constexpr (std::is_integral_v<T> and std::is_unsigned_v<T>) {
+    return Value.is_number_unsigned() and
+           Value.get<std::uint64_t>() <= std::numeric_limits<T>::max();
+  } else if constexpr (std::is_integral_v<T>) {
+    if (Value.is_number_unsigned()) {
+      return Value.get<std::uint64_t>() <=
+             static_cast<std::uint64_t>(std::numeric_limits<T>::max());
+    }
+    return Value.is_number_integer() and
+           Value.get<std::int64_t>() >= std::numeric_limits<T>::min() and
+           Value.get<std::int64_t>() <= std::numeric_limits<T>::max();
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return Value.is_number();
+  } else if constexpr (IsVector<T>::value) {
+    return Value.is_array() and
+           std::all_of(Value.begin(), Value.end(), [](auto const &Element) {
+             return hasType<typename T::value_type>(Element);
+           });
+  } else {
+    static_assert(std::is_same_v<T, std::string>, "Unsupported type.");
+    return Value.is_string();
+  }
+}
+
+/// \brief Description of the JSON values expected for \p T, used in error
+/// messages.
+template <typename T> std::string typeName() {
+  if constexpr (std::is_same_v<T, nlohmann::json>) {
+    return "any value";
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return "a boolean";
+  } else if constexpr (std::is_integral_v<T> and std::is_unsigned_v<T>) {
+    if constexpr (sizeof(T) < sizeof(std::uint64_t)) {
+      return fmt::format("an unsigned integer of at most {}",
+                         std::numeric_limits<T>::max());
+    }
+    return "an unsigned integer";
+  } else if constexpr (std::is_integral_v<T>) {
+    if constexpr (sizeof(T) < sizeof(std::int64_t)) {
+      return fmt::format("an integer from {} to {}",
+                         std::numeric_limits<T>::min(),
+                         std::numeric_limits<T>::max());
+    }
+    return "an integer";
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return "a number";
+  } else if constexpr (IsVector<T>::value) {
+    return "an array of which every element is " +
+           typeName<typename T::value_type>();
+  } else {
+    return "a string";
+  }
+}
+
+/// \brief Get a value, without throwing, if it can be converted to \p T.
+template <typename T>
+std::optional<T> getValue(nlohmann::json const &Value) {
+  if (not hasType<T>(Value)) {
+    return {};
+  }
+  return Value.get<T>();
+}
+
+/// \brief Declarative description of the optional settings in the stream
+/// configuration of a writer module.
+///
+/// Settings are looked up without any exceptions being thrown, which keeps
+/// parsing cheap for jobs with thousands of streams. Settings that are
+/// present but of the wrong type are ignored and reported by apply().
+class ConfigSchema {
+public:
+  using KeyPath = std::vector<std::string>;
+
+  /// \brief Add a setting, calling \p Setter with its value if present.
+  template <typename T>
+  ConfigSchema &add(KeyPath Keys, std::function<void(T const &)> Setter) {
+    Settings.push_back(
+        {std::move(Keys), [Setter = std::move(Setter)](
+                              nlohmann::json const &Value) -> std::string {
+           if (not hasType<T>(Value)) {
+             return typeName<T>();
+           }
+           Setter(Value.get<T>());
+           return {};
+         }});
+    return *this;
+  }
+
+  /// \brief Add a setting stored in \p Target if present.
+  template <typename T> ConfigSchema &add(KeyPath Keys, T &Target) {
+    return add<T>(std::move(Keys),
+                  [&Target](T const &Value) { Target = Value; });
+  }
+
+  /// \brief Add a setting stored in \p Target if present.
+  template <typename T>
+  ConfigSchema &add(KeyPath Keys, std::optional<T> &Target) {
+    return add<T>(std::move(Keys),
+                  [&Target](T const &Value) { Target = Value; });
+  }
+
+  /// \brief Look up all settings in a configuration.
+  ///
+  /// Settings are applied in the order in which they were added, so later
+  /// settings take precedence when they set the same value.
+  ///
+  /// \return A description of every setting that is present but has the
+  /// wrong type.
+  std::vector<std::string> apply(nlohmann::json const &Config) const;
+
+private:
+  struct Setting {
+    KeyPath Keys;
+    /// Returns the expected type if the value has the wrong type.
+    std::function<std::string(nlohmann::json const &)> Apply;
+  };
+  std::vector<Setting> Settings;
+};
+
+} // namespace WriterModule
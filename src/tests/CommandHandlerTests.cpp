@@ -115,3 +115,43 @@ TEST(ExtractStreamSettings, IfAttributesDefinedThenExtracted) {
 
   ASSERT_EQ("{\"NX_class\":\"NXlog\"}", Settings.Attributes);
 }
+
+TEST(ExtractTopicNames, TopicsOfNestedStreamsAreExtracted) {
+  std::string Structure{R"""({
+    "children": [
+      {
+        "type": "group",
+        "name": "entry",
+        "children": [
+          {
+            "type": "stream",
+            "stream": {"topic": "topic_a", "source": "a", "writer_module": "f142"}
+          },
+          {
+            "type": "group",
+            "name": "instrument",
+            "children": [
+              {
+                "type": "stream",
+                "stream": {"topic": "topic_b", "source": "b", "writer_module": "ev42"}
+              },
+              {
+                "type": "stream",
+                "stream": {"topic": "topic_a", "source": "c", "writer_module": "f142"}
+              }
+            ]
+          }
+        ]
+      }
+    ]
+  })"""};
+
+  auto TopicNames = FileWriter::extractTopicNamesFromNexusStructure(Structure);
+  EXPECT_EQ(TopicNames, (std::set<std::string>{"topic_a", "topic_b"}));
+}
+
+TEST(ExtractTopicNames, InvalidJsonGivesNoTopics) {
+  EXPECT_TRUE(
+      FileWriter::extractTopicNamesFromNexusStructure("{\"children\": [")
+          .empty());
+}
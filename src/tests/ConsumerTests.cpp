@@ -8,6 +8,7 @@
 // Screaming Udder!                              https://esss.se
 
 #include "../Kafka/MetadataException.h"
+#include "FlatbufferMessage.h"
 #include "Kafka/Consumer.h"
 #include "helpers/MockMessage.h"
 #include "helpers/RdKafkaMocks.h"
@@ -39,6 +40,8 @@ TEST_F(ConsumerTests, pollReturnsConsumerMessageWithMessagePollStatus) {
   REQUIRE_CALL(*Message, timestamp()).TIMES(2).RETURN(TimeStamp);
   REQUIRE_CALL(*Message, offset()).TIMES(1).RETURN(1);
   ALLOW_CALL(*Message, partition()).RETURN(0);
+  ALLOW_CALL(*Message, headers()).RETURN(nullptr);
+  ALLOW_CALL(*Message, key_pointer()).RETURN(nullptr);
 
   REQUIRE_CALL(*Message, payload())
       .TIMES(1)
@@ -59,6 +62,86 @@ TEST_F(ConsumerTests, pollReturnsConsumerMessageWithMessagePollStatus) {
   }
 }
 
+class ConsumerRoutingTests : public ConsumerTests {
+protected:
+  void SetUp() override {
+    ConsumerTests::SetUp();
+    TimeStamp.timestamp = 1;
+    TimeStamp.type = RdKafka::MessageTimestamp::MSG_TIMESTAMP_CREATE_TIME;
+  }
+  std::pair<PollStatus, FileWriter::Msg> pollOnce(MockMessage *Message) {
+    ALLOW_CALL(*Message, err()).RETURN(RdKafka::ErrorCode::ERR_NO_ERROR);
+    ALLOW_CALL(*Message, timestamp()).RETURN(TimeStamp);
+    ALLOW_CALL(*Message, offset()).RETURN(1);
+    ALLOW_CALL(*Message, partition()).RETURN(0);
+    ALLOW_CALL(*Message, len()).RETURN(TestPayload.size());
+    REQUIRE_CALL(*RdConsumer, consume(_)).TIMES(1).RETURN(Message);
+    REQUIRE_CALL(*RdConsumer, close()).TIMES(1).RETURN(RdKafka::ERR_NO_ERROR);
+    auto Consumer = std::make_unique<Kafka::Consumer>(
+        std::move(RdConsumer),
+        std::unique_ptr<RdKafka::Conf>(
+            RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL)),
+        std::make_unique<Kafka::KafkaEventCb>());
+    Consumer->setWantedSources(
+        {FileWriter::calcSourceHash("f142", "wanted_source")});
+    return Consumer->poll();
+  }
+  RdKafka::MessageTimestamp TimeStamp;
+  std::string TestPayload{"Test payload"};
+};
+
+TEST_F(ConsumerRoutingTests, payloadOfUnwantedSourceInHeadersIsNotCopied) {
+  auto *Message = new MockMessage;
+  std::unique_ptr<RdKafka::Headers> Headers(RdKafka::Headers::create());
+  Headers->add("source_name", "other_source");
+  Headers->add("schema_id", "f142");
+  ALLOW_CALL(*Message, headers()).RETURN(Headers.get());
+  FORBID_CALL(*Message, payload());
+  auto ConsumedMessage = pollOnce(Message);
+  EXPECT_EQ(ConsumedMessage.first, PollStatus::Message);
+  EXPECT_EQ(ConsumedMessage.second.getMetaData().SourceName, "other_source");
+  EXPECT_EQ(ConsumedMessage.second.getMetaData().FlatbufferID, "f142");
+}
+
+TEST_F(ConsumerRoutingTests, payloadOfUnwantedSourceInKeyIsNotCopied) {
+  auto *Message = new MockMessage;
+  std::string Key{"f142:other_source"};
+  ALLOW_CALL(*Message, headers()).RETURN(nullptr);
+  ALLOW_CALL(*Message, key_pointer()).RETURN(Key.data());
+  ALLOW_CALL(*Message, key_len()).RETURN(Key.size());
+  FORBID_CALL(*Message, payload());
+  auto ConsumedMessage = pollOnce(Message);
+  EXPECT_EQ(ConsumedMessage.second.getMetaData().SourceName, "other_source");
+  EXPECT_EQ(ConsumedMessage.second.getMetaData().FlatbufferID, "f142");
+}
+
+TEST_F(ConsumerRoutingTests, payloadOfWantedSourceIsCopied) {
+  auto *Message = new MockMessage;
+  std::unique_ptr<RdKafka::Headers> Headers(RdKafka::Headers::create());
+  Headers->add("source_name", "wanted_source");
+  Headers->add("schema_id", "f142");
+  ALLOW_CALL(*Message, headers()).RETURN(Headers.get());
+  REQUIRE_CALL(*Message, payload())
+      .TIMES(1)
+      .RETURN(reinterpret_cast<void *>(TestPayload.data()));
+  auto ConsumedMessage = pollOnce(Message);
+  EXPECT_EQ(ConsumedMessage.second.size(), TestPayload.size());
+}
+
+TEST_F(ConsumerRoutingTests, payloadWithoutRoutingInfoIsCopied) {
+  auto *Message = new MockMessage;
+  std::string Key{"some key"};
+  ALLOW_CALL(*Message, headers()).RETURN(nullptr);
+  ALLOW_CALL(*Message, key_pointer()).RETURN(Key.data());
+  ALLOW_CALL(*Message, key_len()).RETURN(Key.size());
+  REQUIRE_CALL(*Message, payload())
+      .TIMES(1)
+      .RETURN(reinterpret_cast<void *>(TestPayload.data()));
+  auto ConsumedMessage = pollOnce(Message);
+  EXPECT_EQ(ConsumedMessage.second.size(), TestPayload.size());
+  EXPECT_FALSE(ConsumedMessage.second.getMetaData().hasRoutingInfo());
+}
+
 TEST_F(ConsumerTests, pollReturnsConsumerMessageWithEmptyPollStatusIfTimedOut) {
   auto *Message = new MockMessage;
   REQUIRE_CALL(*Message, err())
@@ -79,6 +162,26 @@ TEST_F(ConsumerTests, pollReturnsConsumerMessageWithEmptyPollStatusIfTimedOut) {
   }
 }
 
+TEST_F(ConsumerTests, pollReturnsEndOfPartitionPollStatusOnPartitionEOF) {
+  auto *Message = new MockMessage;
+  REQUIRE_CALL(*Message, err())
+      .TIMES(1)
+      .RETURN(RdKafka::ErrorCode::ERR__PARTITION_EOF);
+
+  REQUIRE_CALL(*RdConsumer, consume(_)).TIMES(1).RETURN(Message);
+  REQUIRE_CALL(*RdConsumer, close()).TIMES(1).RETURN(RdKafka::ERR_NO_ERROR);
+  // Put this in scope to call standin destructor
+  {
+    auto Consumer = std::make_unique<Kafka::Consumer>(
+        std::move(RdConsumer),
+        std::unique_ptr<RdKafka::Conf>(
+            RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL)),
+        std::make_unique<Kafka::KafkaEventCb>());
+    auto ConsumedMessage = Consumer->poll();
+    ASSERT_EQ(ConsumedMessage.first, PollStatus::EndOfPartition);
+  }
+}
+
 TEST_F(ConsumerTests,
        pollReturnsConsumerMessageWithErrorPollStatusIfUnknownOrUnexpected) {
   auto *Message = new MockMessage;
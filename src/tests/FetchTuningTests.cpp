@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "Kafka/FetchTuning.h"
+#include <gtest/gtest.h>
+
+using namespace Kafka;
+
+namespace {
+std::uint64_t const MiB{1024 * 1024};
+}
+
+TEST(FetchTuning, LowRateConsumerGetsSmallQueueAndNoFetchMinimum) {
+  auto Fetch = fetchSettingsForRate(2 * 1000, 1000, 1024 * MiB);
+  EXPECT_EQ(Fetch.FetchMaxBytes, 1024 * 1024);
+  EXPECT_EQ(Fetch.FetchMinBytes, 20);
+  EXPECT_EQ(Fetch.FetchWaitMaxMs, 500);
+  EXPECT_EQ(Fetch.QueuedMaxKBytes, 1024);
+}
+
+TEST(FetchTuning, HighRateConsumerIsLimitedByBudget) {
+  auto Fetch = fetchSettingsForRate(400.0 * MiB, 10 * MiB, 256 * MiB);
+  EXPECT_EQ(Fetch.FetchMaxBytes, 52428800);
+  EXPECT_EQ(Fetch.FetchMinBytes, 1024 * 1024);
+  EXPECT_EQ(Fetch.FetchWaitMaxMs, 100);
+  EXPECT_EQ(Fetch.QueuedMaxKBytes, 256 * 1024);
+}
+
+TEST(FetchTuning, UnknownRateUsesFullBudget) {
+  auto Fetch = fetchSettingsForRate(0.0, 0, 64 * MiB);
+  EXPECT_EQ(Fetch.FetchMaxBytes, 16 * 1024 * 1024);
+  EXPECT_EQ(Fetch.QueuedMaxKBytes, 64 * 1024);
+}
+
+TEST(FetchTuning, AppliedSettingsAreConsistent) {
+  BrokerSettings Settings;
+  Settings.KafkaConfiguration.erase("message.max.bytes");
+  Settings.KafkaConfiguration.erase("fetch.message.max.bytes");
+  Settings.KafkaConfiguration.erase("receive.message.max.bytes");
+  auto Fetch = fetchSettingsForRate(2 * 1000, 1000, 1024 * MiB);
+  applyFetchSettings(Fetch, Settings);
+  auto &Configuration = Settings.KafkaConfiguration;
+  EXPECT_EQ(Configuration["fetch.max.bytes"], "1048576");
+  EXPECT_EQ(Configuration["receive.message.max.bytes"], "1049088");
+  EXPECT_EQ(Configuration["queued.max.messages.kbytes"], "1024");
+  EXPECT_EQ(Configuration["fetch.wait.max.ms"], "500");
+  EXPECT_EQ(Configuration["fetch.min.bytes"], "20");
+}
+
+TEST(FetchTuning, ConfiguredMessageSizesAreNotLowered) {
+  BrokerSettings Settings;
+  auto &Configuration = Settings.KafkaConfiguration;
+  Configuration["message.max.bytes"] = "24000000";
+  Configuration["fetch.message.max.bytes"] = "20000000";
+  Configuration["receive.message.max.bytes"] = "100000000";
+  auto Fetch = fetchSettingsForRate(2 * 1000, 1000, 1024 * MiB);
+  auto Applied = applyFetchSettings(Fetch, Settings);
+  EXPECT_EQ(Applied.FetchMaxBytes, 24000000);
+  EXPECT_EQ(Applied.QueuedMaxKBytes, 23438);
+  EXPECT_EQ(Configuration["message.max.bytes"], "24000000");
+  EXPECT_EQ(Configuration["fetch.message.max.bytes"], "20000000");
+  EXPECT_EQ(Configuration["fetch.max.bytes"], "24000000");
+  EXPECT_EQ(Configuration["receive.message.max.bytes"], "100000000");
+}
+
+TEST(FetchTuning, FetchHoldsTheLargestMessage) {
+  auto Fetch = fetchSettingsForRate(1000.0, 8 * MiB, 4 * MiB);
+  EXPECT_EQ(Fetch.FetchMaxBytes, 8 * 1024 * 1024);
+  EXPECT_GE(Fetch.QueuedMaxKBytes, 8 * 1024);
+}
+
+TEST(FetchTuning, BudgetIsSplitByRate) {
+  auto Budgets = splitMemoryBudget({3.0, 1.0, 0.0, 0.0}, 800);
+  EXPECT_EQ(Budgets, (std::vector<std::uint64_t>{300, 100, 200, 200}));
+}
+
+TEST(FetchTuning, BudgetIsSplitEvenlyWithoutKnownRates) {
+  auto Budgets = splitMemoryBudget({0.0, 0.0}, 1000);
+  EXPECT_EQ(Budgets, (std::vector<std::uint64_t>{500, 500}));
+}
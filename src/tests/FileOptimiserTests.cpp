@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "FileOptimiser.h"
+#include "Filesystem.h"
+#include "NeXusDataset/NeXusDataset.h"
+#include <gtest/gtest.h>
+#include <h5cpp/hdf5.hpp>
+
+using namespace FileWriter;
+
+class FileOptimiserTest : public ::testing::Test {
+public:
+  void SetUp() override {
+    auto File =
+        hdf5::file::create(TestFileName, hdf5::file::AccessFlags::TRUNCATE);
+    auto Log = File.root().create_group("log");
+    Log.attributes.create_from<std::string>("NX_class", "NXlog");
+    NeXusDataset::Time Time(Log, NeXusDataset::Mode::Create, 4);
+    NeXusDataset::CueIndex(Log, NeXusDataset::Mode::Create,
+                           4); // NOLINT(bugprone-unused-raii)
+    NeXusDataset::CueTimestampZero(Log, NeXusDataset::Mode::Create,
+                                   4); // NOLINT(bugprone-unused-raii)
+    std::vector<std::uint64_t> Times{10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+    Time.appendArray(Times);
+    // A second hard link, as created for a "link" in the nexus structure.
+    H5Lcreate_hard(static_cast<hid_t>(File.root()), "log/time",
+                   static_cast<hid_t>(File.root()), "time_link", H5P_DEFAULT,
+                   H5P_DEFAULT);
+  }
+  void TearDown() override { fs::remove(TestFileName); }
+  std::string TestFileName{"FileOptimiserTestFile.hdf5"};
+};
+
+TEST_F(FileOptimiserTest, SmallDatasetIsConsolidatedAndCuesAreWritten) {
+  auto Statistics = optimiseFile(TestFileName);
+  EXPECT_EQ(Statistics.CueIndicesWritten, 1u);
+  EXPECT_EQ(Statistics.ConsolidatedDatasets, 3u);
+  EXPECT_FALSE(fs::exists(TestFileName + ".optimising"));
+
+  auto File =
+      hdf5::file::open(TestFileName, hdf5::file::AccessFlags::READONLY);
+  auto Log = File.root().get_group("log");
+  std::string NXClass;
+  Log.attributes["NX_class"].read(NXClass);
+  EXPECT_EQ(NXClass, "NXlog");
+
+  auto Time = Log.get_dataset("time");
+  EXPECT_EQ(Time.creation_list().layout(),
+            hdf5::property::DatasetLayout::COMPACT);
+  std::vector<std::uint64_t> Times(10);
+  Time.read(Times);
+  EXPECT_EQ(Times.front(), 10u);
+  EXPECT_EQ(Times.back(), 19u);
+  EXPECT_TRUE(File.root().has_dataset("time_link"));
+  EXPECT_EQ(File.root().get_dataset("time_link").dataspace().size(), 10);
+
+  // One cue entry per chunk (4 elements) of the time dataset.
+  std::vector<std::uint32_t> CueIndex(3);
+  Log.get_dataset("cue_index").read(CueIndex);
+  EXPECT_EQ(CueIndex, std::vector<std::uint32_t>({0, 4, 8}));
+  std::vector<std::uint64_t> CueTimestampZero(3);
+  Log.get_dataset("cue_timestamp_zero").read(CueTimestampZero);
+  EXPECT_EQ(CueTimestampZero, std::vector<std::uint64_t>({10, 14, 18}));
+}
+
+TEST_F(FileOptimiserTest, StoppedOptimisationLeavesFileAsItIs) {
+  EXPECT_THROW(optimiseFile(TestFileName, [] { return true; }),
+               std::runtime_error);
+  EXPECT_FALSE(fs::exists(TestFileName + ".optimising"));
+  auto File =
+      hdf5::file::open(TestFileName, hdf5::file::AccessFlags::READONLY);
+  EXPECT_EQ(File.root()
+                .get_group("log")
+                .get_dataset("time")
+                .creation_list()
+                .layout(),
+            hdf5::property::DatasetLayout::CHUNKED);
+}
+
+TEST_F(FileOptimiserTest, PermissionsOfTheOriginalAreKept) {
+  auto const Permissions =
+      fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read;
+  fs::permissions(TestFileName, Permissions);
+  optimiseFile(TestFileName);
+  EXPECT_EQ(fs::status(TestFileName).permissions(), Permissions);
+}
+
+TEST_F(FileOptimiserTest, CopyOfLargeContiguousDatasetCanBeStopped) {
+  {
+    auto File =
+        hdf5::file::open(TestFileName, hdf5::file::AccessFlags::READWRITE);
+    // Larger than the blocks in which data is copied.
+    std::vector<double> Values(3 * 1024 * 1024, 1.0);
+    File.root().create_dataset("large", hdf5::datatype::create<double>(),
+                               hdf5::dataspace::create(Values));
+    File.root().get_dataset("large").write(Values);
+  }
+  // Stopped between the blocks of the large dataset, after the check for the
+  // root group and the first block.
+  size_t NrOfChecks{0};
+  EXPECT_THROW(optimiseFile(TestFileName,
+                            [&NrOfChecks] { return ++NrOfChecks > 2; }),
+               std::runtime_error);
+  EXPECT_EQ(NrOfChecks, 3u);
+  EXPECT_FALSE(fs::exists(TestFileName + ".optimising"));
+}
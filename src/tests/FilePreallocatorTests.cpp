@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "FilePreallocator.h"
+#include "Filesystem.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+using namespace FileWriter;
+
+namespace {
+std::uint64_t const MiB{1024 * 1024};
+
+std::uint64_t allocatedBytes(std::string const &Path) {
+  struct stat FileStatus {};
+  stat(Path.c_str(), &FileStatus);
+  return static_cast<std::uint64_t>(FileStatus.st_blocks) * 512;
+}
+} // namespace
+
+class FilePreallocatorTest : public ::testing::Test {
+public:
+  void SetUp() override { std::ofstream(TestFileName, std::ios::binary); }
+  void TearDown() override { fs::remove(TestFileName); }
+  void appendToFile(std::uint64_t Size) {
+    std::ofstream File(TestFileName, std::ios::binary | std::ios::app);
+    File << std::string(Size, 'x');
+  }
+  std::string TestFileName{"FilePreallocatorTestFile.hdf5"};
+  Metrics::Registrar Registrar{"some-app", {}};
+};
+
+TEST(FilePreallocator, FileSizeIsEstimatedFromRateAndDuration) {
+  auto Start = std::chrono::milliseconds(1000);
+  auto Stop = time_point(Start + std::chrono::seconds(10));
+  EXPECT_EQ(estimateFileSize(2.5 * MiB, Start, Stop, MiB), 25 * MiB);
+  EXPECT_EQ(estimateFileSize(2.45 * MiB, Start, Stop, 10 * MiB), 30 * MiB);
+  EXPECT_EQ(estimateFileSize(0.0, Start, Stop, MiB), MiB);
+  EXPECT_EQ(estimateFileSize(2.5 * MiB, Start, time_point::max(), MiB), MiB);
+}
+
+TEST(FilePreallocator, FileSizeIsEstimatedUpToTheHorizon) {
+  auto Start = std::chrono::milliseconds(1000);
+  auto Stop = time_point(Start + std::chrono::hours(24 * 365));
+  EXPECT_EQ(estimateFileSize(2.5 * MiB, Start, Stop, MiB,
+                             std::chrono::seconds(4)),
+            10 * MiB);
+}
+
+TEST_F(FilePreallocatorTest, SpaceIsReservedWithoutChangingTheFileSize) {
+  FilePreallocator Preallocator(TestFileName, MiB, Registrar);
+  Preallocator.reserve(4 * MiB);
+  if (Preallocator.reservedSize() == 0) {
+    GTEST_SKIP() << "Reserving disk space is not supported here.";
+  }
+  EXPECT_EQ(Preallocator.reservedSize(), 4 * MiB);
+  EXPECT_GE(allocatedBytes(TestFileName), 4 * MiB);
+  EXPECT_EQ(fs::file_size(TestFileName), 0u);
+}
+
+TEST_F(FilePreallocatorTest, MoreSpaceIsReservedWhenTheFileGrows) {
+  FilePreallocator Preallocator(TestFileName, MiB, Registrar);
+  Preallocator.reserve(MiB);
+  if (Preallocator.reservedSize() == 0) {
+    GTEST_SKIP() << "Reserving disk space is not supported here.";
+  }
+  Preallocator.update();
+  EXPECT_EQ(Preallocator.reservedSize(), MiB);
+  appendToFile(MiB / 2 + 1);
+  Preallocator.update();
+  EXPECT_EQ(Preallocator.reservedSize(), 3 * MiB / 2 + 1);
+}
+
+TEST_F(FilePreallocatorTest, UnusedSpaceIsReleased) {
+  {
+    FilePreallocator Preallocator(TestFileName, MiB, Registrar);
+    Preallocator.reserve(8 * MiB);
+    if (Preallocator.reservedSize() == 0) {
+      GTEST_SKIP() << "Reserving disk space is not supported here.";
+    }
+    appendToFile(MiB);
+  }
+  EXPECT_EQ(fs::file_size(TestFileName), MiB);
+  EXPECT_LT(allocatedBytes(TestFileName), 2 * MiB);
+}
+
+TEST_F(FilePreallocatorTest, PartOfTheFileSystemIsLeftFree) {
+  FilePreallocator Preallocator(TestFileName, MiB, Registrar, 1.0);
+  Preallocator.reserve(4 * MiB);
+  appendToFile(MiB);
+  Preallocator.update();
+  EXPECT_EQ(Preallocator.reservedSize(), 0u);
+}
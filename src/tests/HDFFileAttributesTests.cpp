@@ -523,3 +523,52 @@ TEST(HDFFileAttributesTest, EmptyStringArrayAttributeWithoutType) {
 }
 
 // Add empty string value test
+
+TEST(HDFFileAttributesTest, SmallStaticDatasetIsCompact) {
+  auto TestFile = HDFFileTestHelper::createInMemoryTestFile("in-mem-file.nxs");
+
+  std::string Command = R""({
+      "children": [
+        {
+          "type": "dataset",
+          "name": "small",
+          "values": [1, 2, 3]
+        },
+        {
+          "type": "dataset",
+          "name": "extensible",
+          "dataset": {"size": ["unlimited"]},
+          "values": [1, 2, 3]
+        }
+      ]
+    })"";
+  std::vector<FileWriter::StreamHDFInfo> EmptyStreamHDFInfo;
+  TestFile.init(Command, EmptyStreamHDFInfo);
+
+  auto Small = hdf5::node::get_dataset(TestFile.RootGroup, "/small");
+  EXPECT_EQ(Small.creation_list().layout(),
+            hdf5::property::DatasetLayout::COMPACT);
+  auto Extensible = hdf5::node::get_dataset(TestFile.RootGroup, "/extensible");
+  EXPECT_EQ(Extensible.creation_list().layout(),
+            hdf5::property::DatasetLayout::CHUNKED);
+}
+
+TEST(HDFFileAttributesTest, ManyAttributesAreWrittenToGroup) {
+  auto TestFile = HDFFileTestHelper::createInMemoryTestFile("in-mem-file.nxs");
+
+  auto Attributes = nlohmann::json::object();
+  for (int i = 0; i < 40; ++i) {
+    Attributes["attr_" + std::to_string(i)] = i;
+  }
+  nlohmann::json Command{
+      {"children",
+       {{{"type", "group"}, {"name", "entry"}, {"attributes", Attributes}}}}};
+  std::vector<FileWriter::StreamHDFInfo> EmptyStreamHDFInfo;
+  TestFile.init(Command, EmptyStreamHDFInfo);
+
+  auto Group = hdf5::node::get_group(TestFile.RootGroup, "/entry");
+  EXPECT_EQ(Group.attributes.size(), 40u);
+  int AttrValue{0};
+  Group.attributes["attr_39"].read(AttrValue);
+  EXPECT_EQ(AttrValue, 39);
+}
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "Metrics/MetricFamily.h"
+#include "Metrics/Registrar.h"
+#include "MockSink.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace std::chrono_literals;
+using trompeloeil::_;
+
+namespace Metrics {
+
+class MetricFamilyTest : public ::testing::Test {
+public:
+  FamilyDefinition Definition{
+      "test_family",
+      {{"first", "First counter.", Severity::DEBUG, {LogTo::LOG_MSG}},
+       {"second", "Second counter.", Severity::ERROR, {LogTo::CARBON}}}};
+};
+
+TEST_F(MetricFamilyTest, CountersOfInstancesAreIndependent) {
+  Registrar TestRegistrar("prefix", {});
+  auto First = TestRegistrar.getLabelledRegistrar("topic", "a")
+                   .addFamilyInstance(Definition);
+  auto Second = TestRegistrar.getLabelledRegistrar("topic", "b")
+                    .addFamilyInstance(Definition);
+  auto FirstCounter = First[0];
+  FirstCounter++;
+  FirstCounter += 2;
+  EXPECT_EQ(int(First[0]), 3);
+  EXPECT_EQ(int(First[1]), 0);
+  EXPECT_EQ(int(Second[0]), 0);
+}
+
+TEST_F(MetricFamilyTest, RemovedInstanceIsReusedWithCountersReset) {
+  MetricFamily UnderTest("prefix", Definition);
+  auto Instance = UnderTest.addInstance({"a"});
+  UnderTest.counter(Instance, 1)->store(5);
+  UnderTest.removeInstance(Instance);
+  auto NewInstance = UnderTest.addInstance({"b"});
+  EXPECT_EQ(NewInstance, Instance);
+  EXPECT_EQ(UnderTest.counter(NewInstance, 1)->load(), 0);
+}
+
+TEST_F(MetricFamilyTest, UnconnectedCounterCanBeUsed) {
+  Counter UnderTest;
+  UnderTest++;
+  FamilyInstance NoInstance;
+  auto OtherCounter = NoInstance[0];
+  OtherCounter++;
+}
+
+TEST_F(MetricFamilyTest, CountersAreReportedWithLabelsInTheName) {
+  auto TestSink = std::unique_ptr<Sink>(new MockSink());
+  auto TestMockSink = dynamic_cast<MockSink *>(TestSink.get());
+  auto TestReporter = std::make_shared<Reporter>(std::move(TestSink), 10ms);
+  Registrar TestRegistrar("prefix", {TestReporter});
+  ALLOW_CALL(*TestMockSink, reportMetric(_));
+  REQUIRE_CALL(*TestMockSink, reportMetric(_))
+      .WITH(_1.FullName == "prefix.some_topic.partition_0.first")
+      .TIMES(AT_LEAST(1));
+  {
+    auto Instance = TestRegistrar.getLabelledRegistrar("topic", "some_topic")
+                        .getLabelledRegistrar("partition", "partition_0")
+                        .addFamilyInstance(Definition);
+    std::this_thread::sleep_for(100ms);
+  }
+  // The family has removed itself from the reporter.
+  FORBID_CALL(*TestMockSink, reportMetric(_))
+      .WITH(_1.FullName == "prefix.some_topic.partition_0.first");
+  std::this_thread::sleep_for(50ms);
+}
+
+TEST_F(MetricFamilyTest, FamilyIsOnlyAddedOnceToReporter) {
+  auto TestSink = std::unique_ptr<Sink>(new MockSink());
+  auto TestMockSink = dynamic_cast<MockSink *>(TestSink.get());
+  auto TestReporter = std::make_shared<Reporter>(std::move(TestSink), 1000ms);
+  ALLOW_CALL(*TestMockSink, reportMetric(_));
+  Registrar TestRegistrar("prefix", {TestReporter});
+  auto First = TestRegistrar.getLabelledRegistrar("topic", "a")
+                   .addFamilyInstance(Definition);
+  auto Second = TestRegistrar.getLabelledRegistrar("topic", "b")
+                    .addFamilyInstance(Definition);
+  MetricFamily OtherFamily("prefix", Definition);
+  EXPECT_TRUE(TestReporter->addFamily(OtherFamily));
+  EXPECT_FALSE(TestReporter->addFamily(OtherFamily));
+  EXPECT_TRUE(TestReporter->tryRemoveFamily(OtherFamily));
+  EXPECT_FALSE(TestReporter->tryRemoveFamily(OtherFamily));
+}
+
+TEST_F(MetricFamilyTest, NewFamilyIsReportedWhileOldFamilyIsRemoved) {
+  auto TestSink = std::unique_ptr<Sink>(new MockSink());
+  auto TestMockSink = dynamic_cast<MockSink *>(TestSink.get());
+  auto TestReporter = std::make_shared<Reporter>(std::move(TestSink), 10ms);
+  ALLOW_CALL(*TestMockSink, reportMetric(_));
+  auto OldFamily = std::make_unique<MetricFamily>("prefix", Definition);
+  OldFamily->setReporters({TestReporter});
+  EXPECT_TRUE(TestReporter->addFamily(*OldFamily));
+  // A family with the same name is added before the old one has been
+  // destructed, e.g. by the next job.
+  MetricFamily NewFamily("prefix", Definition);
+  EXPECT_TRUE(TestReporter->addFamily(NewFamily));
+  NewFamily.addInstance({"a"});
+  OldFamily.reset();
+  REQUIRE_CALL(*TestMockSink, reportMetric(_))
+      .WITH(_1.FullName == "prefix.a.first")
+      .TIMES(AT_LEAST(1));
+  std::this_thread::sleep_for(100ms);
+  EXPECT_TRUE(TestReporter->tryRemoveFamily(NewFamily));
+}
+
+} // namespace Metrics
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "NeXusDataset/DatasetPool.h"
+#include <gtest/gtest.h>
+#include <optional>
+#include <stdexcept>
+
+using NeXusDataset::DatasetPool;
+
+class PoolMemberStandIn : public DatasetPool::Member {
+public:
+  explicit PoolMemberStandIn(size_t NrOfDatasets)
+      : NrOfDatasetsOpened(NrOfDatasets) {}
+  size_t nrOfDatasets() const override { return NrOfDatasetsOpened; }
+  void openDatasets() override {
+    if (FailToOpen) {
+      throw std::runtime_error("Unable to open datasets.");
+    }
+    IsOpen = true;
+    if (NrOfDatasetsWhenOpened) {
+      NrOfDatasetsOpened = *NrOfDatasetsWhenOpened;
+    }
+  }
+  void closeDatasets() override { IsOpen = false; }
+  size_t NrOfDatasetsOpened;
+  std::optional<size_t> NrOfDatasetsWhenOpened;
+  bool IsOpen{false};
+  bool FailToOpen{false};
+};
+
+TEST(DatasetPool, LeastRecentlyUsedMemberIsClosed) {
+  DatasetPool Pool(6);
+  PoolMemberStandIn First(3), Second(3), Third(3);
+  Pool.use(First);
+  Pool.use(Second);
+  Pool.use(First);
+  EXPECT_EQ(Pool.nrOfOpenDatasets(), 6u);
+  Pool.use(Third);
+  EXPECT_TRUE(First.IsOpen);
+  EXPECT_FALSE(Second.IsOpen);
+  EXPECT_TRUE(Third.IsOpen);
+  EXPECT_EQ(Pool.nrOfOpenDatasets(), 6u);
+  EXPECT_EQ(Pool.nrOfOpens(), 3u);
+}
+
+TEST(DatasetPool, MemberWithMoreDatasetsThanTheLimitIsOpened) {
+  DatasetPool Pool(2);
+  PoolMemberStandIn Small(1), Large(3);
+  Pool.use(Small);
+  Pool.use(Large);
+  EXPECT_FALSE(Small.IsOpen);
+  EXPECT_TRUE(Large.IsOpen);
+  EXPECT_EQ(Pool.nrOfOpenDatasets(), 3u);
+}
+
+TEST(DatasetPool, RemovedMemberIsNotClosed) {
+  DatasetPool Pool(3);
+  PoolMemberStandIn First(3), Second(3);
+  Pool.use(First);
+  Pool.remove(First);
+  EXPECT_EQ(Pool.nrOfOpenDatasets(), 0u);
+  Pool.use(Second);
+  EXPECT_TRUE(First.IsOpen);
+}
+
+TEST(DatasetPool, MemberThatFailsToOpenIsNotAdded) {
+  DatasetPool Pool(3);
+  PoolMemberStandIn Member(3);
+  Member.FailToOpen = true;
+  EXPECT_THROW(Pool.use(Member), std::runtime_error);
+  EXPECT_EQ(Pool.nrOfOpenDatasets(), 0u);
+  EXPECT_EQ(Pool.nrOfOpens(), 0u);
+}
+
+TEST(DatasetPool, DatasetsAreCountedOnceOpened) {
+  DatasetPool Pool(4);
+  PoolMemberStandIn First(3), Second(0);
+  Second.NrOfDatasetsWhenOpened = 2;
+  Pool.use(First);
+  Pool.use(Second);
+  EXPECT_FALSE(First.IsOpen);
+  EXPECT_TRUE(Second.IsOpen);
+  EXPECT_EQ(Pool.nrOfOpenDatasets(), 2u);
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "NeXusDataset/DirectoryStore.h"
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <zlib.h>
+
+using NeXusDataset::ChunkWriterPool;
+using NeXusDataset::DirectoryStore;
+
+class DirectoryStoreTest : public ::testing::Test {
+public:
+  void TearDown() override { fs::remove_all(StorePath); }
+
+  template <typename T> std::vector<T> readChunk(std::string const &Name) {
+    std::ifstream File((StorePath / Name).string(), std::ios::binary);
+    std::vector<char> Bytes((std::istreambuf_iterator<char>(File)),
+                            std::istreambuf_iterator<char>());
+    std::vector<T> Values(Bytes.size() / sizeof(T));
+    std::memcpy(Values.data(), Bytes.data(), Values.size() * sizeof(T));
+    return Values;
+  }
+
+  nlohmann::json readMetadata() {
+    std::ifstream MetadataFile((StorePath / ".zarray").string());
+    return nlohmann::json::parse(MetadataFile);
+  }
+
+  fs::path StorePath{"DirectoryStoreTest.chunks"};
+};
+
+TEST_F(DirectoryStoreTest, ZarrDataTypes) {
+  EXPECT_EQ(NeXusDataset::zarrDataType<std::uint32_t>(), "<u4");
+  EXPECT_EQ(NeXusDataset::zarrDataType<std::int64_t>(), "<i8");
+  EXPECT_EQ(NeXusDataset::zarrDataType<double>(), "<f8");
+  EXPECT_EQ(NeXusDataset::zarrDataType<std::uint8_t>(), "|u1");
+}
+
+TEST_F(DirectoryStoreTest, ChunksAndMetadataAreWritten) {
+  std::vector<std::uint32_t> Values{1, 2, 3, 4, 5, 6, 7};
+  {
+    DirectoryStore<std::uint32_t> Store(StorePath, 3,
+                                        std::make_shared<ChunkWriterPool>(2));
+    Store.appendArray({Values.data(), 2});
+    Store.appendArray({Values.data() + 2, Values.size() - 2});
+    EXPECT_EQ(Store.size(), Values.size());
+  }
+  EXPECT_EQ(readChunk<std::uint32_t>("0"),
+            std::vector<std::uint32_t>({1, 2, 3}));
+  EXPECT_EQ(readChunk<std::uint32_t>("1"),
+            std::vector<std::uint32_t>({4, 5, 6}));
+  // The last chunk is padded.
+  EXPECT_EQ(readChunk<std::uint32_t>("2"),
+            std::vector<std::uint32_t>({7, 0, 0}));
+  EXPECT_FALSE(fs::exists(StorePath / "3"));
+
+  auto Metadata = readMetadata();
+  EXPECT_EQ(Metadata["zarr_format"], 2);
+  EXPECT_EQ(Metadata["shape"], nlohmann::json::array({7}));
+  EXPECT_EQ(Metadata["chunks"], nlohmann::json::array({3}));
+  EXPECT_EQ(Metadata["dtype"], "<u4");
+}
+
+TEST_F(DirectoryStoreTest, LastChunkIsRewrittenWhenFull) {
+  std::vector<double> Values{1.5, 2.5, 3.5};
+  DirectoryStore<double> Store(StorePath, 2, nullptr);
+  Store.appendArray({Values.data(), 1});
+  Store.flush();
+  EXPECT_EQ(readChunk<double>("0"), std::vector<double>({1.5, 0}));
+  Store.appendArray({Values.data() + 1, 2});
+  Store.flush();
+  EXPECT_EQ(readChunk<double>("0"), std::vector<double>({1.5, 2.5}));
+  EXPECT_EQ(readChunk<double>("1"), std::vector<double>({3.5, 0}));
+}
+
+TEST_F(DirectoryStoreTest, MetadataIsUpdatedForWrittenChunks) {
+  std::vector<std::uint16_t> Values{1, 2, 3, 4, 5};
+  DirectoryStore<std::uint16_t> Store(StorePath, 2, nullptr);
+  Store.appendArray({Values.data(), 1});
+  Store.updateMetadata();
+  EXPECT_EQ(readMetadata()["shape"], nlohmann::json::array({0}));
+  Store.appendArray({Values.data() + 1, 4});
+  Store.updateMetadata();
+  // Only full chunks are included.
+  EXPECT_EQ(readMetadata()["shape"], nlohmann::json::array({4}));
+  Store.flush();
+  EXPECT_EQ(readMetadata()["shape"], nlohmann::json::array({5}));
+}
+
+TEST_F(DirectoryStoreTest, ChunksAreCompressed) {
+  std::vector<std::uint32_t> Values(1000, 7);
+  {
+    DirectoryStore<std::uint32_t> Store(StorePath, Values.size(), nullptr, 6);
+    Store.appendArray({Values.data(), Values.size()});
+  }
+  EXPECT_EQ(readMetadata()["compressor"],
+            nlohmann::json({{"id", "zlib"}, {"level", 6}}));
+  auto Compressed = readChunk<char>("0");
+  EXPECT_LT(Compressed.size(), Values.size() * sizeof(std::uint32_t));
+  std::vector<std::uint32_t> Decompressed(Values.size());
+  uLongf DecompressedSize = Decompressed.size() * sizeof(std::uint32_t);
+  ASSERT_EQ(uncompress(reinterpret_cast<Bytef *>(Decompressed.data()),
+                       &DecompressedSize,
+                       reinterpret_cast<Bytef const *>(Compressed.data()),
+                       Compressed.size()),
+            Z_OK);
+  EXPECT_EQ(Decompressed, Values);
+}
+
+TEST(ChunkWriterPool, StoresShareOnePool) {
+  auto First = ChunkWriterPool::shared(2);
+  auto Second = ChunkWriterPool::shared(3);
+  EXPECT_EQ(First, Second);
+  EXPECT_EQ(First->nrOfThreads(), 3u);
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "SourceProfile.h"
+#include <gtest/gtest.h>
+
+using FileWriter::SourceProfile;
+using FileWriter::SourceProfileStore;
+
+TEST(SourceProfileTests, RateAndSizeFromMessages) {
+  SourceProfile UnderTest;
+  UnderTest.addMessage(100, 1'000'000'000);
+  UnderTest.addMessage(300, 1'500'000'000);
+  UnderTest.addMessage(200, 2'000'000'000);
+  EXPECT_EQ(UnderTest.Messages, 3u);
+  EXPECT_EQ(UnderTest.MaxMessageSize, 300u);
+  EXPECT_DOUBLE_EQ(UnderTest.messageRate(), 2.0);
+  EXPECT_DOUBLE_EQ(UnderTest.meanMessageSize(), 200.0);
+  EXPECT_TRUE(UnderTest.isUsable());
+}
+
+TEST(SourceProfileTests, SingleMessageIsNotUsable) {
+  SourceProfile UnderTest;
+  UnderTest.addMessage(100, 1'000'000'000);
+  EXPECT_DOUBLE_EQ(UnderTest.messageRate(), 0.0);
+  EXPECT_FALSE(UnderTest.isUsable());
+}
+
+TEST(SourceProfileTests, ChunkSizeIsPowerOfTwoWithinLimits) {
+  EXPECT_EQ(FileWriter::chunkSizeForRate(0.0, 10.0, 64, 1024), 64u);
+  EXPECT_EQ(FileWriter::chunkSizeForRate(10.0, 10.0, 64, 1024), 128u);
+  EXPECT_EQ(FileWriter::chunkSizeForRate(1e6, 10.0, 64, 1024), 1024u);
+}
+
+TEST(SourceProfileStoreTests, UnusableProfileDoesNotReplaceExisting) {
+  SourceProfileStore UnderTest("");
+  auto Key = SourceProfileStore::key("topic", "source", "ev42");
+  SourceProfile Good;
+  Good.addMessage(10, 0);
+  Good.addMessage(10, 1'000'000'000);
+  UnderTest.record(Key, Good);
+  UnderTest.record(Key, SourceProfile());
+  auto Result = UnderTest.find(Key);
+  ASSERT_TRUE(Result.has_value());
+  EXPECT_EQ(Result->Messages, 2u);
+  EXPECT_FALSE(UnderTest.find("other").has_value());
+}
+
+TEST(SourceProfileStoreTests, JsonRoundTrip) {
+  SourceProfileStore Original("");
+  auto Key = SourceProfileStore::key("topic", "source", "f142");
+  SourceProfile Profile;
+  Profile.addMessage(40, 5);
+  Profile.addMessage(60, 10);
+  Original.record(Key, Profile);
+
+  SourceProfileStore UnderTest("");
+  UnderTest.fromJsonString(Original.toJsonString());
+  auto Result = UnderTest.find(Key);
+  ASSERT_TRUE(Result.has_value());
+  EXPECT_EQ(Result->Messages, Profile.Messages);
+  EXPECT_EQ(Result->Bytes, Profile.Bytes);
+  EXPECT_EQ(Result->MaxMessageSize, Profile.MaxMessageSize);
+  EXPECT_EQ(Result->FirstTimestamp, Profile.FirstTimestamp);
+  EXPECT_EQ(Result->LastTimestamp, Profile.LastTimestamp);
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "FlatbufferReader.h"
+#include "Stream/DecodePool.h"
+#include "helpers/SetExtractorModule.h"
+#include <array>
+#include <gtest/gtest.h>
+
+class ddddFbReader : public FileWriter::FlatbufferReader {
+public:
+  bool verify(FileWriter::FlatbufferMessage const &Message) const override {
+    return Message.size() > 8;
+  }
+  std::string
+  source_name(FileWriter::FlatbufferMessage const &) const override {
+    return "some_source";
+  }
+  uint64_t timestamp(FileWriter::FlatbufferMessage const &) const override {
+    return 1;
+  }
+};
+
+class DecodePoolTest : public ::testing::Test {
+public:
+  void SetUp() override { setExtractorModule<ddddFbReader>("dddd"); }
+  std::array<char, 9> ValidData{'d', 'd', 'd', 'd', 'd', 'd', 'd', 'd', 'd'};
+  std::array<char, 8> InvalidData{'d', 'd', 'd', 'd', 'd', 'd', 'd', 'd'};
+};
+
+TEST_F(DecodePoolTest, SmallMessagesAreNotDecodedInParallel) {
+  Stream::DecodePool UnderTest(2, 100);
+  EXPECT_FALSE(UnderTest.shouldDecodeInParallel(99));
+  EXPECT_TRUE(UnderTest.shouldDecodeInParallel(100));
+}
+
+TEST_F(DecodePoolTest, NothingIsDecodedInParallelWithoutThreads) {
+  Stream::DecodePool UnderTest(0, 100);
+  EXPECT_FALSE(UnderTest.shouldDecodeInParallel(1000));
+}
+
+TEST_F(DecodePoolTest, ValidMessageIsDecoded) {
+  Stream::DecodePool UnderTest(2, 0);
+  auto Result = UnderTest.decode(
+      FileWriter::Msg(ValidData.data(), ValidData.size()));
+  auto Message = Result.get();
+  EXPECT_TRUE(Message.isValid());
+  EXPECT_EQ(Message.getSourceName(), "some_source");
+  EXPECT_EQ(Message.size(), ValidData.size());
+}
+
+TEST_F(DecodePoolTest, InvalidMessageThrowsWhenResultIsRetrieved) {
+  Stream::DecodePool UnderTest(2, 0);
+  auto Result = UnderTest.decode(
+      FileWriter::Msg(InvalidData.data(), InvalidData.size()));
+  EXPECT_THROW(Result.get(), FileWriter::NotValidFlatbuffer);
+}
+
+TEST_F(DecodePoolTest, MessagesAreDecodedWithoutThreads) {
+  Stream::DecodePool UnderTest(0, 0);
+  auto Result = UnderTest.decode(
+      FileWriter::Msg(ValidData.data(), ValidData.size()));
+  EXPECT_TRUE(Result.get().isValid());
+}
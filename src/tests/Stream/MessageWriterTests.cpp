@@ -12,7 +12,9 @@
 #include "WriterModuleBase.h"
 #include "helpers/SetExtractorModule.h"
 #include <array>
+#include <future>
 #include <gtest/gtest.h>
+#include <thread>
 #include <trompeloeil.hpp>
 
 class WriterModuleStandIn : public WriterModule::Base {
@@ -24,12 +26,14 @@ public:
              override);
   MAKE_MOCK1(reopen, WriterModule::InitResult(hdf5::node::Group &), override);
   MAKE_MOCK1(write, void(FileWriter::FlatbufferMessage const &), override);
+  MAKE_MOCK0(flush, void(), override);
 };
 
 class DataMessageWriterStandIn : public Stream::MessageWriter {
 public:
-  explicit DataMessageWriterStandIn(Metrics::Registrar const &Registrar)
-      : MessageWriter(Registrar) {}
+  explicit DataMessageWriterStandIn(Metrics::Registrar const &Registrar,
+                                    size_t MaxQueuedMessages = 1024)
+      : MessageWriter(Registrar, MaxQueuedMessages) {}
   using MessageWriter::Executor;
 };
 
@@ -114,3 +118,93 @@ TEST_F(DataMessageWriterTest, WriteMessageExceptionKnownFb) {
     });
   }
 }
+
+TEST_F(DataMessageWriterTest, MessagesAreWrittenInOrder) {
+  std::array<uint8_t, 9> FirstData{'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'};
+  std::array<uint8_t, 10> SecondData{'x', 'x', 'x', 'x', 'x',
+                                     'x', 'x', 'x', 'x', 'x'};
+  setExtractorModule<xxxFbReader>("xxxx");
+  auto Destination =
+      reinterpret_cast<Stream::Message::DestPtrType>(&WriterModule);
+  trompeloeil::sequence Sequence;
+  REQUIRE_CALL(WriterModule, write(_))
+      .WITH(_1.size() == FirstData.size())
+      .IN_SEQUENCE(Sequence);
+  REQUIRE_CALL(WriterModule, write(_))
+      .WITH(_1.size() == SecondData.size())
+      .IN_SEQUENCE(Sequence);
+  {
+    DataMessageWriterStandIn Writer{MetReg};
+    Writer.addMessage(
+        {Destination,
+         FileWriter::FlatbufferMessage(FirstData.data(), FirstData.size())});
+    Writer.addMessage(
+        {Destination,
+         FileWriter::FlatbufferMessage(SecondData.data(), SecondData.size())});
+    Writer.Executor.sendWork(
+        [&Writer]() { EXPECT_TRUE(Writer.nrOfWritesDone() == 2); });
+  }
+}
+
+TEST_F(DataMessageWriterTest, ModulesThatWereWrittenToAreFlushed) {
+  WriterModuleStandIn OtherWriterModule;
+  trompeloeil::sequence Sequence;
+  REQUIRE_CALL(WriterModule, write(_)).IN_SEQUENCE(Sequence);
+  REQUIRE_CALL(WriterModule, flush()).IN_SEQUENCE(Sequence);
+  FORBID_CALL(OtherWriterModule, flush());
+  {
+    DataMessageWriterStandIn Writer{MetReg};
+    Writer.addMessage(
+        {reinterpret_cast<Stream::Message::DestPtrType>(&WriterModule),
+         FileWriter::FlatbufferMessage()});
+    Writer.flushModules();
+  }
+}
+
+TEST_F(DataMessageWriterTest, ManyProducersDoNotExhaustTheQueue) {
+  // More producer threads than fit in the queue, each of which would claim
+  // a block of slots in an unbounded concurrent queue.
+  size_t const NrOfProducers{48};
+  size_t const MessagesPerProducer{20};
+  ALLOW_CALL(WriterModule, write(_));
+  auto Destination =
+      reinterpret_cast<Stream::Message::DestPtrType>(&WriterModule);
+  DataMessageWriterStandIn Writer{MetReg, 16};
+  std::vector<std::thread> Producers;
+  for (size_t i = 0; i < NrOfProducers; ++i) {
+    Producers.emplace_back([&Writer, Destination, MessagesPerProducer]() {
+      for (size_t j = 0; j < MessagesPerProducer; ++j) {
+        Writer.addMessage({Destination, FileWriter::FlatbufferMessage()});
+      }
+    });
+  }
+  for (auto &Producer : Producers) {
+    Producer.join();
+  }
+  auto const Expected = int64_t(NrOfProducers * MessagesPerProducer);
+  for (int i = 0; i < 500 and Writer.nrOfWritesDone() < Expected; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(Writer.nrOfWritesDone(), Expected);
+}
+
+TEST_F(DataMessageWriterTest, FullQueueBlocksUntilTheWriterMakesRoom) {
+  ALLOW_CALL(WriterModule, write(_));
+  auto Destination =
+      reinterpret_cast<Stream::Message::DestPtrType>(&WriterModule);
+  DataMessageWriterStandIn Writer{MetReg, 1};
+  std::promise<void> ReleaseWriter;
+  auto WriterReleased = ReleaseWriter.get_future().share();
+  Writer.Executor.sendWork([WriterReleased]() { WriterReleased.wait(); });
+  Writer.addMessage({Destination, FileWriter::FlatbufferMessage()});
+  std::atomic_bool SecondMessageAdded{false};
+  std::thread Producer([&Writer, Destination, &SecondMessageAdded]() {
+    Writer.addMessage({Destination, FileWriter::FlatbufferMessage()});
+    SecondMessageAdded = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(SecondMessageAdded);
+  ReleaseWriter.set_value();
+  Producer.join();
+  EXPECT_TRUE(SecondMessageAdded);
+}
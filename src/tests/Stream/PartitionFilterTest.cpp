@@ -108,3 +108,60 @@ TEST_F(PartitionFilterTest, PartitionShouldStopNotOnErrorOutsideLeeway) {
   UnderTest.setStopTime(std::chrono::system_clock::now() - 15ms);
   EXPECT_FALSE(UnderTest.shouldStopPartition(Kafka::PollStatus::Error));
 }
+
+TEST_F(PartitionFilterTest, EndOfPartitionBeforeStopTimeIsNotTheEnd) {
+  EXPECT_FALSE(
+      UnderTest.shouldStopPartition(Kafka::PollStatus::EndOfPartition));
+  EXPECT_FALSE(UnderTest.hasReachedEndAfterStop());
+}
+
+TEST(PartitionFilterEndTest, EndOfPartitionAfterNewerMessageIsTheEnd) {
+  auto Now = std::chrono::system_clock::now();
+  Stream::PartitionFilter UnderTest{Now - 5ms, 10s, 20ms};
+  UnderTest.setLastMessageTime(Now + 2s);
+  EXPECT_FALSE(
+      UnderTest.shouldStopPartition(Kafka::PollStatus::EndOfPartition));
+  EXPECT_TRUE(UnderTest.hasReachedEndAfterStop());
+}
+
+TEST(PartitionFilterEndTest, EndOfPartitionWaitsForGraceAfterMessageNearStop) {
+  // Messages from other producers, with older timestamps, may still arrive.
+  auto Now = std::chrono::system_clock::now();
+  Stream::PartitionFilter UnderTest{Now - 5ms, 10s, 20ms};
+  UnderTest.setEndOfPartitionGrace(30ms);
+  UnderTest.setLastMessageTime(Now);
+  UnderTest.shouldStopPartition(Kafka::PollStatus::EndOfPartition);
+  EXPECT_FALSE(UnderTest.hasReachedEndAfterStop());
+  std::this_thread::sleep_for(40ms);
+  EXPECT_TRUE(UnderTest.hasReachedEndAfterStop());
+}
+
+TEST(PartitionFilterEndTest, MessageAfterEndOfPartitionResetsTheEnd) {
+  auto Now = std::chrono::system_clock::now();
+  Stream::PartitionFilter UnderTest{Now - 5ms, 10s, 20ms};
+  UnderTest.setLastMessageTime(Now + 2s);
+  UnderTest.shouldStopPartition(Kafka::PollStatus::EndOfPartition);
+  UnderTest.shouldStopPartition(Kafka::PollStatus::Message);
+  EXPECT_FALSE(UnderTest.hasReachedEndAfterStop());
+}
+
+TEST(PartitionFilterEndTest, EndOfPartitionWaitsForGraceIfNoNewerMessage) {
+  auto Now = std::chrono::system_clock::now();
+  Stream::PartitionFilter UnderTest{Now - 5ms, 30ms, 20ms};
+  UnderTest.setLastMessageTime(Now - 10ms);
+  EXPECT_FALSE(
+      UnderTest.shouldStopPartition(Kafka::PollStatus::EndOfPartition));
+  EXPECT_FALSE(UnderTest.hasReachedEndAfterStop());
+  std::this_thread::sleep_for(40ms);
+  EXPECT_TRUE(UnderTest.hasReachedEndAfterStop());
+}
+
+TEST(PartitionFilterEndTest, EndOfPartitionGraceIsConfigurable) {
+  auto Now = std::chrono::system_clock::now();
+  Stream::PartitionFilter UnderTest{Now - 5ms, 10s, 20ms};
+  UnderTest.setEndOfPartitionGrace(10ms);
+  UnderTest.setLastMessageTime(Now - 10ms);
+  UnderTest.shouldStopPartition(Kafka::PollStatus::EndOfPartition);
+  std::this_thread::sleep_for(20ms);
+  EXPECT_TRUE(UnderTest.hasReachedEndAfterStop());
+}
@@ -55,23 +55,29 @@ public:
                    Stream::SrcToDst const &Map, Stream::MessageWriter *Writer,
                    Metrics::Registrar RegisterMetric, time_point Start,
                    time_point Stop, duration StopLeeway,
-                   duration KafkaErrorTimeout)
+                   duration KafkaErrorTimeout,
+                   std::shared_ptr<Stream::DecodePool> Decoders = nullptr)
       : Stream::Partition(std::move(Consumer), Partition, std::move(TopicName),
                           Map, Writer, std::move(RegisterMetric), Start, Stop,
-                          StopLeeway, KafkaErrorTimeout) {}
+                          StopLeeway, KafkaErrorTimeout, nullptr,
+                          std::move(Decoders)) {}
   void addPollTask() override {
     // Do nothing as don't want to automatically poll again
   }
   using Partition::ConsumerPtr;
+  using Partition::DecodedMessages;
   using Partition::Executor;
   using Partition::FlatbufferErrors;
+  using Partition::forwardDecodedMessages;
   using Partition::KafkaErrors;
   using Partition::KafkaTimeouts;
   using Partition::MessagesProcessed;
   using Partition::MessagesReceived;
+  using Partition::MessagesSkipped;
   using Partition::MsgFilters;
   using Partition::pollForMessage;
   using Partition::processMessage;
+  using Partition::queueMessage;
   using Partition::StopTime;
   using Partition::StopTimeLeeway;
 };
@@ -90,7 +96,7 @@ class MessageWriterStandIn : public Stream::MessageWriter {
 public:
   MessageWriterStandIn()
       : Stream::MessageWriter(Metrics::Registrar("test", {})) {}
-  void addMessage(Stream::Message const &) override {}
+  void addMessage(Stream::Message) override {}
 
 protected:
   void writeMsgImpl(WriterModule::Base *,
@@ -246,6 +252,60 @@ TEST_F(PartitionTest, MessageAfterStopLeewayTriggersFinished) {
   EXPECT_TRUE(UnderTest->hasFinished());
 }
 
+TEST_F(PartitionTest, EndOfPartitionAfterStopFinishesAtHighWatermark) {
+  Stop = Start - 2s;
+  Kafka::MockConsumer::PollReturnType PollReturn;
+  PollReturn.first = Kafka::PollStatus::EndOfPartition;
+  auto UnderTest = createTestedInstance(Stop);
+  REQUIRE_CALL(*Consumer, poll()).TIMES(1).LR_RETURN(std::move(PollReturn));
+  REQUIRE_CALL(*Consumer, hasReachedHighWatermark(TopicName, UsedPartitionId))
+      .TIMES(1)
+      .RETURN(true);
+  UnderTest->pollForMessage();
+  EXPECT_TRUE(UnderTest->hasFinished());
+}
+
+TEST_F(PartitionTest, EndOfPartitionAfterStopNotFinishedBelowHighWatermark) {
+  Stop = Start - 2s;
+  Kafka::MockConsumer::PollReturnType PollReturn;
+  PollReturn.first = Kafka::PollStatus::EndOfPartition;
+  auto UnderTest = createTestedInstance(Stop);
+  REQUIRE_CALL(*Consumer, poll()).TIMES(1).LR_RETURN(std::move(PollReturn));
+  REQUIRE_CALL(*Consumer, hasReachedHighWatermark(TopicName, UsedPartitionId))
+      .TIMES(1)
+      .RETURN(false);
+  UnderTest->pollForMessage();
+  EXPECT_FALSE(UnderTest->hasFinished());
+}
+
+TEST_F(PartitionTest, HighWatermarkIsQueriedOncePerGracePeriod) {
+  Stop = Start - 2s;
+  auto UnderTest = createTestedInstance(Stop);
+  UnderTest->setEndOfPartitionGrace(1500ms);
+  REQUIRE_CALL(*Consumer, poll())
+      .TIMES(3)
+      .RETURN(Kafka::MockConsumer::PollReturnType{
+          Kafka::PollStatus::EndOfPartition, FileWriter::Msg{}});
+  REQUIRE_CALL(*Consumer, hasReachedHighWatermark(TopicName, UsedPartitionId))
+      .TIMES(1)
+      .RETURN(false);
+  UnderTest->pollForMessage();
+  UnderTest->pollForMessage();
+  UnderTest->pollForMessage();
+  EXPECT_FALSE(UnderTest->hasFinished());
+}
+
+TEST_F(PartitionTest, EndOfPartitionBeforeStopIsIgnored) {
+  Stop = Start + 20s;
+  Kafka::MockConsumer::PollReturnType PollReturn;
+  PollReturn.first = Kafka::PollStatus::EndOfPartition;
+  auto UnderTest = createTestedInstance(Stop);
+  REQUIRE_CALL(*Consumer, poll()).TIMES(1).LR_RETURN(std::move(PollReturn));
+  FORBID_CALL(*Consumer, hasReachedHighWatermark(_, _));
+  UnderTest->pollForMessage();
+  EXPECT_FALSE(UnderTest->hasFinished());
+}
+
 TEST_F(PartitionTest, FiltersAreInitialisedWithOriginalStoptime) {
   auto StopTime = Start + 100s;
   auto UnderTest = createTestedInstance(StopTime);
@@ -294,6 +354,52 @@ TEST_F(PartitionTest, IfSourceHashIsKnownThenItIsProcessed) {
   EXPECT_EQ(int(UnderTest->MessagesProcessed), 1);
 }
 
+TEST_F(PartitionTest, MessagesDecodedInParallelAreProcessedInOrder) {
+  Kafka::BrokerSettings BrokerSettingsForTest;
+  auto UnderTest = std::make_unique<PartitionStandIn>(
+      std::make_unique<Kafka::MockConsumer>(BrokerSettingsForTest),
+      UsedPartitionId, TopicName, UsedMap, nullptr, Registrar, Start, Stop,
+      StopLeeway, ErrorTimeout, std::make_shared<Stream::DecodePool>(2, 0));
+  auto TestFilter = std::make_unique<SourceFilterStandInAlt>();
+  auto TestFilterPtr = TestFilter.get();
+  UnderTest->MsgFilters.clear();
+  UnderTest->MsgFilters.emplace_back(UsedFilterHash, std::move(TestFilter));
+  setExtractorModule<zzzzFbReader>("zzzz");
+  std::array<char, 10> LargerData{'z', 'z', 'z', 'z', 'z',
+                                  'z', 'z', 'z', 'z', 'z'};
+  trompeloeil::sequence Sequence;
+  REQUIRE_CALL(*TestFilterPtr, filterMessage(_))
+      .WITH(_1.size() == LargerData.size())
+      .IN_SEQUENCE(Sequence)
+      .RETURN(true);
+  REQUIRE_CALL(*TestFilterPtr, filterMessage(_))
+      .WITH(_1.size() == SomeData.size())
+      .IN_SEQUENCE(Sequence)
+      .RETURN(true);
+  ALLOW_CALL(*TestFilterPtr, hasFinished()).RETURN(false);
+  UnderTest->queueMessage(
+      FileWriter::Msg(LargerData.data(), LargerData.size()));
+  UnderTest->processMessage(FileWriter::Msg(SomeData.data(), SomeData.size()));
+  UnderTest->forwardDecodedMessages(true);
+  EXPECT_TRUE(UnderTest->DecodedMessages.empty());
+  EXPECT_EQ(int(UnderTest->MessagesProcessed), 2);
+}
+
+TEST_F(PartitionTest, UnwantedSourceInKafkaHeadersIsSkipped) {
+  auto UnderTest = createTestedInstance();
+  auto TestFilter = std::make_unique<SourceFilterStandInAlt>();
+  auto TestFilterPtr = TestFilter.get();
+  UnderTest->MsgFilters.clear();
+  UnderTest->MsgFilters.emplace_back(UsedFilterHash, std::move(TestFilter));
+  FORBID_CALL(*TestFilterPtr, filterMessage(_));
+  FileWriter::MessageMetaData MetaData;
+  MetaData.SourceName = "some_other_name";
+  MetaData.FlatbufferID = "zzzz";
+  UnderTest->processMessage(FileWriter::Msg(MetaData));
+  EXPECT_EQ(int(UnderTest->MessagesSkipped), 1);
+  EXPECT_EQ(int(UnderTest->FlatbufferErrors), 0);
+}
+
 TEST_F(PartitionTest, FilterNotRemovedIfNotDone) {
   auto UnderTest = createTestedInstance();
   auto TestFilter = std::make_unique<SourceFilterStandInAlt>();
@@ -19,7 +19,7 @@
 class MessageWriterStandIn : public Stream::MessageWriter {
 public:
   MessageWriterStandIn() : MessageWriter(Metrics::Registrar("", {})) {}
-  MAKE_MOCK1(addMessage, void(Stream::Message const &), override);
+  MAKE_MOCK1(addMessage, void(Stream::Message), override);
 };
 
 class SourceFilterStandIn : public Stream::SourceFilter {
@@ -246,3 +246,16 @@ TEST_F(TopicTest, TopicIsDoneIfAllItsPartitionsAreFinished) {
   UnderTest->checkIfDone();
   EXPECT_TRUE(UnderTest->isDone());
 }
+
+TEST_F(TopicTest, StartWithPrefetchedOffsetsSkipsMetadataCalls) {
+  auto UnderTest = createTestedInstance();
+  TopicStandIn::offset_list PartitionOffsets{{0, 12}, {1, 14}};
+
+  FORBID_CALL(*UnderTest, getPartitionsForTopic(_, _));
+  FORBID_CALL(*UnderTest, getOffsetsForPartitions(_, _, _));
+  REQUIRE_CALL(*UnderTest, createStreams(_, UsedTopicName, PartitionOffsets))
+      .TIMES(1);
+  UnderTest->start(PartitionOffsets);
+
+  waitUntilDoneProcessing(UnderTest.get());
+}
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "Filesystem.h"
+#include "Stream/WriteWatchdog.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace std::chrono_literals;
+using Clock = Stream::WriteWatchdog::Clock;
+
+class WriteWatchdogTest : public ::testing::Test {
+public:
+  Stream::WatchdogSettings getSettings() {
+    Stream::WatchdogSettings Settings;
+    Settings.StallTimeout = 1s;
+    Settings.MaxMessageAge = 5s;
+    // Samples are taken by the tests, not by the watchdog thread.
+    Settings.SampleInterval = 1h;
+    Settings.HistoryLength = 3h;
+    Settings.DumpDirectory = fs::temp_directory_path().string();
+    return Settings;
+  }
+  Metrics::Registrar Registrar{"test", {}};
+  size_t QueueDepth{0};
+};
+
+TEST_F(WriteWatchdogTest, NoStallWhenIdle) {
+  Stream::WriteWatchdog UnderTest(getSettings(), Registrar,
+                                  [this]() { return QueueDepth; });
+  UnderTest.checkWriter(Clock::now() + 1min);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 0);
+}
+
+TEST_F(WriteWatchdogTest, LongWriteIsReportedOnce) {
+  Stream::WriteWatchdog UnderTest(getSettings(), Registrar,
+                                  [this]() { return QueueDepth; });
+  auto Start = UnderTest.writeStarted();
+  UnderTest.checkWriter(Start + 500ms);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 0);
+  UnderTest.checkWriter(Start + 2s);
+  UnderTest.checkWriter(Start + 3s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 1);
+  UnderTest.writeDone(Start);
+  UnderTest.checkWriter(Start + 4s);
+  auto NextStart = UnderTest.writeStarted();
+  UnderTest.checkWriter(NextStart + 2s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 2);
+}
+
+TEST_F(WriteWatchdogTest, OldMessageIsReported) {
+  Stream::WriteWatchdog UnderTest(getSettings(), Registrar,
+                                  [this]() { return QueueDepth; });
+  auto QueuedAt = Clock::now();
+  UnderTest.messageQueued(QueuedAt);
+  UnderTest.checkWriter(QueuedAt + 1s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 0);
+  UnderTest.checkWriter(QueuedAt + 6s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 1);
+}
+
+TEST_F(WriteWatchdogTest, OldestMessageOfWholeQueueIsUsed) {
+  Stream::WriteWatchdog UnderTest(getSettings(), Registrar,
+                                  [this]() { return QueueDepth; });
+  auto FirstQueuedAt = Clock::now();
+  auto SecondQueuedAt = FirstQueuedAt + 3s;
+  UnderTest.messageQueued(FirstQueuedAt);
+  UnderTest.messageQueued(SecondQueuedAt);
+  // The newer message is written first, e.g. as it is from another producer.
+  UnderTest.messageWritten({{}, {}, SecondQueuedAt, SecondQueuedAt + 1s});
+  UnderTest.checkWriter(FirstQueuedAt + 6s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 1);
+}
+
+TEST_F(WriteWatchdogTest, WrittenMessageIsNoLongerPending) {
+  Stream::WriteWatchdog UnderTest(getSettings(), Registrar,
+                                  [this]() { return QueueDepth; });
+  auto FirstQueuedAt = Clock::now();
+  auto SecondQueuedAt = FirstQueuedAt + 3s;
+  UnderTest.messageQueued(FirstQueuedAt);
+  UnderTest.messageQueued(SecondQueuedAt);
+  UnderTest.messageWritten({{}, {}, FirstQueuedAt, FirstQueuedAt + 1s});
+  UnderTest.checkWriter(FirstQueuedAt + 6s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 0);
+}
+
+TEST_F(WriteWatchdogTest, HistoryHoldsStagesOfLastMessage) {
+  Stream::WriteWatchdog UnderTest(getSettings(), Registrar,
+                                  [this]() { return QueueDepth; });
+  auto Now = Clock::now();
+  UnderTest.messageQueued(Now - 2s);
+  UnderTest.messageWritten({Now - 4s, Now - 3s, Now - 2s, Now - 1s});
+  UnderTest.checkWriter(Now);
+  std::stringstream Output;
+  UnderTest.writeHistory(Output);
+  std::string Line;
+  std::getline(Output, Line); // Header
+  std::getline(Output, Line);
+  std::vector<int64_t> Columns;
+  std::stringstream LineStream(Line);
+  std::string Column;
+  while (std::getline(LineStream, Column, ',')) {
+    Columns.push_back(std::stoll(Column));
+  }
+  ASSERT_EQ(Columns.size(), 11u);
+  auto SampleTime = Columns[0];
+  EXPECT_NEAR(Columns[7], SampleTime - 4000, 1);
+  EXPECT_NEAR(Columns[8], SampleTime - 3000, 1);
+  EXPECT_NEAR(Columns[9], SampleTime - 2000, 1);
+  EXPECT_NEAR(Columns[10], SampleTime - 1000, 1);
+}
+
+TEST_F(WriteWatchdogTest, HistoryHoldsSamplesInOrder) {
+  auto Settings = getSettings();
+  Settings.HistoryLength = 2h;
+  Stream::WriteWatchdog UnderTest(Settings, Registrar,
+                                  [this]() { return QueueDepth; });
+  for (QueueDepth = 1; QueueDepth < 4; ++QueueDepth) {
+    UnderTest.checkWriter(Clock::now());
+  }
+  std::stringstream Output;
+  UnderTest.writeHistory(Output);
+  std::string Line;
+  std::vector<std::string> Depths;
+  std::getline(Output, Line); // Header
+  while (std::getline(Output, Line)) {
+    auto DepthStart = Line.find(',') + 1;
+    Depths.push_back(
+        Line.substr(DepthStart, Line.find(',', DepthStart) - DepthStart));
+  }
+  EXPECT_EQ(Depths, (std::vector<std::string>{"2", "3"}));
+}
+
+TEST_F(WriteWatchdogTest, MessageOlderThanAllBucketsIsStillStalled) {
+  Stream::WriteWatchdog UnderTest(getSettings(), Registrar,
+                                  [this]() { return QueueDepth; });
+  auto QueuedAt = Clock::now();
+  UnderTest.messageQueued(QueuedAt);
+  UnderTest.checkWriter(QueuedAt + 6s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 1);
+  // The buckets span about twice the max message age, after which the
+  // bucket of the pending message is reused by newer messages.
+  for (auto Offset = 6s; Offset < 30s; Offset += 1s) {
+    UnderTest.messageQueued(QueuedAt + Offset);
+    UnderTest.messageWritten(
+        {{}, {}, QueuedAt + Offset, QueuedAt + Offset + 100ms});
+    UnderTest.checkWriter(QueuedAt + Offset + 500ms);
+  }
+  EXPECT_EQ(UnderTest.nrOfStalls(), 1);
+  UnderTest.messageWritten({{}, {}, QueuedAt, QueuedAt + 30s});
+  UnderTest.checkWriter(QueuedAt + 31s);
+  UnderTest.messageQueued(QueuedAt + 32s);
+  UnderTest.checkWriter(QueuedAt + 39s);
+  EXPECT_EQ(UnderTest.nrOfStalls(), 2);
+}
@@ -10,6 +10,7 @@
 #include "FileWriterTask.h"
 #include "Kafka/Producer.h"
 #include "StreamController.h"
+#include "helpers/StubWriterModule.h"
 #include <gtest/gtest.h>
 
 class ProducerStandIn : public Kafka::Producer {
@@ -38,3 +39,46 @@ public:
 TEST_F(StreamControllerTests, getJobIdReturnsCorrectValue) {
   ASSERT_EQ(JobId, StreamController->getJobId());
 }
+
+class MergingWriterModule : public StubWriterModule {
+public:
+  explicit MergingWriterModule(std::vector<std::string> Sources)
+      : MergedSources(std::move(Sources)) {}
+  std::vector<std::string> mergedSources() const override {
+    return MergedSources;
+  }
+  std::vector<std::string> MergedSources;
+};
+
+TEST(MapSourcesToTopics, MergedSourceDoesNotReplaceItsOwnStream) {
+  std::vector<FileWriter::Source> Sources;
+  Sources.emplace_back("detector_1", "ev42", "ev42", "events",
+                       std::make_unique<MergingWriterModule>(
+                           std::vector<std::string>{"detector_2",
+                                                    "detector_3"}));
+  Sources.emplace_back("detector_4", "ev42", "ev42", "events",
+                       std::make_unique<MergingWriterModule>(
+                           std::vector<std::string>{"detector_3"}));
+  Sources.emplace_back("detector_2", "ev42", "ev42", "events",
+                       std::make_unique<StubWriterModule>());
+  auto TopicSrcMap = FileWriter::mapSourcesToTopics(Sources, {"events"});
+  ASSERT_EQ(TopicSrcMap.size(), 1u);
+  auto const &SrcMap = TopicSrcMap["events"];
+  ASSERT_EQ(SrcMap.size(), 4u);
+  for (size_t i = 0; i < Sources.size(); ++i) {
+    EXPECT_EQ(SrcMap[i].SourceName, Sources[i].sourcename());
+    EXPECT_EQ(SrcMap[i].WriteHash, Sources[i].getModuleHash());
+    EXPECT_EQ(SrcMap[i].Destination, Sources[i].getWriterPtr());
+  }
+  // Only merged by the first writer module that merges it.
+  EXPECT_EQ(SrcMap[3].SourceName, "detector_3");
+  EXPECT_EQ(SrcMap[3].Destination, Sources[0].getWriterPtr());
+}
+
+TEST(MapSourcesToTopics, SourcesOfUnknownTopicsAreSkipped) {
+  std::vector<FileWriter::Source> Sources;
+  Sources.emplace_back("detector_1", "ev42", "ev42", "events",
+                       std::make_unique<MergingWriterModule>(
+                           std::vector<std::string>{"detector_2"}));
+  EXPECT_TRUE(FileWriter::mapSourcesToTopics(Sources, {"motion"}).empty());
+}
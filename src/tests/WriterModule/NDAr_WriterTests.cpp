@@ -30,6 +30,7 @@ public:
   using NDAr_Writer::Timestamp;
   using NDAr_Writer::Type;
   using NDAr_Writer::Values;
+  using NDAr_Writer::values;
 };
 
 class AreaDetectorWriter : public ::testing::Test {
@@ -120,7 +121,7 @@ TEST_F(AreaDetectorWriter, WriterInitInt8) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::int8_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::int8_t>(), Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitUInt8) {
@@ -131,7 +132,7 @@ TEST_F(AreaDetectorWriter, WriterInitUInt8) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::uint8_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::uint8_t>(), Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitInt16) {
@@ -142,7 +143,7 @@ TEST_F(AreaDetectorWriter, WriterInitInt16) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::int16_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::int16_t>(), Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitUInt16) {
@@ -153,7 +154,8 @@ TEST_F(AreaDetectorWriter, WriterInitUInt16) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::uint16_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::uint16_t>(),
+            Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitInt32) {
@@ -164,7 +166,7 @@ TEST_F(AreaDetectorWriter, WriterInitInt32) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::int32_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::int32_t>(), Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitUInt32) {
@@ -175,7 +177,8 @@ TEST_F(AreaDetectorWriter, WriterInitUInt32) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::uint32_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::uint32_t>(),
+            Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitInt64) {
@@ -186,7 +189,7 @@ TEST_F(AreaDetectorWriter, WriterInitInt64) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::int64_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::int64_t>(), Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitUInt64) {
@@ -197,7 +200,8 @@ TEST_F(AreaDetectorWriter, WriterInitUInt64) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::uint64_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::uint64_t>(),
+            Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitDouble) {
@@ -208,7 +212,8 @@ TEST_F(AreaDetectorWriter, WriterInitDouble) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::double_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::double_t>(),
+            Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitFloat) {
@@ -219,7 +224,7 @@ TEST_F(AreaDetectorWriter, WriterInitFloat) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<std::float_t>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<std::float_t>(), Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterInitChar) {
@@ -230,19 +235,19 @@ TEST_F(AreaDetectorWriter, WriterInitChar) {
   Writer.parse_config(JsonConfig.dump());
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<char>(), Writer.Values->datatype());
+  EXPECT_EQ(hdf5::datatype::create<char>(), Writer.values().datatype());
 }
 
 TEST_F(AreaDetectorWriter, WriterDefaultValuesTest) {
   ADWriterStandIn Temp;
   Temp.init_hdf(UsedGroup, "{}");
   Temp.reopen(UsedGroup);
-  EXPECT_EQ(hdf5::datatype::create<double>(), Temp.Values->datatype());
-  auto Dataspace = hdf5::dataspace::Simple(Temp.Values->dataspace());
+  EXPECT_EQ(hdf5::datatype::create<double>(), Temp.values().datatype());
+  auto Dataspace = hdf5::dataspace::Simple(Temp.values().dataspace());
   EXPECT_EQ(Dataspace.maximum_dimensions(),
             (hdf5::Dimensions{H5S_UNLIMITED, H5S_UNLIMITED, H5S_UNLIMITED}));
   EXPECT_EQ(Dataspace.current_dimensions(), (hdf5::Dimensions{0, 1, 1}));
-  auto CreationProperties = Temp.Values->creation_list();
+  auto CreationProperties = Temp.values().creation_list();
   auto ChunkDims = CreationProperties.chunk();
   EXPECT_EQ(ChunkDims, (hdf5::Dimensions{64, 1, 1}));
 }
@@ -324,7 +329,7 @@ TEST_F(AreaDetectorWriter, WriterDimensionsTest) {
   Writer.init_hdf(UsedGroup, "{}");
   Writer.reopen(UsedGroup);
   EXPECT_NO_THROW(Writer.write(Message));
-  auto Dataspace = hdf5::dataspace::Simple(Writer.Values->dataspace());
+  auto Dataspace = hdf5::dataspace::Simple(Writer.values().dataspace());
   EXPECT_EQ((hdf5::Dimensions{1, 10, 12}), Dataspace.current_dimensions());
 }
 
@@ -485,10 +490,10 @@ bool WriteTest(hdf5::node::Group &UsedGroup, FB_Tables::DType FBType) {
   }
   std::vector<Type> dataFromFile(testData.size());
   hdf5::Dimensions CDims =
-      hdf5::dataspace::Simple(Writer.Values->dataspace()).current_dimensions();
+      hdf5::dataspace::Simple(Writer.values().dataspace()).current_dimensions();
   hdf5::Dimensions ExpectedDims{{1, 10, 10, 10}};
   EXPECT_EQ(CDims, ExpectedDims);
-  Writer.Values->read(dataFromFile);
+  Writer.values().read(dataFromFile);
   EXPECT_EQ(dataFromFile, testData);
   return true;
 }
@@ -532,3 +537,76 @@ TEST_F(AreaDetectorWriter, WriterCharTest) {
 TEST_F(AreaDetectorWriter, WriterWrongFBTypeTest) {
   EXPECT_FALSE(WriteTest<char>(UsedGroup, FB_Tables::DType(9999)));
 }
+
+TEST_F(AreaDetectorWriter, WriterCropsAndBinsFrames) {
+  FileWriter::FlatbufferMessage Message(RawData.get(), FileSize);
+  ADWriterStandIn Writer;
+  nlohmann::json JsonConfig = nlohmann::json::parse(R"({
+    "array_size": [10, 12],
+    "roi": {"offset": [2, 3], "size": [6, 8]},
+    "binning": [2, 4]})");
+  Writer.parse_config(JsonConfig.dump());
+  Writer.init_hdf(UsedGroup, "{}");
+  Writer.reopen(UsedGroup);
+  EXPECT_NO_THROW(Writer.write(Message));
+  auto Dataspace = hdf5::dataspace::Simple(Writer.values().dataspace());
+  EXPECT_EQ((hdf5::Dimensions{1, 3, 2}), Dataspace.current_dimensions());
+}
+
+TEST(FrameTransformTest, RoiIsCroppedAndBinned) {
+  WriterModule::NDAr::FrameTransform UnderTest({1, 1}, {2, 4}, {1, 2});
+  // 3 x 5 frame
+  std::vector<std::uint16_t> Frame{0,  1,  2,  3,  4,  //
+                                   5,  6,  7,  8,  9,  //
+                                   10, 11, 12, 13, 14};
+  hdf5::Dimensions FrameShape{3, 5};
+  EXPECT_EQ((hdf5::Dimensions{2, 2}), UnderTest.outputShape(FrameShape));
+  std::vector<std::uint32_t> Output(4);
+  UnderTest.apply(Frame.data(), FrameShape, Output.data());
+  EXPECT_EQ((std::vector<std::uint32_t>{6 + 7, 8 + 9, 11 + 12, 13 + 14}),
+            Output);
+}
+
+TEST(FrameTransformTest, BinsOfRowsAndColumnsAreSummed) {
+  WriterModule::NDAr::FrameTransform UnderTest({}, {}, {2, 2});
+  std::vector<std::uint16_t> Frame{0, 1, 2, 3, //
+                                   4, 5, 6, 7};
+  std::vector<std::uint16_t> Output(2);
+  UnderTest.apply(Frame.data(), {2, 4}, Output.data());
+  EXPECT_EQ((std::vector<std::uint16_t>{0 + 1 + 4 + 5, 2 + 3 + 6 + 7}),
+            Output);
+}
+
+TEST(FrameTransformTest, BinSumsAreClampedToTheOutputType) {
+  WriterModule::NDAr::FrameTransform UnderTest({}, {}, {1, 2});
+  std::vector<std::uint16_t> Frame{60000, 60000, 1, 2};
+  std::vector<std::uint16_t> Output(2);
+  UnderTest.apply(Frame.data(), {1, 4}, Output.data());
+  EXPECT_EQ((std::vector<std::uint16_t>{65535, 3}), Output);
+
+  std::vector<std::int8_t> SignedFrame{-100, -100, 100, 100};
+  std::vector<std::int8_t> SignedOutput(2);
+  UnderTest.apply(SignedFrame.data(), {1, 4}, SignedOutput.data());
+  EXPECT_EQ((std::vector<std::int8_t>{-128, 127}), SignedOutput);
+}
+
+TEST(FrameTransformTest, RoiOutsideOfFrameThrows) {
+  WriterModule::NDAr::FrameTransform UnderTest({2, 0}, {2, 2}, {});
+  EXPECT_THROW(UnderTest.outputShape({3, 5}), std::runtime_error);
+}
+
+TEST(FrameTransformTest, BinSumsOf64BitIntegersAreClamped) {
+  WriterModule::NDAr::FrameTransform UnderTest({}, {}, {1, 2});
+  auto const Max = std::numeric_limits<std::int64_t>::max();
+  auto const Lowest = std::numeric_limits<std::int64_t>::lowest();
+  std::vector<std::int64_t> Frame{Max, Max, Lowest, -1};
+  std::vector<std::int64_t> Output(2);
+  UnderTest.apply(Frame.data(), {1, 4}, Output.data());
+  EXPECT_EQ((std::vector<std::int64_t>{Max, Lowest}), Output);
+}
+
+TEST(FrameTransformTest, TooManyPixelsPerBinThrows) {
+  EXPECT_THROW(
+      WriterModule::NDAr::FrameTransform({}, {}, {1 << 16, (1 << 15) + 1}),
+      std::runtime_error);
+}
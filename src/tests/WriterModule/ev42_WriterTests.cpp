@@ -14,6 +14,7 @@
 #include <ev42_events_generated.h>
 #include <gmock/gmock.h>
 
+#include <fstream>
 #include <utility>
 
 #include "AccessMessageMetadata/ev42/ev42_Extractor.h"
@@ -275,6 +276,67 @@ TEST_F(EventWriterTests, WriterSuccessfullyRecordsEventDataFromSingleMessage) {
          "values from the message";
 }
 
+TEST_F(EventWriterTests, WriterWritesOneIndexEntryPerPulse) {
+  std::vector<flatbuffers::DetachedBuffer> Buffers;
+  Buffers.push_back(generateFlatbufferData("TestSource", 0, 1, {0, 1}, {1, 2}));
+  Buffers.push_back(generateFlatbufferData("TestSource", 1, 1, {2}, {3}));
+  Buffers.push_back(generateFlatbufferData("TestSource", 2, 2, {0}, {4}));
+  Buffers.push_back(generateFlatbufferData("TestSource", 3, 1, {0}, {5}));
+  {
+    WriterModule::ev42::ev42_Writer Writer;
+    Writer.parse_config(R"({"event_filter": {"masked_detector_ids": [2]}})");
+    EXPECT_TRUE(Writer.init_hdf(TestGroup, "{}") == InitResult::OK);
+    EXPECT_TRUE(Writer.reopen(TestGroup) == InitResult::OK);
+    for (auto const &Buffer : Buffers) {
+      EXPECT_NO_THROW(Writer.write(
+          FileWriter::FlatbufferMessage(Buffer.data(), Buffer.size())));
+    }
+  }
+  std::vector<uint64_t> EventTimeZero(
+      TestGroup.get_dataset("event_time_zero").dataspace().size());
+  TestGroup.get_dataset("event_time_zero").read(EventTimeZero);
+  std::vector<uint32_t> EventIndex(
+      TestGroup.get_dataset("event_index").dataspace().size());
+  TestGroup.get_dataset("event_index").read(EventIndex);
+  std::vector<uint32_t> EventVetoed(
+      TestGroup.get_dataset("event_vetoed").dataspace().size());
+  TestGroup.get_dataset("event_vetoed").read(EventVetoed);
+  // Only consecutive messages of the same pulse are coalesced.
+  EXPECT_EQ(EventTimeZero, (std::vector<uint64_t>{1, 2, 1}));
+  EXPECT_EQ(EventIndex, (std::vector<uint32_t>{0, 2, 3}));
+  EXPECT_EQ(EventVetoed, (std::vector<uint32_t>{1, 0, 0}));
+}
+
+TEST_F(EventWriterTests, WriterWritesEventsToDirectoryStores) {
+  std::vector<uint32_t> const TimeOfFlight = {0, 1, 2};
+  std::vector<uint32_t> const DetectorID = {3, 4, 5};
+  auto MessageBuffer =
+      generateFlatbufferData("TestSource", 0, 42, TimeOfFlight, DetectorID);
+  FileWriter::FlatbufferMessage TestMessage(MessageBuffer.data(),
+                                            MessageBuffer.size());
+  {
+    WriterModule::ev42::ev42_Writer Writer;
+    Writer.parse_config(R"({"directory_store": {"enabled": true}})");
+    EXPECT_TRUE(Writer.init_hdf(TestGroup, "{}") == InitResult::OK);
+    EXPECT_TRUE(Writer.reopen(TestGroup) == InitResult::OK);
+    EXPECT_NO_THROW(Writer.write(TestMessage));
+  }
+
+  auto EventIDDataset = TestGroup.get_dataset("event_id");
+  EXPECT_EQ(EventIDDataset.dataspace().size(), 0);
+  std::string StorePath;
+  EventIDDataset.attributes[NeXusDataset::DirectoryStoreAttribute].read(
+      StorePath);
+  EXPECT_EQ(StorePath, "EventWriterTestFile.nxs.chunks/test_group/event_id");
+  std::ifstream Chunk(StorePath + "/0", std::ios::binary);
+  std::vector<uint32_t> EventID(DetectorID.size());
+  Chunk.read(reinterpret_cast<char *>(EventID.data()),
+             EventID.size() * sizeof(uint32_t));
+  EXPECT_EQ(EventID, DetectorID);
+  EXPECT_EQ(TestGroup.get_dataset("event_time_zero").dataspace().size(), 1);
+  fs::remove_all("EventWriterTestFile.nxs.chunks");
+}
+
 TEST_F(EventWriterTests, WriterSuccessfullyRecordsEventDataFromTwoMessages) {
   // Create a single event message with data we can later check is recorded in
   // the file
@@ -318,16 +380,14 @@ TEST_F(EventWriterTests, WriterSuccessfullyRecordsEventDataFromTwoMessages) {
   EXPECT_THAT(EventTimeOffset, testing::ContainerEq(TimeOfFlight))
       << "Expected event_time_offset dataset to contain the time of flight "
          "values from both messages";
-  EXPECT_EQ(EventTimeZero.size(), 2U)
-      << "Expected event_time_zero to contain a "
-         "two values, as we wrote two "
-         "messages";
+  EXPECT_EQ(EventTimeZero.size(), 1U)
+      << "Expected event_time_zero to contain a single value, as both "
+         "messages are of the same pulse";
   EXPECT_EQ(EventTimeZero[0], PulseTime)
       << "Expected event_time_zero to contain the pulse time from the message";
-  EXPECT_EQ(EventIndex.size(), 2U) << "Expected event_index to contain two "
-                                      "values, as we wrote two messages";
-  EXPECT_EQ(EventIndex[1], 3U) << "Expected second message to start at index 3 "
-                                  "as there were 3 events in the first message";
+  EXPECT_EQ(EventIndex, (std::vector<uint32_t>{0}))
+      << "Expected event_index to contain a single value, as both messages "
+         "are of the same pulse";
   EXPECT_THAT(EventID, testing::ContainerEq(DetectorID))
       << "Expected event_id dataset to contain the detector ID "
          "values from both messages";
@@ -469,3 +529,240 @@ TEST_F(EventWriterTests,
               testing::ContainerEq(ThresholdTime));
   EXPECT_THAT(AdcInfoFromFile.PeakTime, testing::ContainerEq(PeakTime));
 }
+
+TEST(EventBanksTests, EventsAreSplitByDetectorIdInOrder) {
+  EventBanks UnderTest({{"upper", 10, 19}, {"lower", 0, 4}});
+  std::vector<uint32_t> const TimeOfFlight = {1, 2, 3, 4, 5, 6};
+  std::vector<uint32_t> const DetectorId = {12, 3, 7, 19, 0, 25};
+  UnderTest.split({TimeOfFlight.data(), TimeOfFlight.size()},
+                  {DetectorId.data(), DetectorId.size()});
+  ASSERT_EQ(UnderTest.size(), 2U);
+  EXPECT_EQ(UnderTest[0].Name, "lower");
+  auto LowerIds = UnderTest.detectorId(0);
+  auto LowerTofs = UnderTest.timeOfFlight(0);
+  EXPECT_EQ(std::vector<uint32_t>(LowerIds.data(),
+                                  LowerIds.data() + LowerIds.size()),
+            (std::vector<uint32_t>{3, 0}));
+  EXPECT_EQ(std::vector<uint32_t>(LowerTofs.data(),
+                                  LowerTofs.data() + LowerTofs.size()),
+            (std::vector<uint32_t>{2, 5}));
+  auto UpperIds = UnderTest.detectorId(1);
+  EXPECT_EQ(std::vector<uint32_t>(UpperIds.data(),
+                                  UpperIds.data() + UpperIds.size()),
+            (std::vector<uint32_t>{12, 19}));
+  EXPECT_EQ(UnderTest.eventsOutsideBanks(), 2U);
+}
+
+TEST(EventBanksTests, EmptyAndOverlappingBanksAreReportedAndIgnored) {
+  EventBanks UnderTest(
+      {{"second", 10, 20}, {"first", 0, 10}, {"empty", 30, 25}});
+  EXPECT_EQ(UnderTest.errors().size(), 2u);
+  ASSERT_EQ(UnderTest.size(), 1u);
+  EXPECT_EQ(UnderTest[0].Name, "first");
+}
+
+TEST_F(EventWriterTests, WriterWritesEventsOfEachBankToItsOwnGroup) {
+  auto MessageBuffer =
+      generateFlatbufferData("TestSource", 0, 42, {0, 1, 2, 3}, {1, 5, 2, 9});
+  FileWriter::FlatbufferMessage TestMessage(MessageBuffer.data(),
+                                            MessageBuffer.size());
+  {
+    WriterModule::ev42::ev42_Writer Writer;
+    Writer.parse_config(R"({"banks": [
+      {"name": "bank_a", "detector_id_min": 0, "detector_id_max": 3},
+      {"name": "bank_b", "detector_id_min": 4, "detector_id_max": 7}]})");
+    EXPECT_TRUE(Writer.init_hdf(TestGroup, "{}") == InitResult::OK);
+    EXPECT_TRUE(Writer.reopen(TestGroup) == InitResult::OK);
+    EXPECT_NO_THROW(Writer.write(TestMessage));
+    EXPECT_NO_THROW(Writer.write(TestMessage));
+  }
+  EXPECT_FALSE(TestGroup.has_dataset("event_id"));
+  auto BankA = TestGroup.get_group("bank_a");
+  auto BankB = TestGroup.get_group("bank_b");
+  std::vector<uint32_t> BankAIds(
+      BankA.get_dataset("event_id").dataspace().size());
+  BankA.get_dataset("event_id").read(BankAIds);
+  std::vector<uint32_t> BankBIndex(
+      BankB.get_dataset("event_index").dataspace().size());
+  BankB.get_dataset("event_index").read(BankBIndex);
+  std::vector<uint64_t> BankBTimeZero(
+      BankB.get_dataset("event_time_zero").dataspace().size());
+  BankB.get_dataset("event_time_zero").read(BankBTimeZero);
+  EXPECT_EQ(BankAIds, (std::vector<uint32_t>{1, 2, 1, 2}));
+  EXPECT_EQ(BankBIndex, (std::vector<uint32_t>{0}));
+  EXPECT_EQ(BankBTimeZero, (std::vector<uint64_t>{42}));
+}
+
+TEST(EventFilterTests, EventsOutsideWindowRangesOrMaskedAreVetoed) {
+  EventFilter UnderTest(nlohmann::json::parse(R"({
+      "time_of_flight_min": 10, "time_of_flight_max": 100,
+      "detector_id_ranges": [[0, 9], [20, 29]],
+      "masked_detector_ids": [5, 200]})"));
+  ASSERT_TRUE(UnderTest.isEnabled());
+  std::vector<uint32_t> const TimeOfFlight = {5, 10, 50, 100, 101, 50, 50};
+  std::vector<uint32_t> const DetectorId = {1, 2, 5, 21, 3, 15, 300};
+  UnderTest.apply({TimeOfFlight.data(), TimeOfFlight.size()},
+                  {DetectorId.data(), DetectorId.size()});
+  auto KeptIds = UnderTest.detectorId();
+  auto KeptTofs = UnderTest.timeOfFlight();
+  EXPECT_EQ(std::vector<uint32_t>(KeptIds.data(),
+                                  KeptIds.data() + KeptIds.size()),
+            (std::vector<uint32_t>{2, 21}));
+  EXPECT_EQ(std::vector<uint32_t>(KeptTofs.data(),
+                                  KeptTofs.data() + KeptTofs.size()),
+            (std::vector<uint32_t>{10, 100}));
+  EXPECT_EQ(UnderTest.vetoed(), 5U);
+}
+
+TEST(EventFilterTests, TooLargeMaskedIdIsReportedAndIgnored) {
+  EventFilter UnderTest(nlohmann::json::parse(
+      R"({"masked_detector_ids": [5, 4000000000]})"));
+  EXPECT_EQ(UnderTest.errors().size(), 1u);
+  std::vector<uint32_t> const TimeOfFlight = {1, 2};
+  std::vector<uint32_t> const DetectorId = {5, 4000000000};
+  UnderTest.apply({TimeOfFlight.data(), TimeOfFlight.size()},
+                  {DetectorId.data(), DetectorId.size()});
+  EXPECT_EQ(UnderTest.vetoed(), 1u);
+  EventFilter LargestId(nlohmann::json::parse(fmt::format(
+      R"({{"masked_detector_ids": [5, {}]}})", EventFilter::MaxMaskedId)));
+  EXPECT_TRUE(LargestId.errors().empty());
+}
+
+TEST(EventFilterTests, EmptyTimeOfFlightWindowIsReportedAndIgnored) {
+  EventFilter UnderTest(nlohmann::json::parse(
+      R"({"time_of_flight_min": 100, "time_of_flight_max": 10})"));
+  EXPECT_EQ(UnderTest.errors().size(), 1u);
+  EXPECT_FALSE(UnderTest.isEnabled());
+}
+
+TEST(EventFilterTests, InvalidSettingsAreReportedAndIgnored) {
+  EventFilter UnderTest(nlohmann::json::parse(R"({
+      "time_of_flight_min": "ten",
+      "detector_id_ranges": [[0, 9], [5]],
+      "masked_detector_ids": [-1]})"));
+  EXPECT_EQ(UnderTest.errors().size(), 3u);
+  std::vector<uint32_t> const TimeOfFlight = {1, 2};
+  std::vector<uint32_t> const DetectorId = {5, 15};
+  UnderTest.apply({TimeOfFlight.data(), TimeOfFlight.size()},
+                  {DetectorId.data(), DetectorId.size()});
+  EXPECT_EQ(UnderTest.vetoed(), 1u);
+}
+
+TEST_F(EventWriterTests, WriterRecordsNumberOfVetoedEventsPerPulse) {
+  auto FirstBuffer =
+      generateFlatbufferData("TestSource", 0, 1, {0, 1, 2}, {1, 2, 3});
+  FileWriter::FlatbufferMessage FirstMessage(FirstBuffer.data(),
+                                             FirstBuffer.size());
+  auto SecondBuffer =
+      generateFlatbufferData("TestSource", 1, 2, {0, 1, 2}, {2, 2, 2});
+  FileWriter::FlatbufferMessage SecondMessage(SecondBuffer.data(),
+                                              SecondBuffer.size());
+  // Continues the pulse of the second message.
+  auto ThirdBuffer = generateFlatbufferData("TestSource", 2, 2, {0}, {2});
+  FileWriter::FlatbufferMessage ThirdMessage(ThirdBuffer.data(),
+                                             ThirdBuffer.size());
+  {
+    WriterModule::ev42::ev42_Writer Writer;
+    Writer.parse_config(R"({"event_filter": {"masked_detector_ids": [2]}})");
+    EXPECT_TRUE(Writer.init_hdf(TestGroup, "{}") == InitResult::OK);
+    EXPECT_TRUE(Writer.reopen(TestGroup) == InitResult::OK);
+    EXPECT_NO_THROW(Writer.write(FirstMessage));
+    EXPECT_EQ(TestGroup.get_dataset("event_vetoed").dataspace().size(), 1);
+    EXPECT_NO_THROW(Writer.write(SecondMessage));
+    EXPECT_NO_THROW(Writer.write(ThirdMessage));
+  }
+  std::vector<uint32_t> EventID(
+      TestGroup.get_dataset("event_id").dataspace().size());
+  TestGroup.get_dataset("event_id").read(EventID);
+  std::vector<uint32_t> EventIndex(
+      TestGroup.get_dataset("event_index").dataspace().size());
+  TestGroup.get_dataset("event_index").read(EventIndex);
+  std::vector<uint32_t> EventVetoed(
+      TestGroup.get_dataset("event_vetoed").dataspace().size());
+  TestGroup.get_dataset("event_vetoed").read(EventVetoed);
+  EXPECT_EQ(EventID, (std::vector<uint32_t>{1, 3}));
+  EXPECT_EQ(EventIndex, (std::vector<uint32_t>{0, 2}));
+  EXPECT_EQ(EventVetoed, (std::vector<uint32_t>{1, 4}));
+}
+
+TEST(EventMergerTests, PulsesAreMergedOnceEverySourceHasMovedOn) {
+  EventMerger UnderTest({"board_1", "board_2"}, 4);
+  std::vector<uint32_t> const First = {1, 2};
+  std::vector<uint32_t> const Second = {3};
+  EXPECT_TRUE(UnderTest.add("board_1", 10, {First.data(), First.size()},
+                            {First.data(), First.size()}));
+  EXPECT_FALSE(UnderTest.add("board_3", 10, {First.data(), First.size()},
+                             {First.data(), First.size()}));
+  UnderTest.add("board_1", 20, {Second.data(), Second.size()},
+                {Second.data(), Second.size()});
+  EXPECT_FALSE(UnderTest.next());
+  UnderTest.add("board_2", 10, {Second.data(), Second.size()},
+                {Second.data(), Second.size()});
+  EXPECT_FALSE(UnderTest.next());
+  UnderTest.add("board_2", 30, {First.data(), First.size()},
+                {First.data(), First.size()});
+  ASSERT_TRUE(UnderTest.next());
+  EXPECT_EQ(UnderTest.pulseTime(), 10u);
+  auto Ids = UnderTest.detectorId();
+  EXPECT_EQ(std::vector<uint32_t>(Ids.data(), Ids.data() + Ids.size()),
+            (std::vector<uint32_t>{1, 2, 3}));
+  EXPECT_FALSE(UnderTest.next());
+  ASSERT_TRUE(UnderTest.next(true));
+  EXPECT_EQ(UnderTest.pulseTime(), 20u);
+  ASSERT_TRUE(UnderTest.next(true));
+  EXPECT_EQ(UnderTest.pulseTime(), 30u);
+  EXPECT_FALSE(UnderTest.next(true));
+  EXPECT_EQ(UnderTest.latePulses(), 0u);
+}
+
+TEST(EventMergerTests, SourceFallingBehindTheWindowIsNotWaitedFor) {
+  EventMerger UnderTest({"board_1", "board_2"}, 2);
+  std::vector<uint32_t> const Events = {1};
+  ArrayAdapter<const uint32_t> EventsAdapter(Events.data(), Events.size());
+  for (uint64_t PulseTime = 1; PulseTime <= 3; ++PulseTime) {
+    UnderTest.add("board_1", PulseTime, EventsAdapter, EventsAdapter);
+  }
+  ASSERT_TRUE(UnderTest.next());
+  EXPECT_EQ(UnderTest.pulseTime(), 1u);
+  EXPECT_FALSE(UnderTest.next());
+  UnderTest.add("board_2", 1, EventsAdapter, EventsAdapter);
+  ASSERT_TRUE(UnderTest.next(true));
+  EXPECT_EQ(UnderTest.pulseTime(), 1u);
+  EXPECT_EQ(UnderTest.latePulses(), 1u);
+}
+
+TEST_F(EventWriterTests, WriterMergesSourcesIntoOneTimeOrderedEventData) {
+  auto makeMessage = [](std::string const &Source, uint64_t PulseTime,
+                        std::vector<uint32_t> const &Events) {
+    return generateFlatbufferData(Source, 0, PulseTime, Events, Events);
+  };
+  std::vector<flatbuffers::DetachedBuffer> Buffers;
+  Buffers.push_back(makeMessage("board_1", 10, {1, 2}));
+  Buffers.push_back(makeMessage("board_2", 10, {3}));
+  Buffers.push_back(makeMessage("board_2", 20, {5}));
+  Buffers.push_back(makeMessage("board_1", 20, {4}));
+  {
+    WriterModule::ev42::ev42_Writer Writer;
+    Writer.parse_config(R"({"source": "board_1",
+      "merge": {"sources": ["board_2"], "window": 4}})");
+    EXPECT_EQ(Writer.mergedSources(), std::vector<std::string>{"board_2"});
+    EXPECT_TRUE(Writer.init_hdf(TestGroup, "{}") == InitResult::OK);
+    EXPECT_TRUE(Writer.reopen(TestGroup) == InitResult::OK);
+    for (auto const &Buffer : Buffers) {
+      EXPECT_NO_THROW(Writer.write(
+          FileWriter::FlatbufferMessage(Buffer.data(), Buffer.size())));
+    }
+  }
+  std::vector<uint32_t> EventID(
+      TestGroup.get_dataset("event_id").dataspace().size());
+  TestGroup.get_dataset("event_id").read(EventID);
+  std::vector<uint32_t> EventIndex(
+      TestGroup.get_dataset("event_index").dataspace().size());
+  TestGroup.get_dataset("event_index").read(EventIndex);
+  std::vector<uint64_t> EventTimeZero(
+      TestGroup.get_dataset("event_time_zero").dataspace().size());
+  TestGroup.get_dataset("event_time_zero").read(EventTimeZero);
+  EXPECT_EQ(EventID, (std::vector<uint32_t>{1, 2, 3, 4, 5}));
+  EXPECT_EQ(EventIndex, (std::vector<uint32_t>{0, 3}));
+  EXPECT_EQ(EventTimeZero, (std::vector<uint64_t>{10, 20}));
+}
@@ -13,6 +13,7 @@
 #include <gtest/gtest.h>
 #include <h5cpp/hdf5.hpp>
 #include <memory>
+#include <thread>
 
 #include "AccessMessageMetadata/f142/f142_Extractor.h"
 #include "FlatbufferMessage.h"
@@ -50,6 +51,7 @@ public:
   using f142_Writer::Timestamp;
   using f142_Writer::ValueIndexInterval;
   using f142_Writer::Values;
+  using f142_Writer::values;
 };
 
 TEST_F(f142Init, BasicDefaultInit) {
@@ -300,7 +302,7 @@ TEST_F(f142WriteData, ConfigUnitsAttributeOnValueDataset) {
   // THEN a units attributes is created on the value dataset with the specified
   // string
   std::string attribute_value;
-  EXPECT_NO_THROW(TestWriter.Values.attributes["units"].read(attribute_value))
+  EXPECT_NO_THROW(TestWriter.values().attributes["units"].read(attribute_value))
       << "Expect units attribute to be present on the value dataset";
   EXPECT_EQ(attribute_value, units_string) << "Expect units attribute to have "
                                               "the value specified in the JSON "
@@ -319,7 +321,7 @@ TEST_F(f142WriteData, ConfigUnitsAttributeOnValueDatasetIfEmpty) {
   // THEN a units attributes is created on the value dataset with an empty
   // string value
   std::string attribute_value;
-  EXPECT_NO_THROW(TestWriter.Values.attributes["units"].read(attribute_value))
+  EXPECT_NO_THROW(TestWriter.values().attributes["units"].read(attribute_value))
       << "Expect units attribute to be present on the value dataset";
   EXPECT_EQ(attribute_value, "") << "Expect units attribute to have empty "
                                     "string as the value, as specified in the "
@@ -336,7 +338,7 @@ TEST_F(f142WriteData, UnitsAttributeOnValueDatasetNotCreatedIfNotInConfig) {
   TestWriter.reopen(RootGroup);
 
   // THEN a units attributes is not created on the value dataset
-  EXPECT_FALSE(TestWriter.Values.attributes.exists("units"))
+  EXPECT_FALSE(TestWriter.values().attributes.exists("units"))
       << "units attribute should not be created if it was not specified in the "
          "JSON config";
 }
@@ -348,14 +350,14 @@ TEST_F(f142WriteData, WriteOneElement) {
   double ElementValue{3.14};
   std::uint64_t Timestamp{11};
   auto FlatbufferData = generateFlatbufferMessage(ElementValue, Timestamp);
-  EXPECT_EQ(TestWriter.Values.get_extent(), hdf5::Dimensions({0, 1}));
+  EXPECT_EQ(TestWriter.values().get_extent(), hdf5::Dimensions({0, 1}));
   EXPECT_EQ(TestWriter.Timestamp.dataspace().size(), 0);
   TestWriter.write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
                                                  FlatbufferData.second));
-  ASSERT_EQ(TestWriter.Values.get_extent(), hdf5::Dimensions({1, 1}));
+  ASSERT_EQ(TestWriter.values().get_extent(), hdf5::Dimensions({1, 1}));
   ASSERT_EQ(TestWriter.Timestamp.dataspace().size(), 1);
   std::vector<double> WrittenValues(1);
-  TestWriter.Values.read(WrittenValues);
+  TestWriter.values().read(WrittenValues);
   EXPECT_EQ(WrittenValues.at(0), ElementValue);
   std::vector<std::uint64_t> WrittenTimes(1);
   TestWriter.Timestamp.read(WrittenTimes);
@@ -372,14 +374,14 @@ TEST_F(f142WriteData, WriteOneDefaultValueElement) {
   double ElementValue{0.0};
   std::uint64_t Timestamp{11};
   auto FlatbufferData = generateFlatbufferMessage(ElementValue, Timestamp);
-  EXPECT_EQ(TestWriter.Values.get_extent(), hdf5::Dimensions({0, 1}));
+  EXPECT_EQ(TestWriter.values().get_extent(), hdf5::Dimensions({0, 1}));
   EXPECT_EQ(TestWriter.Timestamp.dataspace().size(), 0);
   TestWriter.write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
                                                  FlatbufferData.second));
-  ASSERT_EQ(TestWriter.Values.get_extent(), hdf5::Dimensions({1, 1}));
+  ASSERT_EQ(TestWriter.values().get_extent(), hdf5::Dimensions({1, 1}));
   ASSERT_EQ(TestWriter.Timestamp.dataspace().size(), 1);
   std::vector<double> WrittenValues(1);
-  TestWriter.Values.read(WrittenValues);
+  TestWriter.values().read(WrittenValues);
   EXPECT_EQ(WrittenValues.at(0), ElementValue);
   std::vector<std::uint64_t> WrittenTimes(1);
   TestWriter.Timestamp.read(WrittenTimes);
@@ -408,12 +410,152 @@ TEST_F(f142WriteData, WriteOneArray) {
       generateFlatbufferArrayMessage(ElementValues, Timestamp);
   TestWriter.write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
                                                  FlatbufferData.second));
-  ASSERT_EQ(TestWriter.Values.get_extent(), hdf5::Dimensions({1, 3}));
+  ASSERT_EQ(TestWriter.values().get_extent(), hdf5::Dimensions({1, 3}));
   std::vector<double> WrittenValues(3);
-  TestWriter.Values.read(WrittenValues);
+  TestWriter.values().read(WrittenValues);
   EXPECT_EQ(WrittenValues, ElementValues);
 }
 
+TEST_F(f142WriteData, WriteRaggedArrays) {
+  std::vector<std::vector<double>> ElementValues{{3.14, 4.5, 3.1}, {2.71}};
+  {
+    f142_WriterStandIn TestWriter;
+    TestWriter.parse_config(R"({"array_layout": "ragged"})");
+    TestWriter.init_hdf(RootGroup, "");
+    TestWriter.reopen(RootGroup);
+    uint64_t Timestamp{12};
+    for (auto const &Values : ElementValues) {
+      auto FlatbufferData =
+          generateFlatbufferArrayMessage(Values, Timestamp++);
+      TestWriter.write(FileWriter::FlatbufferMessage(
+          FlatbufferData.first.get(), FlatbufferData.second));
+    }
+    // Buffered until a chunk is full, the buffer is too old or the writer
+    // module is destructed.
+    EXPECT_EQ(TestWriter.Timestamp.dataspace().size(), 0);
+  }
+  auto ValueDataset = RootGroup.get_dataset("value");
+  ASSERT_EQ(ValueDataset.dataspace().size(), 4);
+  std::vector<double> WrittenValues(4);
+  ValueDataset.read(WrittenValues);
+  EXPECT_EQ(WrittenValues, std::vector<double>({3.14, 4.5, 3.1, 2.71}));
+  std::vector<std::uint64_t> WrittenIndex(2);
+  RootGroup.get_dataset("value_index").read(WrittenIndex);
+  EXPECT_EQ(WrittenIndex, std::vector<std::uint64_t>({0, 3}));
+  std::vector<std::uint64_t> WrittenTimes(2);
+  RootGroup.get_dataset("time").read(WrittenTimes);
+  EXPECT_EQ(WrittenTimes, std::vector<std::uint64_t>({12, 13}));
+}
+
+TEST_F(f142WriteData, RaggedArraysAreFlushedWhenTooOld) {
+  f142_WriterStandIn TestWriter;
+  TestWriter.parse_config(
+      R"({"array_layout": "ragged", "nexus.buffer_max_age_ms": 20})");
+  TestWriter.init_hdf(RootGroup, "");
+  TestWriter.reopen(RootGroup);
+  auto FlatbufferData = generateFlatbufferArrayMessage({3.14, 4.5}, 12);
+  TestWriter.write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
+                                                 FlatbufferData.second));
+  TestWriter.flush();
+  EXPECT_EQ(TestWriter.Timestamp.dataspace().size(), 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  TestWriter.flush();
+  EXPECT_EQ(TestWriter.Timestamp.dataspace().size(), 1);
+  EXPECT_EQ(RootGroup.get_dataset("value").dataspace().size(), 2);
+}
+
+TEST_F(f142WriteData, UpdatesBufferedForAPoolAreFlushedWhenTooOld) {
+  auto Pool = std::make_shared<NeXusDataset::DatasetPool>(100);
+  f142_WriterStandIn TestWriter;
+  TestWriter.parse_config(R"({"nexus.buffer_max_age_ms": 20})");
+  TestWriter.init_hdf(RootGroup, "");
+  TestWriter.useDatasetPool(Pool);
+  TestWriter.reopen(RootGroup);
+  EXPECT_EQ(TestWriter.nrOfDatasets(), 7u);
+  auto FlatbufferData = generateFlatbufferMessage(3.14, 12);
+  TestWriter.write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
+                                                 FlatbufferData.second));
+  TestWriter.flush();
+  EXPECT_EQ(RootGroup.get_dataset("time").dataspace().size(), 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  TestWriter.flush();
+  EXPECT_EQ(RootGroup.get_dataset("time").dataspace().size(), 1);
+}
+
+TEST_F(f142WriteData, WritersSharingADatasetPoolKeepItsLimit) {
+  auto Pool = std::make_shared<NeXusDataset::DatasetPool>(7);
+  std::vector<hdf5::node::Group> Groups{RootGroup.create_group("a"),
+                                        RootGroup.create_group("b")};
+  {
+    std::vector<std::unique_ptr<f142_WriterStandIn>> Writers;
+    for (auto &Group : Groups) {
+      Writers.push_back(std::make_unique<f142_WriterStandIn>());
+      Writers.back()->parse_config(R"({"nexus.buffer_size": 2})");
+      Writers.back()->init_hdf(Group, "");
+      Writers.back()->useDatasetPool(Pool);
+      Writers.back()->reopen(Group);
+    }
+    for (uint64_t Timestamp = 0; Timestamp < 5; ++Timestamp) {
+      for (auto &Writer : Writers) {
+        auto FlatbufferData =
+            generateFlatbufferMessage(double(Timestamp), Timestamp);
+        Writer->write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
+                                                    FlatbufferData.second));
+      }
+      EXPECT_LE(Pool->nrOfOpenDatasets(), 7u);
+    }
+    // The last update of each writer is still buffered.
+    EXPECT_EQ(Groups[0].get_dataset("time").dataspace().size(), 4);
+  }
+  EXPECT_EQ(Pool->nrOfOpenDatasets(), 0u);
+  // Opened by reopen() and once for every two updates.
+  EXPECT_EQ(Pool->nrOfOpens(), 8u);
+  for (auto &Group : Groups) {
+    std::vector<double> WrittenValues(5);
+    Group.get_dataset("value").read(WrittenValues);
+    EXPECT_EQ(WrittenValues, std::vector<double>({0, 1, 2, 3, 4}));
+    std::vector<std::uint64_t> WrittenTimes(5);
+    Group.get_dataset("time").read(WrittenTimes);
+    EXPECT_EQ(WrittenTimes, std::vector<std::uint64_t>({0, 1, 2, 3, 4}));
+  }
+}
+
+TEST_F(f142WriteData, WriteTwoElements) {
+  f142_WriterStandIn TestWriter;
+  TestWriter.init_hdf(RootGroup, "");
+  TestWriter.reopen(RootGroup);
+  std::vector<double> ElementValues{3.14, 2.71};
+  for (auto const &ElementValue : ElementValues) {
+    auto FlatbufferData = generateFlatbufferMessage(ElementValue, 11);
+    TestWriter.write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
+                                                   FlatbufferData.second));
+  }
+  ASSERT_EQ(TestWriter.values().get_extent(), hdf5::Dimensions({2, 1}));
+  std::vector<double> WrittenValues(2);
+  TestWriter.values().read(WrittenValues);
+  EXPECT_EQ(WrittenValues, ElementValues);
+}
+
+TEST_F(f142WriteData, ValueOfOtherTypeIsConverted) {
+  f142_WriterStandIn TestWriter;
+  TestWriter.init_hdf(RootGroup, "");
+  TestWriter.reopen(RootGroup);
+  std::int32_t ElementValue{42};
+  auto ValueFunc = [ElementValue](auto &Builder) {
+    IntBuilder ValueBuilder(Builder);
+    ValueBuilder.add_value(ElementValue);
+    return ValueBuilder.Finish().Union();
+  };
+  auto FlatbufferData =
+      generateFlatbufferMessageBase(ValueFunc, Value::Int, 11);
+  TestWriter.write(FileWriter::FlatbufferMessage(FlatbufferData.first.get(),
+                                                 FlatbufferData.second));
+  ASSERT_EQ(TestWriter.values().get_extent(), hdf5::Dimensions({1, 1}));
+  std::vector<double> WrittenValues(1);
+  TestWriter.values().read(WrittenValues);
+  EXPECT_EQ(WrittenValues.at(0), double(ElementValue));
+}
+
 TEST_F(f142WriteData, WhenMessageContainsAlarmStatusOfNoChangeItIsNotWritten) {
   f142_WriterStandIn TestWriter;
   TestWriter.init_hdf(RootGroup, "");
@@ -12,6 +12,7 @@
 #include "WriterModule/hs00/Exceptions.h"
 #include "WriterModule/hs00/Shape.h"
 #include "WriterModule/hs00/Slice.h"
+#include "WriterModule/hs00/Sparse.h"
 #include "WriterModule/hs00/WriterTyped.h"
 #include "WriterModule/hs00/hs00_Writer.h"
 #include "WriterRegistrar.h"
@@ -29,6 +30,7 @@ using WriterModule::hs00::Dimension;
 using WriterModule::hs00::hs00_Writer;
 using WriterModule::hs00::Shape;
 using WriterModule::hs00::Slice;
+using WriterModule::hs00::StorageMode;
 using WriterModule::hs00::UnexpectedJsonInput;
 using WriterModule::hs00::WriterTyped;
 
@@ -144,6 +146,28 @@ TEST_F(EventHistogramWriter, SlicePartialOverlap) {
   ASSERT_TRUE(B.doesOverlap(A));
 }
 
+TEST_F(EventHistogramWriter, FindNonZero) {
+  std::vector<double> Data{0, 1.5, 0, 0, -2, 0, 0, 0, 0, 3};
+  std::vector<uint32_t> Positions{7, 7, 7};
+  WriterModule::hs00::findNonZero(Data.data(), Data.size(), Positions);
+  ASSERT_EQ(Positions, (std::vector<uint32_t>{1, 4, 9}));
+}
+
+TEST_F(EventHistogramWriter, SlicePositionsToHistogramPositions) {
+  // Slice of 2x2 at offset (1, 2) in a 4x5 histogram.
+  std::vector<uint64_t> Positions;
+  WriterModule::hs00::toHistogramPositions({0, 1, 2, 3}, {1, 2}, {2, 2},
+                                           {4, 5}, Positions);
+  ASSERT_EQ(Positions, (std::vector<uint64_t>{7, 8, 12, 13}));
+}
+
+TEST_F(EventHistogramWriter, UnknownStorageModeThrows) {
+  ASSERT_EQ(WriterModule::hs00::storageModeFromString("auto"),
+            StorageMode::Auto);
+  ASSERT_THROW(WriterModule::hs00::storageModeFromString("compressed"),
+               UnexpectedJsonInput);
+}
+
 json createTestWriterTypedJson() {
   auto Json = json::parse(R""({
     "data_type": "uint64",
@@ -478,6 +502,115 @@ TEST_F(EventHistogramWriter, WriteManyHistograms) {
   }
 }
 
+TEST_F(EventHistogramWriter, WriteSparseHistogram) {
+  auto File = createFile("Test.EventHistogramWriter.WriteSparseHistogram",
+                         FileCreationLocation::Default);
+  auto Group = File.root();
+  auto Json = createTestWriterTypedJson();
+  Json["storage"] = "sparse";
+  auto Writer = hs00_Writer::create();
+  Writer->parse_config(Json.dump());
+  ASSERT_TRUE(Writer->init_hdf(Group, "{}") == InitResult::OK);
+  Writer = hs00_Writer::create();
+  Writer->parse_config(Json.dump());
+  ASSERT_TRUE(Writer->reopen(Group) == InitResult::OK);
+  std::vector<uint32_t> DimLengths{4, 2, 2};
+  for (size_t i = 0; i < 4; ++i) {
+    auto M = createTestMessage(0, i, DimLengths);
+    ASSERT_NO_THROW(Writer->write(wrapBuilder(M)));
+  }
+  ASSERT_FALSE(Group.nodes.exists("histograms"));
+  EXPECT_EQ(Group.get_dataset("sparse_offsets").dataspace().size(), 4);
+  EXPECT_EQ(Group.get_dataset("sparse_timestamps").dataspace().size(), 4);
+  auto Indices = Group.get_dataset("sparse_indices");
+  auto Values = Group.get_dataset("sparse_values");
+  ASSERT_EQ(Indices.dataspace().size(), 16);
+  std::vector<uint64_t> IndexBuffer(16);
+  std::vector<uint64_t> ValueBuffer(16);
+  Indices.read(IndexBuffer);
+  Values.read(ValueBuffer);
+  for (size_t i = 0; i < IndexBuffer.size(); ++i) {
+    EXPECT_EQ(ValueBuffer[i],
+              getValueAtFlatIndex(0, IndexBuffer[i], DimLengths));
+  }
+  std::vector<uint64_t> Latest(16);
+  Group.get_dataset("data").read(Latest);
+  for (size_t Flat = 0; Flat < Latest.size(); ++Flat) {
+    EXPECT_EQ(Latest[Flat], getValueAtFlatIndex(0, Flat, DimLengths));
+  }
+}
+
+TEST_F(EventHistogramWriter, AutoStorageSelectsDenseForDenseData) {
+  auto File =
+      createFile("Test.EventHistogramWriter.AutoStorageSelectsDenseForDense",
+                 FileCreationLocation::Default);
+  auto Group = File.root();
+  auto Json = createTestWriterTypedJson();
+  Json["storage"] = "auto";
+  auto Writer = hs00_Writer::create();
+  Writer->parse_config(Json.dump());
+  ASSERT_TRUE(Writer->init_hdf(Group, "{}") == InitResult::OK);
+  EXPECT_TRUE(Group.nodes.exists("histograms"));
+  EXPECT_FALSE(Group.nodes.exists("sparse_indices"));
+  std::vector<uint32_t> DimLengths{4, 2, 2};
+  for (size_t i = 0; i < 4; ++i) {
+    auto M = createTestMessage(0, i, DimLengths);
+    ASSERT_NO_THROW(Writer->write(wrapBuilder(M)));
+  }
+  hdf5::dataspace::Simple Dataspace(
+      Group.get_dataset("histograms").dataspace());
+  EXPECT_EQ(Dataspace.current_dimensions().at(0), 1u);
+}
+
+TEST_F(EventHistogramWriter, AutoStorageSelectsSparseForLowExpectedDensity) {
+  auto File = createFile(
+      "Test.EventHistogramWriter.AutoStorageSelectsSparseForLowDensity",
+      FileCreationLocation::Default);
+  auto Group = File.root();
+  auto Json = createTestWriterTypedJson();
+  Json["storage"] = "auto";
+  Json["expected_density"] = 0.01;
+  auto Writer = hs00_Writer::create();
+  Writer->parse_config(Json.dump());
+  ASSERT_TRUE(Writer->init_hdf(Group, "{}") == InitResult::OK);
+  EXPECT_FALSE(Group.nodes.exists("histograms"));
+  EXPECT_TRUE(Group.nodes.exists("sparse_indices"));
+  Writer = hs00_Writer::create();
+  Writer->parse_config(Json.dump());
+  ASSERT_TRUE(Writer->reopen(Group) == InitResult::OK);
+  std::vector<uint32_t> DimLengths{4, 2, 2};
+  for (size_t i = 0; i < 4; ++i) {
+    auto M = createTestMessage(0, i, DimLengths);
+    ASSERT_NO_THROW(Writer->write(wrapBuilder(M)));
+  }
+  EXPECT_EQ(Group.get_dataset("sparse_offsets").dataspace().size(), 4);
+}
+
+TEST_F(EventHistogramWriter, LatestDatasetIsCreatedWithTheOthers) {
+  // Datasets can not be created once the file is in SWMR mode.
+  for (std::string Storage : {"dense", "sparse"}) {
+    auto File = createFile("Test.EventHistogramWriter.LatestDataset" + Storage,
+                           FileCreationLocation::Default);
+    auto Group = File.root();
+    auto Json = createTestWriterTypedJson();
+    Json["storage"] = Storage;
+    auto Writer = hs00_Writer::create();
+    Writer->parse_config(Json.dump());
+    ASSERT_TRUE(Writer->init_hdf(Group, "{}") == InitResult::OK);
+    EXPECT_TRUE(Group.nodes.exists("data")) << Storage;
+  }
+}
+
+TEST_F(EventHistogramWriter, FileIsOnlyFlushedEachWriteIfConfigured) {
+  hs00_Writer Writer;
+  Writer.parse_config(createTestWriterTypedJson().dump());
+  EXPECT_FALSE(Writer.DoFlushEachWrite);
+  auto Json = createTestWriterTypedJson();
+  Json["flush_each_write"] = true;
+  Writer.parse_config(Json.dump());
+  EXPECT_TRUE(Writer.DoFlushEachWrite);
+}
+
 TEST_F(EventHistogramWriter, WriteAMORExample) {
   auto File = createFile("Test.EventHistogramWriter.WriteAMORExample",
                          FileCreationLocation::Default);
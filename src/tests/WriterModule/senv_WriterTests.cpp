@@ -229,3 +229,110 @@ TEST_F(FastSampleEnvironmentWriter, WriteDataWithNoTimestampsInFB) {
   EXPECT_NO_THROW(CueTimestampZeroDataset.read(CueTimestamp));
   EXPECT_EQ(CueTimestamp.at(0), FbPointer->PacketTimestamp());
 }
+
+TEST_F(FastSampleEnvironmentWriter, WriteDataWithPacketLayout) {
+  size_t BufferSize;
+  auto Buffer = GenerateFlatbufferData(BufferSize);
+  auto TimestampsLengthPtr =
+      reinterpret_cast<flatbuffers::uoffset_t *>(const_cast<std::uint8_t *>(
+          GetSampleEnvironmentData(Buffer.get())->Timestamps()->Data())) -
+      1;
+  *TimestampsLengthPtr = 0;
+  WriterModule::senv::senv_Writer Writer;
+  Writer.parse_config(R"({"layout": "packets"})");
+  EXPECT_TRUE(Writer.init_hdf(UsedGroup, "{}") == InitResult::OK);
+  EXPECT_TRUE(Writer.reopen(UsedGroup) == InitResult::OK);
+  FileWriter::FlatbufferMessage TestMsg(Buffer.get(), BufferSize);
+  EXPECT_NO_THROW(Writer.write(TestMsg));
+  EXPECT_NO_THROW(Writer.write(TestMsg));
+  EXPECT_FALSE(UsedGroup.has_dataset("time"));
+  auto FbPointer = GetSampleEnvironmentData(TestMsg.data());
+
+  auto RawValuesDataset = UsedGroup.get_dataset("raw_value");
+  EXPECT_EQ(RawValuesDataset.dataspace().size(),
+            2 * FbPointer->Values()->size());
+
+  std::vector<std::uint32_t> CueIndex(2);
+  UsedGroup.get_dataset("cue_index").read(CueIndex);
+  EXPECT_EQ(CueIndex.at(0), 0u);
+  EXPECT_EQ(CueIndex.at(1), FbPointer->Values()->size());
+
+  std::vector<double> TimeDelta(2);
+  UsedGroup.get_dataset("time_delta").read(TimeDelta);
+  EXPECT_EQ(TimeDelta.at(0), FbPointer->TimeDelta());
+  EXPECT_EQ(TimeDelta.at(1), FbPointer->TimeDelta());
+}
+
+TEST_F(FastSampleEnvironmentWriter, UnevenTimestampsAreKeptInPacketLayout) {
+  size_t BufferSize;
+  auto Buffer = GenerateFlatbufferData(BufferSize);
+  WriterModule::senv::senv_Writer Writer;
+  Writer.parse_config(R"({"layout": "packets"})");
+  EXPECT_TRUE(Writer.init_hdf(UsedGroup, "{}") == InitResult::OK);
+  EXPECT_TRUE(Writer.reopen(UsedGroup) == InitResult::OK);
+  FileWriter::FlatbufferMessage TestMsg(Buffer.get(), BufferSize);
+  EXPECT_NO_THROW(Writer.write(TestMsg));
+  auto FbPointer = GetSampleEnvironmentData(TestMsg.data());
+  auto NrOfSamples = FbPointer->Values()->size();
+
+  // Every sample is written as a packet of its own.
+  std::vector<std::uint32_t> CueIndex(NrOfSamples);
+  UsedGroup.get_dataset("cue_index").read(CueIndex);
+  std::vector<std::uint64_t> CueTimestamp(NrOfSamples);
+  UsedGroup.get_dataset("cue_timestamp_zero").read(CueTimestamp);
+  std::vector<double> TimeDelta(NrOfSamples);
+  UsedGroup.get_dataset("time_delta").read(TimeDelta);
+  for (size_t i = 0; i < NrOfSamples; ++i) {
+    EXPECT_EQ(CueIndex.at(i), i);
+    EXPECT_EQ(CueTimestamp.at(i), FbPointer->Timestamps()->operator[](i));
+    EXPECT_EQ(TimeDelta.at(i), 0.0);
+  }
+  EXPECT_EQ(UsedGroup.get_dataset("raw_value").dataspace().size(),
+            NrOfSamples);
+}
+
+TEST_F(FastSampleEnvironmentWriter, JitteredTimestampsAreOnePacket) {
+  flatbuffers::FlatBufferBuilder Builder;
+  std::vector<std::uint16_t> Values{0, 1, 2, 3, 4, 5};
+  std::uint64_t const PacketTimestamp{1600000000000000000};
+  std::vector<std::int64_t> Jitter{0, 4, -3, 2, -5, 1};
+  std::vector<std::uint64_t> Timestamps;
+  for (size_t i = 0; i < Values.size(); ++i) {
+    Timestamps.push_back(PacketTimestamp + 100 * i + Jitter[i]);
+  }
+  auto ValuesOffset = Builder.CreateVector(Values);
+  auto TimestampsOffset = Builder.CreateVector(Timestamps);
+  auto NameOffset = Builder.CreateString("SomeTestString");
+  SampleEnvironmentDataBuilder MessageBuilder(Builder);
+  MessageBuilder.add_Name(NameOffset);
+  MessageBuilder.add_Values(ValuesOffset);
+  MessageBuilder.add_Timestamps(TimestampsOffset);
+  MessageBuilder.add_PacketTimestamp(PacketTimestamp);
+  MessageBuilder.add_TimeDelta(100.0);
+  Builder.Finish(MessageBuilder.Finish(), SampleEnvironmentDataIdentifier());
+  FileWriter::FlatbufferMessage TestMsg(Builder.GetBufferPointer(),
+                                        Builder.GetSize());
+
+  WriterModule::senv::senv_Writer Writer;
+  Writer.parse_config(R"({"layout": "packets"})");
+  EXPECT_TRUE(Writer.init_hdf(UsedGroup, "{}") == InitResult::OK);
+  EXPECT_TRUE(Writer.reopen(UsedGroup) == InitResult::OK);
+  EXPECT_NO_THROW(Writer.write(TestMsg));
+  EXPECT_EQ(UsedGroup.get_dataset("cue_index").dataspace().size(), 1);
+  std::vector<std::uint64_t> CueTimestamp(1);
+  UsedGroup.get_dataset("cue_timestamp_zero").read(CueTimestamp);
+  EXPECT_EQ(CueTimestamp.at(0), PacketTimestamp);
+  EXPECT_EQ(UsedGroup.get_dataset("raw_value").dataspace().size(),
+            Values.size());
+
+  // Jitter beyond the tolerance writes a packet per sample.
+  WriterModule::senv::senv_Writer StrictWriter;
+  StrictWriter.parse_config(
+      R"({"layout": "packets", "timestamp_tolerance": 0.01})");
+  auto StrictGroup = RootGroup.create_group("StrictGroup");
+  EXPECT_TRUE(StrictWriter.init_hdf(StrictGroup, "{}") == InitResult::OK);
+  EXPECT_TRUE(StrictWriter.reopen(StrictGroup) == InitResult::OK);
+  EXPECT_NO_THROW(StrictWriter.write(TestMsg));
+  EXPECT_EQ(StrictGroup.get_dataset("cue_index").dataspace().size(),
+            static_cast<hssize_t>(Values.size()));
+}
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: BSD-2-Clause
+//
+// This code has been produced by the European Spallation Source
+// and its partner institutes under the BSD 2 Clause License.
+//
+// See LICENSE.md at the top level for license information.
+//
+// Screaming Udder!                              https://esss.se
+
+#include "WriterModule/NDAr/NDAr_Writer.h"
+#include "WriterModule/ev42/ev42_Writer.h"
+#include "WriterModule/f142/f142_Writer.h"
+#include "WriterModuleConfig.h"
+#include <chrono>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <iostream>
+
+using namespace WriterModule;
+
+TEST(WriterModuleConfig, InvalidJsonIsNotParsed) {
+  EXPECT_FALSE(parseConfig("{\"chunk_kb\": ").has_value());
+  EXPECT_TRUE(parseConfig("{\"chunk_kb\": 1}").has_value());
+}
+
+TEST(WriterModuleConfig, NestedValueIsFound) {
+  auto Config = *parseConfig(R"({"nexus": {"chunk": {"chunk_kb": 42}}})");
+  auto Value = findValue(Config, {"nexus", "chunk", "chunk_kb"});
+  ASSERT_NE(Value, nullptr);
+  EXPECT_EQ(Value->get<int>(), 42);
+  EXPECT_EQ(findValue(Config, {"nexus", "chunk", "chunk_mb"}), nullptr);
+  EXPECT_EQ(findValue(Config, {"nexus", "chunk", "chunk_kb", "more"}),
+            nullptr);
+}
+
+TEST(WriterModuleConfig, SettingsOfTheRightTypeAreApplied) {
+  auto Config = *parseConfig(
+      R"({"nexus.chunk_size": 1024, "value_units": "m", "debug": true})");
+  uint64_t ChunkSize{0};
+  std::optional<std::string> Units;
+  bool Debug{false};
+  double NotPresent{1.5};
+  ConfigSchema Schema;
+  Schema.add({"nexus.chunk_size"}, ChunkSize)
+      .add({"value_units"}, Units)
+      .add({"debug"}, Debug)
+      .add({"not_present"}, NotPresent);
+  EXPECT_TRUE(Schema.apply(Config).empty());
+  EXPECT_EQ(ChunkSize, 1024u);
+  EXPECT_EQ(Units, "m");
+  EXPECT_TRUE(Debug);
+  EXPECT_EQ(NotPresent, 1.5);
+}
+
+TEST(WriterModuleConfig, SettingOfTheWrongTypeIsReportedAndNotApplied) {
+  auto Config = *parseConfig(R"({"nexus": {"chunk_kb": "large"}})");
+  uint64_t ChunkSize{64};
+  ConfigSchema Schema;
+  Schema.add({"nexus", "chunk_kb"}, ChunkSize);
+  auto Errors = Schema.apply(Config);
+  ASSERT_EQ(Errors.size(), 1u);
+  EXPECT_EQ(Errors.front(), "The setting \"nexus/chunk_kb\" should be an "
+                            "unsigned integer, not \"large\".");
+  EXPECT_EQ(ChunkSize, 64u);
+}
+
+TEST(WriterModuleConfig, NegativeValueIsNotAnUnsignedInteger) {
+  auto Config = *parseConfig(R"({"array_size": -1})");
+  size_t ArraySize{1};
+  ConfigSchema Schema;
+  Schema.add({"array_size"}, ArraySize);
+  EXPECT_EQ(Schema.apply(Config).size(), 1u);
+  EXPECT_EQ(ArraySize, 1u);
+}
+
+TEST(WriterModuleConfig, IntegerOutOfRangeIsReportedAndNotApplied) {
+  auto Config = *parseConfig(R"({"threads": 5000000000, "offset": -129})");
+  std::uint32_t Threads{4};
+  std::int8_t Offset{0};
+  ConfigSchema Schema;
+  Schema.add({"threads"}, Threads).add({"offset"}, Offset);
+  auto Errors = Schema.apply(Config);
+  ASSERT_EQ(Errors.size(), 2u);
+  EXPECT_EQ(Errors.front(), "The setting \"threads\" should be an unsigned "
+                            "integer of at most 4294967295, not 5000000000.");
+  EXPECT_EQ(Threads, 4u);
+  EXPECT_EQ(Offset, 0);
+}
+
+TEST(WriterModuleConfig, ArrayIsAppliedIfEveryElementHasTheRightType) {
+  auto Config = *parseConfig(R"({"shape": [2, 3], "chunk": [2, -3]})");
+  std::vector<std::uint64_t> Shape;
+  std::vector<std::uint64_t> Chunk{64};
+  ConfigSchema Schema;
+  Schema.add({"shape"}, Shape).add({"chunk"}, Chunk);
+  EXPECT_EQ(Schema.apply(Config).size(), 1u);
+  EXPECT_EQ(Shape, std::vector<std::uint64_t>({2, 3}));
+  EXPECT_EQ(Chunk, std::vector<std::uint64_t>({64}));
+}
+
+TEST(WriterModuleConfig, WriterModulesDoNotThrowOnSettingsOfTheWrongType) {
+  f142::f142_Writer LogWriter;
+  EXPECT_NO_THROW(LogWriter.parse_config(
+      R"({"type": 42, "array_size": "many", "nexus.chunk_size": -1})"));
+  ev42::ev42_Writer EventWriter;
+  EXPECT_NO_THROW(EventWriter.parse_config(
+      R"({"nexus": {"indices": {"index_every_kb": "often"}},
+          "banks": [{"name": 1}, "bank"],
+          "event_filter": {"detector_id_ranges": 5}})"));
+  EXPECT_NO_THROW(EventWriter.parse_config(R"({"nexus": )"));
+}
+
+TEST(WriterModuleConfig, WriterModulesDoNotThrowOnInconsistentSettings) {
+  ev42::ev42_Writer EventWriter;
+  EXPECT_NO_THROW(EventWriter.parse_config(
+      R"({"banks": [
+            {"name": "a", "detector_id_min": 0, "detector_id_max": 10},
+            {"name": "b", "detector_id_min": 10, "detector_id_max": 20},
+            {"name": "c", "detector_id_min": 30, "detector_id_max": 25}]})"));
+  EXPECT_NO_THROW(EventWriter.parse_config(
+      R"({"event_filter": {"time_of_flight_min": 100,
+                           "time_of_flight_max": 10,
+                           "masked_detector_ids": [4000000000]}})"));
+  NDAr::NDAr_Writer AreaDetectorWriter;
+  EXPECT_NO_THROW(AreaDetectorWriter.parse_config(
+      R"({"roi": {"offset": [0, 0], "size": [0, 4]}})"));
+  EXPECT_NO_THROW(AreaDetectorWriter.parse_config(
+      R"({"roi": {"offset": [0], "size": [4, 4]}})"));
+  EXPECT_NO_THROW(
+      AreaDetectorWriter.parse_config(R"({"binning": [65536, 65536]})"));
+}
+
+/// Time parsing the configuration of the streams of a large job. Run with
+/// --gtest_also_run_disabled_tests.
+TEST(WriterModuleConfig, DISABLED_ParseConfigOf5000Streams) {
+  size_t const NrOfStreams{5000};
+  std::vector<std::string> Configs;
+  for (size_t i = 0; i < NrOfStreams; ++i) {
+    if (i % 2 == 0) {
+      Configs.push_back(
+          fmt::format(R"({{"topic": "motion", "source": "pv:{}", )"
+                      R"("writer_module": "f142", "type": "double", )"
+                      R"("value_units": "mm", "nexus.cue_interval": 1000, )"
+                      R"("nexus.chunk_size": 4096}})",
+                      i));
+    } else {
+      Configs.push_back(fmt::format(
+          R"({{"topic": "events", "source": "detector_{}", )"
+          R"("writer_module": "ev42", "adc_pulse_debug": false, )"
+          R"("nexus": {{"indices": {{"index_every_mb": 2}}, )"
+          R"("chunk": {{"chunk_mb": 1}}}}}})",
+          i));
+    }
+  }
+  auto Start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < NrOfStreams; ++i) {
+    if (i % 2 == 0) {
+      f142::f142_Writer Writer;
+      Writer.parse_config(Configs[i]);
+    } else {
+      ev42::ev42_Writer Writer;
+      Writer.parse_config(Configs[i]);
+    }
+  }
+  auto Duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - Start);
+  std::cout << fmt::format("Parsed the configuration of {} streams in {} us "
+                           "({:.1f} us per stream).\n",
+                           NrOfStreams, Duration.count(),
+                           double(Duration.count()) / NrOfStreams);
+}
@@ -23,6 +23,8 @@ public:
   IMPLEMENT_MOCK1(queryTopicPartitions);
   IMPLEMENT_MOCK0(poll);
   IMPLEMENT_MOCK3(addPartitionAtOffset);
+  IMPLEMENT_MOCK2(hasReachedHighWatermark);
+  IMPLEMENT_MOCK1(setWantedSources);
 };
 
 } // namespace Kafka